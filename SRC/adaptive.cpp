@@ -0,0 +1,111 @@
+/* File for the adaptive sampling period function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "adaptive.h"
+#include "alarms.h"
+#include "sensors_thread.h"
+#include "timebase.h"
+#include "float_only.h"
+
+// ==============================================================================================
+// DEADBAND TABLE (one row per adaptive channel)
+// ==============================================================================================
+// Change worth a sample, in the fixed-point units of message_t_sensors: each channel aims at one deadband per interval
+static constexpr int32_t DEADBAND[ADAPTIVE_CHANNELS] = {
+    10,                                                         // Temperature: 0.1 celsius
+    50,                                                         // Relative humidity: 0.5 %RH
+    20,                                                         // Soil moisture: 0.2 % (irrigation moves it by several % in minutes)
+    100,                                                        // Ambient light: 1 % (100 lux)
+};
+
+static const char CHANNEL_LETTER[ADAPTIVE_CHANNELS] = {'T', 'H', 'M', 'L'};
+
+MBED_STATIC_ASSERT(ADAPTIVE_CHANNELS <= ALARM_CH_COUNT && ALARM_CH_TEMPERATURE == 0 && ALARM_CH_HUMIDITY == 1 && ALARM_CH_MOISTURE == 2 && ALARM_CH_LIGHT == 3,
+                   "The adaptive channels are the first alarm_channel_t entries");
+// DEADBAND TABLE END ===========================================================================
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    int32_t previous;                                           // Last valid value
+    uint64_t previous_tick_us;                                  // 0 = no value yet
+    uint32_t rate;                                              // Rate of change estimate, milli-units per second
+    uint32_t interval_ms;                                       // Time for the rate to move the value by one deadband, within the limits
+} adaptive_state_t;
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+static adaptive_state_t state[ADAPTIVE_CHANNELS];               // Sensors' task only
+static volatile uint32_t period_ms = ADAPTIVE_MIN_PERIOD_MS;    // Shortest interval, read by the main thread for the stats
+static volatile uint32_t samples = 0;                           // NORMAL_MODE samples since the last stats
+static volatile uint64_t stats_tick_us = 0;                     // Start of the stats period, 0 until the first NORMAL_MODE sample
+
+// FUNCTION TO UPDATE THE INTERVAL OF ONE CHANNEL ==========================================================================
+static void update_channel(uint8_t ch, int32_t x, uint64_t tick_us, bool anomalous){
+    adaptive_state_t *s = &state[ch];
+    if(s->previous_tick_us == 0 || tick_us <= s->previous_tick_us){
+        s->previous = x;
+        s->previous_tick_us = tick_us;
+        s->interval_ms = ADAPTIVE_MIN_PERIOD_MS;                // Start fast until the rate is known
+        return;
+    }
+
+    // Rate of the last step: a faster one is taken at once, a slower one only pulls the estimate down by 1/4
+    uint32_t step = (uint32_t)((x > s->previous) ? x - s->previous : s->previous - x);
+    uint64_t rate = (uint64_t)step * 1000000000ULL / (tick_us - s->previous_tick_us);
+    uint32_t last_rate = (rate > UINT32_MAX) ? UINT32_MAX : (uint32_t)rate;
+    s->rate = (last_rate >= s->rate) ? last_rate : s->rate - ((s->rate - last_rate) >> ADAPTIVE_RELEASE_SHIFT);
+    s->previous = x;
+    s->previous_tick_us = tick_us;
+
+    // Interval for one deadband of change: shrinks at once, stretches by 5/4 per sample at most
+    uint64_t target = (s->rate > 0) ? (uint64_t)DEADBAND[ch] * 1000000ULL / s->rate : ADAPTIVE_MAX_PERIOD_MS;
+    uint64_t grown = (uint64_t)s->interval_ms * ADAPTIVE_GROWTH_NUM / ADAPTIVE_GROWTH_DEN;
+    uint64_t interval = anomalous ? ADAPTIVE_MIN_PERIOD_MS : ((target < grown) ? target : grown);
+    s->interval_ms = (interval < ADAPTIVE_MIN_PERIOD_MS) ? ADAPTIVE_MIN_PERIOD_MS : (interval > ADAPTIVE_MAX_PERIOD_MS) ? ADAPTIVE_MAX_PERIOD_MS : (uint32_t)interval;
+}
+
+// ==============================================================================================
+// PUBLIC FUNCTIONS
+// ==============================================================================================
+// All channels share one acquisition (one I2C scan, one message), so the shortest interval sets the period
+void adaptive_update(const message_t_sensors *sample){
+    int32_t values[ALARM_CH_COUNT];
+    alarms_channel_values(sample, values);
+
+    uint32_t shortest = ADAPTIVE_MAX_PERIOD_MS;
+    for(uint8_t ch = 0; ch < ADAPTIVE_CHANNELS; ch++){
+        if(alarms_channel_valid(sample, (alarm_channel_t)ch)){
+            update_channel(ch, values[ch], sample->tick_us, (sample->anomalies >> ch) & 1);  // An anomaly (step or outlier) falls back to the fastest rate
+        }
+        shortest = (state[ch].interval_ms > 0 && state[ch].interval_ms < shortest) ? state[ch].interval_ms : shortest;
+    }
+    core_util_atomic_store_u32(&period_ms, shortest);
+}
+
+std::chrono::milliseconds adaptive_period(){
+    if(core_util_atomic_load_u64(&stats_tick_us) == 0){
+        core_util_atomic_store_u64(&stats_tick_us, timebase_now_us());
+    }
+    core_util_atomic_incr_u32(&samples, 1);
+    return std::chrono::milliseconds(core_util_atomic_load_u32(&period_ms));
+}
+
+void adaptive_print_stats(){
+    uint64_t now_us = timebase_now_us();
+    uint64_t start_us = core_util_atomic_load_u64(&stats_tick_us);
+    uint32_t taken = core_util_atomic_exchange_u32(&samples, 0);
+    core_util_atomic_store_u64(&stats_tick_us, now_us);
+    uint32_t elapsed_s = (start_us > 0) ? (uint32_t)((now_us - start_us) / 1000000) : 0;
+    if(elapsed_s == 0){
+        return;
+    }
+
+    uint32_t fixed_per_hour = 3600000 / (uint32_t)std::chrono::milliseconds(NORMAL_MODE_SENSOR_THREAD_SLEEP).count();
+    printf("Adaptive sampling: %lu samples/h (fixed rate %lu/h), period %lu ms, intervals", (unsigned long)((uint64_t)taken * 3600 / elapsed_s),
+           (unsigned long)fixed_per_hour, (unsigned long)core_util_atomic_load_u32(&period_ms));
+    for(uint8_t ch = 0; ch < ADAPTIVE_CHANNELS; ch++){
+        printf(" %c %lu s", CHANNEL_LETTER[ch], (unsigned long)(state[ch].interval_ms / 1000));
+    }
+    printf("\n\r");
+}
+// PUBLIC FUNCTIONS END =========================================================================
@@ -0,0 +1,49 @@
+/* File for the adaptive sampling period function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// NORMAL_MODE period follows the signals instead of NORMAL_MODE_SENSOR_THREAD_SLEEP, from mbed_app.json
+#if defined(MBED_CONF_APP_ADAPTIVE_SAMPLING) && MBED_CONF_APP_ADAPTIVE_SAMPLING
+#define ADAPTIVE_ENABLED          1
+#else
+#define ADAPTIVE_ENABLED          0
+#endif
+
+#ifdef MBED_CONF_APP_ADAPTIVE_MIN_PERIOD_MS
+#define ADAPTIVE_MIN_PERIOD_MS    MBED_CONF_APP_ADAPTIVE_MIN_PERIOD_MS
+#else
+#define ADAPTIVE_MIN_PERIOD_MS    2000
+#endif
+
+#ifdef MBED_CONF_APP_ADAPTIVE_MAX_PERIOD_MS
+#define ADAPTIVE_MAX_PERIOD_MS    MBED_CONF_APP_ADAPTIVE_MAX_PERIOD_MS
+#else
+#define ADAPTIVE_MAX_PERIOD_MS    600000                        // 10 minutes
+#endif
+
+#define ADAPTIVE_GROWTH_NUM       5                             // A quiet channel stretches its interval by 5/4 per sample...
+#define ADAPTIVE_GROWTH_DEN       4
+#define ADAPTIVE_RELEASE_SHIFT    2                             // ...and its rate estimate decays by 1/4 per sample, while a faster change is taken at once
+#define ADAPTIVE_CHANNELS         4                             // Temperature, humidity, soil moisture and light (first alarm_channel_t entries)
+
+MBED_STATIC_ASSERT(ADAPTIVE_MIN_PERIOD_MS > 0 && ADAPTIVE_MIN_PERIOD_MS <= ADAPTIVE_MAX_PERIOD_MS, "adaptive-min-period-ms must be above 0 and below adaptive-max-period-ms");
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void adaptive_update(const message_t_sensors *sample);           // Sensors' task, every probe 0 sample: rate of change and interval of each channel
+std::chrono::milliseconds adaptive_period();                     // Shortest channel interval, the wait after a NORMAL_MODE sample (counted for the stats)
+void adaptive_print_stats();                                     // Samples per hour since the last call, against the fixed NORMAL_MODE rate, and channel intervals
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,144 @@
+/* File for the alarm rule table function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "alarms.h"
+#include "float_only.h"
+
+// ==============================================================================================
+// RULE TABLE (adding an alarm only needs a new row here)
+// ==============================================================================================
+static constexpr alarm_rule_t ALARM_RULES[] = {
+    // channel             low     high    hyst  qualify  actions                                     LED               name
+    {ALARM_CH_TEMPERATURE, -1000,  5000,   50,   1,       ALARM_ACTION_LED | ALARM_ACTION_LOG,        ALARM_LED_RED,    "Temperature"},
+    {ALARM_CH_HUMIDITY,     2500,  7500,   100,  1,       ALARM_ACTION_LED | ALARM_ACTION_LOG,        ALARM_LED_BLUE,   "Relative humidity"},
+    {ALARM_CH_MOISTURE,     1000,  10000,  200,  3,       ALARM_ACTION_LOG | ALARM_ACTION_PRIORITY,   ALARM_LED_OFF,    "Soil moisture"},
+};
+
+static constexpr uint8_t ALARM_RULE_COUNT = sizeof(ALARM_RULES) / sizeof(ALARM_RULES[0]);
+
+// COMPILE-TIME TABLE CHECK ----------------------------------------------------------------------
+static constexpr bool alarm_rule_valid(const alarm_rule_t &rule){
+    return (rule.channel < ALARM_CH_COUNT)
+        && (rule.low <= rule.high)
+        && (rule.hysteresis >= 0)
+        && (2 * rule.hysteresis <= rule.high - rule.low)            // The clear band must not be empty
+        && (rule.qualify_samples >= 1)
+        && (rule.actions != 0)
+        && (rule.led_pattern <= ALARM_LED_OFF);
+}
+
+static constexpr bool alarm_rules_valid(uint8_t index = 0){
+    return (index >= ALARM_RULE_COUNT) || (alarm_rule_valid(ALARM_RULES[index]) && alarm_rules_valid(index + 1));
+}
+
+MBED_STATIC_ASSERT(ALARM_RULE_COUNT <= ALARM_MAX_RULES, "Too many alarm rules for the 16-bit active mask");
+MBED_STATIC_ASSERT(alarm_rules_valid(), "Invalid alarm rule in ALARM_RULES");
+// RULE TABLE END ===============================================================================
+
+// Validity bit of each channel in message_t_sensors.valid
+static constexpr uint8_t CHANNEL_VALID_BIT[ALARM_CH_COUNT] = {
+    MSG_VALID_TEMPERATURE, MSG_VALID_HUMIDITY, MSG_VALID_MOISTURE, MSG_VALID_LIGHT,
+    MSG_VALID_COLOUR, MSG_VALID_ACCEL, MSG_VALID_ACCEL, MSG_VALID_ACCEL
+};
+
+// STATIC VARIABLES (only touched by the producer thread) ------------------------------------------------------------------
+static uint8_t out_of_range_count[ALARM_RULE_COUNT];            // Consecutive out-of-range samples per rule
+static uint16_t active_mask = 0;                                // Active alarms, bit i is ALARM_RULES[i]
+
+// FUNCTION TO EXTRACT THE CHANNEL VALUES OF A SAMPLE ======================================================================
+void alarms_channel_values(const message_t_sensors *sample, int32_t values[ALARM_CH_COUNT]){
+    values[ALARM_CH_TEMPERATURE] = sample->temperature;
+    values[ALARM_CH_HUMIDITY]    = sample->humidity;
+    values[ALARM_CH_MOISTURE]    = sample->moistPercAnalogValue;
+    values[ALARM_CH_LIGHT]       = sample->lightPercAnalogValue;
+    values[ALARM_CH_CLEAR]       = sample->clear;
+    values[ALARM_CH_AX]          = sample->ax;
+    values[ALARM_CH_AY]          = sample->ay;
+    values[ALARM_CH_AZ]          = sample->az;
+}
+
+// FUNCTION TO EVALUATE ALL RULES ON A SAMPLE ==============================================================================
+uint16_t alarms_evaluate(const message_t_sensors *sample){
+    int32_t values[ALARM_CH_COUNT];
+    alarms_channel_values(sample, values);
+
+    uint16_t next_mask = 0;
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++){
+        const alarm_rule_t &rule = ALARM_RULES[i];
+        int32_t value = values[rule.channel];
+        uint8_t valid = alarms_channel_valid(sample, rule.channel);
+
+        // Boolean arithmetic instead of nested ifs: one pass, no data dependent branches
+        uint8_t out = (value < rule.low) | (value > rule.high);
+        uint8_t inside_clear_band = valid & (value >= rule.low + rule.hysteresis) & (value <= rule.high - rule.hysteresis);
+        uint8_t count = (uint8_t)((out_of_range_count[i] + (out_of_range_count[i] < UINT8_MAX)) * out);  // Saturating counter, reset when back in range
+        count = valid ? count : out_of_range_count[i];               // A failed read neither raises nor clears: the rule holds its state
+        out_of_range_count[i] = count;
+
+        uint8_t was_active = (active_mask >> i) & 1;
+        uint8_t is_active = (was_active & !inside_clear_band) | (!was_active & (count >= rule.qualify_samples));
+        next_mask |= (uint16_t)(is_active << i);
+    }
+
+    active_mask = next_mask;
+    return active_mask;
+}
+
+// FUNCTION TO CHECK IF THE READ OF A CHANNEL SUCCEEDED ====================================================================
+bool alarms_channel_valid(const message_t_sensors *sample, alarm_channel_t channel){
+    return (sample->valid & CHANNEL_VALID_BIT[channel]) != 0;
+}
+
+// FUNCTION TO CHECK IF A NEWLY RAISED ALARM IS A PRIORITY ONE =============================================================
+bool alarms_is_priority(uint16_t active, uint16_t previous){
+    uint16_t raised = active & ~previous;
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++){
+        if((raised >> i) & 1 && (ALARM_RULES[i].actions & ALARM_ACTION_PRIORITY)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// FUNCTION TO GET THE RGB PATTERN OF THE ACTIVE ALARMS ====================================================================
+uint8_t alarms_led_pattern(uint16_t active){
+    uint8_t pattern = ALARM_LED_OFF;
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++){              // Later rows override earlier ones, as %RH used to override T
+        if((active >> i) & 1 && (ALARM_RULES[i].actions & ALARM_ACTION_LED)){
+            pattern = ALARM_RULES[i].led_pattern;
+        }
+    }
+    return pattern;
+}
+
+// FUNCTION TO PRINT THE ALARM TRANSITIONS =================================================================================
+void alarms_log(uint16_t active, uint16_t previous){
+    uint16_t changed = active ^ previous;
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++){
+        if((changed >> i) & 1 && (ALARM_RULES[i].actions & ALARM_ACTION_LOG)){
+            printf("ALARM %s: %s\n\r", ((active >> i) & 1) ? "RAISED" : "CLEARED", ALARM_RULES[i].name);
+        }
+    }
+}
+
+// FUNCTION TO CHECK IF A CHANNEL HAS AN ACTIVE ALARM ======================================================================
+bool alarms_channel_active(uint16_t active, alarm_channel_t channel){
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++){
+        if((active >> i) & 1 && ALARM_RULES[i].channel == channel){
+            return true;
+        }
+    }
+    return false;
+}
+
+// FUNCTION TO CHECK A SINGLE VALUE AGAINST THE RULE RANGES OF ITS CHANNEL =================================================
+bool alarms_in_range(alarm_channel_t channel, int32_t value){
+    bool in_range = true;
+    for(uint8_t i = 0; i < ALARM_RULE_COUNT; i++){
+        if(ALARM_RULES[i].channel == channel){
+            in_range = in_range && value >= ALARM_RULES[i].low && value <= ALARM_RULES[i].high;
+        }
+    }
+    return in_range;
+}
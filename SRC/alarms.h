@@ -0,0 +1,69 @@
+/* File for the alarm rule table function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef ALARMS_H
+#define ALARMS_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Actions of a rule (can be OR-ed)
+#define ALARM_ACTION_LED      0x01                              // Drive the RGB LED with the rule pattern while the alarm is active
+#define ALARM_ACTION_LOG      0x02                              // Print a line when the alarm is raised or cleared
+#define ALARM_ACTION_PRIORITY 0x04                              // Send the sample as a priority message and report it immediately
+
+// RGB patterns (active low: bit 0 = red, bit 1 = green, bit 2 = blue)
+#define ALARM_LED_OFF         0b111
+#define ALARM_LED_RED         0b110
+#define ALARM_LED_GREEN       0b101
+#define ALARM_LED_BLUE        0b011
+#define ALARM_LED_YELLOW      0b100
+
+#define ALARM_MAX_RULES       16                                // Width of the active alarms bitmask carried in message_t_sensors
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// Channels a rule can watch, values are in the fixed-point units of message_t_sensors
+typedef enum {
+    ALARM_CH_TEMPERATURE,                                        // centi-celsius
+    ALARM_CH_HUMIDITY,                                           // centi-%RH
+    ALARM_CH_MOISTURE,                                           // centi-%
+    ALARM_CH_LIGHT,                                              // centi-%
+    ALARM_CH_CLEAR,                                              // raw TCS34725 clear counts
+    ALARM_CH_AX,                                                 // raw MMA8451Q counts
+    ALARM_CH_AY,
+    ALARM_CH_AZ,
+    ALARM_CH_COUNT
+} alarm_channel_t;
+
+typedef struct {
+    alarm_channel_t channel;                                     // Watched channel
+    int32_t low, high;                                           // Valid range [low, high] in channel units
+    int32_t hysteresis;                                          // The value must be back inside [low + hysteresis, high - hysteresis] to clear
+    uint8_t qualify_samples;                                     // Consecutive out-of-range samples needed to raise the alarm
+    uint8_t actions;                                             // ALARM_ACTION_* mask
+    uint8_t led_pattern;                                         // RGB pattern used with ALARM_ACTION_LED
+    const char *name;                                            // Name used by ALARM_ACTION_LOG
+} alarm_rule_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+uint16_t alarms_evaluate(const message_t_sensors *sample);          // Producer side: one pass over the rules per sample, returns the active mask
+bool alarms_is_priority(uint16_t active, uint16_t previous);        // True if a newly raised alarm has ALARM_ACTION_PRIORITY
+uint8_t alarms_led_pattern(uint16_t active);                        // RGB pattern of the last active rule with ALARM_ACTION_LED
+void alarms_log(uint16_t active, uint16_t previous);                // Print the raise/clear transitions of rules with ALARM_ACTION_LOG
+bool alarms_channel_active(uint16_t active, alarm_channel_t channel); // True if any active alarm watches the channel
+bool alarms_in_range(alarm_channel_t channel, int32_t value);       // True if the value is inside every rule range of the channel
+void alarms_channel_values(const message_t_sensors *sample, int32_t values[ALARM_CH_COUNT]);  // Channel values of a sample, indexed by alarm_channel_t
+bool alarms_channel_valid(const message_t_sensors *sample, alarm_channel_t channel);        // False if the read of the channel failed
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,101 @@
+/* File for the streaming anomaly detector function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "anomaly.h"
+#include "float_only.h"
+
+// ==============================================================================================
+// LIMITS TABLE (one row per alarm_channel_t)
+// ==============================================================================================
+// The step allowed between two samples grows with the time between them, so a long sampling period (adaptive.h) does not
+// turn a slow drift into a step anomaly that would in turn force the fastest period
+static constexpr anomaly_limits_t LIMITS[] = {
+    // min_variance  max_step  max_rate
+    {100,            200,      100},                            // Temperature: 0.1 celsius noise, 2 celsius step, 1 celsius per minute
+    {2500,           1000,     500},                            // Relative humidity: 0.5 %RH noise, 10 %RH step, 5 %RH per minute
+    {2500,           1500,     100},                            // Soil moisture: 0.5 % noise, 15 % step (watering or a probe out of the soil), 1 % per minute
+    {10000,          3000,     1000},                           // Ambient light: 1 % noise, 30 % step, 10 % per minute (dawn, dusk)
+    {2500,           20000,    5000},                           // Clear counts
+    {1024,           2048,     0},                              // ax: 32 counts (8 mg) noise, 0.5 g step whatever the time (tilt or knock)
+    {1024,           2048,     0},                              // ay
+    {1024,           2048,     0},                              // az
+};
+
+static const char *const CHANNEL_NAME[] = {"Temperature", "Relative humidity", "Soil moisture", "Ambient light", "Clear light", "ax", "ay", "az"};
+
+MBED_STATIC_ASSERT(sizeof(LIMITS) / sizeof(LIMITS[0]) == ALARM_CH_COUNT, "One LIMITS row per alarm_channel_t");
+MBED_STATIC_ASSERT(sizeof(CHANNEL_NAME) / sizeof(CHANNEL_NAME[0]) == ALARM_CH_COUNT, "One CHANNEL_NAME per alarm_channel_t");
+MBED_STATIC_ASSERT(ALARM_CH_COUNT <= 8, "The anomaly mask is 8 bits wide");
+// LIMITS TABLE END =============================================================================
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    int32_t mean_q;                                             // EWMA mean, Q8 channel units
+    uint32_t variance;                                          // EWMA variance, channel units^2
+    int32_t previous;                                           // Previous valid sample, for the rate-of-change check
+    uint32_t previous_ms;                                       // Its acquisition tick in ms, wraps after 49 days but differences stay right
+    uint8_t samples;                                            // Valid samples seen, saturates at ANOMALY_WARMUP_SAMPLES
+} anomaly_state_t;
+
+// STATIC VARIABLES (only touched by the producer thread) ------------------------------------------------------------------
+static anomaly_state_t state[ALARM_CH_COUNT];
+
+// FUNCTION TO SCORE A SAMPLE AND UPDATE THE ESTIMATES =====================================================================
+uint8_t anomaly_evaluate(const message_t_sensors *sample){
+    int32_t values[ALARM_CH_COUNT];
+    alarms_channel_values(sample, values);
+
+    uint8_t anomalies = 0;
+    for(uint8_t ch = 0; ch < ALARM_CH_COUNT; ch++){
+        if(!alarms_channel_valid(sample, (alarm_channel_t)ch)){
+            continue;                                           // A failed read is not scored and does not move the estimates
+        }
+
+        anomaly_state_t *s = &state[ch];
+        int32_t x = values[ch];
+        if(s->samples == 0){
+            s->mean_q = x * (1 << ANOMALY_MEAN_FRAC_BITS);      // First sample seeds the estimates
+            s->variance = LIMITS[ch].min_variance;
+            s->previous = x;
+            s->previous_ms = (uint32_t)(sample->tick_us / 1000);
+            s->samples = 1;
+            continue;
+        }
+
+        // Tests use the estimates of the past samples only
+        int32_t diff_q = x * (1 << ANOMALY_MEAN_FRAC_BITS) - s->mean_q;
+        int32_t diff = diff_q / (1 << ANOMALY_MEAN_FRAC_BITS);
+        uint64_t diff2 = (uint64_t)((int64_t)diff * diff);
+        uint32_t variance = (s->variance > LIMITS[ch].min_variance) ? s->variance : LIMITS[ch].min_variance;
+
+        uint8_t z_out = (s->samples >= ANOMALY_WARMUP_SAMPLES) & (diff2 > (uint64_t)ANOMALY_Z_LIMIT * ANOMALY_Z_LIMIT * variance);  // z^2 > Z^2, no square root
+        uint32_t now_ms = (uint32_t)(sample->tick_us / 1000);
+        uint32_t elapsed_ms = now_ms - s->previous_ms;
+        int64_t max_step = LIMITS[ch].max_step + (int64_t)LIMITS[ch].max_rate * elapsed_ms / ANOMALY_RATE_PERIOD_MS;
+        int32_t step = x - s->previous;
+        uint8_t step_out = (step > max_step) | (step < -max_step);
+        anomalies |= (uint8_t)((z_out | step_out) << ch);
+
+        // EWMA update: mean += a * d, variance = (1 - a) * (variance + a * d^2), with a = 2^-ANOMALY_EWMA_SHIFT
+        s->mean_q += diff_q / (1 << ANOMALY_EWMA_SHIFT);
+        uint64_t next_variance = s->variance + (diff2 >> ANOMALY_EWMA_SHIFT);
+        next_variance -= next_variance >> ANOMALY_EWMA_SHIFT;
+        s->variance = (next_variance > UINT32_MAX) ? UINT32_MAX : (uint32_t)next_variance;
+        s->previous = x;
+        s->previous_ms = now_ms;
+        s->samples += (s->samples < ANOMALY_WARMUP_SAMPLES);
+    }
+
+    return anomalies;
+}
+
+// FUNCTION TO PRINT THE NEW ANOMALIES =====================================================================================
+void anomaly_log(uint8_t anomalies, uint8_t previous){
+    uint8_t raised = anomalies & ~previous;
+    for(uint8_t ch = 0; ch < ALARM_CH_COUNT; ch++){
+        if((raised >> ch) & 1){
+            printf("ANOMALY: %s\n\r", CHANNEL_NAME[ch]);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/* File for the streaming anomaly detector function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+#include "alarms.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#define ANOMALY_EWMA_SHIFT      4                               // EWMA weight 1/16: mean and variance follow ~16 samples
+#define ANOMALY_MEAN_FRAC_BITS  8                               // Mean kept in Q8 channel units
+#define ANOMALY_Z_LIMIT         4                               // |x - mean| above 4 standard deviations is an anomaly
+#define ANOMALY_WARMUP_SAMPLES  16                              // No z-score test until the estimates have settled
+#define ANOMALY_LED_PATTERN     0b010                           // Magenta (red + blue, active low)
+#define ANOMALY_RATE_PERIOD_MS  60000                           // max_rate is per minute
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// Per-channel limits, in the fixed-point units of message_t_sensors (see alarm_channel_t)
+typedef struct {
+    uint32_t min_variance;                                       // Noise floor (units^2), keeps a flat signal from flagging its first LSB of noise
+    int32_t max_step;                                            // Largest plausible change between two samples close in time (sensor noise and jitter)
+    int32_t max_rate;                                            // Largest plausible drift per minute, added over the time between the two samples
+} anomaly_limits_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+uint8_t anomaly_evaluate(const message_t_sensors *sample);       // Producer side, O(1) per channel: bit c set if channel c (alarm_channel_t) is anomalous
+void anomaly_log(uint8_t anomalies, uint8_t previous);           // Print the channels that just became anomalous
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,236 @@
+/* File for the accelerometer black-box recorder function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include <algorithm>
+#include <stddef.h>
+#include "blackbox.h"
+#include "persist.h"
+#include "timebase.h"
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+// Window around a trigger, also the flash record (PERSIST_SLOT_BLACKBOX): samples[0] is the oldest once frozen
+typedef struct {
+    uint64_t trigger_tick_us;                                   // Tick of the MMA8451Q interrupt
+    uint8_t event;                                              // blackbox_event_t
+    uint8_t rate_hz;                                            // MMA8451_ODR_HZ
+    uint16_t pre_samples;                                       // Samples before the trigger, samples[pre_samples] is the trigger one
+    uint16_t count;                                             // Samples in the window
+    uint16_t overflows;                                         // FIFO overflows while recording (gaps in the window)
+} blackbox_header_t;
+
+typedef struct {
+    blackbox_header_t header;
+    int16_t samples[BLACKBOX_SAMPLES][3];                       // Raw counts, MMA8451_COUNTS_PER_G
+} blackbox_record_t;
+
+typedef enum {
+    BLACKBOX_RECORDING,                                         // Ring overwritten continuously
+    BLACKBOX_TRIGGERED,                                         // Recording the post-trigger samples
+    BLACKBOX_FROZEN,                                            // Window complete and unwrapped, dumped and saved as often as asked until BLACKBOX_HOLD_TIME
+    BLACKBOX_DUMPING                                            // Frozen window printed without the lock, the sensors' task leaves it and the interrupts alone
+} blackbox_state_t;
+
+MBED_STATIC_ASSERT(PERSIST_FITS(sizeof(blackbox_record_t), PERSIST_BLACKBOX_SIZE), "The black-box window does not fit its flash slot");
+MBED_STATIC_ASSERT(MMA8451_ODR_HZ <= UINT8_MAX, "rate_hz is 8-bit");
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+static blackbox_record_t record;                                // The ring while recording, the window once frozen
+static blackbox_state_t state = BLACKBOX_RECORDING;
+static uint32_t total = 0;                                      // Samples written since the ring was armed, the next one goes to total % BLACKBOX_SAMPLES
+static uint32_t trigger_index = 0;                              // Trigger sample, counted like total
+static uint64_t armed_tick_us = 0;                              // Interrupts older than this belong to a window already dropped
+static uint64_t frozen_tick_us = 0;
+static bool announced = false;                                  // Frozen window printed on the terminal
+static Mutex ring_mutex;                                        // Written by the sensors' task, frozen, dumped and saved by the main thread
+
+// Last interrupt, set by the ISRs (a freefall is never replaced by a tap)
+static volatile uint8_t pending_event = BLACKBOX_EVENT_NONE;
+static volatile uint64_t pending_tick_us = 0;
+
+static const char EVENT_NAME[3][9] = {"none", "tap", "freefall"};
+
+// FUNCTION TO START RECORDING AGAIN (lock held) ===========================================================================
+static void arm(){
+    memset(&record.header, 0, sizeof(record.header));
+    total = 0;
+    state = BLACKBOX_RECORDING;
+    announced = false;
+    armed_tick_us = timebase_now_us();
+}
+
+// FUNCTION TO TAKE THE INTERRUPT TO ACT ON, IF ANY (lock held) ============================================================
+static blackbox_event_t take_pending(uint64_t read_tick_us, uint64_t *tick_us){
+    blackbox_event_t event = BLACKBOX_EVENT_NONE;
+    core_util_critical_section_enter();                         // 64-bit tick written by an ISR
+    if(pending_event != BLACKBOX_EVENT_NONE && pending_tick_us <= read_tick_us){  // Later ones wait for the samples around them
+        if(pending_tick_us >= armed_tick_us){
+            event = (blackbox_event_t)pending_event;
+            *tick_us = pending_tick_us;
+        }
+        pending_event = BLACKBOX_EVENT_NONE;
+    }
+    core_util_critical_section_exit();
+    return event;
+}
+
+// FUNCTION TO PLACE THE TRIGGER AMONG THE SAMPLES (lock held) =============================================================
+// The newest sample of the batch was taken at most one ODR period before read_tick_us, the trigger is counted back from it
+static void trigger(blackbox_event_t event, uint64_t tick_us, uint8_t count, uint64_t read_tick_us){
+    uint32_t back = (uint32_t)(((read_tick_us - tick_us) * MMA8451_ODR_HZ + 500000) / 1000000);
+    uint32_t newest = total + count - 1;
+    trigger_index = (back < newest) ? newest - back : 0;
+    if(total > BLACKBOX_POST_SAMPLES && trigger_index < total - BLACKBOX_POST_SAMPLES){
+        trigger_index = total - BLACKBOX_POST_SAMPLES;          // Late drain: keep what is still in the ring
+    }
+
+    record.header.trigger_tick_us = tick_us;
+    record.header.event = event;
+    record.header.rate_hz = MMA8451_ODR_HZ;
+    record.header.pre_samples = (trigger_index < BLACKBOX_PRE_SAMPLES) ? trigger_index : BLACKBOX_PRE_SAMPLES;
+    record.header.count = record.header.pre_samples + BLACKBOX_POST_SAMPLES;
+    state = BLACKBOX_TRIGGERED;
+}
+
+// FUNCTION TO UNWRAP THE RING ONCE THE WINDOW IS COMPLETE (lock held) =====================================================
+static void freeze(){
+    uint32_t first = (trigger_index - record.header.pre_samples) % BLACKBOX_SAMPLES;
+    int16_t *flat = &record.samples[0][0];
+    std::rotate(flat, flat + 3 * first, flat + 3 * BLACKBOX_SAMPLES);  // In place, no second buffer in 20 KB of RAM
+    state = BLACKBOX_FROZEN;
+    frozen_tick_us = timebase_now_us();
+}
+
+// FUNCTION TO PRINT A WINDOW, THE FROZEN ONE OR THE ONE IN FLASH (lock not held) =========================================
+// The flash record is read a line at a time: a RAM copy next to the ring would not fit in 20 KB either
+static void dump(const blackbox_header_t *h, bool from_flash){
+    int16_t line[BLACKBOX_DUMP_PER_LINE][3];
+    uint16_t count = (h->count <= BLACKBOX_SAMPLES) ? h->count : BLACKBOX_SAMPLES;
+    printf("BBH,%s,%u,%u,%u,%llu,%u\n\r", EVENT_NAME[h->event % 3], h->rate_hz, h->pre_samples, count, (unsigned long long)h->trigger_tick_us, h->overflows);
+    for(uint16_t i = 0; i < count; i += BLACKBOX_DUMP_PER_LINE){
+        uint16_t n = (count - i < BLACKBOX_DUMP_PER_LINE) ? count - i : BLACKBOX_DUMP_PER_LINE;
+        if(from_flash){
+            if(!persist_read(PERSIST_SLOT_BLACKBOX, offsetof(blackbox_record_t, samples) + i * sizeof(line[0]), line, n * sizeof(line[0]))){
+                break;
+            }
+        }else{
+            memcpy(line, record.samples[i], n * sizeof(line[0]));
+        }
+        printf("BBD,%u,", i);
+        for(uint16_t j = 0; j < n; j++){
+            printf("%04X%04X%04X", (uint16_t)line[j][0], (uint16_t)line[j][1], (uint16_t)line[j][2]);
+        }
+        printf("\n\r");
+    }
+    printf("BBE\n\r");
+}
+
+// ==============================================================================================
+// PUBLIC FUNCTIONS
+// ==============================================================================================
+// MMA8451Q ISRs: only the event and its tick, the window is cut by the sensors' task at the next FIFO drain
+void blackbox_trigger_from_isr(blackbox_event_t event){
+    if(event >= pending_event){
+        pending_event = event;
+        pending_tick_us = timebase_now_us();
+    }
+}
+
+void blackbox_push(const int16_t xyz[][3], uint8_t count, bool overflow, uint64_t read_tick_us){
+    ring_mutex.lock();
+    uint64_t tick_us;
+    blackbox_event_t event = (state == BLACKBOX_DUMPING) ? BLACKBOX_EVENT_NONE : take_pending(read_tick_us, &tick_us);  // Acted on after the dump
+
+    // A freefall takes over a tap window: from its own trigger if the tap one is still open, from an empty ring once frozen
+    if(event == BLACKBOX_EVENT_FREEFALL && record.header.event == BLACKBOX_EVENT_TAP && state == BLACKBOX_FROZEN){
+        arm();
+    }
+    if(event != BLACKBOX_EVENT_NONE && (state == BLACKBOX_RECORDING || (state == BLACKBOX_TRIGGERED && event > record.header.event))){
+        trigger(event, tick_us, count, read_tick_us);
+    }
+
+    if(state == BLACKBOX_RECORDING || state == BLACKBOX_TRIGGERED){
+        record.header.overflows += overflow ? 1 : 0;
+        for(uint8_t i = 0; i < count; i++){
+            if(state == BLACKBOX_TRIGGERED && total >= trigger_index + BLACKBOX_POST_SAMPLES){
+                freeze();                                       // Later samples of the batch would overwrite the oldest of the window
+                break;
+            }
+            memcpy(record.samples[total % BLACKBOX_SAMPLES], xyz[i], sizeof(record.samples[0]));
+            total++;
+        }
+        if(state == BLACKBOX_TRIGGERED && total >= trigger_index + BLACKBOX_POST_SAMPLES){
+            freeze();
+        }
+    }
+    ring_mutex.unlock();
+}
+
+blackbox_event_t blackbox_frozen_event(){
+    ring_mutex.lock();
+    blackbox_event_t event = (state == BLACKBOX_FROZEN) ? (blackbox_event_t)record.header.event : BLACKBOX_EVENT_NONE;
+    ring_mutex.unlock();
+    return event;
+}
+
+void blackbox_init(){
+    blackbox_header_t header;
+    if(persist_check(PERSIST_SLOT_BLACKBOX, sizeof(blackbox_record_t)) && persist_read(PERSIST_SLOT_BLACKBOX, 0, &header, sizeof(header))){
+        printf("Black box: %s window saved at the last shutdown (%c dumps it)\n\r", EVENT_NAME[header.event % 3], BLACKBOX_COMMAND);
+    }
+    ring_mutex.lock();
+    arm();
+    ring_mutex.unlock();
+}
+
+void blackbox_service(){
+    ring_mutex.lock();
+    if(state == BLACKBOX_FROZEN){
+        if(!announced){
+            announced = true;
+            printf("Black box: %s window frozen, %u samples (%c dumps it)\n\r", EVENT_NAME[record.header.event % 3], record.header.count, BLACKBOX_COMMAND);
+        }else if(timebase_now_us() - frozen_tick_us > (uint64_t)std::chrono::microseconds(BLACKBOX_HOLD_TIME).count()){
+            arm();                                              // Not dumped: recording resumes
+        }
+    }
+    ring_mutex.unlock();
+}
+
+bool blackbox_save(){
+    ring_mutex.lock();
+    bool saved = (state == BLACKBOX_FROZEN) && persist_save(PERSIST_SLOT_BLACKBOX, &record, sizeof(record));
+    ring_mutex.unlock();
+    return saved;
+}
+
+// Dump format, one line each: BBH,event,rate_hz,pre_samples,count,trigger_tick_us,overflows
+// then BBD,first index,XXXXYYYYZZZZ... (BLACKBOX_DUMP_PER_LINE samples of 16-bit hex counts) and BBE to close
+void blackbox_command(const char *args){
+    (void)args;
+    ring_mutex.lock();
+    blackbox_state_t previous = state;
+    if(previous == BLACKBOX_FROZEN){
+        state = BLACKBOX_DUMPING;
+    }
+    ring_mutex.unlock();                                        // Printing takes longer than the FIFO holds, the sensors' task must not wait for it
+
+    if(previous == BLACKBOX_FROZEN){
+        dump(&record.header, false);
+        ring_mutex.lock();
+        state = BLACKBOX_FROZEN;                                // Still saved at shutdown, dropped after BLACKBOX_HOLD_TIME as before the dump
+        ring_mutex.unlock();
+        return;
+    }
+    if(previous == BLACKBOX_TRIGGERED){
+        printf("Black box: window still recording, dump it once frozen\n\r");
+        return;
+    }
+
+    blackbox_header_t header;                                   // The ring keeps recording while the flash record is printed
+    if(persist_check(PERSIST_SLOT_BLACKBOX, sizeof(blackbox_record_t)) && persist_read(PERSIST_SLOT_BLACKBOX, 0, &header, sizeof(header))){
+        dump(&header, true);
+    }else{
+        printf("Black box: no frozen window and none saved in flash\n\r");
+    }
+}
+// PUBLIC FUNCTIONS END =========================================================================
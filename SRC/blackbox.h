@@ -0,0 +1,46 @@
+/* File for the accelerometer black-box recorder function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "mma8451.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#define BLACKBOX_PRE_SAMPLES    (2 * MMA8451_ODR_HZ)            // 2 s of history before the trigger
+#define BLACKBOX_POST_SAMPLES   (1 * MMA8451_ODR_HZ)            // 1 s after it
+#define BLACKBOX_SAMPLES        (BLACKBOX_PRE_SAMPLES + BLACKBOX_POST_SAMPLES)  // RAM ring, 6 bytes per sample
+#define BLACKBOX_DRAIN_PERIOD   200ms                           // FIFO read at least this often (it overflows after 320 ms)
+#define BLACKBOX_SAVE_TIMEOUT   1500ms                          // Longest wait for the post-trigger window before the shutdown goes on without it
+#define BLACKBOX_HOLD_TIME      30s                             // A frozen window not dumped is dropped after this and recording resumes
+#define BLACKBOX_DUMP_PER_LINE  8                               // Samples per dump line
+#define BLACKBOX_COMMAND        'B'                             // Console: dump the frozen window, or the one saved in flash at the last shutdown
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+typedef enum {
+    BLACKBOX_EVENT_NONE,
+    BLACKBOX_EVENT_TAP,
+    BLACKBOX_EVENT_FREEFALL,                                     // Takes over a tap window, it is the one saved at shutdown
+} blackbox_event_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void blackbox_trigger_from_isr(blackbox_event_t event);          // Called by the MMA8451Q ISRs, the window is cut around this tick
+void blackbox_push(const int16_t xyz[][3], uint8_t count, bool overflow, uint64_t read_tick_us);  // FIFO samples, oldest first (sensors' task)
+void blackbox_init();                                            // Announce a window saved at the last shutdown and start recording
+blackbox_event_t blackbox_frozen_event();                        // Event of the window once its post-trigger samples are in, BLACKBOX_EVENT_NONE before
+void blackbox_service();                                         // Main thread: announce frozen windows, resume recording after BLACKBOX_HOLD_TIME
+bool blackbox_save();                                            // Write the frozen window to flash (shutdown path)
+void blackbox_command(const char *args);                         // Console: dump over serial for TOOLS/blackbox_export.py
+// PROTOTYPES END ===============================================================================
+
+#endif
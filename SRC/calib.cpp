@@ -0,0 +1,185 @@
+/* File for the analog channel calibration function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include <ctype.h>
+#include "calib.h"
+#include "persist.h"
+#include "float_only.h"
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+// Piecewise-linear curve: constant below the first point and above the last one, linear in between.
+// The bins split the raw range evenly, each one records the segment holding its first count, and since calibration points
+// are at least one bin apart a count is at most one segment further: lookup = bin read + one compare.
+struct calib_curve_t {
+    uint16_t start[CALIB_MAX_POINTS + 2];                        // First count of each segment, start[segments] = CALIB_RAW_MAX + 1 ends the table
+    int16_t base[CALIB_MAX_POINTS + 1];                          // Value at the start of each segment
+    int32_t slope[CALIB_MAX_POINTS + 1];                         // Q12 centi-units per count
+    uint8_t bin_segment[CALIB_BINS];                             // Segment holding the first count of each bin
+
+    constexpr calib_curve_t(const calib_points_t &p) : start(), base(), slope(), bin_segment(){
+        base[0] = p.points[0].value;
+        for(uint8_t i = 0; i < p.count; i++){
+            start[i + 1] = p.points[i].raw;
+            base[i + 1] = p.points[i].value;
+            if(i + 1 < p.count){
+                slope[i + 1] = ((int32_t)p.points[i + 1].value - p.points[i].value) * (1 << CALIB_SLOPE_SHIFT) / (p.points[i + 1].raw - p.points[i].raw);
+            }
+        }
+        start[p.count + 1] = CALIB_RAW_MAX + 1;
+        for(uint8_t i = p.count + 2; i < CALIB_MAX_POINTS + 2; i++){
+            start[i] = CALIB_RAW_MAX + 1;
+        }
+
+        uint8_t s = 0;
+        for(uint16_t bin = 0; bin < CALIB_BINS; bin++){
+            while(start[s + 1] <= (bin << CALIB_BIN_SHIFT)){
+                s++;
+            }
+            bin_segment[bin] = s;
+        }
+    }
+};
+
+// Flash record (PERSIST_SLOT_CALIBRATION), written by the console command
+typedef struct {
+    calib_points_t channel[CALIB_CH_COUNT];
+} calib_record_t;
+MBED_STATIC_ASSERT(PERSIST_FITS(sizeof(calib_record_t), PERSIST_CALIBRATION_SIZE), "The calibration record does not fit its flash slot");
+
+// CHECK OF A SET OF POINTS (compile time for the tables, run time for the flash record and the console) --------------------
+static constexpr bool points_valid(const calib_points_t &p, uint8_t i = 0){
+    return (p.count >= 2) && (p.count <= CALIB_MAX_POINTS)
+        && ((i >= p.count)
+            || ((p.points[i].raw <= CALIB_RAW_MAX) && (p.points[i].value <= CALIB_VALUE_MAX)
+                && (i == 0 || p.points[i].raw >= p.points[i - 1].raw + (1 << CALIB_BIN_SHIFT))   // At most one breakpoint per bin
+                && points_valid(p, i + 1)));
+}
+
+// ==============================================================================================
+// CALIBRATION TABLES (one row per analog probe, CALIB_PROBE selects the one fitted to the board)
+// ==============================================================================================
+// Soil moisture: capacitive probe, the output falls as the soil gets wetter. Bench points against gravimetric VWC
+static constexpr calib_points_t MOISTURE_PROBES[] = {
+    //      raw:value (centi-% VWC)
+    {5, {{1300, 5000}, {1750, 3500}, {2300, 2000}, {2900, 800}, {3300, 0}}},    // Probe 0
+    {5, {{1250, 5000}, {1700, 3500}, {2250, 2000}, {2850, 800}, {3250, 0}}},    // Probe 1
+};
+
+// Ambient light: phototransistor, roughly logarithmic. Points against a lux meter (1 unit = 10 lux)
+static constexpr calib_points_t LIGHT_PROBES[] = {
+    //      raw:value (centi-% of 100 klx)
+    {6, {{300, 0}, {700, 5}, {1300, 50}, {2400, 500}, {3300, 3000}, {4000, 10000}}},   // Probe 0
+    {6, {{320, 0}, {720, 5}, {1350, 50}, {2450, 500}, {3350, 3000}, {4050, 10000}}},   // Probe 1
+};
+
+static constexpr uint8_t PROBE_COUNT = sizeof(MOISTURE_PROBES) / sizeof(MOISTURE_PROBES[0]);
+
+static constexpr bool probes_valid(uint8_t i = 0){
+    return (i >= PROBE_COUNT) || (points_valid(MOISTURE_PROBES[i]) && points_valid(LIGHT_PROBES[i]) && probes_valid(i + 1));
+}
+
+MBED_STATIC_ASSERT(sizeof(LIGHT_PROBES) / sizeof(LIGHT_PROBES[0]) == PROBE_COUNT, "Every probe needs both curves");
+MBED_STATIC_ASSERT(CALIB_PROBE < PROBE_COUNT, "analog-probe is not in the calibration tables");
+MBED_STATIC_ASSERT(probes_valid(), "Invalid calibration points");
+
+static constexpr calib_points_t DEFAULT_POINTS[CALIB_CH_COUNT] = {MOISTURE_PROBES[CALIB_PROBE], LIGHT_PROBES[CALIB_PROBE]};
+static constexpr calib_curve_t DEFAULT_CURVES[CALIB_CH_COUNT] = {calib_curve_t(DEFAULT_POINTS[0]), calib_curve_t(DEFAULT_POINTS[1])};
+// CALIBRATION TABLES END =======================================================================
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+static calib_points_t points[CALIB_CH_COUNT] = {DEFAULT_POINTS[0], DEFAULT_POINTS[1]};  // Points of the curves in use
+static calib_curve_t curves[CALIB_CH_COUNT] = {DEFAULT_CURVES[0], DEFAULT_CURVES[1]};
+static Mutex curves_mutex;                                      // Applied by the sensors' thread, replaced from the console
+
+static const char CHANNEL_LETTER[CALIB_CH_COUNT] = {'M', 'L'};
+
+// FUNCTION TO LOAD THE CURVES SAVED IN FLASH ==============================================================================
+void calib_init(){
+    calib_record_t record;
+    if(!persist_load(PERSIST_SLOT_CALIBRATION, &record, sizeof(record))){
+        return;                                                 // No record: compile-time curves
+    }
+
+    curves_mutex.lock();
+    for(uint8_t ch = 0; ch < CALIB_CH_COUNT; ch++){
+        if(points_valid(record.channel[ch])){
+            points[ch] = record.channel[ch];
+            curves[ch] = calib_curve_t(points[ch]);
+        }
+    }
+    curves_mutex.unlock();
+}
+
+// FUNCTION TO CONVERT RAW COUNTS ==========================================================================================
+int16_t calib_apply(calib_channel_t channel, uint16_t raw){
+    raw = (raw <= CALIB_RAW_MAX) ? raw : CALIB_RAW_MAX;
+
+    curves_mutex.lock();
+    const calib_curve_t *c = &curves[channel];
+    uint8_t s = c->bin_segment[raw >> CALIB_BIN_SHIFT];
+    s += (raw >= c->start[s + 1]);                              // The breakpoint inside the bin, if any
+    int16_t value = c->base[s] + (((int32_t)(raw - c->start[s]) * c->slope[s] + (1 << (CALIB_SLOPE_SHIFT - 1))) >> CALIB_SLOPE_SHIFT);
+    curves_mutex.unlock();
+
+    return value;
+}
+
+// FUNCTION TO PRINT OR REPLACE A CURVE FROM THE CONSOLE ===================================================================
+void calib_command(const char *args){
+    char letter = ' ';
+    int consumed = 0;
+    if(sscanf(args, " %c%n", &letter, &consumed) != 1){
+        letter = ' ';
+    }
+    int8_t channel = -1;
+    for(uint8_t ch = 0; ch < CALIB_CH_COUNT; ch++){
+        if(CHANNEL_LETTER[ch] == toupper(letter)){
+            channel = ch;
+        }
+    }
+    if(channel < 0){
+        printf("Usage: %c <M|L> [raw:value ... | default], e.g. %c M 1300:5000 2300:2000 3300:0\n\r", CALIB_COMMAND, CALIB_COMMAND);
+        return;
+    }
+    args += consumed;
+
+    // New points, "default" or none (just print the curve)
+    calib_points_t p;
+    unsigned raw, value;
+    int n = 0;
+    p.count = 0;
+    sscanf(args, " default%n", &n);
+    if(n > 0){
+        p = DEFAULT_POINTS[channel];
+    }else{
+        while(p.count < CALIB_MAX_POINTS && sscanf(args, " %u:%u%n", &raw, &value, &n) == 2){
+            p.points[p.count].raw = (raw <= UINT16_MAX) ? raw : UINT16_MAX;
+            p.points[p.count].value = (value <= UINT16_MAX) ? value : UINT16_MAX;
+            p.count++;
+            args += n;
+        }
+    }
+
+    if(p.count > 0){
+        if(!points_valid(p)){
+            printf("Rejected: 2 to %d points, raw 0 - %d increasing by at least %d, values 0 - %d\n\r", CALIB_MAX_POINTS, CALIB_RAW_MAX, 1 << CALIB_BIN_SHIFT, CALIB_VALUE_MAX);
+            return;
+        }
+        calib_curve_t curve(p);                                 // Built outside the lock
+        curves_mutex.lock();
+        points[channel] = p;
+        curves[channel] = curve;
+        curves_mutex.unlock();
+
+        calib_record_t record;
+        memcpy(record.channel, points, sizeof(record.channel));
+        printf("%s\n\r", persist_save(PERSIST_SLOT_CALIBRATION, &record, sizeof(record)) ? "Calibration saved" : "Calibration applied, flash save failed");
+    }
+
+    printf("%c curve:", CHANNEL_LETTER[channel]);
+    for(uint8_t i = 0; i < points[channel].count; i++){
+        printf(" %u:%u", points[channel].points[i].raw, points[channel].points[i].value);
+    }
+    printf("\n\r");
+}
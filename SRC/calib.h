@@ -0,0 +1,59 @@
+/* File for the analog channel calibration function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef CALIB_H
+#define CALIB_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Analog probe fitted to the board, from mbed_app.json (index in the calibration tables of calib.cpp)
+#ifdef MBED_CONF_APP_ANALOG_PROBE
+#define CALIB_PROBE         MBED_CONF_APP_ANALOG_PROBE
+#else
+#define CALIB_PROBE         0
+#endif
+
+#define CALIB_RAW_BITS      12                                  // AnalogIn::read_u16() >> 4, the STM32L0 ADC resolution
+#define CALIB_RAW_MAX       ((1 << CALIB_RAW_BITS) - 1)
+#define CALIB_BIN_SHIFT     8                                   // 16 bins of 256 counts, calibration points must be at least one bin apart
+#define CALIB_BINS          (1 << (CALIB_RAW_BITS - CALIB_BIN_SHIFT))
+#define CALIB_MAX_POINTS    8
+#define CALIB_SLOPE_SHIFT   12                                  // Segment slopes in Q12 centi-units per count
+#define CALIB_VALUE_MAX     10000                               // Both channels are carried in centi-% fields of message_t_sensors
+#define CALIB_COMMAND       'C'                                 // Console: "C <M|L> [raw:value ... | default]", values in hundredths, no points prints the curve
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+typedef enum {
+    CALIB_CH_MOISTURE,                                           // Volumetric water content, centi-%
+    CALIB_CH_LIGHT,                                              // Illuminance in centi-% of 100 klx (1 unit = 10 lux)
+    CALIB_CH_COUNT
+} calib_channel_t;
+
+// Calibration points of a channel, in increasing raw order (also the layout of the flash record)
+typedef struct {
+    uint16_t raw;                                                // 12-bit ADC counts
+    uint16_t value;                                              // Reference value in centi-units
+} calib_point_t;
+
+typedef struct {
+    uint8_t count;                                               // 2 .. CALIB_MAX_POINTS
+    calib_point_t points[CALIB_MAX_POINTS];
+} calib_points_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void calib_init();                                               // Use the flash record curves where there is one
+int16_t calib_apply(calib_channel_t channel, uint16_t raw);      // Raw 12-bit counts to centi-units: one table read, one compare, one multiply
+void calib_command(const char *args);                            // Console: print or replace (and save) the curve of a channel
+// PROTOTYPES END ===============================================================================
+
+#endif
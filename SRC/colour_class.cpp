@@ -0,0 +1,78 @@
+/* File for the leaf colour classifier function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "colour_class.h"
+#include "alarms.h"
+#include "float_only.h"
+
+// ==============================================================================================
+// LOOKUP TABLE (generated at compile time, only the class boundaries below need tuning)
+// ==============================================================================================
+// Class of a chromaticity cell, from its centre in 1/256 units (b is what is left of the clear channel)
+static constexpr uint8_t classify_cell(uint8_t r_index, uint8_t g_index){
+    int32_t r = (2 * r_index + 1) * 128 / COLOUR_LUT_SIZE;
+    int32_t g = (2 * g_index + 1) * 128 / COLOUR_LUT_SIZE;
+    int32_t b = (r + g < 256) ? 256 - r - g : 0;
+
+    if(r + g > 300){
+        return COLOUR_UNKNOWN;                                  // R + G well above C: saturated or IR-heavy reading
+    }
+    if(b >= g){
+        return COLOUR_UNKNOWN;                                  // Bluish or grey, not leaf tissue
+    }
+    if(8 * g > 9 * r){
+        return COLOUR_HEALTHY_GREEN;                            // g > 1.125 r
+    }
+    if(8 * r <= 10 * g){
+        return COLOUR_CHLOROTIC_YELLOW;                         // r within [0.89 g, 1.25 g]
+    }
+    return COLOUR_NECROTIC_BROWN;
+}
+
+typedef struct colour_lut {
+    uint8_t cell[COLOUR_LUT_SIZE][COLOUR_LUT_SIZE];              // [r index][g index]
+
+    constexpr colour_lut() : cell(){
+        for(uint8_t r = 0; r < COLOUR_LUT_SIZE; r++){
+            for(uint8_t g = 0; g < COLOUR_LUT_SIZE; g++){
+                cell[r][g] = classify_cell(r, g);
+            }
+        }
+    }
+} colour_lut_t;
+
+static constexpr colour_lut_t COLOUR_LUT;                       // In flash, 1 KB
+
+MBED_STATIC_ASSERT(COLOUR_LUT.cell[8][14] == COLOUR_HEALTHY_GREEN, "r = 0.27, g = 0.45 must be healthy green");
+MBED_STATIC_ASSERT(COLOUR_LUT.cell[13][13] == COLOUR_CHLOROTIC_YELLOW, "r = g = 0.42 must be chlorotic yellow");
+MBED_STATIC_ASSERT(COLOUR_LUT.cell[15][10] == COLOUR_NECROTIC_BROWN, "r = 0.48, g = 0.33 must be necrotic brown");
+// LOOKUP TABLE END =============================================================================
+
+static const char CLASS_NAME[COLOUR_CLASS_COUNT][17] = {"healthy green", "chlorotic yellow", "necrotic brown", "dark", "unknown"};
+static const uint8_t CLASS_LED[COLOUR_CLASS_COUNT] = {ALARM_LED_GREEN, ALARM_LED_YELLOW, ALARM_LED_RED, ALARM_LED_OFF, ALARM_LED_OFF};
+
+// FUNCTION TO CLASSIFY A TCS34725 READING =================================================================================
+colour_class_t colour_classify(uint16_t clear, uint16_t red, uint16_t green, uint16_t blue){
+    (void)blue;                                                 // Implied by r and g, the table already accounts for it
+    if(clear < COLOUR_DARK_CLEAR){
+        return COLOUR_DARK;
+    }
+
+    // Chromaticity cell, integer only: r = R / C and g = G / C scaled to the table size
+    uint32_t r_index = (uint32_t)red * COLOUR_LUT_SIZE / clear;
+    uint32_t g_index = (uint32_t)green * COLOUR_LUT_SIZE / clear;
+    r_index = (r_index < COLOUR_LUT_SIZE) ? r_index : COLOUR_LUT_SIZE - 1;
+    g_index = (g_index < COLOUR_LUT_SIZE) ? g_index : COLOUR_LUT_SIZE - 1;
+
+    return (colour_class_t)COLOUR_LUT.cell[r_index][g_index];
+}
+
+// FUNCTIONS TO DISPLAY A CLASS ============================================================================================
+const char *colour_class_name(colour_class_t colour){
+    return (colour < COLOUR_CLASS_COUNT) ? CLASS_NAME[colour] : "?";
+}
+
+uint8_t colour_class_led(colour_class_t colour){
+    return (colour < COLOUR_CLASS_COUNT) ? CLASS_LED[colour] : ALARM_LED_OFF;
+}
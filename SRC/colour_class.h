@@ -0,0 +1,38 @@
+/* File for the leaf colour classifier function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef COLOUR_CLASS_H
+#define COLOUR_CLASS_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#define COLOUR_LUT_SIZE    32                                   // Chromaticity cells per axis (r = R / C and g = G / C, 0 - 1)
+#define COLOUR_DARK_CLEAR  64                                   // Below this clear count there is too little light to tell a colour
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+typedef enum {
+    COLOUR_HEALTHY_GREEN,                                        // Green clearly above red and blue
+    COLOUR_CHLOROTIC_YELLOW,                                     // Red close to green, little blue (chlorophyll loss)
+    COLOUR_NECROTIC_BROWN,                                       // Red above green, little blue (dead tissue)
+    COLOUR_DARK,                                                 // Not enough light
+    COLOUR_UNKNOWN,                                              // Bluish, greyish or saturated readings
+    COLOUR_CLASS_COUNT
+} colour_class_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+colour_class_t colour_classify(uint16_t clear, uint16_t red, uint16_t green, uint16_t blue);  // Integer normalisation plus one table lookup
+const char *colour_class_name(colour_class_t colour);
+uint8_t colour_class_led(colour_class_t colour);                // RGB pattern (active low) shown in TEST_MODE
+// PROTOTYPES END ===============================================================================
+
+#endif
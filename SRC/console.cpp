@@ -0,0 +1,43 @@
+/* File for the serial console command input function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "console.h"
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+static FileHandle *console = nullptr;                           // The stdio serial port, shared with printf
+static char buffer[CONSOLE_LINE_SIZE];                          // Line being received
+static uint8_t length = 0;
+
+// FUNCTION TO COLLECT A COMMAND LINE ======================================================================================
+bool console_read_line(char *line, uint16_t size){
+    if(console == nullptr){
+        console = mbed_file_handle(STDIN_FILENO);               // Left blocking so printf keeps its behaviour, only read what is already there
+    }
+
+    char c;
+    while(console->readable() && console->read(&c, 1) == 1){
+        if(c == '\r' || c == '\n'){
+            if(length == 0){
+                continue;                                       // Empty line or the LF of a CRLF
+            }
+            buffer[length] = '\0';
+            strncpy(line, buffer, size - 1);
+            line[size - 1] = '\0';
+            length = 0;
+            return true;
+        }
+        if(length < CONSOLE_LINE_SIZE - 1){
+            buffer[length++] = c;
+        }
+    }
+    return false;
+}
+
+// FUNCTION TO RELEASE THE RECEIVER ========================================================================================
+void console_disable_input(){
+    if(console == nullptr){
+        console = mbed_file_handle(STDIN_FILENO);
+    }
+    console->enable_input(false);                               // A buffered stdio keeps its RX IRQ, and the deep sleep lock, until then
+}
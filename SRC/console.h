@@ -0,0 +1,18 @@
+/* File for the serial console command input function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// MACROS ---------------------------------------------------------------------------------------
+#define CONSOLE_LINE_SIZE 48                                    // Longest command line, longer input is truncated
+
+// PROTOTYPES ===================================================================================
+bool console_read_line(char *line, uint16_t size);              // Never blocks: true once a full line (CR or LF terminated) has been received
+void console_disable_input();                                   // Before deep sleep, output (printf) keeps working
+// PROTOTYPES END ===============================================================================
+
+#endif
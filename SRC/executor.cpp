@@ -0,0 +1,172 @@
+/* File for the task executor function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "executor.h"
+#include "timebase.h"
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+static executor_task_t *tasks[EXECUTOR_MAX_TASKS];              // Every task started, for the stats
+static uint8_t task_count = 0;
+
+#if EXECUTOR_ENABLED
+static EventQueue queue(EXECUTOR_QUEUE_SIZE);                   // Dispatched by the main thread, the only stack the tasks run on
+#endif
+
+// FUNCTION PROTOTYPES -----------------------------------------------------------------------------------------------------
+static void add_task(executor_task_t *task);
+static std::chrono::milliseconds run_step(executor_task_t *task, uint32_t woken);
+#if EXECUTOR_ENABLED
+static void dispatch_step(executor_task_t *task);
+#else
+static void thread_loop(executor_task_t *task);
+#endif
+
+// FUNCTIONS TO START AND RUN TASKS ========================================================================================
+void executor_start(executor_task_t *task, Thread *thread){
+    add_task(task);
+#if EXECUTOR_ENABLED
+    (void)thread;
+    task->event = queue.call(dispatch_step, task);
+#else
+    task->thread = thread;
+    thread->start(callback(thread_loop, task));
+#endif
+}
+
+void executor_run(executor_task_t *task){
+    task->thread_id = ThisThread::get_id();
+    add_task(task);
+#if EXECUTOR_ENABLED
+    task->event = queue.call(dispatch_step, task);
+    queue.dispatch_forever();
+#else
+    thread_loop(task);
+#endif
+}
+
+static void add_task(executor_task_t *task){
+    core_util_atomic_store_u64(&task->due_us, timebase_now_us());
+    if(task_count < EXECUTOR_MAX_TASKS){
+        tasks[task_count++] = task;
+    }
+}
+
+// FUNCTION TO RUN AND TIME ONE STEP =======================================================================================
+static std::chrono::milliseconds run_step(executor_task_t *task, uint32_t woken){
+    uint64_t start_us = timebase_now_us();
+    uint64_t due_us = core_util_atomic_load_u64(&task->due_us);
+    uint32_t latency_us = 0;
+    if(start_us > due_us){
+        latency_us = (start_us - due_us < UINT32_MAX) ? (uint32_t)(start_us - due_us) : UINT32_MAX;
+    }
+    if(latency_us > task->worst_latency_us){
+        task->worst_latency_us = latency_us;
+    }
+    task->total_latency_us += latency_us;
+    task->steps++;
+
+    std::chrono::milliseconds next = task->step(woken);
+
+    uint64_t end_us = timebase_now_us();
+    if(end_us - start_us > task->worst_step_us){
+        task->worst_step_us = (uint32_t)(end_us - start_us);
+    }
+    core_util_atomic_store_u64(&task->due_us, end_us + (uint64_t)next.count() * 1000);
+    return next;
+}
+
+#if EXECUTOR_ENABLED
+// Executor build: the task posts its next step and returns, waits cost one queued event instead of a stack
+static void dispatch_step(executor_task_t *task){
+    task->event = 0;
+    uint32_t woken = task->woken;
+    task->woken = 0;
+    std::chrono::milliseconds next = run_step(task, woken);
+    task->event = queue.call_in(next, dispatch_step, task);
+}
+#else
+// Threaded build: the task waits on its own stack
+static void thread_loop(executor_task_t *task){
+    task->thread_id = ThisThread::get_id();
+    uint32_t woken = 0;
+    while(true){
+        std::chrono::milliseconds next = run_step(task, woken);
+        woken = 0;
+        if(task->wake_flags != 0){
+            uint32_t flags = ThisThread::flags_wait_any_for(task->wake_flags, next);
+            woken = (flags & osFlagsError) ? 0 : flags;         // Timeout is returned as an error code
+        }else{
+            ThisThread::sleep_for(next);
+        }
+    }
+}
+#endif
+
+// FUNCTION TO CUT THE WAIT OF A TASK SHORT ================================================================================
+void executor_wake(executor_task_t *task, uint32_t flag){
+    core_util_atomic_store_u64(&task->due_us, timebase_now_us());
+#if EXECUTOR_ENABLED
+    (void)flag;
+    if(task->event != 0){                                       // Not stopped (and not the task running this call)
+        task->woken |= flag;
+        queue.cancel(task->event);
+        task->event = queue.call(dispatch_step, task);
+    }
+#else
+    if(task->thread != nullptr){
+        task->thread->flags_set(flag);
+    }
+#endif
+}
+
+void executor_stop(executor_task_t *task){
+#if EXECUTOR_ENABLED
+    queue.cancel(task->event);
+    task->event = 0;
+#else
+    task->thread->terminate();
+#endif
+}
+
+// FUNCTION TO NAME A THREAD IN THE STACK STATS ===========================================================================
+static const char *thread_name(osThreadId_t id){
+    for(uint8_t i = 0; i < task_count; i++){
+        if(tasks[i]->thread_id == id){
+            return tasks[i]->name;
+        }
+    }
+    const char *name = osThreadGetName(id);                     // RTOS idle and timer threads
+    return (name != nullptr) ? name : "unnamed";
+}
+
+// FUNCTION TO PRINT THE TASK TIMING AND THE MEASURED RAM OF THIS BUILD ====================================================
+// Run both builds (cooperative-executor true and false in mbed_app.json) to compare them
+void executor_print_stats(){
+    printf("Tasks (%s), step latency worst / mean, longest step:", EXECUTOR_ENABLED ? "cooperative, one stack" : "one thread each");
+    for(uint8_t i = 0; i < task_count; i++){
+        uint32_t mean_us = (tasks[i]->steps > 0) ? (uint32_t)(tasks[i]->total_latency_us / tasks[i]->steps) : 0;
+        printf("%s %s %lu / %lu / %lu us", (i == 0) ? "" : ",", tasks[i]->name, (unsigned long)tasks[i]->worst_latency_us, (unsigned long)mean_us,
+               (unsigned long)tasks[i]->worst_step_us);
+    }
+    printf("\n\r");
+
+    // Stack high-water marks (platform.stack-stats-enabled), the stacks of the threaded build are also in the heap figures
+    mbed_stats_stack_t stacks[EXECUTOR_MAX_THREADS];
+    size_t count = mbed_stats_stack_get_each(stacks, EXECUTOR_MAX_THREADS);
+    uint32_t used = 0, reserved = 0;
+    printf("Stacks, used / reserved:");
+    for(size_t i = 0; i < count; i++){
+        printf("%s %s %lu / %lu B", (i == 0) ? "" : ",", thread_name((osThreadId_t)(uintptr_t)stacks[i].thread_id), (unsigned long)stacks[i].max_size,
+               (unsigned long)stacks[i].reserved_size);
+        used += stacks[i].max_size;
+        reserved += stacks[i].reserved_size;
+    }
+    printf(" - total %lu / %lu B\n\r", (unsigned long)used, (unsigned long)reserved);
+
+    // Heap (platform.heap-stats-enabled): thread stacks and control blocks, or the event queue buffer
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    printf("Heap: %lu B in use, %lu B peak, %lu B reserved, %lu allocations failed\n\r", (unsigned long)heap.current_size, (unsigned long)heap.max_size,
+           (unsigned long)heap.reserved_size, (unsigned long)heap.alloc_fail_cnt);
+}
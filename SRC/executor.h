@@ -0,0 +1,62 @@
+/* File for the task executor function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Execution model, from mbed_app.json: every task on its own thread (default) or all of them on one EventQueue
+#ifdef MBED_CONF_APP_COOPERATIVE_EXECUTOR
+#define EXECUTOR_ENABLED     MBED_CONF_APP_COOPERATIVE_EXECUTOR
+#else
+#define EXECUTOR_ENABLED     0
+#endif
+
+#define EXECUTOR_MAX_TASKS   3                                  // main, sensors and GPS
+#define EXECUTOR_MAX_THREADS (EXECUTOR_MAX_TASKS + 2)           // Stacks reported: the tasks' threads plus the RTOS idle and timer threads
+#define EXECUTOR_QUEUE_SIZE  (2 * EXECUTOR_MAX_TASKS * EVENTS_EVENT_SIZE)  // One pending step per task, twice over for the cancel + post of a wake-up
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// One step of a task: runs until it would wait and returns how long to wait. A step must never block, and must cope with
+// being called before that time is over, so it checks its own deadlines. woken holds the flags of executor_wake() since the
+// previous step (0 if the wait just ran out)
+typedef std::chrono::milliseconds (*executor_step_t)(uint32_t woken);
+
+typedef struct {
+    const char *name;
+    executor_step_t step;
+    uint32_t wake_flags;                                         // Thread flags that cut the wait short (threaded build)
+    // Filled at run time
+    Thread *thread;                                              // Threaded build
+    osThreadId_t thread_id;                                      // Thread its steps run on, to name its stack in the stats (main thread for all in the executor build)
+    int event;                                                   // Executor build: pending step, 0 if none
+    uint32_t woken;                                              // Executor build: flags of the wake-ups not seen by the step yet
+    volatile uint64_t due_us;                                    // Tick the pending step should start at
+    uint32_t worst_latency_us;                                   // Worst start of a step after its due tick
+    uint64_t total_latency_us;                                   // Sum over every step, for the mean
+    uint32_t steps;
+    uint32_t worst_step_us;                                      // Longest step, also the worst delay it adds to the others on one queue
+} executor_task_t;
+
+#define EXECUTOR_TASK(name, step, wake_flags)  {name, step, wake_flags, nullptr, nullptr, 0, 0, 0, 0, 0, 0, 0}
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void executor_start(executor_task_t *task, Thread *thread);      // Start a task on its own thread, or on the queue (thread unused, nullptr)
+void executor_run(executor_task_t *task);                        // Run a task on the calling thread, and every started one with it in the executor build. Never returns
+void executor_wake(executor_task_t *task, uint32_t flag);        // Run the next step now instead of at the end of its wait
+void executor_stop(executor_task_t *task);
+void executor_print_stats();                                     // Step latency and longest step of every task, measured stack and heap use of this build
+// PROTOTYPES END ===============================================================================
+
+#endif
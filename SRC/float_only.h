@@ -0,0 +1,21 @@
+/* File for the single-precision build check of the sample path */
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef FLOAT_ONLY_H
+#define FLOAT_ONLY_H
+
+// ==============================================================================================
+// DIAGNOSTICS
+// ==============================================================================================
+// The STM32L072 (Cortex-M0+) has no FPU: every double operation is a soft-float library call, several times slower than
+// the float one. Included LAST in the files of the sample path (after mbed.h and the C headers, which are not checked), it
+// turns any double promotion or float to integer narrowing into a build error.
+#pragma GCC diagnostic error "-Wdouble-promotion"
+#pragma GCC diagnostic error "-Wfloat-conversion"
+
+// printf() takes its floats as double by definition: console output blocks (never in the sample path) are wrapped in these
+#define FLOAT_ONLY_OUTPUT_BEGIN _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wdouble-promotion\"")
+#define FLOAT_ONLY_OUTPUT_END   _Pragma("GCC diagnostic pop")
+// DIAGNOSTICS END ==============================================================================
+
+#endif
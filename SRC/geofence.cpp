@@ -0,0 +1,113 @@
+/* File for the geofence engine function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "geofence.h"
+#include "geofence_index.h"
+
+// ==============================================================================================
+// POLYGON TABLE (kept in flash; adding a fence only needs its vertices and a new row here)
+// ==============================================================================================
+static constexpr geofence_vertex_t GEOFENCE_VERTICES[] = {
+    // Campus
+    {40391500, -3632000}, {40391800, -3625500}, {40388000, -3625000}, {40387200, -3629000}, {40388500, -3632500},
+    // Greenhouse (inside the campus)
+    {40390200, -3630000}, {40390300, -3628500}, {40389300, -3628400}, {40389200, -3629900},
+    // Field
+    {40386000, -3624000}, {40386800, -3621000}, {40385000, -3619500}, {40383800, -3621500}, {40384200, -3623800},
+};
+
+static constexpr geofence_polygon_t GEOFENCE_POLYGONS[] = {
+    // first  count  name
+    {0,       5,     "Campus"},
+    {5,       4,     "Greenhouse"},
+    {9,       5,     "Field"},
+};
+
+static constexpr uint16_t GEOFENCE_VERTEX_COUNT = sizeof(GEOFENCE_VERTICES) / sizeof(GEOFENCE_VERTICES[0]);
+static constexpr uint8_t GEOFENCE_POLYGON_COUNT = sizeof(GEOFENCE_POLYGONS) / sizeof(GEOFENCE_POLYGONS[0]);
+
+// COMPILE-TIME TABLE CHECK ----------------------------------------------------------------------
+static constexpr bool geofence_polygons_valid(uint8_t index = 0){
+    return (index >= GEOFENCE_POLYGON_COUNT)
+        || ((GEOFENCE_POLYGONS[index].vertex_count >= 3)
+            && (GEOFENCE_POLYGONS[index].first_vertex + GEOFENCE_POLYGONS[index].vertex_count <= GEOFENCE_VERTEX_COUNT)
+            && geofence_polygons_valid(index + 1));
+}
+
+MBED_STATIC_ASSERT(GEOFENCE_POLYGON_COUNT <= GEOFENCE_MAX_POLYGONS, "Too many fences for 15-bit fence indexes");
+MBED_STATIC_ASSERT(geofence_polygons_valid(), "Invalid polygon in GEOFENCE_POLYGONS");
+// POLYGON TABLE END ============================================================================
+
+// GRID INDEX (built by the compiler into flash, sized by a first counting build) ------------------------------------------
+static constexpr geofence_grid_t GEOFENCE_GRID = geofence_index_build(GEOFENCE_VERTICES, GEOFENCE_VERTEX_COUNT, GEOFENCE_POLYGONS, GEOFENCE_POLYGON_COUNT,
+                                                                      GEOFENCE_GRID_ROWS, GEOFENCE_GRID_COLS, nullptr, nullptr, 0, nullptr, 0);
+
+typedef struct geofence_tables {
+    uint32_t cell_start[GEOFENCE_GRID_ROWS * GEOFENCE_GRID_COLS + 1];
+    geofence_entry_t entries[GEOFENCE_GRID.entry_count];
+    uint16_t cell_edges[GEOFENCE_GRID.edge_count];
+
+    constexpr geofence_tables() : cell_start(), entries(), cell_edges() {
+        geofence_index_build(GEOFENCE_VERTICES, GEOFENCE_VERTEX_COUNT, GEOFENCE_POLYGONS, GEOFENCE_POLYGON_COUNT, GEOFENCE_GRID_ROWS, GEOFENCE_GRID_COLS,
+                             cell_start, entries, GEOFENCE_GRID.entry_count, cell_edges, GEOFENCE_GRID.edge_count);
+    }
+} geofence_tables_t;
+
+static constexpr geofence_tables_t GEOFENCE_TABLES;
+static constexpr geofence_index_t GEOFENCE_INDEX = {GEOFENCE_VERTICES, GEOFENCE_POLYGONS, GEOFENCE_GRID,
+                                                    GEOFENCE_TABLES.cell_start, GEOFENCE_TABLES.entries, GEOFENCE_TABLES.cell_edges};
+
+// STATIC VARIABLES (only touched by the GPS thread) -----------------------------------------------------------------------
+static uint16_t reported[GEOFENCE_MAX_INSIDE];                  // Fences the events sent so far put the station in
+static uint8_t reported_count = 0;
+
+// FUNCTION TO CLASSIFY A POINT ============================================================================================
+uint8_t geofence_classify(int32_t latitude, int32_t longitude, uint16_t *inside, uint8_t max){
+    return geofence_index_classify(&GEOFENCE_INDEX, latitude, longitude, inside, max);
+}
+
+// FUNCTION TO TURN A FIX INTO ENTER/EXIT EVENTS ===========================================================================
+// Only the events handed out update the reported fences, so what did not fit in this fix is raised by the next ones
+uint8_t geofence_update(int32_t latitude, int32_t longitude, uint16_t *events){
+    uint16_t inside[GEOFENCE_MAX_INSIDE];
+    uint8_t inside_count = geofence_classify(latitude, longitude, inside, GEOFENCE_MAX_INSIDE);
+    uint8_t n = 0;
+
+    // Exits first, they make room for the enters when GEOFENCE_MAX_INSIDE fences are reported
+    for(uint8_t r = 0; r < reported_count && n < GEOFENCE_MAX_EVENTS; ){
+        bool kept = false;
+        for(uint8_t i = 0; i < inside_count; i++){
+            kept |= (inside[i] == reported[r]);
+        }
+        if(kept){
+            r++;
+            continue;
+        }
+        events[n++] = reported[r];
+        reported[r] = reported[--reported_count];
+    }
+
+    for(uint8_t i = 0; i < inside_count && n < GEOFENCE_MAX_EVENTS && reported_count < GEOFENCE_MAX_INSIDE; i++){
+        bool known = false;
+        for(uint8_t r = 0; r < reported_count; r++){
+            known |= (inside[i] == reported[r]);
+        }
+        if(!known){
+            events[n++] = inside[i] | GEOFENCE_ENTERED;
+            reported[reported_count++] = inside[i];
+        }
+    }
+
+    for(uint8_t i = n; i < GEOFENCE_MAX_EVENTS; i++){
+        events[i] = GEOFENCE_NO_EVENT;
+    }
+    return n;
+}
+
+// FUNCTION TO PRINT THE ENTER/EXIT EVENTS =================================================================================
+void geofence_log(const uint16_t *events){
+    for(uint8_t i = 0; i < GEOFENCE_MAX_EVENTS && events[i] != GEOFENCE_NO_EVENT; i++){
+        printf("Geofence: %s %s\n\r", (events[i] & GEOFENCE_ENTERED) ? "entered" : "left", GEOFENCE_POLYGONS[events[i] & ~GEOFENCE_ENTERED].name);
+    }
+}
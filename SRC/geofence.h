@@ -0,0 +1,46 @@
+/* File for the geofence engine function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#define GEOFENCE_MAX_POLYGONS   0x7FFF                          // Fence indexes are 15 bits, the 16th marks an enter event
+#define GEOFENCE_GRID_COLS      8                               // Uniform grid over the bounding box of every fence
+#define GEOFENCE_GRID_ROWS      8
+#define GEOFENCE_MAX_INSIDE     4                               // Nested fences tracked at one position, deeper ones are ignored
+#define GEOFENCE_MAX_EVENTS     2                               // Events carried by one fix, further ones follow on the next fixes
+
+// Event: fence index | GEOFENCE_ENTERED, or the index alone when the fence is left
+#define GEOFENCE_ENTERED        0x8000
+#define GEOFENCE_NO_EVENT       0xFFFF
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+typedef struct {
+    int32_t latitude, longitude;                                 // Micro-degrees, same units as message_t_gps
+} geofence_vertex_t;
+
+typedef struct {
+    uint16_t first_vertex;                                       // Index in the vertex table, the polygon closes back on it
+    uint8_t vertex_count;
+    const char *name;                                            // Name used by the enter/exit log
+} geofence_polygon_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+uint8_t geofence_classify(int32_t latitude, int32_t longitude, uint16_t *inside, uint8_t max);  // Fences containing the point (ascending, at most max): one cell lookup plus the few edges of that cell
+uint8_t geofence_update(int32_t latitude, int32_t longitude, uint16_t *events);  // Fill GEOFENCE_MAX_EVENTS events (GEOFENCE_NO_EVENT padded) since the last update, returns how many
+void geofence_log(const uint16_t *events);                       // Print the enter/exit events of a fix
+// PROTOTYPES END ===============================================================================
+
+#endif
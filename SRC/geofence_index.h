@@ -0,0 +1,191 @@
+/* File for the geofence grid index, built at compile time for the firmware and at run time by the host benchmark */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "geofence.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef GEOFENCE_INDEX_H
+#define GEOFENCE_INDEX_H
+
+// ==============================================================================================
+// GRID INDEX
+// Every cell lists the polygons that touch it. For each one it keeps whether the cell centre is
+// inside and the edges that cross the cell: a point is inside if the centre is, flipped once per
+// edge crossed on the way to the centre. Entries of a cell are in ascending polygon order.
+// ==============================================================================================
+#define GEOFENCE_CENTRE_INSIDE 0x8000                           // Flag in geofence_entry_t.polygon
+
+typedef struct {
+    uint16_t polygon;                                            // Polygon index | GEOFENCE_CENTRE_INSIDE
+    uint16_t edge_count;
+    uint32_t first_edge;                                         // Index in the cell edge table
+} geofence_entry_t;
+
+typedef struct {
+    int32_t lat0, lon0;                                          // South-west corner of the grid
+    int32_t cell_height, cell_width;                             // Micro-degrees
+    uint16_t rows, cols;
+    uint32_t entry_count, edge_count;                            // Needed by the fences, even when the tables given to the build were smaller
+} geofence_grid_t;
+
+// Everything geofence_index_classify() reads, all of it const so the firmware one lives in flash
+typedef struct {
+    const geofence_vertex_t *vertices;
+    const geofence_polygon_t *polygons;
+    geofence_grid_t grid;
+    const uint32_t *cell_start;                                  // Entries of cell i are [cell_start[i], cell_start[i + 1])
+    const geofence_entry_t *entries;
+    const uint16_t *cell_edges;                                  // First vertex of the edge, the second one is the next vertex of the polygon
+} geofence_index_t;
+// GRID INDEX END ===============================================================================
+
+// ==============================================================================================
+// GEOMETRY (constexpr, so the firmware index is built by the compiler)
+// ==============================================================================================
+// Vertex closing an edge
+static constexpr uint16_t geofence_next_vertex(const geofence_polygon_t *p, uint16_t vertex){
+    return (vertex + 1 == p->first_vertex + p->vertex_count) ? p->first_vertex : vertex + 1;
+}
+
+// Side of a point on the line A-B (> 0 left, < 0 right)
+static constexpr int64_t geofence_orientation(const geofence_vertex_t *a, const geofence_vertex_t *b, int32_t lat, int32_t lon){
+    return (int64_t)(b->longitude - a->longitude) * (lat - a->latitude) - (int64_t)(b->latitude - a->latitude) * (lon - a->longitude);
+}
+
+// Whether the segment P-C crosses the edge A-B, half-open on both lines so a path through a vertex is counted once
+static constexpr bool geofence_crosses(const geofence_vertex_t *a, const geofence_vertex_t *b, int32_t p_lat, int32_t p_lon, int32_t c_lat, int32_t c_lon){
+    if((geofence_orientation(a, b, p_lat, p_lon) > 0) == (geofence_orientation(a, b, c_lat, c_lon) > 0)){
+        return false;
+    }
+    geofence_vertex_t p = {p_lat, p_lon}, c = {c_lat, c_lon};
+    return (geofence_orientation(&p, &c, a->latitude, a->longitude) > 0) != (geofence_orientation(&p, &c, b->latitude, b->longitude) > 0);
+}
+
+// Brute-force test of a point against every edge of a polygon (index build and host reference)
+static constexpr bool geofence_inside_polygon(const geofence_vertex_t *vertices, const geofence_polygon_t *p, int32_t lat, int32_t lon){
+    bool inside = false;
+    for(uint16_t v = p->first_vertex; v < p->first_vertex + p->vertex_count; v++){
+        const geofence_vertex_t *a = &vertices[v];
+        const geofence_vertex_t *b = &vertices[geofence_next_vertex(p, v)];
+        if((a->latitude > lat) != (b->latitude > lat)){
+            // Longitude where the edge meets the parallel of the point, compared without dividing
+            int64_t lhs = (int64_t)(lon - a->longitude) * (b->latitude - a->latitude);
+            int64_t rhs = (int64_t)(b->longitude - a->longitude) * (lat - a->latitude);
+            if((b->latitude > a->latitude) ? (lhs < rhs) : (lhs > rhs)){
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+// Whether an edge may touch a cell (bounding boxes, extra edges only cost a test)
+static constexpr bool geofence_edge_touches_cell(const geofence_vertex_t *a, const geofence_vertex_t *b, int32_t lat0, int32_t lon0, int32_t height, int32_t width){
+    return ((a->latitude > b->latitude) ? a->latitude : b->latitude) >= lat0
+        && ((a->latitude < b->latitude) ? a->latitude : b->latitude) <= lat0 + height
+        && ((a->longitude > b->longitude) ? a->longitude : b->longitude) >= lon0
+        && ((a->longitude < b->longitude) ? a->longitude : b->longitude) <= lon0 + width;
+}
+// GEOMETRY END =================================================================================
+
+// ==============================================================================================
+// INDEX BUILD: the counts are returned whatever the table sizes, so a first call with null tables
+// sizes them. cell_start needs rows * cols + 1 elements.
+// ==============================================================================================
+static constexpr geofence_grid_t geofence_index_build(const geofence_vertex_t *vertices, uint16_t vertex_count,
+                                                      const geofence_polygon_t *polygons, uint16_t polygon_count, uint16_t rows, uint16_t cols,
+                                                      uint32_t *cell_start, geofence_entry_t *entries, uint32_t max_entries,
+                                                      uint16_t *cell_edges, uint32_t max_edges){
+    geofence_grid_t grid = {0, 0, 1, 1, rows, cols, 0, 0};
+
+    // Grid over the bounding box of every vertex
+    int32_t lat_min = INT32_MAX, lat_max = INT32_MIN, lon_min = INT32_MAX, lon_max = INT32_MIN;
+    for(uint16_t v = 0; v < vertex_count; v++){
+        lat_min = (vertices[v].latitude < lat_min) ? vertices[v].latitude : lat_min;
+        lat_max = (vertices[v].latitude > lat_max) ? vertices[v].latitude : lat_max;
+        lon_min = (vertices[v].longitude < lon_min) ? vertices[v].longitude : lon_min;
+        lon_max = (vertices[v].longitude > lon_max) ? vertices[v].longitude : lon_max;
+    }
+    grid.lat0 = lat_min;
+    grid.lon0 = lon_min;
+    grid.cell_height = (lat_max - lat_min) / rows + 1;           // Rounded up, so the north-east corner falls inside the grid
+    grid.cell_width = (lon_max - lon_min) / cols + 1;
+
+    if(cell_start != nullptr){
+        cell_start[0] = 0;
+    }
+    for(uint32_t cell = 0; cell < (uint32_t)rows * cols; cell++){
+        int32_t lat0 = grid.lat0 + (int32_t)(cell / cols) * grid.cell_height;
+        int32_t lon0 = grid.lon0 + (int32_t)(cell % cols) * grid.cell_width;
+
+        for(uint16_t i = 0; i < polygon_count; i++){
+            const geofence_polygon_t *p = &polygons[i];
+            uint32_t first_edge = grid.edge_count;
+            for(uint16_t v = p->first_vertex; v < p->first_vertex + p->vertex_count; v++){
+                if(geofence_edge_touches_cell(&vertices[v], &vertices[geofence_next_vertex(p, v)], lat0, lon0, grid.cell_height, grid.cell_width)){
+                    if(grid.edge_count < max_edges){
+                        cell_edges[grid.edge_count] = v;
+                    }
+                    grid.edge_count++;
+                }
+            }
+
+            bool centre_inside = geofence_inside_polygon(vertices, p, lat0 + grid.cell_height / 2, lon0 + grid.cell_width / 2);
+            if(grid.edge_count == first_edge && !centre_inside){
+                continue;                                        // Polygon away from this cell
+            }
+            if(grid.entry_count < max_entries){
+                entries[grid.entry_count].polygon = i | (centre_inside ? GEOFENCE_CENTRE_INSIDE : 0);
+                entries[grid.entry_count].edge_count = (uint16_t)(grid.edge_count - first_edge);
+                entries[grid.entry_count].first_edge = first_edge;
+            }
+            grid.entry_count++;
+        }
+        if(cell_start != nullptr){
+            cell_start[cell + 1] = grid.entry_count;
+        }
+    }
+    return grid;
+}
+// INDEX BUILD END ==============================================================================
+
+// ==============================================================================================
+// CLASSIFICATION: fences containing a point, ascending, at most max of them
+// ==============================================================================================
+static inline uint8_t geofence_index_classify(const geofence_index_t *index, int32_t latitude, int32_t longitude, uint16_t *inside, uint8_t max){
+    const geofence_grid_t *grid = &index->grid;
+    if(latitude < grid->lat0 || longitude < grid->lon0){
+        return 0;
+    }
+    int32_t row = (latitude - grid->lat0) / grid->cell_height;
+    int32_t col = (longitude - grid->lon0) / grid->cell_width;
+    if(row >= grid->rows || col >= grid->cols){
+        return 0;                                                // Outside the grid, so outside every fence
+    }
+
+    uint32_t cell = (uint32_t)row * grid->cols + col;
+    int32_t centre_lat = grid->lat0 + row * grid->cell_height + grid->cell_height / 2;
+    int32_t centre_lon = grid->lon0 + col * grid->cell_width + grid->cell_width / 2;
+
+    uint8_t count = 0;
+    for(uint32_t e = index->cell_start[cell]; e < index->cell_start[cell + 1] && count < max; e++){
+        const geofence_entry_t *entry = &index->entries[e];
+        uint16_t polygon = entry->polygon & ~GEOFENCE_CENTRE_INSIDE;
+        const geofence_polygon_t *p = &index->polygons[polygon];
+        bool is_inside = (entry->polygon & GEOFENCE_CENTRE_INSIDE) != 0;
+        for(uint32_t k = entry->first_edge; k < entry->first_edge + entry->edge_count; k++){
+            uint16_t v = index->cell_edges[k];
+            if(geofence_crosses(&index->vertices[v], &index->vertices[geofence_next_vertex(p, v)], latitude, longitude, centre_lat, centre_lon)){
+                is_inside = !is_inside;
+            }
+        }
+        if(is_inside){
+            inside[count++] = polygon;
+        }
+    }
+    return count;
+}
+// CLASSIFICATION END ===========================================================================
+
+#endif
@@ -0,0 +1,152 @@
+/* File for the GPS receiver configuration (baud, update rate and sentence filter) definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "gps_config.h"
+#include <string.h>
+
+// FUNCTION PROTOTYPES -----------------------------------------------------------------------------------------------------
+static void probe_start(BufferedSerial &serial, gps_negotiation_t *n, int baud);
+static int probe_poll(BufferedSerial &serial, gps_negotiation_t *n);
+
+// FUNCTION TO SEND A PMTK COMMAND =========================================================================================
+void gps_send_command(BufferedSerial &serial, const char *body){
+    char command[GPS_COMMAND_SIZE];
+    uint8_t checksum = 0;
+
+    for(const char *p = body; *p != '\0'; p++){
+        checksum ^= *p;                                         // NMEA checksum: XOR of every char between '$' and '*'
+    }
+
+    int length = snprintf(command, sizeof(command), "$%s*%02X\r\n", body, checksum);
+    if(length > 0 && length < (int)sizeof(command)){
+        serial.write(command, length);
+    }
+}
+
+// FUNCTIONS TO CHECK IF VALID SENTENCES ARRIVE AT A GIVEN BAUD ============================================================
+static void probe_start(BufferedSerial &serial, gps_negotiation_t *n, int baud){
+    serial.set_baud(baud);
+    serial.set_blocking(false);
+    n->parser = 0;                                              // 0: wait '$', 1: summing, 2: first hex digit, 3: second hex digit
+    n->checksum = 0;
+    n->deadline = Kernel::Clock::now() + GPS_BAUD_PROBE_TIME;
+}
+
+// Checks what arrived since the last call: 1 = valid sentence, 0 = still listening, -1 = probe time over
+static int probe_poll(BufferedSerial &serial, gps_negotiation_t *n){
+    char c;
+    bool found = false;
+
+    while(!found && serial.read(&c, 1) == 1){
+        // At a wrong baud the bytes are garbage, so one sentence with a good checksum is enough
+        if(c == '$'){
+            n->parser = 1;
+            n->checksum = 0;
+        }else if(n->parser == 1){
+            if(c == '*'){
+                n->parser = 2;
+            }else{
+                n->checksum ^= c;
+            }
+        }else if(n->parser == 2 || n->parser == 3){
+            int nibble = (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if(nibble < 0){
+                n->parser = 0;
+            }else if(n->parser == 2){
+                n->received = nibble << 4;
+                n->parser = 3;
+            }else{
+                found = ((n->received | nibble) == n->checksum);
+                n->parser = 0;
+            }
+        }
+    }
+
+    if(!found && Kernel::Clock::now() < n->deadline){
+        return 0;
+    }
+    serial.set_blocking(true);
+    return found ? 1 : -1;
+}
+
+// FUNCTIONS TO MOVE THE RECEIVER TO GPS_TARGET_BAUD (PMTK251) =============================================================
+void gps_config_negotiate_start(BufferedSerial &serial, gps_negotiation_t *n){
+    // The receiver may still be at the target baud from a previous boot (backup power kept)
+    n->stage = GPS_NEGOTIATE_PROBE_TARGET;
+    probe_start(serial, n, GPS_TARGET_BAUD);
+}
+
+bool gps_config_negotiate_step(BufferedSerial &serial, gps_negotiation_t *n, std::chrono::milliseconds *next){
+    int heard;
+    *next = GPS_BAUD_POLL_PERIOD;
+
+    switch(n->stage){
+        case GPS_NEGOTIATE_PROBE_TARGET:
+            heard = probe_poll(serial, n);
+            if(heard == 0){
+                return false;
+            }
+            if(heard > 0){
+                n->baud = GPS_TARGET_BAUD;
+                n->stage = GPS_NEGOTIATE_DONE;
+                return true;
+            }
+
+            char body[24];
+            snprintf(body, sizeof(body), "PMTK251,%d", GPS_TARGET_BAUD);
+            serial.set_baud(GPS_DEFAULT_BAUD);
+            gps_send_command(serial, body);                     // Leaves at 9600 baud in ~30 ms, well within the switch delay (no sync() holding the step)
+            n->deadline = Kernel::Clock::now() + GPS_BAUD_SWITCH_DELAY;
+            n->stage = GPS_NEGOTIATE_SWITCH;
+            *next = GPS_BAUD_SWITCH_DELAY;
+            return false;
+
+        case GPS_NEGOTIATE_SWITCH:
+            if(Kernel::Clock::now() < n->deadline){
+                *next = n->deadline - Kernel::Clock::now();     // Called early (woken up), keep waiting
+                return false;
+            }
+            probe_start(serial, n, GPS_TARGET_BAUD);
+            n->stage = GPS_NEGOTIATE_PROBE_SWITCHED;
+            return false;
+
+        case GPS_NEGOTIATE_PROBE_SWITCHED:
+            heard = probe_poll(serial, n);
+            if(heard == 0){
+                return false;
+            }
+            if(heard > 0){
+                n->baud = GPS_TARGET_BAUD;
+            }else{
+                serial.set_baud(GPS_DEFAULT_BAUD);              // Receiver did not follow, stay at the factory baud
+                n->baud = GPS_DEFAULT_BAUD;
+            }
+            n->stage = GPS_NEGOTIATE_DONE;
+            return true;
+
+        default:
+            return true;
+    }
+}
+
+// FUNCTION TO SET THE UPDATE RATE AND THE SENTENCE FILTER =================================================================
+int gps_config_apply(BufferedSerial &serial, int baud){
+    char body[32];
+
+    // If the baud negotiation failed, fall back to the highest rate the link can still carry
+    int rate = GPS_UPDATE_RATE_HZ;
+    while(rate > 1 && GPS_SENTENCES_PER_EPOCH * GPS_SENTENCE_MAX_BYTES * 10 * rate > baud * 8 / 10){
+        rate = (rate == 10) ? 5 : 1;
+    }
+
+    gps_send_command(serial, GPS_OUTPUT_FILTER);                // Only the sentences parse_GPS_data() uses
+    gps_send_command(serial, GPS_ANTENNA_STATUS_OFF);
+
+    snprintf(body, sizeof(body), "PMTK300,%d,0,0,0,0", 1000 / rate);
+    gps_send_command(serial, body);                             // Fix interval
+    snprintf(body, sizeof(body), "PMTK220,%d", 1000 / rate);
+    gps_send_command(serial, body);                             // NMEA output interval
+
+    return rate;
+}
@@ -0,0 +1,64 @@
+/* File for the GPS receiver configuration (baud, update rate and sentence filter) declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef GPS_CONFIG_H
+#define GPS_CONFIG_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Configuration
+#define GPS_UPDATE_RATE_HZ      1                               // Fix and NMEA output rate: 1, 5 or 10 Hz
+#define GPS_DEFAULT_BAUD        9600                            // Factory baud rate of the receiver
+#define GPS_TARGET_BAUD         115200                          // Baud negotiated with PMTK251
+#define GPS_BAUD_PROBE_TIME     1100ms                          // Listening time to detect a receiver already at GPS_TARGET_BAUD (> one 1 Hz epoch)
+#define GPS_BAUD_SWITCH_DELAY   100ms                           // Time for the receiver to apply PMTK251
+#define GPS_BAUD_POLL_PERIOD    5ms                             // UART polling period while probing a baud
+
+// Sentences kept by PMTK314: GGA (position, time, fix) and RMC (date for the aided start), nothing else is parsed
+#define GPS_SENTENCE_MAX_BYTES  82                              // NMEA 0183 maximum sentence length, CRLF included
+#define GPS_SENTENCES_PER_EPOCH 2
+#define GPS_OUTPUT_FILTER       "PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0"  // GLL,RMC,VTG,GGA,GSA,GSV,... output divisors
+#define GPS_ANTENNA_STATUS_OFF  "PGCMD,33,0"                    // $PGTOP antenna status is not parsed either
+
+#define GPS_UPDATE_PERIOD_MS    (1000 / GPS_UPDATE_RATE_HZ)
+#define GPS_COMMAND_SIZE        96                              // Longest PMTK command built at runtime, $ + body + *hh\r\n included
+
+// Compile-time checks
+MBED_STATIC_ASSERT(GPS_UPDATE_RATE_HZ == 1 || GPS_UPDATE_RATE_HZ == 5 || GPS_UPDATE_RATE_HZ == 10, "GPS_UPDATE_RATE_HZ must be 1, 5 or 10");
+MBED_STATIC_ASSERT(GPS_SENTENCES_PER_EPOCH * GPS_SENTENCE_MAX_BYTES * 10 * GPS_UPDATE_RATE_HZ <= GPS_TARGET_BAUD * 8 / 10,
+                   "GPS_TARGET_BAUD cannot carry the enabled sentences at GPS_UPDATE_RATE_HZ with a 20% margin");
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// Baud negotiation, run one step at a time so it never holds the caller for the whole probe
+typedef enum {
+    GPS_NEGOTIATE_PROBE_TARGET,                                  // Listening for a receiver already at GPS_TARGET_BAUD
+    GPS_NEGOTIATE_SWITCH,                                        // PMTK251 sent at the factory baud, waiting for the receiver to apply it
+    GPS_NEGOTIATE_PROBE_SWITCHED,                                // Listening at GPS_TARGET_BAUD again
+    GPS_NEGOTIATE_DONE
+} gps_negotiate_stage_t;
+
+typedef struct {
+    gps_negotiate_stage_t stage;
+    Kernel::Clock::time_point deadline;                          // End of the current probe or wait
+    uint8_t parser, checksum, received;                          // Checksum check of the sentences heard by the probe
+    int baud;                                                    // Baud the receiver ends up using, once DONE
+} gps_negotiation_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void gps_send_command(BufferedSerial &serial, const char *body);  // Frame a PMTK body with $, checksum and CRLF and send it
+void gps_config_negotiate_start(BufferedSerial &serial, gps_negotiation_t *n);
+bool gps_config_negotiate_step(BufferedSerial &serial, gps_negotiation_t *n, std::chrono::milliseconds *next);  // True once n->baud is known, else call again after *next
+int gps_config_apply(BufferedSerial &serial, int baud);           // Update rate and sentence filter, returns the rate used in Hz
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -5,6 +5,12 @@
 #include "gps_thread.h"
 #include <string.h>
 #include "message_q.h"
+#include "timebase.h"
+#include "persist.h"
+#include "gps_config.h"
+#include "geofence.h"
+#include "track.h"
+#include <time.h>
 
 // CONSTRUCTORS ------------------------------------------------------------------------
 BufferedSerial gps(GPS_TX, GPS_RX, GPS_BAUD_RATE);                    // GPS Serial interface (Adjust TX, RX pins for your board)
@@ -13,41 +19,113 @@ BufferedSerial gps(GPS_TX, GPS_RX, GPS_BAUD_RATE);                    // GPS Ser
 // Variables to parse the GPGGA sentence buffer
 static char buffer[GPS_BUFFER_SIZE];                                  // GPS sentence buffer
 static int bufferIndex = 0;
+static uint64_t sentence_tick_us = 0;                                 // Monotonic tick when the '$' of the current sentence arrived
 
 // Variables to store GPS fields
-static uint8_t fix_status = 0, gps_hour = 0, gps_minute = 0;
-static float gps_seconds = 0.0f, latitude = 0.0f, longitude = 0.0f, altitude = 0.0f;
+static uint8_t fix_status = 0, gps_hour = 0, gps_minute = 0;        // UTC, the local offset is only applied for display
+static uint16_t gps_millis = 0;                                       // Seconds of the minute in milliseconds, fraction included
+static int32_t latitude = 0, longitude = 0;                          // Micro-degrees, parsed without going through a float
+static float altitude = 0.0f;
+static uint8_t gps_day = 0, gps_month = 0;                            // UTC date from the GPRMC sentence
+static uint16_t gps_year = 0;
+static bool date_valid = false;
+
+// Steps of the task
+typedef enum {
+    GPS_STATE_SETUP,                                                  // UART
+    GPS_STATE_NEGOTIATE,                                              // PMTK251 to GPS_TARGET_BAUD, resumable (gps_config.h)
+    GPS_STATE_START,                                                  // Time/position aiding when a last fix is persisted
+    GPS_STATE_CONFIGURE,                                              // Update rate and sentence filter
+    GPS_STATE_READ                                                    // Drain the UART twice per update period
+} gps_state_t;
+static gps_state_t state = GPS_STATE_SETUP;
+static gps_negotiation_t negotiation;
+static std::chrono::milliseconds drain_period = GPS_THREAD_SLEEP;     // Half the update period the receiver was actually set to
+
+// Variables for the aided start and the time to first fix
+typedef struct {
+    int32_t latitude, longitude;                                      // Micro-degrees
+    int16_t altitude;                                                 // Decimetres
+    uint32_t utc_time;                                                // Unix time of the fix, also orders the copies
+} gps_fix_record_t;
+MBED_STATIC_ASSERT(PERSIST_FITS(sizeof(gps_fix_record_t), PERSIST_GPS_SIZE), "The GPS record does not fit its flash slot");
+
+static uint64_t gps_start_tick_us = 0;                                // Tick when the task started, the receiver searches from then (power up or standby wake)
+static volatile uint32_t ttff_ms = 0;                                 // Time to first fix of this boot
+static bool aided_start = false;
+static bool fix_checked = false;
+static uint64_t last_check_tick_us = 0;
+static gps_fix_record_t saved_record;                                 // Newest persisted fix
+static int8_t saved_copy = -1;                                        // Its copy in the flash slot, -1 if there is none
 
 // FUNCTION PROTOTYPES -----------------------------------------------------------------
-static void settingFrequency();
-static void enableGettingStatusFromAntenna();
 static void initializesSerialPort();
+static bool load_last_fix();
+static void startReceiver();
+static void aidReceiver(const gps_fix_record_t &record);
+static void onValidFix();
+static char *next_field(char **cursor);
+static void format_microdeg(char *out, size_t size, int32_t microdeg);
+static bool parse_UTC_time(const char *token);
+static int32_t parse_coordinate(const char *token);
 static bool parse_GPS_data(char *nmea_data);
 static void read_GPS();
 
 // =====================================================================================
 // GPS MAIN FUNCTION
 // =====================================================================================
-void gps_th_routine(){
-    // Initialization routine 
-    initializesSerialPort();
-    enableGettingStatusFromAntenna();
-    settingFrequency();
+// Run by its own thread or by the cooperative executor (see executor.h), so it never blocks: each wait is returned instead
+std::chrono::milliseconds gps_step(uint32_t woken){
+    std::chrono::milliseconds next;
+
+    switch(state){
+        // Initialization routine
+        case GPS_STATE_SETUP:
+            gps_start_tick_us = timebase_now_us();                    // The TTFF counts the baud negotiation too, the receiver is already searching
+            initializesSerialPort();
+            gps_config_negotiate_start(gps, &negotiation);
+            state = GPS_STATE_NEGOTIATE;
+            return GPS_BAUD_POLL_PERIOD;
+
+        case GPS_STATE_NEGOTIATE:
+            if(!gps_config_negotiate_step(gps, &negotiation, &next)){  // PMTK251 to GPS_TARGET_BAUD
+                return next;
+            }
+            state = GPS_STATE_START;
+            return 0ms;
 
-    while (true) {
-        read_GPS();                                                   // Read and process GPS data
+        case GPS_STATE_START:
+            startReceiver();                                          // Time/position aiding when a last fix is persisted
+            state = GPS_STATE_CONFIGURE;
+            return 0ms;
 
-        //sending message through message queue
+        case GPS_STATE_CONFIGURE: {
+            int rate_hz = gps_config_apply(gps, negotiation.baud);    // PMTK220/PMTK300 update rate and PMTK314 sentence filter
+            drain_period = std::chrono::milliseconds(1000 / rate_hz / 2);  // Lower than GPS_UPDATE_RATE_HZ if the baud negotiation failed
+            state = GPS_STATE_READ;
+            return drain_period;
+        }
 
-        ThisThread::sleep_for(GPS_THREAD_SLEEP);
+        case GPS_STATE_READ:
+        default:
+            read_GPS();                                               // Read and process GPS data
+            return drain_period;                                      // Sleep until the next read unless woken up earlier
     }
 }
 // GPS MAIN FUNCTION END ===============================================================
 
+// Put the receiver in standby and release the UART so the MCU can enter deep sleep ---
+void gps_standby(){
+    gps.write(SET_STANDBY, strlen(SET_STANDBY));
+    gps.sync();                                                       // Wait until the command is out
+    gps.enable_input(false);
+    gps.enable_output(false);
+}
+
 // Initializes UART 9600 8N1
 static void initializesSerialPort(){
-    // Initializes serial port 9600 bauds (8N1)
-    gps.set_baud(9600);
+    // Initializes serial port 9600 bauds (8N1), the faster baud is negotiated afterwards
+    gps.set_baud(GPS_BAUD_RATE);
     gps.set_format(
         /* bits */     8,
         /* parity */   BufferedSerial::None,
@@ -55,23 +133,206 @@ static void initializesSerialPort(){
     );
 }
 
-// Enable trace to see the antena status
-static void enableGettingStatusFromAntenna(){
-    gps.write(ENABLE_STATUS_ANTENA, sizeof(ENABLE_STATUS_ANTENA));
+// Format micro-degrees as a signed decimal degrees string ------------------------------
+static void format_microdeg(char *out, size_t size, int32_t microdeg){
+    uint32_t magnitude = (microdeg < 0) ? -microdeg : microdeg;
+    snprintf(out, size, "%s%lu.%06lu", (microdeg < 0) ? "-" : "", (unsigned long)(magnitude / MSG_MICRODEG_SCALE), (unsigned long)(magnitude % MSG_MICRODEG_SCALE));
+}
+
+// Newest copy of the persisted fix, the saves rotate through PERSIST_GPS_COPIES -------
+static bool load_last_fix(){
+    saved_copy = -1;
+    for(uint8_t copy = 0; copy < PERSIST_GPS_COPIES; copy++){
+        gps_fix_record_t record;
+        if(persist_load_copy(PERSIST_SLOT_GPS, copy, &record, sizeof(record)) && (saved_copy < 0 || record.utc_time > saved_record.utc_time)){
+            saved_record = record;
+            saved_copy = copy;
+        }
+    }
+    return saved_copy >= 0;
+}
+
+// Aid the start with the last persisted fix to cut the time to first fix -------------
+// No restart command: the receiver has been searching with its backup domain since power up, PMTK101 would start that
+// search over and drop what it acquired meanwhile
+static void startReceiver(){
+    if(!load_last_fix()){
+        return;                                                       // Nothing to aid with: the receiver does its own (cold) start
+    }
+
+    // Aiding needs the current time: only trust the RTC if it kept running since the fix was saved (warm reset, RTC backup).
+    // A wrong reference time would mislead the search instead of shortening it.
+    if(time(NULL) < (time_t)saved_record.utc_time){
+        return;
+    }
+
+    aided_start = true;
+    aidReceiver(saved_record);
+}
+
+// Time and position aiding, taken by the receiver while it searches --------------------
+static void aidReceiver(const gps_fix_record_t &record){
+    time_t now = time(NULL);                                          // Checked against the record by startReceiver()
+
+    struct tm *utc = gmtime(&now);
+    char body[GPS_COMMAND_SIZE - 8], lat[16], lon[16];
+
+    snprintf(body, sizeof(body), TIME_AIDING ",%04d,%02d,%02d,%02d,%02d,%02d", utc->tm_year + 1900, utc->tm_mon + 1, utc->tm_mday, utc->tm_hour, utc->tm_min, utc->tm_sec);
+    gps_send_command(gps, body);
+
+    format_microdeg(lat, sizeof(lat), record.latitude);
+    format_microdeg(lon, sizeof(lon), record.longitude);
+    snprintf(body, sizeof(body), POSITION_AIDING ",%s,%s,%d,%04d,%02d,%02d,%02d,%02d,%02d", lat, lon, record.altitude / MSG_ALTITUDE_SCALE,
+             utc->tm_year + 1900, utc->tm_mon + 1, utc->tm_mday, utc->tm_hour, utc->tm_min, utc->tm_sec);
+    gps_send_command(gps, body);
+}
+
+// Record the TTFF and keep the last good fix for the next start ----------------------
+static void onValidFix(){
+    if(ttff_ms == 0){
+        uint32_t elapsed_ms = (uint32_t)((sentence_tick_us - gps_start_tick_us) / 1000);
+        core_util_atomic_store_u32(&ttff_ms, elapsed_ms > 0 ? elapsed_ms : 1);
+    }
+
+    if(!date_valid){
+        return;                                                       // Aiding needs the date of GPRMC
+    }
+
+    // newlib has no TZ configured, so mktime() works in UTC here
+    struct tm utc = {};
+    utc.tm_year = gps_year - 1900;
+    utc.tm_mon = gps_month - 1;
+    utc.tm_mday = gps_day;
+    utc.tm_hour = gps_hour;
+    utc.tm_min = gps_minute;
+    utc.tm_sec = gps_millis / 1000;
+    time_t now = mktime(&utc);
+
+    if(fix_checked && (sentence_tick_us - last_check_tick_us) < GPS_PERSIST_PERIOD_US){
+        return;
+    }
+    fix_checked = true;
+    last_check_tick_us = sentence_tick_us;
+
+    set_time(now);                                                    // Keep the RTC on GPS time, it survives warm resets
+
+    // The aiding takes its time from the RTC, the record only has to be near: flash is written when the position moved,
+    // each time to the next copy (a sector rewritten at every boot and every hour lasted about 14 months)
+    if(saved_copy >= 0){
+        uint32_t north = (latitude > saved_record.latitude) ? latitude - saved_record.latitude : saved_record.latitude - latitude;
+        uint32_t east = (longitude > saved_record.longitude) ? longitude - saved_record.longitude : saved_record.longitude - longitude;
+        if(north <= GPS_PERSIST_MOVE_MICRODEG && east <= GPS_PERSIST_MOVE_MICRODEG){
+            return;
+        }
+    }
+    gps_fix_record_t record = {latitude, longitude, metres_to_decimetres(altitude), (uint32_t)now};
+    int8_t copy = (saved_copy + 1) % PERSIST_GPS_COPIES;
+    if(persist_save_copy(PERSIST_SLOT_GPS, copy, &record, sizeof(record))){
+        saved_record = record;
+        saved_copy = copy;
+    }
+}
+
+// TTFF getters for the main thread ----------------------------------------------------
+uint32_t gps_get_ttff_ms(){
+    return core_util_atomic_load_u32(&ttff_ms);
+}
+
+bool gps_is_aided_start(){
+    return aided_start;
+}
+
+// Split the next comma separated field, keeping empty ones (strtok would skip them) ---
+static char *next_field(char **cursor){
+    char *field = *cursor;
+    if(field == NULL){
+        return NULL;
+    }
+
+    char *comma = strchr(field, ',');
+    if(comma != NULL){
+        *comma = '\0';
+        *cursor = comma + 1;
+    }else{
+        *cursor = NULL;
+    }
+    return field;
 }
 
-// Set GPS measuring frequencies
-static void settingFrequency(){
-    gps.write(SET_UPDATING_NMEA_1HZ_RATE, sizeof(SET_UPDATING_NMEA_1HZ_RATE));  // Setting 1HZ of internal freq (updating NMEA traces frecuency at 1Hz)
-    gps.write(SET_SAMPLE_1HZ, sizeof(SET_SAMPLE_1HZ));                // Setting receptor sampling at 1Hz
+// Function to parse hhmmss[.sss] into hour, minute and milliseconds of the minute -----
+static bool parse_UTC_time(const char *token){
+    for(int i = 0; i < 6; i++){
+        if(token[i] < '0' || token[i] > '9'){
+            return false;
+        }
+    }
+
+    gps_hour = (token[0] - '0') * 10 + (token[1] - '0');
+    gps_minute = (token[2] - '0') * 10 + (token[3] - '0');
+    gps_millis = ((token[4] - '0') * 10 + (token[5] - '0')) * 1000;
+
+    // Fractional seconds, digit by digit so nothing is truncated through an int or lost in a float
+    if(token[6] == '.'){
+        uint16_t scale = 100;
+        for(const char *p = &token[7]; *p >= '0' && *p <= '9' && scale > 0; p++){
+            gps_millis += (*p - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    return true;
+}
+
+// Function to parse [d]ddmm.mmmm into micro-degrees -----------------------------------
+// A float has 24 bits of mantissa, about 1 m at 100 degrees of longitude, so the
+// minutes are read digit by digit and only divided by 60 once, rounded
+static int32_t parse_coordinate(const char *token){
+    int32_t whole = 0;                                                // [d]ddmm
+    const char *p = token;
+    for(; *p >= '0' && *p <= '9'; p++){
+        whole = whole * 10 + (*p - '0');
+    }
+
+    int32_t minutes_micro = (whole % 100) * 1000000;                 // Minutes in millionths of a minute
+    if(*p == '.'){
+        int32_t scale = 100000;
+        for(p++; *p >= '0' && *p <= '9' && scale > 0; p++){
+            minutes_micro += (*p - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    return (whole / 100) * MSG_MICRODEG_SCALE + (minutes_micro + 30) / 60;
 }
 
 // Function to parse and extract lat, lon and alt from GPGGA sentence ------------------
+// (and the date from GPRMC, only needed to aid the next start)
 static bool parse_GPS_data(char *nmea_data){
     bool ret = false;
 
+    if(strncmp(nmea_data, "$GPRMC", 6) == 0){
+        char *cursor = nmea_data;
+        char *token = next_field(&cursor);
+        int field = 0;
+
+        while(token != NULL){
+            field++;
+
+            // Field 10: Date (ddmmyy format)
+            if(field == 10 && strlen(token) == 6){
+                gps_day = (token[0] - '0') * 10 + (token[1] - '0');
+                gps_month = (token[2] - '0') * 10 + (token[3] - '0');
+                gps_year = 2000 + (token[4] - '0') * 10 + (token[5] - '0');
+                date_valid = (gps_day >= 1 && gps_day <= 31 && gps_month >= 1 && gps_month <= 12);
+            }
+
+            token = next_field(&cursor);
+        }
+    }
+
     if(strncmp(nmea_data, "$GPGGA", 6) == 0){                         // Check if it's a GPGGA sentence
-        char *token = strtok(nmea_data, ",");
+        char *cursor = nmea_data;
+        char *token = next_field(&cursor);
         int field = 0;
 
         ret = true;
@@ -81,16 +342,7 @@ static bool parse_GPS_data(char *nmea_data){
 
             // Field 2: UTC Time (hhmmss.sss format)
             if(field == 2 && strlen(token) >= 6) {
-                int raw_time = atof(token);
-                gps_hour = raw_time / 10000;
-                gps_minute = (raw_time % 10000) / 100;
-                gps_seconds = fmod(raw_time, 100.0f);
-
-                // Adjust for Spain time (UTC+1)
-                gps_hour ++;
-                if (gps_hour >= 24) {
-                    gps_hour -= 24;                                   // Wrap around if exceeding 23
-                }
+                parse_UTC_time(token);                                // Kept in UTC, fractional seconds included
             }
 
             // Field 7: GPS Fix status (0 = no fix, 1 = GPS fix, 2 = DGPS fix)
@@ -100,10 +352,7 @@ static bool parse_GPS_data(char *nmea_data){
 
             // Field 3: Latitude
             if(field == 3 && strlen(token) > 0){
-                float raw_latitude = atof(token);
-                int degrees = (int)(raw_latitude / 100);
-                float minutes = raw_latitude - (degrees * 100);
-                latitude = degrees + minutes / 60.0f;
+                latitude = parse_coordinate(token);
             }
 
             // Field 4: Latitude hemisphere (N/S)
@@ -113,10 +362,7 @@ static bool parse_GPS_data(char *nmea_data){
 
             // Field 5: Longitude
             if(field == 5 && strlen(token) > 0){
-                float raw_longitude = atof(token);
-                int degrees = (int)(raw_longitude / 100);
-                float minutes = raw_longitude - (degrees * 100);
-                longitude = degrees + minutes / 60.0f;
+                longitude = parse_coordinate(token);
             }
 
             // Field 6: Longitude hemisphere (E/W)
@@ -126,10 +372,10 @@ static bool parse_GPS_data(char *nmea_data){
 
             // Field 10: Altitude
             if(field == 10 && strlen(token) > 0){
-                altitude = atof(token);
+                altitude = strtof(token, nullptr);
             }
 
-            token = strtok(NULL, ",");
+            token = next_field(&cursor);
         }
     }
 
@@ -140,8 +386,8 @@ static bool parse_GPS_data(char *nmea_data){
 static void read_GPS(){
     char c;
     
-    // Read from GPS serial until a complete NMEA sentence is received
-    while (gps.read(&c, 1)) {
+    // Read what the UART already holds, never waiting for more (a step must not block)
+    while (gps.readable() && gps.read(&c, 1) == 1) {
         if (c == '\n') {
             buffer[bufferIndex] = '\0';                               // Null-terminate the string
             bufferIndex = 0;
@@ -149,11 +395,29 @@ static void read_GPS(){
             // Parse GPS data if it's a GPGGA sentence
             //printf("%s",buffer);
             if(parse_GPS_data(buffer)){
-                send_GPS_message_through_main_thread(fix_status, gps_hour, gps_minute, gps_seconds, latitude, longitude,  altitude);
-                break;
+                uint16_t geofence_events[GEOFENCE_MAX_EVENTS];
+                memset(geofence_events, 0xFF, sizeof(geofence_events));  // GEOFENCE_NO_EVENT
+                if(fix_status > 0 && fix_status <= 2){
+                    onValidFix();
+
+                    // Without a fix the fences keep their last state, so losing the signal raises no exit event
+                    geofence_update(latitude, longitude, geofence_events);
+                }
+                message_t_gps fix, kept[TRACK_MAX_OUTPUT];
+                pack_GPS_message(&fix, sentence_tick_us, fix_status, gps_hour, gps_minute, gps_millis, latitude, longitude,  altitude, geofence_events);
+                update_latest_GPS(&fix);                              // Current position, whether the fix shapes the track or not
+
+                // Only the points of the simplified track are queued
+                uint8_t count = track_push(&fix, kept);
+                for(uint8_t i = 0; i < count; i++){
+                    send_GPS_message_through_main_thread(&kept[i]);
+                }
             }
 
         } else {
+            if(c == '$'){
+                sentence_tick_us = timebase_now_us();                 // Stamp the sentence as soon as it starts arriving
+            }
             buffer[bufferIndex++] = c;
             if (bufferIndex >= sizeof(buffer) - 1) {
                 bufferIndex = 0;                                      // Prevent buffer overflow
@@ -2,6 +2,7 @@
 
 // LIBRARIES ------------------------------------------------------------------------------------
 #include "mbed.h"
+#include "gps_config.h"
 
 // LIBRARY GUARD --------------------------------------------------------------------------------
 #ifndef GPS_THREAD_H
@@ -11,24 +12,31 @@
 // MACROS
 // ==============================================================================================
 // Thread macros
-#define GPS_THREAD_SLEEP   500ms              // GPS measuring every 500 ms
+#define GPS_THREAD_STACK   1024               // Stack of the GPS thread (threaded build)
+#define GPS_THREAD_SLEEP   std::chrono::milliseconds(GPS_UPDATE_PERIOD_MS / 2)   // UART drained twice per update period (500 ms at 1 Hz, 50 ms at 10 Hz), until the rate is configured
+#define GPS_FLAG_READ_NOW  0x01               // Thread flag to read the UART right away (mode change or on-demand request)
+#define GPS_PERSIST_PERIOD_US 3600000000ULL   // Fix checked against the flash record at the first fix and then once per hour
+#define GPS_PERSIST_MOVE_MICRODEG 10000       // Written again only once this far from the record on either axis (1.1 km north-south)
 
 // UART macros
 #define GPS_TX           PA_9
 #define GPS_RX           PA_10
-#define GPS_BAUD_RATE    9600
-#define GPS_BUFFER_SIZE  256
+#define GPS_BAUD_RATE    GPS_DEFAULT_BAUD     // Baud at power up, GPS_TARGET_BAUD is negotiated afterwards
+#define GPS_BUFFER_SIZE  96                   // One NMEA sentence (82 chars max) plus margin, only GGA and RMC are output
 
 // Commands to send (RX)
-#define ENABLE_STATUS_ANTENA       "$PGCMD,33,1*6C\r\n"
-#define SET_UPDATING_NMEA_1HZ_RATE "$PMTK300,1000,0,0,0,0*2C\r\n"
-#define SET_SAMPLE_1HZ             "$PMTK220,1000*1F\r\n"
+#define SET_STANDBY                "$PMTK161,0*28\r\n"   // Standby, the receiver keeps its almanac/ephemeris for the next start
+#define TIME_AIDING                "PMTK740"                // Reference UTC time: YYYY,MM,DD,hh,mm,ss (checksum added at runtime)
+#define POSITION_AIDING            "PMTK741"                // Reference position: Lat,Long,Alt,YYYY,MM,DD,hh,mm,ss
 // MACROS END ===================================================================================
 
 // ==============================================================================================
 // PROTOTYPES
 // ==============================================================================================
-extern void gps_th_routine();
+extern std::chrono::milliseconds gps_step(uint32_t woken);  // One step of the GPS task (setup, baud, start, configuration, reading), returns the wait before the next
+extern void gps_standby();                    // Call once the GPS thread is stopped
+extern uint32_t gps_get_ttff_ms();            // Time to first fix of this boot, 0 while there is no fix yet
+extern bool gps_is_aided_start();             // True if this boot started with a persisted position
 // PROTOTYPES END ===============================================================================
 
 #endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+/* File for the shared I2C bus function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include <algorithm>
+#include <new>
+#include "i2c_bus.h"
+#include "tca9548a.h"
+#include "timebase.h"
+
+// DEVICE TABLE ------------------------------------------------------------------------------------------------------------
+typedef struct {
+    const char *name;
+    uint32_t budget_us;                                         // Time after which no attempt starts and a late answer is discarded
+} i2c_device_info_t;
+
+// The budget limits the retries, not one attempt: mbed's blocking I2C can not be aborted, so an attempt in flight ends
+// when the slave answers or after I2C_HAL_BYTE_TIMEOUT_US per byte, whatever the budget. A transaction lasts at most
+// budget_us + (bytes + 1) * I2C_HAL_BYTE_TIMEOUT_US, plus a bus recovery
+
+static const i2c_device_info_t DEVICES[I2C_DEV_COUNT] = {
+    {"MMA8451Q", 20000},                                        // Full FIFO, 192-byte burst at 100 kHz, is ~17.5 ms
+    {"Si7021",   30000},                                        // Hold master mode: the slave stretches SCL up to 22.8 ms (12-bit RH + 14-bit T)
+    {"TCS34725", 2000},                                         // 8-byte burst at 100 kHz is ~1 ms
+    {"TCA9548A", 1000},                                         // One control byte
+};
+
+// CONSTRUCTORS ------------------------------------------------------------------------------------------------------------
+static I2C i2c(SDA_PIN, SCL_PIN);                               // Only used by the sensors' thread, re-created in place by i2c_bus_recover()
+
+// FUNCTION TO CHECK WHETHER A SLAVE HOLDS SDA LOW =========================================================================
+static bool sda_held_low(){
+    gpio_t sda;
+    gpio_init(&sda, SDA_PIN);                                   // Only maps the input register: the pin stays with the I2C peripheral (STM32 IDR reads it in any mode)
+    return gpio_read(&sda) == 0;                                // The failed transaction ended with a STOP, so a free bus is idle high
+}
+
+// FUNCTION TO RUN ONE ATTEMPT OF A TRANSACTION ============================================================================
+static bool attempt(int address, const char *tx, int tx_len, char *rx, int rx_len){
+    if(i2c.write(address, tx, tx_len, rx_len > 0) != 0){       // NACK or bus error (the repeated start keeps the bus for the read)
+        return false;
+    }
+    return (rx_len == 0) || (i2c.read(address, rx, rx_len) == 0);
+}
+
+// FUNCTION TO RUN A TRANSACTION WITH RETRIES LIMITED BY THE DEVICE BUDGET =================================================
+bool i2c_bus_transfer(i2c_probe_t *probe, const char *tx, int tx_len, char *rx, int rx_len){
+    i2c_health_t *h = &probe->health;
+    uint32_t budget_us = DEVICES[probe->device].budget_us;
+    uint64_t start_us = timebase_now_us();
+    uint32_t elapsed_us = 0;
+    uint8_t attempts = I2C_MAX_ATTEMPTS;                        // Narrowed to what the budget still holds once the first attempt is timed
+    bool timed_out = false;
+    bool ok = false;
+
+    h->transactions++;
+    bool routed = (probe->mux_channel == I2C_MUX_NONE) || tca9548a_select(probe->mux_channel);  // No-op if the channel is already selected
+    for(uint8_t i = 0; routed && i < attempts && !ok; i++){
+        if(i > 0){
+            h->retries++;
+            wait_us(I2C_RETRY_DELAY_US);
+        }
+
+        uint64_t attempt_start_us = timebase_now_us();
+        ok = attempt(probe->address, tx, tx_len, rx, rx_len);
+        uint64_t now_us = timebase_now_us();
+        elapsed_us = (uint32_t)(now_us - start_us);
+        if(elapsed_us > budget_us){                             // A late answer is not trusted and the budget is spent: no more attempts
+            h->over_budget++;
+            timed_out = true;
+            ok = false;
+            break;
+        }
+
+        if(i == 0 && !ok){
+            // A NACK ends an attempt early, so a retry is planned as the slower of this attempt and a complete transfer
+            uint32_t attempt_us = std::max((uint32_t)(now_us - attempt_start_us), (uint32_t)(tx_len + rx_len + 2) * I2C_BYTE_TIME_US);
+            uint32_t retries = (budget_us - elapsed_us) / (I2C_RETRY_DELAY_US + attempt_us);
+            attempts = (uint8_t)std::min((uint32_t)I2C_MAX_ATTEMPTS, 1 + retries);
+        }
+    }
+
+    if(elapsed_us > h->worst_us){
+        h->worst_us = elapsed_us;
+    }
+
+    if(ok){
+        h->consecutive_failures = 0;
+        return true;
+    }
+
+    h->failures++;
+    if(h->consecutive_failures < UINT8_MAX){
+        h->consecutive_failures++;
+    }
+
+    // A slave interrupted mid-byte keeps SDA low and blocks every other device, release it before the next transaction.
+    // A plain NACK (absent or busy probe) leaves the bus idle and needs nothing.
+    if(routed && (timed_out || sda_held_low())){                // Otherwise the failed mux transaction already did it
+        h->recoveries++;
+        i2c_bus_recover();
+    }
+    return false;
+}
+
+// FUNCTION TO RECOVER A STUCK BUS =========================================================================================
+void i2c_bus_recover(){
+    i2c.~I2C();                                                 // Hand the pins back to GPIO
+
+    {
+        DigitalInOut sda(SDA_PIN);
+        DigitalInOut scl(SCL_PIN);
+        sda.input();
+        scl.output();
+        scl.mode(OpenDrain);
+        scl = 1;
+
+        // Clock until the slave lets SDA go
+        for(uint8_t i = 0; i < I2C_RECOVERY_CLOCKS && !sda.read(); i++){
+            scl = 0;
+            wait_us(I2C_RECOVERY_HALF_PERIOD_US);
+            scl = 1;
+            wait_us(I2C_RECOVERY_HALF_PERIOD_US);
+        }
+
+        // STOP condition: SDA rising while SCL is high
+        sda.output();
+        sda.mode(OpenDrain);
+        scl = 0;
+        sda = 0;
+        wait_us(I2C_RECOVERY_HALF_PERIOD_US);
+        scl = 1;
+        wait_us(I2C_RECOVERY_HALF_PERIOD_US);
+        sda = 1;
+        wait_us(I2C_RECOVERY_HALF_PERIOD_US);
+    }
+
+    new (&i2c) I2C(SDA_PIN, SCL_PIN);                           // Pins back to the peripheral, which also clears its error state
+}
+
+// FUNCTION TO GET THE NAME OF A DEVICE TYPE ==============================================================================
+const char *i2c_bus_device_name(i2c_device_t device){
+    return DEVICES[device].name;
+}
+
+// FUNCTION TO PRINT THE HEALTH COUNTERS OF A PROBE ========================================================================
+void i2c_bus_print_health(const i2c_probe_t *probe){
+    const i2c_health_t *h = &probe->health;
+    printf("I2C %s #%d", DEVICES[probe->device].name, probe->probe_id);
+    if(probe->mux_channel != I2C_MUX_NONE){
+        printf(" (mux %d)", probe->mux_channel);
+    }
+    printf(": %lu transactions, %lu failed, %lu retries, %lu over budget, %lu recoveries, worst %lu us%s\n\r",
+           (unsigned long)h->transactions, (unsigned long)h->failures, (unsigned long)h->retries, (unsigned long)h->over_budget,
+           (unsigned long)h->recoveries, (unsigned long)h->worst_us, h->consecutive_failures ? " - NOT RESPONDING" : "");
+}
@@ -0,0 +1,72 @@
+/* File for the shared I2C bus function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Pins
+#define SDA_PIN PB_9
+#define SCL_PIN PB_8
+
+// Retry policy (the latency budget of each device is in i2c_bus.cpp)
+#define I2C_MAX_ATTEMPTS           3                            // Attempts of a transaction while its budget lasts
+#define I2C_RETRY_DELAY_US         100                          // Pause between attempts, lets a slave finish an internal write
+#define I2C_BYTE_TIME_US           90                           // One byte + ACK at 100 kHz, lower bound of an attempt when planning retries
+#define I2C_HAL_BYTE_TIMEOUT_US    9600                         // STM32 i2c_api gives up on a byte after SystemCoreClock / hz * 30 cycles: the only end of an attempt a slave stretches
+
+#define I2C_MUX_NONE               0xFF                         // Probe wired directly to the bus, not behind the TCA9548A
+
+// Bus recovery (NXP UM10204, 3.1.16: clock the stuck slave out, then issue a STOP)
+#define I2C_RECOVERY_CLOCKS        9                            // One byte + ACK, enough for any slave to release SDA
+#define I2C_RECOVERY_HALF_PERIOD_US 5                           // 100 kHz bit-banged clock
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+typedef enum {
+    I2C_DEV_MMA8451,
+    I2C_DEV_SI7021,
+    I2C_DEV_TCS34725,
+    I2C_DEV_TCA9548A,
+    I2C_DEV_COUNT
+} i2c_device_t;
+
+// Health counters of a probe, only written by the sensors' thread
+typedef struct {
+    uint32_t transactions;                                       // Transactions requested
+    uint32_t failures;                                           // Transactions that failed after every attempt
+    uint32_t retries;                                            // Extra attempts
+    uint32_t over_budget;                                        // Transactions whose answer came after the device budget (discarded, not retried)
+    uint32_t recoveries;                                         // Bus recoveries triggered by this device
+    uint32_t worst_us;                                           // Slowest transaction
+    uint8_t consecutive_failures;                                // Failed transactions in a row (0 = device healthy)
+} i2c_health_t;
+
+// One physical device on the bus, passed to every driver call
+typedef struct {
+    i2c_device_t device;                                         // Type: selects the driver and the retry budget
+    int address;                                                 // 8-bit mbed address
+    uint8_t mux_channel;                                         // TCA9548A channel the probe sits behind, or I2C_MUX_NONE
+    uint8_t probe_id;                                            // Carried in the messages (probes of different types on one bed share it)
+    bool ready;                                                  // Configured and answering, cleared on a failed read
+    i2c_health_t health;
+} i2c_probe_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+bool i2c_bus_transfer(i2c_probe_t *probe, const char *tx, int tx_len, char *rx, int rx_len);  // Route the mux to the probe, write tx, then read rx_len bytes after a repeated start (rx_len 0 = write only)
+void i2c_bus_recover();                                                          // Free a slave holding SDA low and re-initialize the peripheral
+const char *i2c_bus_device_name(i2c_device_t device);
+void i2c_bus_print_health(const i2c_probe_t *probe);
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,58 @@
+/* File for the latest-value cell (double-buffered, sequence checked) template */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef LATEST_VALUE_H
+#define LATEST_VALUE_H
+
+// ==============================================================================================
+// LATEST-VALUE CELL
+// - One writer thread, any number of reader threads (or ISRs), no locks and no memory pool.
+// - Two slots: a write fills the slot not published and then publishes it by advancing the
+//   sequence, so the published slot is always complete and a reader never waits for a writer.
+// - A reader copies the published slot and retries only if a write was published meanwhile (the
+//   next one would refill that very slot). A reader that preempted the writer (higher priority or
+//   ISR) cannot see that happen and always finishes in one pass; a lower priority one retries only
+//   while complete writes keep preempting its copy.
+// ==============================================================================================
+template <typename T>
+class LatestValue {
+public:
+    LatestValue() : _seq(0) {}
+
+    // Writer side: constant time, never blocks
+    void write(const T &value){
+        uint32_t seq = _seq;                                     // Only the writer changes it
+        memcpy(&_slot[(seq + 1) & 1], &value, sizeof(T));        // The slot readers are not told about
+        core_util_atomic_store_u32(&_seq, seq + 1);              // Publish it (the store is fenced on both sides)
+    }
+
+    // Reader side: false if nothing was written yet
+    bool read(T *value) const {
+        while(true){
+            uint32_t before = core_util_atomic_load_u32(&_seq);  // Fenced after the load: the copy cannot start earlier
+            if(before == 0){
+                return false;
+            }
+            memcpy(value, &_slot[before & 1], sizeof(T));
+            MBED_BARRIER();                                      // Nor finish after the second load
+            if(core_util_atomic_load_u32(&_seq) == before){
+                return true;                                     // The slot is only refilled by the write after the next publication
+            }
+        }
+    }
+
+    // Number of writes so far
+    uint32_t writes() const {
+        return core_util_atomic_load_u32(&_seq);
+    }
+
+private:
+    volatile uint32_t _seq;                                      // Writes published, the newest value is in _slot[_seq & 1]
+    T _slot[2];
+};
+// LATEST-VALUE CELL END ========================================================================
+
+#endif
@@ -11,9 +11,25 @@
 
 // LIBRARIES ----------------------------------------------------------------------------------
 #include "mbed.h"
+#include <ctype.h>
 #include "sensors_thread.h"
 #include "gps_thread.h"
 #include "message_q.h"
+#include "alarms.h"
+#include "anomaly.h"
+#include "timebase.h"
+#include "stats.h"
+#include "persist.h"
+#include "mma8451.h"
+#include "rollup.h"
+#include "console.h"
+#include "scan.h"
+#include "geofence.h"
+#include "colour_class.h"
+#include "calib.h"
+#include "executor.h"
+#include "blackbox.h"
+#include "uplink.h"
 
 // MACROS -------------------------------------------------------------------------------------
 #define MAIN_THREAD_FREQ   100ms                                                 // Main thread sampling frequency
@@ -21,7 +37,9 @@
 #define TEST_TICKER_FREQ   2000ms                                                // Ticker timer to print measurements in TEST_MODE
 #define NORMAL_TICKER_FREQ 10000ms                                               // Ticker timer to print measurements in NORMAL_MODE
 #define STATS_TICKER_FREQ  60000ms                                               // Ticker timer to print stats in NORMAL_MODE
-#define G_TO_MS2           9.81                                                  // Macro to convert G forces of the accelerometer to m/s2
+#define MODE_SWITCH_BUDGET_US 200000                                             // Bound from the button to a fresh sample at the new cadence (wake-up + ~50 ms acquisition + 100 ms main loop)
+#define SHUTDOWN_BLINKS    6                                                     // LED4 blinks before the freefall low-power state
+#define WAKE_BUTTON_FLAG   0x01                                                  // Event flag set by the USER BUTTON to leave the low-power state
 #define LED1_PIN           PB_5                                                  // Pin internally connected to LED1
 #define LED3_PIN           PB_6                                                  // Pin internally connected to LED3
 #define LED4_PIN           PB_7                                                  // Pin internally connected to LED4
@@ -35,9 +53,11 @@ static Ticker test_ticker;
 static Ticker normal_ticker;                                                     // Constructor for ticker NORMAL_MODE
 static Ticker stats_ticker;                                                      // Constructor for printing stats in NORMAL_MODE
 
-// THREADS ------------------------------------------------------------------------------------
-static Thread sensors_th(osPriorityNormal, 512);                                 // Thread for the measurements of ANALOGIC and I2C sensors
-static Thread gps_th(osPriorityHigh, 1024);                                      // Thread for the measurements of the GPS
+// THREADS (the cooperative build runs their tasks on the main thread instead) ---------------
+#if !EXECUTOR_ENABLED
+static Thread sensors_th(osPriorityNormal, SENSORS_THREAD_STACK);                // Thread for the measurements of ANALOGIC and I2C sensors
+static Thread gps_th(osPriorityHigh, GPS_THREAD_STACK);                          // Thread for the measurements of the GPS
+#endif
 
 // I/O INITIALIZATION -------------------------------------------------------------------------
 static BusOut myLED(LED1_PIN, LED3_PIN, LED4_PIN);                               // Control of the built-in LEDs
@@ -48,11 +68,24 @@ static InterruptIn button(BUTTON_PIN);
 enum Mode{TEST_MODE, NORMAL_MODE, ADVANCED_MODE};                                // Sequential state machine modes
 static volatile Mode current_mode = TEST_MODE;                                   // Mode to store the current mode
 
+// PERSISTED STATE ----------------------------------------------------------------------------
+typedef struct {
+    uint8_t mode;                                                                // Mode at shutdown
+    uint8_t tap_count;                                                           // Taps counted since the last report
+    uint8_t sensors_configured;                                                  // I2C sensors were configured and keep power, their init can be skipped
+    uint8_t warm_boot_pending;                                                   // Set by the shutdown path, consumed by the next boot
+    stats_t stats;                                                               // Stats accumulators of the current period
+    message_t_gps last_fix;                                                      // Last GPS fix received
+} state_record_t;
+MBED_STATIC_ASSERT(PERSIST_FITS(sizeof(state_record_t), PERSIST_STATE_SIZE), "The state record does not fit its flash slot");
+
 // GLOBAL VARIABLES ---------------------------------------------------------------------------
-bool TEST_MODE_SAMPLING_FLAG = true;                                             // Initially, we are in TEST_MODE
-bool NORMAL_MODE_SAMPLING_FLAG = false;
-static bool T_INVALID = false;
-static bool RH_INVALID = false;
+volatile bool TEST_MODE_SAMPLING_FLAG = true;                                    // Initially, we are in TEST_MODE. Read by the sensors' thread, always accessed atomically
+volatile bool NORMAL_MODE_SAMPLING_FLAG = false;
+static uint16_t alarms_active = 0;                                               // Active alarm rules of the last received sample
+static uint16_t alarms_seen = 0;                                                 // Alarms active at any sample since the last NORMAL_MODE report
+static uint8_t anomalies_active = 0;                                             // Anomalous channels of the last received sample
+static uint8_t anomalies_seen = 0;                                               // Anomalies flagged since the last NORMAL_MODE report
 
 // EXTERN VARIABLES ---------------------------------------------------------------------------
 extern volatile bool tap_detected;                                               // Flag that is received from the sensors' thread when MMA8451Q interruptions take place
@@ -64,18 +97,15 @@ static volatile bool normal_tick_event = false;
 static volatile bool stats_tick_event = false;                                   // Flag for stats calculation in NORMAL_MODE
 static volatile bool mode_change_flag = false;                                   // Flag to be set at mode change
 
-// STATS VARIABLES (static mejor!!!!!!!) ----------------------------------------------------------------------------
-static float humidity_min = 100.0, humidity_max = 0.0, humidity_sum = 0.0;       // Variables to store stats of Si7021 %RH. FOR ALL VARIABLES, THESE INITIALIZATIONS HAVE BEEN DONE LIKE THIS TO WORK WITH 'fmin()' and 'fmax()' FUNCTIONS
-static float temperature_min = 100.0, temperature_max = -100.0, temperature_sum = 0.0;  // Variables to store stats of Si7021 T
-static float moist_min = 100.0, moist_max = 0.0, moist_sum = 0.0;                // Variables to store stats of soil moisture sensor
-static float light_min = 100.0, light_max = 0.0, light_sum = 0.0;                // Variables to store stats of phototransistor
-static float ax_min = 100.0, ax_max = -100.0;                                    // Variables to store stats of x-axis
-static float ay_min = 100.0, ay_max = -100.0;                                    // Variables to store stats of y-axis
-static float az_min = 100.0, az_max = -100.0;                                    // Variables to store stats of z-axis
+// STATS VARIABLES (accumulators live in stats.cpp) ------------------------------------------
 static uint8_t tap_count = 0;                                                    // Counter for the amount of taps on the accelerometer
-static uint8_t sample_count = 0;                                                 // Counter to computate stats after the performed amount of measurements
-static uint8_t humidity_count = 0, temperature_count = 0;                        // Valid temperature and relative humidity samples count
-static uint8_t red_count = 0, green_count = 0, blue_count = 0;                   // Color dominance counters
+
+// BOOT VARIABLES -----------------------------------------------------------------------------
+static EventFlags wake_flags;                                                    // Wakes the main thread from the freefall low-power state
+static bool warm_boot = false;                                                   // State restored from the freefall snapshot
+static bool first_sample_pending = true;                                         // Boot-to-first-sample time not reported yet
+static bool first_fix_pending = true;                                            // GPS time to first fix not reported yet
+static uint64_t freefall_tick_us = 0;                                            // ADVANCED_MODE freefall being handled: waiting for its black-box window
 
 // STATIC VARIABLES (SENSORS AND GPS QUEUE MESSAGES) ------------------------------------------
 static float humidity, temperature;
@@ -83,16 +113,34 @@ static float moistPercAnalogValue;
 static float lightPercAnalogValue;
 static float ax, ay, az;
 static uint16_t clear, red, green, blue;
-static uint8_t fix_status, gps_hour, gps_minute;
-static float gps_seconds, latitude, longitude, altitude;
+static colour_class_t leaf_colour = COLOUR_UNKNOWN;                             // Class of the last valid colour reading
+static message_t_sensors sensors_msg;                                            // Last packed sensors' sample
+static message_t_sensors probe_msgs[SCAN_PROBE_IDS];                             // Last sample of every bed on the I2C multiplexer (index = probe_id, 0 unused)
+static message_t_gps gps_msg;                                                    // Last packed GPS fix
+static uint64_t timebase_fix_tick_us = 0;                                        // Tick of the last fix that disciplined the timebase
+static record_t_joined joined_record;                                            // Last sample paired with the fix nearest in time
+static volatile uint64_t button_press_tick_us = 0;                               // Tick of the last button press, stamped by its ISR
+static uint64_t mode_switch_tick_us = 0;                                         // Tick of the press being measured, 0 once its latency has been measured
+static uint32_t mode_switch_latency_max_us = 0;                                  // Worst mode switch latency since boot
+static char console_line[CONSOLE_LINE_SIZE];                                     // Last command received on the serial console
 
 // FUNCTION PROTOTYPES ------------------------------------------------------------------------
+static std::chrono::milliseconds mainLoopStep(uint32_t woken);
 static void startAllThreads();
 static void set_mode_change_flag();
 static void next_mode();
+static bool receivePrimarySample();
 static void printSensorsInfo();
-static void resetStats();
-static void printStats();                                                        // REMEMBER THIS FUNCTION IS TO CALCULATE STATS FOR THE REQUIRED SENSORS, NOT ALL OF THEM
+static void measureModeSwitchLatency();
+static void printJoinedRecord();
+static void restoreState(const state_record_t *state);
+static void shutdownAndWaitForWakeUp();
+static void handleConsoleCommand(const char *line);
+
+// TASKS --------------------------------------------------------------------------------------
+static executor_task_t main_task = EXECUTOR_TASK("main", mainLoopStep, 0);
+static executor_task_t sensors_task = EXECUTOR_TASK("sensors", sensors_step, SENSORS_WAKEUP_FLAGS);
+static executor_task_t gps_task = EXECUTOR_TASK("gps", gps_step, GPS_FLAG_READ_NOW);
 
 // ============================================================================================
 // INTERRUPTION SUBROUTINES
@@ -114,8 +162,14 @@ static void stats_ticker_ISR(){
 
 // BUTTON PRESS ISR
 static void button_press_ISR(){
+    core_util_atomic_store_u64(&button_press_tick_us, timebase_now_us());        // The mode switch latency is measured from the press itself
     mode_change_flag = true;                                                     // Set flag to change mode
 }
+
+// BUTTON PRESS ISR IN THE FREEFALL LOW-POWER STATE
+static void wake_up_ISR(){
+    wake_flags.set(WAKE_BUTTON_FLAG);
+}
 // INTERRUPTION SUBROUTINES END ===============================================================
 
 // ============================================================================================
@@ -123,6 +177,16 @@ static void button_press_ISR(){
 // ============================================================================================
 int main(){
     // SETUP ==================================================================================
+    // Warm boot: a valid snapshot left by the freefall shutdown path is restored (and used only once)
+    state_record_t state;
+    warm_boot = persist_load(PERSIST_SLOT_STATE, &state, sizeof(state)) && state.warm_boot_pending;
+    if(warm_boot){
+        persist_erase(PERSIST_SLOT_STATE);
+    }
+    sensors_set_warm_boot(warm_boot && state.sensors_configured);               // Sensors that kept their configuration are not initialized again
+    calib_init();                                                                // Analog curves entered on the console override the compile-time ones
+    blackbox_init();                                                             // Before the sensors' task, which fills it
+
     // ISR callbacks
     test_ticker.attach(&test_ticker_ISR, TEST_TICKER_FREQ);                      // Attach function to tick event for TEST_MODE as it is the initial
     button.fall(&button_press_ISR);                                              // Set flag on button press (falling edge)
@@ -131,167 +195,193 @@ int main(){
     startAllThreads();                                                           // Launch of all tasks
     myLED = 0b001;                                                               // Initial condition is to switch on LED1 for TEST_MODE
     myRGB = 0b111;                                                               // Ensure RGB LED is OFF
+
+    if(warm_boot){
+        restoreState(&state);
+    }
     // SETUP END ==============================================================================
 
     // LOOP ===================================================================================
-    while(true){
-        // If a USER BUTTON interruption takes place, mode change is toggled
-        if(mode_change_flag){
-            mode_change_flag = false;
-            next_mode();
+    executor_run(&main_task);                                                    // mainLoopStep() every MAIN_THREAD_FREQ, with the other tasks in the cooperative build. Never returns
+    // LOOP END ===============================================================================
+}
+// MAIN END ===================================================================================
+
+// ============================================================================================
+// MAIN LOOP STEP
+// ============================================================================================
+static std::chrono::milliseconds mainLoopStep(uint32_t woken){
+    // If a USER BUTTON interruption takes place, mode change is toggled
+    if(mode_change_flag){
+        mode_change_flag = false;
+        next_mode();
+    }
+
+    // The timebase follows every fix (latest value), the track simplifier only filters what is queued and logged
+    message_t_gps latest_fix;
+    if(read_latest_from_GPS(&latest_fix) && latest_fix.tick_us != timebase_fix_tick_us){
+        timebase_fix_tick_us = latest_fix.tick_us;
+        timebase_update_from_gps(&latest_fix);
+    }
+
+    // PULLING MESSAGES FROM MESSAGES QUEUES IF EXISTS
+    while(receive_info_from_GPS(&gps_msg)){                                      // Drain every kept track point so the join stage sees all of them
+        join_push_fix(&gps_msg);
+        uint16_t geofence_events[GEOFENCE_MAX_EVENTS];                           // Aligned copy, the message is packed
+        memcpy(geofence_events, gps_msg.geofence_events, sizeof(geofence_events));
+        geofence_log(geofence_events);                                           // Enter/exit events, in every mode
+
+        if(first_fix_pending && gps_msg.fix_status > 0 && gps_msg.fix_status <= 2){
+            first_fix_pending = false;
+            printf("GPS TTFF: %lu ms (%s)\n\r", (unsigned long)gps_get_ttff_ms(), gps_is_aided_start() ? "aided with the persisted fix" : "unaided start");
         }
+    }
 
-        // PULLING MESSAGES FROM MESSAGES QUEUES IF EXISTS
-        receive_info_from_sensors(&ax, &ay, &az, &moistPercAnalogValue, &lightPercAnalogValue, &clear, &red, &green, &blue, &temperature, &humidity);
-        receive_info_from_GPS(&fix_status,  &gps_hour, &gps_minute, &gps_seconds, &latitude, &longitude, &altitude);
+    // Every queued sample in acquisition order (the queue is FIFO): an alarm sample is acted on in this step, after the older ones
+    while(receivePrimarySample()){
+        uint16_t previous_alarms = alarms_active;
+        uint8_t previous_anomalies = anomalies_active;
+        unpack_sensors_message(&sensors_msg, &ax, &ay, &az, &moistPercAnalogValue, &lightPercAnalogValue, &clear, &red, &green, &blue, &temperature, &humidity);
+        if(sensors_msg.valid & MSG_VALID_COLOUR){
+            leaf_colour = colour_classify(clear, red, green, blue);             // Classified once per sample, for TEST_MODE and the stats
+        }
+        join_sensor_sample(&sensors_msg, &joined_record);                       // Time-aligned sensor + position record
+        rollup_add(&sensors_msg);                                                // Minute/hour/day history, in every mode
+        uplink_add(&sensors_msg);                                                // Batched for the radio, in every mode
 
-        // TEST_MODE --------------------------------------------------------------------------
-        if(current_mode == TEST_MODE){                                           // Check if we are in TEST MODE            
-            if(tap_detected){
-                tap_count++;
-                tap_detected = false;   
-            }
+        measureModeSwitchLatency();                                              // First fresh sample after a mode change closes the measurement
 
-            if(test_tick_event){                                                 // Check for ticker event
-                printf("--------------------------------\n\r");
-                printf("TEST MODE (Period: 2s)\n\r");
-                printSensorsInfo();                                              // Print sensor information
-                
-                tap_count = 0;                                                   // Reset the tap counter after printing measurements
-
-                // Determine and print the most dominant color, turn on its RGB counterpart
-                if(red > green && red > blue){
-                    printf("Dominant Color: Red\n\r");
-                    myRGB = 0b110;
-                }else if(green > red && green > blue){
-                    printf("Dominant Color: Green\n\r");
-                    myRGB = 0b101;
-                }else if(blue > red && blue > green){
-                    printf("Dominant Color: Blue\n\r");
-                    myRGB = 0b011;
-                }else{
-                    printf("Dominant Color: No clear dominant color\n\r");
-                    myRGB = 0b111;
-                }
-                
-                test_tick_event = false;                                         // Reset tick_event flag
-            }
+        if(first_sample_pending){
+            first_sample_pending = false;
+            printf("%s boot: first sample %lu ms after reset\n\r", warm_boot ? "Warm" : "Cold", (unsigned long)(sensors_msg.tick_us / 1000));
         }
-        // NORMAL_MODE ------------------------------------------------------------------------
-        else if(current_mode == NORMAL_MODE){            
-            if(tap_detected){
-                tap_count++;
-                tap_detected = false;   
-            }
 
-            if(normal_tick_event){       
-                printf("--------------------------------\n\r");
-                printf("NORMAL MODE (Period: 30s)\n\r");                         // Check for ticker event
-                printSensorsInfo();                                              // Print sensor information
-                
-                tap_count = 0;                                                   // Reset the tap counter after printing measurements
-
-                // Turn on RGB if a measurement is out of valid range
-                if(T_INVALID){
-                    myRGB = 0b110;                                               // Set the RGB to RED if T is out of valid range
-                }
-                if(RH_INVALID){
-                    myRGB = 0b011;                                               // Set the RGB to BLUE if %RH is out of valid range
-                }
-                if(!T_INVALID && !RH_INVALID){
-                    myRGB = 0b111;                                               // If none is true, RGB OFF
-                }
-
-                T_INVALID = false;                                               // Set INVALID flags to false
-                RH_INVALID = false;
-
-                // Update humidity stats if within valid range
-                if(humidity >= 25.0 && humidity <= 75.0) {
-                    humidity_sum += humidity;
-                    humidity_min = fmin(humidity_min, humidity);                 // Function that returns the smaller of two floating-point numbers
-                    humidity_max = fmax(humidity_max, humidity);                 // Function that returns the larger of two floating-point numbers.
-                    humidity_count++;
-                }
-
-                // Update temperature stats if within valid range
-                if(temperature >= -10.0 && temperature <= 50.0) {
-                    temperature_sum += temperature;
-                    temperature_min = fmin(temperature_min, temperature);
-                    temperature_max = fmax(temperature_max, temperature);
-                    temperature_count++;
-                }
-
-                // Always update soil moisture and ambient light stats
-                moist_sum += moistPercAnalogValue;
-                moist_min = fmin(moist_min, moistPercAnalogValue);
-                moist_max = fmax(moist_max, moistPercAnalogValue);
-                light_sum += lightPercAnalogValue;
-                light_min = fmin(light_min, lightPercAnalogValue);
-                light_max = fmax(light_max, lightPercAnalogValue);
-
-                // Update min and max acceleration for each axis
-                ax_min = fmin(ax_min, ax);
-                ax_max = fmax(ax_max, ax);
-                ay_min = fmin(ay_min, ay);
-                ay_max = fmax(ay_max, ay);
-                az_min = fmin(az_min, az);
-                az_max = fmax(az_max, az);
-
-                sample_count++;
-
-                // Determine and count the dominant color
-                if(red > green && red > blue){
-                    red_count++;
-                }else if(green > red && green > blue){
-                    green_count++;
-                }else if(blue > red && blue > green){
-                    blue_count++;
-                }
-
-                normal_tick_event = false;                                       // Reset tick_event flag
+        alarms_active = sensors_msg.alarms;
+        alarms_log(alarms_active, previous_alarms);                             // Rules were already evaluated by the sensors' thread, only act on them here
+        alarms_seen |= alarms_active;
+
+        anomalies_active = sensors_msg.anomalies;
+        anomaly_log(anomalies_active, previous_anomalies);
+        anomalies_seen |= anomalies_active;
+        if(anomalies_active){
+            myRGB = ANOMALY_LED_PATTERN;                                         // Shown as soon as the sample arrives, in every mode
+        }
+
+        bool new_anomaly = (anomalies_active & ~previous_anomalies) != 0;
+        if(current_mode == NORMAL_MODE && (alarms_is_priority(alarms_active, previous_alarms) || new_anomaly)){
+            normal_tick_event = true;                                            // Priority alarms and new anomalies are reported without waiting for the ticker
+        }
+    }
+
+    // Commands typed on the serial console (never blocks)
+    if(console_read_line(console_line, sizeof(console_line))){
+        handleConsoleCommand(console_line);
+    }
+    blackbox_service();                                                          // Frozen windows are announced here and dropped after BLACKBOX_HOLD_TIME
+    uplink_service();                                                            // Next payload on air once the duty cycle allows it
+
+    // TEST_MODE --------------------------------------------------------------------------
+    if(current_mode == TEST_MODE){                                               // Check if we are in TEST MODE            
+        if(tap_detected){
+            tap_count++;
+            tap_detected = false;   
+        }
+
+        if(test_tick_event){                                                     // Check for ticker event
+            printf("--------------------------------\n\r");
+            printf("TEST MODE (Period: 2s)\n\r");
+            printSensorsInfo();                                                  // Print sensor information
+            
+            tap_count = 0;                                                       // Reset the tap counter after printing measurements
+
+            // Print the leaf colour class, turn on its RGB counterpart
+            if(!(sensors_msg.valid & MSG_VALID_COLOUR)){
+                printf("Leaf colour: color sensor not responding\n\r");
+                myRGB = 0b111;
+            }else{
+                printf("Leaf colour: %s\n\r", colour_class_name(leaf_colour));
+                myRGB = colour_class_led(leaf_colour);
             }
 
-            if(stats_tick_event){
-                printStats();
-                stats_tick_event = false;
+            if(anomalies_active){
+                myRGB = ANOMALY_LED_PATTERN;                                     // An anomaly takes precedence over the color
             }
+            
+            test_tick_event = false;                                             // Reset tick_event flag
+        }
+    }
+    // NORMAL_MODE ------------------------------------------------------------------------
+    else if(current_mode == NORMAL_MODE){            
+        if(tap_detected){
+            tap_count++;
+            tap_detected = false;   
         }
 
-        // ADVANCED MODE ----------------------------------------------------------------------
-        else{
-            if(freefall_detected){
+        if(normal_tick_event){       
+            printf("--------------------------------\n\r");
+            printf("NORMAL MODE (Period: 30s)\n\r");                             // Check for ticker event
+            printSensorsInfo();                                                  // Print sensor information
+            
+            tap_count = 0;                                                       // Reset the tap counter after printing measurements
+
+            // Turn on RGB with the anomaly pattern or the pattern of the alarms raised since the last report (OFF if none)
+            myRGB = anomalies_seen ? ANOMALY_LED_PATTERN : alarms_led_pattern(alarms_seen);
+            alarms_seen = alarms_active;                                         // Keep still active alarms for the next report
+            anomalies_seen = anomalies_active;
+
+            // Update stats (T and %RH only within their valid range)
+            stats_update(sensors_msg.valid, humidity, temperature, moistPercAnalogValue, lightPercAnalogValue, ax, ay, az, leaf_colour);
+
+            normal_tick_event = false;                                           // Reset tick_event flag
+        }
+
+        if(stats_tick_event){
+            stats_print();
+            stats_tick_event = false;
+        }
+    }
+
+    // ADVANCED MODE ----------------------------------------------------------------------
+    else{
+        if(freefall_detected){
+            if(freefall_tick_us == 0){
                 printf("Freefall detected on Z-axis. SYSTEM SHUT DOWN!\n");
                 printf("================================\n\r");
-                
-                // System switch OFF conditions
                 button.fall(nullptr);                                            // Detaches the interrupt on the falling edge
-                sensors_th.terminate();                                          // Inmediately stop the sensors' thread
-                gps_th.terminate();
-                
-                // System switch OFF blinking indicator
-                while(true){
-                    myLED = myLED | 0b100;                                       // Set to 1 LED4 and 0 to the others
-                    ThisThread::sleep_for(FREEFALL_BLINK);
-
-                    myLED = myLED & ~0b100;                                      // Set the complement of the 3 bit, LED4, to 0 while leaving the others unchanged, still 0
-                    ThisThread::sleep_for(FREEFALL_BLINK);
-                }
+                freefall_tick_us = timebase_now_us();
             }
-        }
 
-        ThisThread::sleep_for(MAIN_THREAD_FREQ);                                 // Main thread frquency set to 100ms, not 2000ms, as other functions could be implemented in parallel and be compromised by such slow speed
+            // The sensors' task keeps draining the accelerometer until the samples after the fall are in the black box
+            uint64_t waited_us = timebase_now_us() - freefall_tick_us;
+            if(blackbox_frozen_event() != BLACKBOX_EVENT_FREEFALL && waited_us < (uint64_t)std::chrono::microseconds(BLACKBOX_SAVE_TIMEOUT).count()){
+                return MAIN_THREAD_FREQ;
+            }
+
+            // System switch OFF conditions
+            executor_stop(&sensors_task);                                        // Stop the sensors' thread
+            executor_stop(&gps_task);
+            printf("Black box %s\n\r", blackbox_save() ? "saved" : "NOT saved (window incomplete)");
+
+            shutdownAndWaitForWakeUp();                                          // Snapshot, low-power state and warm restart, never returns
+        }
     }
-    // LOOP END ===============================================================================
+
+    return MAIN_THREAD_FREQ;                                                     // Main thread frquency set to 100ms, not 2000ms, as other functions could be implemented in parallel and be compromised by such slow speed
 }
-// MAIN END ===================================================================================
+// MAIN LOOP STEP END =========================================================================
 
 // ============================================================================================
 // CUSTOM FUNCTIONS
 // ============================================================================================
 // FUNCTION TO START ALL THREADS --------------------------------------------------------------
 static void startAllThreads(){    
-    sensors_th.start(sensor_th_routine);
-    gps_th.start(gps_th_routine);    
+#if EXECUTOR_ENABLED
+    executor_start(&sensors_task, nullptr);                                      // Queued, they run once main reaches executor_run()
+    executor_start(&gps_task, nullptr);
+#else
+    executor_start(&sensors_task, &sensors_th);
+    executor_start(&gps_task, &gps_th);
+#endif
 }
 
 // FUNCTION TO SWITCH TO THE NEXT MODE --------------------------------------------------------
@@ -308,14 +398,16 @@ static void next_mode(){
 
     // Switch OFF RGB
     myRGB = 0b111;
+    alarms_seen = alarms_active;                                                 // Do not report alarms raised in the previous mode
+    anomalies_seen = anomalies_active;
 
     if(current_mode == TEST_MODE){
         current_mode = NORMAL_MODE;
         myLED = 0b010;                                                           // Turn on LED3 for NORMAL_MODE
 
         // Set threads sampling frequency to NORMAL_MODE (30 seconds)
-        TEST_MODE_SAMPLING_FLAG = false;
-        NORMAL_MODE_SAMPLING_FLAG = true;
+        core_util_atomic_store_bool(&TEST_MODE_SAMPLING_FLAG, false);
+        core_util_atomic_store_bool(&NORMAL_MODE_SAMPLING_FLAG, true);
 
         // Attach NORMAL_MODE tickers
         normal_ticker.attach(&normal_ticker_ISR, NORMAL_TICKER_FREQ);
@@ -325,7 +417,7 @@ static void next_mode(){
         current_mode = ADVANCED_MODE;
         myLED = 0b100;                                                           // Turn on LED4 for ADVANCED_MODE
 
-        resetStats();                                                            // Reset stats when exiting NORMAL_MODE to avoid stale data
+        stats_reset();                                                           // Reset stats when exiting NORMAL_MODE to avoid stale data
         printf("--------------------------------\n\r");
         printf("ADVANCED MODE (FREEFALL DETECTION)\n\r");
         printf("--------------------------------\n\r");
@@ -335,111 +427,236 @@ static void next_mode(){
         myLED = 0b001;                                                           // Turn on LED1 for TEST_MODE        
         
         // Set threads sampling frequency to TEST_MODE (2 seconds)
-        TEST_MODE_SAMPLING_FLAG = true;
-        NORMAL_MODE_SAMPLING_FLAG = false;
+        core_util_atomic_store_bool(&TEST_MODE_SAMPLING_FLAG, true);
+        core_util_atomic_store_bool(&NORMAL_MODE_SAMPLING_FLAG, false);
         
         // Attach ticker for TEST_MODE
         test_ticker.attach(&test_ticker_ISR, TEST_TICKER_FREQ);
     }
+
+    // Wake both tasks up so the new cadence applies now instead of after the current sleep
+    mode_switch_tick_us = core_util_atomic_load_u64(&button_press_tick_us);
+    executor_wake(&sensors_task, SENSORS_FLAG_MODE_CHANGE);
+    executor_wake(&gps_task, GPS_FLAG_READ_NOW);
+}
+
+// FUNCTION TO MEASURE THE MODE SWITCH LATENCY ------------------------------------------------
+static void measureModeSwitchLatency(){
+    if(mode_switch_tick_us == 0 || sensors_msg.tick_us < mode_switch_tick_us){
+        return;                                                                  // No pending measurement or sample taken before the switch
+    }
+
+    uint32_t latency_us = (uint32_t)(timebase_now_us() - mode_switch_tick_us);
+    mode_switch_tick_us = 0;
+    if(latency_us > mode_switch_latency_max_us){
+        mode_switch_latency_max_us = latency_us;
+    }
+
+    printf("Mode switch latency: %lu us (max %lu us)%s\n\r", (unsigned long)latency_us, (unsigned long)mode_switch_latency_max_us,
+           (latency_us > MODE_SWITCH_BUDGET_US) ? " - OVER BUDGET!" : "");
+}
+
+// FUNCTION TO RECEIVE THE NEXT BOARD PROBE SAMPLE, KEEPING THE OTHER BEDS --------------------
+static bool receivePrimarySample(){
+    message_t_sensors msg;
+    while(receive_info_from_sensors(&msg)){
+        if(msg.probe_id == 0){
+            sensors_msg = msg;
+            return true;
+        }
+        if(msg.probe_id < SCAN_PROBE_IDS){
+            probe_msgs[msg.probe_id] = msg;                                      // Only displayed, alarms and anomalies watch probe 0
+        }
+    }
+    return false;
 }
 
 // FUNCTION TO PRINT SENSORS MEASUREMENTS -----------------------------------------------------
 static void printSensorsInfo(){
     printf("--------------------------------\n\r");
     // TCS34725 measurements
-    printf("C = %u, R = %u, G = %u, B = %u\n\r", clear, red, green, blue);
+    if(sensors_msg.valid & MSG_VALID_COLOUR){
+        printf("C = %u, R = %u, G = %u, B = %u\n\r", clear, red, green, blue);
+    }else{
+        printf("Color sensor not responding!\n\r");
+    }
 
     // MMA8451Q measurements
-    printf("ax = %.2f m/s2, ay = %.2f m/s2, az = %.2f m/s2\n\r", ax * G_TO_MS2, ay * G_TO_MS2, az * G_TO_MS2);
+    if(sensors_msg.valid & MSG_VALID_ACCEL){
+        printf("ax = %.2f m/s2, ay = %.2f m/s2, az = %.2f m/s2\n\r", ax * G_TO_MS2, ay * G_TO_MS2, az * G_TO_MS2);
+    }else{
+        printf("Accelerometer not responding!\n\r");
+    }
     
     // Si7021 measurements
-    if(temperature > -10 && temperature < 50){
+    if(!(sensors_msg.valid & MSG_VALID_TEMPERATURE)){
+        printf("Temperature sensor not responding! ");
+    }else if(!alarms_channel_active(alarms_active, ALARM_CH_TEMPERATURE)){
         printf("T = %.1f celsius, ", temperature);
     }else{
         printf("Temperature out of valid range! ");
-        T_INVALID = true;
     }
-    if(humidity > 25 && humidity < 75){
+    if(!(sensors_msg.valid & MSG_VALID_HUMIDITY)){
+        printf("Relative humidity sensor not responding!\n\r");
+    }else if(!alarms_channel_active(alarms_active, ALARM_CH_HUMIDITY)){
         printf("RH = %.1f %%\n\r", humidity);
     }else{
         printf("Relative humidity out of valid range!\n\r");
-        RH_INVALID = true;
+    }
+
+    // Beds on the I2C multiplexer, probe 0 is the one above
+    for(uint8_t id = 1; id < SCAN_PROBE_IDS; id++){
+        const message_t_sensors *m = &probe_msgs[id];
+        printf("Probe %d: ", id);
+        if(m->valid & MSG_VALID_TEMPERATURE){
+            printf("T = %.1f celsius, ", centi_to_float(m->temperature));
+        }else{
+            printf("T not responding, ");
+        }
+        if(m->valid & MSG_VALID_HUMIDITY){
+            printf("RH = %.1f %%, ", centi_to_float(m->humidity));
+        }else{
+            printf("RH not responding, ");
+        }
+        if(m->valid & MSG_VALID_COLOUR){
+            printf("C = %u, R = %u, G = %u, B = %u (%s)\n\r", m->clear, m->red, m->green, m->blue, colour_class_name(colour_classify(m->clear, m->red, m->green, m->blue)));
+        }else{
+            printf("color not responding\n\r");
+        }
     }
 
     // Analogic sensors measurements
     printf("Soil moisture = %.1f %%\n\r", moistPercAnalogValue);
     printf("Ambient light = %.1f %%\n\r", lightPercAnalogValue);
 
-    // GPS measurements
-    if(fix_status > 0 && fix_status <= 2){                                       // Print values only if there is a valid fix. ONLY 1 AND 2 ARE VALID
-        printf("Fix Status = %d, Time (UTC + 1): %02d:%02d:%.1f, Alt = %.2f m, Lat = %.6f deg, Lon = %.6f deg\n\r", fix_status, gps_hour, gps_minute, gps_seconds, altitude, latitude, longitude);
+    // GPS measurements (newest fix, even if it is still waiting in the queue)
+    message_t_gps fix;
+    if(read_latest_from_GPS(&fix) && fix.fix_status > 0 && fix.fix_status <= 2){  // Print values only if there is a valid fix. ONLY 1 AND 2 ARE VALID
+        uint8_t local_hour, local_minute;
+        uint16_t local_millis;
+        timebase_split_local((fix.gps_hour * 60 + fix.gps_minute) * 60000UL + fix.gps_millis, &local_hour, &local_minute, &local_millis);
+        printf("Fix Status = %d, Time (UTC + %d): %02d:%02d:%.1f, Alt = %.2f m, Lat = %.6f deg, Lon = %.6f deg\n\r", fix.fix_status, LOCAL_TIME_OFFSET_MINUTES / 60, local_hour, local_minute, local_millis / 1000.0f,
+               decimetres_to_metres(fix.altitude), microdeg_to_degrees(fix.latitude), microdeg_to_degrees(fix.longitude));
     }else{
         printf("No GPS fix yet, please wait for signal...\n\r");
     }
 
     // Taps counted
     printf("Total Taps: %d\n\r", tap_count);
-}
 
-// FUNCTION TO RESET STATS VARIABLES ----------------------------------------------------------
-static void resetStats(){
-    // Reset stats for next period - Si7021
-    humidity_min = 100.0; humidity_max = 0.0; humidity_sum = 0.0;
-    temperature_min = 100.0; temperature_max = -100.0; temperature_sum = 0.0;
-    
-    // Reset stats for next period - Analogic sensors
-    moist_min = 100.0; moist_max = 0.0; moist_sum = 0.0;
-    light_min = 100.0; light_max = 0.0; light_sum = 0.0;
-    
-    // Reset stats for next period - MMA8451Q
-    ax_min = 100.0; ax_max = -100.0;                                             // Reset acceleration min/max values
-    ay_min = 100.0; ay_max = -100.0;
-    az_min = 100.0; az_max = -100.0;
-    
-    // Reset counters for next period
-    sample_count = 0;
-    humidity_count = 0; temperature_count = 0;                                   // Reset Si7021 counters
-    red_count = 0; green_count = 0; blue_count = 0;                              // Reset color counters
+    printJoinedRecord();
 }
 
-// FUNCTION TO CALCULATE STATS FOR Si7021 AND ANALOGIC SENSORS --------------------------------
-static void printStats(){
-    printf("--------------------------------\n\r");
-    printf("ONE HOUR STATS:\n\r");
-    printf("--------------------------------\n\r");
-    // Only print Si7021 relative humidity stats if we have valid samples
-    if(humidity_count > 0){
-        printf("RHmin = %.1f %%, RHmax = %.1f %%, RHavg = %.1f %%\n\r", humidity_min, humidity_max, humidity_sum / humidity_count);
+// FUNCTION TO PRINT THE TIME-ALIGNED RECORD OF THE LAST SAMPLE -------------------------------
+static void printJoinedRecord(){
+    const record_t_joined *rec = &joined_record;
+
+    if(rec->flags & RECORD_UTC_VALID){
+        uint8_t local_hour, local_minute;
+        uint16_t local_millis;
+        timebase_split_local(rec->utc_ms, &local_hour, &local_minute, &local_millis);
+        printf("Sample time (UTC + %d): %02d:%02d:%02d.%03d, nearest fix %ld ms away\n\r", LOCAL_TIME_OFFSET_MINUTES / 60, local_hour, local_minute, local_millis / 1000, local_millis % 1000, (long)rec->skew_ms);
     }else{
-        printf("No valid data for relative humidity\n\r");
+        printf("Sample time: no GPS time yet (tick = %llu us)\n\r", (unsigned long long)rec->sensors.tick_us);
     }
 
-    // Only print Si7021 temperature stats if we have valid samples
-    if(temperature_count > 0){
-        printf("Tmin = %.1f celsius, Tmax = %.1f celsius, Tavg = %.1f celsius\n\r", temperature_min, temperature_max, temperature_sum / temperature_count);
+    // Export line: REC,tick_us,utc_ms,skew_ms,T(cC),RH(c%),SM(c%),AL(c%),lat(udeg),lon(udeg),alt(dm) - empty fields when not valid
+    printf("REC,%llu,", (unsigned long long)rec->sensors.tick_us);
+    if(rec->flags & RECORD_UTC_VALID){
+        printf("%lu,%ld,", (unsigned long)rec->utc_ms, (long)rec->skew_ms);
     }else{
-        printf("No valid data for temperature\n\r");
+        printf(",,");
     }
-
-    printf("SMmin = %.1f %%, SMmax = %.1f %%, SMavg = %.1f %%\n\r", moist_min, moist_max, moist_sum / sample_count);
-    printf("ALmin = %.1f %%, ALmax = %.1f %%, ALavg = %.1f %%\n\r", light_min, light_max, light_sum / sample_count);
-
-    // Print min and max acceleration for each axis
-    printf("axmin = %.2f m/s2, axmax = %.2f m/s2\n\r", ax_min * G_TO_MS2, ax_max * G_TO_MS2);
-    printf("aymin = %.2f m/s2, aymax = %.2f m/s2\n\r", ay_min * G_TO_MS2, ay_max * G_TO_MS2);
-    printf("azmin = %.2f m/s2, azmax = %.2f m/s2\n\r", az_min * G_TO_MS2, az_max * G_TO_MS2);
-
-    // Determine and print the most dominant color
-    if(red_count > green_count && red_count > blue_count){
-        printf("Dominant Color: Red\n\r");
-    }else if(green_count > red_count && green_count > blue_count){
-        printf("Dominant Color: Green\n\r");
-    }else if(blue_count > red_count && blue_count > green_count){
-        printf("Dominant Color: Blue\n\r");
+    if(rec->sensors.valid & MSG_VALID_TEMPERATURE){
+        printf("%d", rec->sensors.temperature);
+    }
+    printf(",");
+    if(rec->sensors.valid & MSG_VALID_HUMIDITY){
+        printf("%d", rec->sensors.humidity);
+    }
+    printf(",%u,%u,", rec->sensors.moistPercAnalogValue, rec->sensors.lightPercAnalogValue);
+    if(rec->flags & RECORD_POSITION_VALID){
+        printf("%ld,%ld,%d\n\r", (long)rec->fix.latitude, (long)rec->fix.longitude, rec->fix.altitude);
     }else{
-        printf("Dominant Color: No clear dominant color\n\r");
+        printf(",,\n\r");
     }
+}
+
+// FUNCTION TO RUN A SERIAL CONSOLE COMMAND --------------------------------------------------
+static void handleConsoleCommand(const char *line){
+    switch(toupper(line[0])){
+        case ROLLUP_QUERY_COMMAND:
+            rollup_query_command(line + 1);                                      // History of a channel over a range of minutes
+            break;
+        case CALIB_COMMAND:
+            calib_command(line + 1);                                             // Print or replace an analog calibration curve
+            break;
+        case BLACKBOX_COMMAND:
+            blackbox_command(line + 1);                                          // Dump the accelerometer window of the last tap or freefall
+            break;
+        case SENSORS_SAMPLE_COMMAND:
+            executor_wake(&sensors_task, SENSORS_FLAG_SAMPLE_NOW);               // One sample now, the cadence restarts from it
+            printf("Sampling now\n\r");
+            break;
+        default:
+            printf("Unknown command \"%s\". Commands: %c <T|H|M|L> <from minutes ago> <to minutes ago>, %c <M|L> [raw:value ...], %c, %c\n\r", line, ROLLUP_QUERY_COMMAND, CALIB_COMMAND, BLACKBOX_COMMAND, SENSORS_SAMPLE_COMMAND);
+            break;
+    }
+}
+
+// FUNCTION TO RESTORE THE STATE SAVED AT THE FREEFALL SHUTDOWN ------------------------------
+static void restoreState(const state_record_t *state){
+    while(current_mode != (Mode)state->mode && state->mode <= ADVANCED_MODE){
+        next_mode();                                                             // Walk the mode sequence so tickers, LEDs and sampling flags are set as usual
+    }
+    mode_switch_tick_us = 0;                                                     // Not a user mode change, nothing to measure
+
+    stats_restore(&state->stats);                                                // After next_mode(), which resets the stats when entering ADVANCED_MODE
+    tap_count = state->tap_count;
+
+    printf("WARM BOOT: state restored (%d taps pending", tap_count);
+    if(state->last_fix.fix_status > 0 && state->last_fix.fix_status <= 2){
+        printf(", last fix Lat = %.6f deg, Lon = %.6f deg", microdeg_to_degrees(state->last_fix.latitude), microdeg_to_degrees(state->last_fix.longitude));
+    }
+    printf(")\n\r");
+}
+
+// FUNCTION TO SNAPSHOT THE STATE, ENTER LOW POWER AND WARM RESTART ON THE USER BUTTON --------
+static void shutdownAndWaitForWakeUp(){
+    state_record_t state;
+    memset(&state, 0, sizeof(state));
+    state.mode = current_mode;
+    state.tap_count = tap_count;
+    state.sensors_configured = sensors_are_configured();
+    state.warm_boot_pending = 1;
+    stats_snapshot(&state.stats);
+    read_latest_from_GPS(&state.last_fix);                                       // Newest fix, whether the main loop consumed it or not
+
+    bool saved = persist_save(PERSIST_SLOT_STATE, &state, sizeof(state));
+    printf("State %s. Press USER BUTTON to restart\n\r", saved ? "saved" : "NOT saved");
+
+    // Nothing periodic may keep the MCU awake
+    test_ticker.detach();
+    normal_ticker.detach();
+    stats_ticker.detach();
+    gps_standby();
+    console_disable_input();                                                     // A serial with RX enabled holds the deep sleep lock
+
+    // System switch OFF blinking indicator, then every LED OFF
+    for(int i = 0; i < SHUTDOWN_BLINKS; i++){
+        myLED = myLED | 0b100;                                                   // Set to 1 LED4 and 0 to the others
+        ThisThread::sleep_for(FREEFALL_BLINK);
+
+        myLED = myLED & ~0b100;                                                  // Set the complement of the 3 bit, LED4, to 0 while leaving the others unchanged, still 0
+        ThisThread::sleep_for(FREEFALL_BLINK);
+    }
+    myLED = 0;
+    myRGB = 0b111;
+
+    // Every thread is now blocked and both UARTs have RX disabled, so the idle thread can enter deep sleep until the button EXTI fires
+    button.fall(&wake_up_ISR);
+    wake_flags.wait_any(WAKE_BUTTON_FLAG);
 
-    resetStats();
+    NVIC_SystemReset();                                                          // Warm boot from the saved state
 }
 // CUSTOM FUNCTIONS END =======================================================================
\ No newline at end of file
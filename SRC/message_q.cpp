@@ -3,6 +3,8 @@
 // LIBRARIES -----------------------------------------------------------------------------------------------------
 #include "mbed.h"
 #include "message_q.h"
+#include "latest_value.h"
+#include "float_only.h"
 
 // STATIC DEFINITIONS --------------------------------------------------------------------------------------------
 static MemoryPool<message_t_sensors, MESSAGE_QUEUE_MAX_LENGTH> mpool_sensors;
@@ -11,58 +13,134 @@ static MemoryPool<message_t_gps, MESSAGE_QUEUE_MAX_LENGTH> mpool_gps;
 static Queue<message_t_sensors, MESSAGE_QUEUE_MAX_LENGTH> queue_sensors;
 static Queue<message_t_gps, MESSAGE_QUEUE_MAX_LENGTH> queue_gps;
 
+//latest value of each stream, written next to the queue so "current value" readers never touch the pools
+static LatestValue<message_t_sensors> latest_sensors;
+static LatestValue<message_t_gps> latest_gps;
+
+//messages dropped because the consumer fell behind (one writer per counter)
+static volatile uint32_t dropped_sensors = 0;
+static volatile uint32_t dropped_gps = 0;
+
 // GLOBAL FUNCTIONS ----------------------------------------------------------------------------------------------
-void send_sensors_message_through_main_thread(float ax,float ay,float az,float moistPercAnalogValue, float lightPercAnalogValue, uint16_t c, uint16_t r, uint16_t g, uint16_t b, float temperature, float humidity){
+void pack_sensors_message(message_t_sensors * message, uint64_t tick_us, uint8_t valid, float ax,float ay,float az,float moistPercAnalogValue, float lightPercAnalogValue, uint16_t c, uint16_t r, uint16_t g, uint16_t b, float temperature, float humidity){
+    //converting the float measurements to the fixed-point message layout
+
+    //filling sensor message structure
+    message->tick_us = tick_us;
+
+    message->ax = accel_g_to_counts(ax);
+    message->ay = accel_g_to_counts(ay);
+    message->az = accel_g_to_counts(az);
+
+    message->moistPercAnalogValue = percent_to_centi(moistPercAnalogValue);
+
+    message->lightPercAnalogValue = percent_to_centi(lightPercAnalogValue);
+
+    message->clear = c;
+    message->red = r;
+    message->green = g;
+    message->blue = b;
+
+    message->temperature = float_to_centi(temperature);
+    message->humidity = float_to_centi(humidity);
+
+    message->alarms = 0;
+    message->valid = valid;
+    message->anomalies = 0;
+    message->probe_id = 0;
+}
+
+void unpack_sensors_message(const message_t_sensors * message, float * ax,float * ay,float * az,float * moistPercAnalogValue, float * lightPercAnalogValue, uint16_t * c, uint16_t * r, uint16_t * g, uint16_t * b, float * temperature, float * humidity){
+    //converting the fixed-point message layout back to float measurements
+
+    //extracting each field of the sturcture
+    *ax = accel_counts_to_g(message->ax);
+    *ay = accel_counts_to_g(message->ay);
+    *az = accel_counts_to_g(message->az);
+
+    *moistPercAnalogValue = centi_to_float(message->moistPercAnalogValue);
+
+    *lightPercAnalogValue = centi_to_float(message->lightPercAnalogValue);
+
+    *c = message->clear;
+    *r = message->red;
+    *g = message->green;
+    *b = message->blue;
+
+    *temperature = centi_to_float(message->temperature);
+    *humidity = centi_to_float(message->humidity);
+}
+
+void send_sensors_message_through_main_thread(const message_t_sensors * message){
     //this functions use a message inside the message pool to send a message to another task
     //in our app the comuser thread will be the main thread (thread in charge of printing info through the terminal).
 
+    //the latest value (board probe only) is always updated, even if the queue is full
+    if(message->probe_id == 0){
+        latest_sensors.write(*message);
+    }
+
     //booking dinamic space for the new message
     message_t_sensors *new_message = mpool_sensors.alloc();
+    if(new_message == nullptr){
+        //pool exhausted: the consumer still sees this sample through the latest value
+        dropped_sensors = dropped_sensors + 1;
+        return;
+    }
 
-    //filling sensor message structure
-    new_message->ax = ax;
-    new_message->ay = ay;
-    new_message->az = az;
+    //copying the already packed sample
+    *new_message = *message;
+
+    //sending message to the queue in acquisition order: consumers rely on tick_us never going backwards, and the main
+    //loop drains the whole queue every step, so alarm samples need no queue priority to be handled right away
+    if(queue_sensors.put(new_message) != osOK){
+        mpool_sensors.free(new_message);
+        dropped_sensors = dropped_sensors + 1;
+    }
+}
 
-    new_message->moistPercAnalogValue = moistPercAnalogValue;
+void pack_GPS_message(message_t_gps * message, uint64_t tick_us, uint8_t fix_status,  uint8_t gps_hour, uint8_t gps_minute, uint16_t gps_millis, int32_t latitude, int32_t longitude,  float altitude, const uint16_t *geofence_events){
+    //filling GPS message structure
+    message->tick_us = tick_us;
 
-    new_message->lightPercAnalogValue = lightPercAnalogValue;
+    message->fix_status = fix_status;
 
-    new_message->clear = c;
-    new_message->red = r;
-    new_message->green = g;
-    new_message->blue = b;
+    message->gps_hour = gps_hour;
+    message->gps_minute = gps_minute;
+    message->gps_millis = gps_millis;
 
-    new_message->temperature = temperature;
-    new_message->humidity = humidity;    
+    message->latitude = latitude;
+    message->longitude = longitude;
+    message->altitude = metres_to_decimetres(altitude);
 
-    //sending message to the queue
-    queue_sensors.put(new_message);
+    memcpy(message->geofence_events, geofence_events, sizeof(message->geofence_events));
 }
 
-void send_GPS_message_through_main_thread(uint8_t fix_status,  uint8_t gps_hour, uint8_t gps_minute, float gps_seconds, float latitude, float longitude,  float altitude){
+void update_latest_GPS(const message_t_gps * message){
+    //every fix goes to the latest value, only the kept points of the track go through the queue
+    latest_gps.write(*message);
+}
+
+void send_GPS_message_through_main_thread(const message_t_gps * message){
     //this functions use a message inside the message pool to send a message to another task
     //in our app the comuser thread will be the main thread (thread in charge of printing info through the terminal).
 
     //booking dinamic space for the new message
     message_t_gps *new_message = mpool_gps.alloc();
-
-    //filling sensor message structure
-    new_message->fix_status = fix_status;
-
-    new_message->gps_hour = gps_hour;
-    new_message->gps_minute = gps_minute;
-    new_message->gps_seconds = gps_seconds;
-
-    new_message->latitude = latitude;
-    new_message->longitude = longitude;
-    new_message->altitude = altitude;    
+    if(new_message == nullptr){
+        dropped_gps = dropped_gps + 1;
+        return;
+    }
+    *new_message = *message;
 
     //sending message to the queue
-    queue_gps.put(new_message);
+    if(queue_gps.put(new_message) != osOK){
+        mpool_gps.free(new_message);
+        dropped_gps = dropped_gps + 1;
+    }
 }
 
-void receive_info_from_sensors(float * ax,float * ay,float * az,float * moistPercAnalogValue, float * lightPercAnalogValue, uint16_t * c, uint16_t * r, uint16_t * g, uint16_t * b, float * temperature, float * humidity){
+bool receive_info_from_sensors(message_t_sensors * message){
     //feching older message in the queue
     osEvent evt = queue_sensors.get(0);
 
@@ -71,30 +149,18 @@ void receive_info_from_sensors(float * ax,float * ay,float * az,float * moistPer
         //extracting the data from the message
         message_t_sensors *message_received = (message_t_sensors*)evt.value.p;
 
-        //extracting each field of the sturcture
-        *ax = message_received->ax;
-        *ay = message_received->ay;
-        *az = message_received->az; 
-
-        *moistPercAnalogValue = message_received->moistPercAnalogValue;
-
-        *lightPercAnalogValue = message_received->lightPercAnalogValue;
-
-        *c = message_received->clear;
-        *r = message_received->red;
-        *g = message_received->green;
-        *b= message_received->blue;
-
-        *temperature = message_received->temperature;
-        *humidity = message_received->humidity;
-        
+        //copying the whole packed structure, it is unpacked by the consumer only where floats are needed
+        *message = *message_received;
 
         //releasing allocated memory from the message pool
         mpool_sensors.free(message_received);
-    }  
+        return true;
+    }
+
+    return false;
 }
 
-void receive_info_from_GPS(uint8_t * fix_status,  uint8_t * gps_hour, uint8_t * gps_minute, float * gps_seconds, float * latitude, float * longitude,  float * altitude){
+bool receive_info_from_GPS(message_t_gps * message){
     //feching older message in the queue
     osEvent evt = queue_gps.get(0);
 
@@ -104,18 +170,31 @@ void receive_info_from_GPS(uint8_t * fix_status,  uint8_t * gps_hour, uint8_t *
         //extracting the data from the message
         message_t_gps *message_received = (message_t_gps*)evt.value.p;
 
-        //extracting each field of the sturcture
-        *fix_status = message_received->fix_status;
-
-        *gps_hour = message_received->gps_hour;
-        *gps_minute = message_received->gps_minute; 
-        *gps_seconds = message_received->gps_seconds;
-
-        *latitude = message_received->latitude;
-        *longitude = message_received->longitude;
-        *altitude = message_received->altitude;
+        //copying the whole packed structure
+        *message = *message_received;
 
         //releasing allocated memory from the message pool
         mpool_gps.free(message_received);
+        return true;
     }
-}
\ No newline at end of file
+
+    return false;
+}
+
+bool read_latest_from_sensors(message_t_sensors * message){
+    //newest sample in constant time, without consuming anything from the queue
+    return latest_sensors.read(message);
+}
+
+bool read_latest_from_GPS(message_t_gps * message){
+    //newest fix in constant time, without consuming anything from the queue
+    return latest_gps.read(message);
+}
+
+uint32_t sensors_messages_dropped(){
+    return core_util_atomic_load_u32(&dropped_sensors);
+}
+
+uint32_t GPS_messages_dropped(){
+    return core_util_atomic_load_u32(&dropped_gps);
+}
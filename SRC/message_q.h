@@ -2,6 +2,7 @@
 
 // LIBRARIES ------------------------------------------------------------------------------------
 #include "mbed.h"
+#include "geofence.h"
 
 // LIBRARY GUARD --------------------------------------------------------------------------------
 #ifndef MESSAGE_Q_H
@@ -10,32 +11,120 @@
 // MACROS ---------------------------------------------------------------------------------------
 #define MESSAGE_QUEUE_MAX_LENGTH 16
 
+// Fixed-point scales of the packed messages
+#define MSG_ACCEL_COUNTS_PER_G  4096                             // MMA8451Q raw 14-bit counts per g (±2g range)
+#define MSG_CENTI_SCALE         100                              // T, %RH and analog percentages stored in hundredths
+#define MSG_MILLI_SCALE         1000                             // GPS seconds stored in milliseconds
+#define MSG_MICRODEG_SCALE      1000000                          // Latitude and longitude stored in micro-degrees
+#define MSG_ALTITUDE_SCALE      10                               // Altitude stored in decimetres (saturates at ±3276.7 m)
+
+// Validity bits of a sensors' sample, a cleared bit means the read failed and the fields hold stale values
+#define MSG_VALID_ACCEL         0x01                             // ax, ay, az
+#define MSG_VALID_TEMPERATURE   0x02
+#define MSG_VALID_HUMIDITY      0x04
+#define MSG_VALID_COLOUR        0x08                             // clear, red, green, blue
+#define MSG_VALID_MOISTURE      0x10
+#define MSG_VALID_LIGHT         0x20
+#define MSG_VALID_ALL           0x3F
+
 // ==============================================================================================
 // MESSAGE STRUCTS definition (format of messages between task)
 // ==============================================================================================
-typedef struct {
-    float ax, ay, az;                                            // Variables to store the accelerations
-    float moistPercAnalogValue;                                  // Variable to store the normalized analog value of the sensor (0 - 1)
-    float lightPercAnalogValue;                                  // Light percentage
+typedef MBED_PACKED(struct) {
+    uint64_t tick_us;                                            // Monotonic microsecond tick at acquisition
+    int16_t ax, ay, az;                                          // Raw 14-bit acceleration counts (MSG_ACCEL_COUNTS_PER_G per g)
+    uint16_t moistPercAnalogValue;                               // Soil volumetric water content in hundredths of percent (0 - 10000, calibrated)
+    uint16_t lightPercAnalogValue;                               // Light in hundredths of percent of 100 klx (0 - 10000, calibrated, 1 unit = 10 lux)
     uint16_t clear, red, green, blue;                            // Raw measures of color channels
-    float temperature, humidity;                                 // Temperature in celsius and %RH
+    int16_t temperature, humidity;                               // Temperature in centi-celsius and centi-%RH (Si7021 can report below 0 %RH)
+    uint16_t alarms;                                             // Active alarm rules when the sample was taken (bit i = row i of the rule table)
+    uint8_t valid;                                               // MSG_VALID_* bits of the channels read successfully
+    uint8_t anomalies;                                           // Channels flagged by the streaming detector (bit c = alarm_channel_t c)
+    uint8_t probe_id;                                            // Bed the I2C channels come from (0 = board probe, the only one with accelerometer, analog channels, alarms and anomalies)
 } message_t_sensors;
 
-typedef struct{
-    int fix_status;                                              // Fix status
-    int gps_hour, gps_minute;                                    // Time
-    float gps_seconds;                                           // Seconds
-    float latitude , longitude, altitude;                        // Position
-}message_t_gps;
+typedef MBED_PACKED(struct) {
+    uint64_t tick_us;                                            // Monotonic microsecond tick when the sentence started arriving
+    int32_t latitude, longitude;                                 // Position in micro-degrees
+    int16_t altitude;                                            // Altitude in decimetres
+    uint16_t gps_millis;                                         // Seconds of the minute in milliseconds (0 - 59999), UTC
+    uint8_t fix_status;                                          // Fix status
+    uint8_t gps_hour, gps_minute;                                // Time, UTC
+    uint16_t geofence_events[GEOFENCE_MAX_EVENTS];               // Fences entered or left with this fix (see geofence.h), GEOFENCE_NO_EVENT padded
+} message_t_gps;
+
+// Compile-time size checks, both structs are reserved MESSAGE_QUEUE_MAX_LENGTH times in the pools
+MBED_STATIC_ASSERT(sizeof(message_t_sensors) == 35, "message_t_sensors layout changed, review the pool size");
+MBED_STATIC_ASSERT(sizeof(message_t_gps) == 27, "message_t_gps layout changed, review the pool size");
 // MESSAGE STRUCTS ==============================================================================
 
+// ==============================================================================================
+// CONVERSION HELPERS (float <-> fixed-point, rounding to nearest and saturating)
+// ==============================================================================================
+static inline int32_t float_to_fixed(float value, float scale, int32_t min, int32_t max){
+    float scaled = value * scale;
+    scaled += (scaled >= 0.0f) ? 0.5f : -0.5f;                   // Round half away from zero before truncating
+    if(scaled <= (float)min){
+        return min;
+    }
+    if(scaled >= (float)max){
+        return max;
+    }
+    return (int32_t)scaled;
+}
+
+static inline int16_t accel_g_to_counts(float g){
+    return (int16_t)float_to_fixed(g, MSG_ACCEL_COUNTS_PER_G, -8192, 8191);     // 14-bit signed range
+}
+
+static inline float accel_counts_to_g(int16_t counts){
+    return (float)counts / MSG_ACCEL_COUNTS_PER_G;
+}
+
+static inline int16_t float_to_centi(float value){
+    return (int16_t)float_to_fixed(value, MSG_CENTI_SCALE, INT16_MIN, INT16_MAX);
+}
+
+static inline uint16_t percent_to_centi(float percent){
+    return (uint16_t)float_to_fixed(percent, MSG_CENTI_SCALE, 0, 100 * MSG_CENTI_SCALE);
+}
+
+static inline float centi_to_float(int32_t centi){
+    return (float)centi / MSG_CENTI_SCALE;
+}
+
+static inline int32_t degrees_to_microdeg(float degrees){
+    return float_to_fixed(degrees, MSG_MICRODEG_SCALE, -180 * MSG_MICRODEG_SCALE, 180 * MSG_MICRODEG_SCALE);
+}
+
+static inline float microdeg_to_degrees(int32_t microdeg){
+    return (float)microdeg / MSG_MICRODEG_SCALE;
+}
+
+static inline int16_t metres_to_decimetres(float metres){
+    return (int16_t)float_to_fixed(metres, MSG_ALTITUDE_SCALE, INT16_MIN, INT16_MAX);
+}
+
+static inline float decimetres_to_metres(int16_t decimetres){
+    return (float)decimetres / MSG_ALTITUDE_SCALE;
+}
+// CONVERSION HELPERS END =======================================================================
+
 // ==============================================================================================
 // PROTOTYPES
 // ==============================================================================================
-extern void send_sensors_message_through_main_thread(float ax,float ay,float az,float moistPercAnalogValue, float lightPercAnalogValue, uint16_t c, uint16_t r, uint16_t g, uint16_t b, float temperature, float humidity);
-extern void receive_info_from_sensors(float * ax,float * ay,float * az,float * moistPercAnalogValue, float * lightPercAnalogValue, uint16_t * c, uint16_t * r, uint16_t * g, uint16_t * b, float * temperature, float * humidity);
-extern void send_GPS_message_through_main_thread(uint8_t fix_status,  uint8_t gps_hour, uint8_t gps_minute, float gps_seconds, float latitude, float longitude,  float altitude);
-extern void receive_info_from_GPS(uint8_t * fix_status,  uint8_t * gps_hour, uint8_t * gps_minute, float * gps_seconds, float * latitude, float * longitude,  float * altitude);
+extern void pack_sensors_message(message_t_sensors * message, uint64_t tick_us, uint8_t valid, float ax,float ay,float az,float moistPercAnalogValue, float lightPercAnalogValue, uint16_t c, uint16_t r, uint16_t g, uint16_t b, float temperature, float humidity);
+extern void unpack_sensors_message(const message_t_sensors * message, float * ax,float * ay,float * az,float * moistPercAnalogValue, float * lightPercAnalogValue, uint16_t * c, uint16_t * r, uint16_t * g, uint16_t * b, float * temperature, float * humidity);
+extern void send_sensors_message_through_main_thread(const message_t_sensors * message);
+extern bool receive_info_from_sensors(message_t_sensors * message);
+extern void pack_GPS_message(message_t_gps * message, uint64_t tick_us, uint8_t fix_status,  uint8_t gps_hour, uint8_t gps_minute, uint16_t gps_millis, int32_t latitude, int32_t longitude,  float altitude, const uint16_t *geofence_events);
+extern void send_GPS_message_through_main_thread(const message_t_gps * message);
+extern bool receive_info_from_GPS(message_t_gps * message);
+extern bool read_latest_from_sensors(message_t_sensors * message);       // Newest probe 0 sample (consistent snapshot, queue untouched), false if none yet
+extern void update_latest_GPS(const message_t_gps * message);            // Every fix, queued or not
+extern bool read_latest_from_GPS(message_t_gps * message);               // Newest fix (consistent snapshot, queue untouched), false if none yet
+extern uint32_t sensors_messages_dropped();                              // Samples not queued because the pool or queue was full
+extern uint32_t GPS_messages_dropped();
 // PROTOTYPES END ===============================================================================
 
 #endif
\ No newline at end of file
@@ -2,65 +2,113 @@
 
 // LIBRARIES ------------------------------------------------------------------------------------------------------------
 #include "mbed.h"
-#include "sensors_thread.h"
+#include "i2c_bus.h"
 #include "mma8451.h"
-
-// CONSTRUCTORS ---------------------------------------------------------------------------------------------------------
-extern I2C i2c;                                                   // I2C communication
+#include "float_only.h"
 
 // FUNCTION TO WRITE TO REGISTER ========================================================================================
-static void write_register_mma8451(char reg, char value){         // WRITE function receives the Control Register 1 and the ax direction
+static bool write_register_mma8451(i2c_probe_t *probe, char reg, char value){ // WRITE function receives the Control Register 1 and the ax direction
     char data[2] = {reg, value};
-    i2c.write(MMA8451_I2C_ADDRESS, data, 2);                      // We write in the MMA8451 direction the command to get, for example, ax
+    return i2c_bus_transfer(probe, data, 2, nullptr, 0);          // We write in the MMA8451 direction the command to get, for example, ax
+}
+
+// FUNCTION TO READ CONSECUTIVE REGISTERS ===============================================================================
+static bool read_registers_mma8451(i2c_probe_t *probe, char reg, char *data, int len){ // The register address auto-increments after each byte read
+    return i2c_bus_transfer(probe, &reg, 1, data, len);
 }
 
 // FUNCTION TO READ A REGISTER ==========================================================================================
-static char read_register_mma8451(char reg){                      // READ function does only get as a parameter the register to be read
-    char data;
-    i2c.write(MMA8451_I2C_ADDRESS, &reg, 1, true);                // Send register address from, for example, ax
-    i2c.read(MMA8451_I2C_ADDRESS, &data, 1);                      // Read data returned from the register
-    return data;
+static bool read_register_mma8451(i2c_probe_t *probe, char reg, char *value){ // False if the accelerometer did not answer, value is then left untouched
+    return read_registers_mma8451(probe, reg, value, 1);
 }
 
-// FUNCTION TO READ 14-BIT AXIS VALUE (X, Y, Z) =========================================================================
-static int16_t read_axis(char msb_reg){                           // This function receives as a parameter only the MSB acceleration register
-    char msb = read_register_mma8451(msb_reg);                    // The MSB register for each component is read
-    char lsb = read_register_mma8451(msb_reg + 1);                // The same with the LSB register which is actually 6 bit long, having bits 0 and 1, the most significant, empty
-    return (int16_t)((msb << 8) | lsb) >> 2;                      // Combine MSB (8-bit) and LSB (6-bit), and shift by 2 for 14-bit value
+// FUNCTION TO COMBINE THE 14-BIT AXIS VALUE (X, Y, Z) ==================================================================
+static int16_t axis_value(const char *msb_lsb){                   // MSB register followed by the LSB register
+    return (int16_t)((msb_lsb[0] << 8) | (uint8_t)msb_lsb[1]) >> 2;  // Combine MSB (8-bit) and LSB (6-bit), and shift by 2 for 14-bit value
 }
 
 // FUNCTION TO INITIALIZE THE ACCELEROMETER WITH FREEFALL DETECTION =====================================================
-void init_mma8451_pulse_ff() {
-    write_register_mma8451(CTRL_REG1, 0x08);                      // bit 3 = 1, Standby Mode, DRO = 400 Hz
+bool init_mma8451_pulse_ff(i2c_probe_t *probe) {
+    bool ok = write_register_mma8451(probe, CTRL_REG1, 0x18);     // bits 4:3 = 11, Standby Mode, DRO = 100 Hz (the FIFO then lasts 320 ms between reads)
+
+    // FIFO COMMAND (black-box recorder) -------------------------------------------------------------------
+    ok = ok && write_register_mma8451(probe, F_SETUP, 0x40);      // Circular buffer: the oldest sample is dropped when full, the newest are always there
 
     // FREEFALL INTERRUPT COMMAND --------------------------------------------------------------------------
-    write_register_mma8451(FF_MT_CFG, 0xB8);                      // Enable motion detection on Z-axis with event latch enabled
-    write_register_mma8451(FF_MT_THS, 0x03);                      // Set threshold to ~0.18g (0x03 * 0.063g/LSB)
-    write_register_mma8451(FF_MT_COUNT, 0x06);                    // Set debounce count to filter transient events, 400 Hz (2.5 ms) timer 120 ms
+    ok = ok && write_register_mma8451(probe, FF_MT_CFG, 0xB8);    // Enable motion detection on Z-axis with event latch enabled
+    ok = ok && write_register_mma8451(probe, FF_MT_THS, 0x03);    // Set threshold to ~0.18g (0x03 * 0.063g/LSB)
+    ok = ok && write_register_mma8451(probe, FF_MT_COUNT, 0x02);  // Set debounce count to filter transient events, 100 Hz (10 ms) timer 20 ms
 
     // TAP INTERRUPT COMMANDS ------------------------------------------------------------------------------
-    write_register_mma8451(PULSE_CFG, 0x15);                      // Configure PULSE_CFG to enable single tap on X, Y, Z with latch enabled
-    write_register_mma8451(PULSE_THSX, 0x19);                     // Set X threshold for 1.575g
-    write_register_mma8451(PULSE_THSY, 0x19);                     // Set Y threshold for 1.575g
-    write_register_mma8451(PULSE_THSZ, 0x2A);                     // Set Z threshold for 2.65g
-    write_register_mma8451(PULSE_TMLT, 0x50);                     // Set time limit for 50 ms
-    write_register_mma8451(PULSE_LTCY, 0xF0);                     // Set latency for 300 ms
+    ok = ok && write_register_mma8451(probe, PULSE_CFG, 0x15);    // Configure PULSE_CFG to enable single tap on X, Y, Z with latch enabled
+    ok = ok && write_register_mma8451(probe, PULSE_THSX, 0x19);   // Set X threshold for 1.575g
+    ok = ok && write_register_mma8451(probe, PULSE_THSY, 0x19);   // Set Y threshold for 1.575g
+    ok = ok && write_register_mma8451(probe, PULSE_THSZ, 0x2A);   // Set Z threshold for 2.65g
+    ok = ok && write_register_mma8451(probe, PULSE_TMLT, 0x14);   // Set time limit for 50 ms (2.5 ms steps at 100 Hz)
+    ok = ok && write_register_mma8451(probe, PULSE_LTCY, 0x3C);   // Set latency for 300 ms (5 ms steps at 100 Hz)
 
     // SHARED INTERRUPT COMMANDS ---------------------------------------------------------------------------
-    write_register_mma8451(CTRL_REG4, 0x0C);                      // Enable pulse (bit 3) and FF (bit 2) interrupt - 0000 1100
-    write_register_mma8451(CTRL_REG5, 0x08);                      // Route INT_CFG_PULSE (bit 3 = 1) to IN1 and INT_CFG_FF_MT (bit 2 = 0) to IN2 - 0000 1000
-    char data = read_register_mma8451(CTRL_REG1);                 // Initialize the MMA8451Q accelerometer by setting it to active mode, read the state of Control Register 1 (0x2A)
-    write_register_mma8451(CTRL_REG1, data | 0x01);
+    ok = ok && write_register_mma8451(probe, CTRL_REG4, 0x0C);    // Enable pulse (bit 3) and FF (bit 2) interrupt - 0000 1100
+    ok = ok && write_register_mma8451(probe, CTRL_REG5, 0x08);    // Route INT_CFG_PULSE (bit 3 = 1) to IN1 and INT_CFG_FF_MT (bit 2 = 0) to IN2 - 0000 1000
+    char data;
+    ok = ok && read_register_mma8451(probe, CTRL_REG1, &data);    // Initialize the MMA8451Q accelerometer by setting it to active mode, read the state of Control Register 1 (0x2A)
+    ok = ok && write_register_mma8451(probe, CTRL_REG1, data | 0x01);
+    return ok;                                                    // A failed step stops the sequence, the caller retries it later
 }
 
-// FUNCTION TO READ ACCELERATIONS =======================================================================================
-void read_accelerations(float *ax, float *ay, float *az){         // This function receives as parameters pointers to the memory addresses of the variables so they are directly modified, instead of receiving just a copy of that variable
-    int16_t raw_x = read_axis(OUT_X_MSB);                         // Remember, only the MSB is passed, but the function adds one to the register to get the LSB part
-    int16_t raw_y = read_axis(OUT_Y_MSB);
-    int16_t raw_z = read_axis(OUT_Z_MSB);
+// FUNCTION TO CHECK THAT THE CONFIGURATION OF init_mma8451_pulse_ff() IS STILL IN PLACE (warm boot) ====================
+bool mma8451_is_configured(i2c_probe_t *probe){
+    char ctrl1, f_setup, ff_mt_cfg, pulse_cfg, ctrl4, ctrl5;
+    return read_register_mma8451(probe, CTRL_REG1, &ctrl1)
+        && read_register_mma8451(probe, F_SETUP, &f_setup)
+        && read_register_mma8451(probe, FF_MT_CFG, &ff_mt_cfg)
+        && read_register_mma8451(probe, PULSE_CFG, &pulse_cfg)
+        && read_register_mma8451(probe, CTRL_REG4, &ctrl4)
+        && read_register_mma8451(probe, CTRL_REG5, &ctrl5)
+        && (ctrl1 & 0x39) == 0x19                                 // Active mode at 100 Hz
+        && f_setup == 0x40
+        && ff_mt_cfg == (char)0xB8
+        && pulse_cfg == 0x15
+        && ctrl4 == 0x0C
+        && ctrl5 == 0x08;
+}
+
+// FUNCTION TO CLEAR THE LATCHED FREEFALL AND TAP EVENTS ================================================================
+bool mma8451_clear_interrupts(i2c_probe_t *probe){
+    char source;
+    bool ok = read_register_mma8451(probe, FF_MT_SRC, &source);   // Both sources are latched, reading them releases INT1/INT2
+    return read_register_mma8451(probe, PULSE_SRC, &source) && ok;
+}
+
+// FUNCTION TO READ THE FIFO ============================================================================================
+bool mma8451_read_fifo(i2c_probe_t *probe, int16_t xyz[][3], uint8_t *count, bool *overflow){
+    static char data[MMA8451_FIFO_SIZE * 6];                      // Static, the caller's stack is small
+    char status;
+    if(!read_register_mma8451(probe, F_STATUS, &status)){
+        return false;                                             // The outputs are left untouched
+    }
+    *count = status & 0x3F;                                       // F_CNT, 0 to 32
+    *overflow = (status & 0x80) != 0;                             // F_OVF: samples were dropped since the last read
+    if(*count == 0){
+        return true;
+    }
+
+    // X, Y and Z MSB/LSB of every sample in one burst: with the FIFO on, the address wraps from OUT_Z_LSB back to OUT_X_MSB
+    if(!read_registers_mma8451(probe, OUT_X_MSB, data, *count * 6)){
+        return false;
+    }
+    for(uint8_t i = 0; i < *count; i++){
+        xyz[i][0] = axis_value(&data[i * 6]);
+        xyz[i][1] = axis_value(&data[i * 6 + 2]);
+        xyz[i][2] = axis_value(&data[i * 6 + 4]);
+    }
+    return true;
+}
 
+// FUNCTION TO CONVERT A SAMPLE TO ACCELERATIONS ========================================================================
+void mma8451_to_g(const int16_t xyz[3], float *ax, float *ay, float *az){ // This function receives as parameters pointers to the memory addresses of the variables so they are directly modified, instead of receiving just a copy of that variable
     // Sensitivity is 4096 counts/g for ±2g range
-    *ax = (float)raw_x / 4096.0f;                                 // Asterisk is used again to dereference the pointer, meaning that the value at the memory address that 'ax' points to will be updated with the calculated acceleration for ax
-    *ay = (float)raw_y / 4096.0f;                                 // With ±2g range the maximum positive acceleration is 2 * 4096 = 8192 and the same but negative for the negative range. NARROWER RANGE, BUT HIGHER SENSITIVITY
-    *az = (float)raw_z / 4096.0f;                                 // By dividing it by 4096, again, the value of Gs is ±2
+    *ax = xyz[0] * (1.0f / MMA8451_COUNTS_PER_G);                 // Asterisk is used again to dereference the pointer, meaning that the value at the memory address that 'ax' points to will be updated with the calculated acceleration for ax
+    *ay = xyz[1] * (1.0f / MMA8451_COUNTS_PER_G);                 // With ±2g range the maximum positive acceleration is 2 * 4096 = 8192 and the same but negative for the negative range. NARROWER RANGE, BUT HIGHER SENSITIVITY
+    *az = xyz[2] * (1.0f / MMA8451_COUNTS_PER_G);                 // By dividing it by 4096, again, the value of Gs is ±2
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 // LIBRARIES ------------------------------------------------------------------------------------
 #include "mbed.h"
+#include "i2c_bus.h"
 
 // LIBRARY GUARD --------------------------------------------------------------------------------
 #ifndef MMA8451_H
@@ -23,13 +24,25 @@
 #define PULSE_LTCY 0x27                                           // Latency time limit
 #define CTRL_REG4 0x2D                                            // Interrupt enable register
 #define CTRL_REG5 0x2E                                            // Interrupt pin routing register
-#define OUT_X_MSB 0x01                                            // Register for X-axis MSB
+#define F_STATUS 0x00                                             // FIFO status: overflow flag and sample count
+#define OUT_X_MSB 0x01                                            // Register for X-axis MSB (oldest FIFO sample while the FIFO is on)
 #define OUT_Y_MSB 0x03                                            // Register for Y-axis MSB
 #define OUT_Z_MSB 0x05                                            // Register for Z-axis MSB
+#define FF_MT_SRC 0x16                                            // Freefall/Motion source register (reading it clears the latched event)
+#define PULSE_SRC 0x22                                            // Pulse source register (reading it clears the latched event)
+#define F_SETUP 0x09                                              // FIFO setup register (only writable in standby)
+#define MMA8451_ODR_HZ 100                                        // Output data rate, also the rate of the FIFO samples
+#define MMA8451_FIFO_SIZE 32                                      // Samples held by the FIFO: 320 ms at MMA8451_ODR_HZ
+#define MMA8451_COUNTS_PER_G 4096                                 // ±2g range, 14-bit
+#define G_TO_MS2 9.81f                                            // Macro to convert G forces of the accelerometer to m/s2
 
 // PROTOTYPES ===================================================================================
-void init_mma8451_pulse_ff();
-void read_accelerations(float *ax, float *ay, float *az);
+// Every function returns false if the accelerometer did not answer within its I2C budget
+bool init_mma8451_pulse_ff(i2c_probe_t *probe);
+bool mma8451_read_fifo(i2c_probe_t *probe, int16_t xyz[][3], uint8_t *count, bool *overflow);  // Oldest first, up to MMA8451_FIFO_SIZE samples
+void mma8451_to_g(const int16_t xyz[3], float *ax, float *ay, float *az);
+bool mma8451_is_configured(i2c_probe_t *probe);
+bool mma8451_clear_interrupts(i2c_probe_t *probe);
 // PROTOTYPES END ===============================================================================
 
 #endif
\ No newline at end of file
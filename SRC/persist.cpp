@@ -0,0 +1,171 @@
+/* File for the flash persistence function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "persist.h"
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    uint32_t magic;                                             // PERSIST_MAGIC
+    uint8_t version;                                            // PERSIST_VERSION
+    uint8_t slot;                                               // Slot the record was written for
+    uint16_t size;                                              // Size of the data following the header
+    uint32_t crc;                                               // CRC-32 of the data
+} persist_header_t;
+MBED_STATIC_ASSERT(sizeof(persist_header_t) == PERSIST_HEADER_SIZE, "PERSIST_HEADER_SIZE is out of date");
+
+// Bytes each copy of a slot must hold, at least one sector, and the copies a slot rotates through
+static const uint16_t SLOT_SIZE[PERSIST_SLOT_COUNT] = {PERSIST_STATE_SIZE, PERSIST_GPS_SIZE, PERSIST_CALIBRATION_SIZE, PERSIST_BLACKBOX_SIZE};
+static const uint8_t SLOT_COPIES[PERSIST_SLOT_COUNT] = {1, PERSIST_GPS_COPIES, 1, 1};
+
+// CONSTRUCTORS ------------------------------------------------------------------------------------------------------------
+static FlashIAP flash;
+static Mutex flash_mutex;                                       // Records can be saved from more than one thread
+
+// FUNCTION TO GET THE SECTOR ADDRESS AND SIZE OF A COPY OF A SLOT =========================================================
+// Copy 0 of every slot from the end of the flash, then the other copies below them, so adding copies moves no record
+static uint32_t slot_address(persist_slot_t slot, uint8_t copy = 0, uint32_t *span = nullptr){
+    uint32_t address = flash.get_flash_start() + flash.get_flash_size();
+    uint32_t size = 0;
+    for(int pass = 0; pass < 2; pass++){
+        for(int i = 0; i < PERSIST_SLOT_COUNT; i++){
+            for(int c = pass; c < (pass ? SLOT_COPIES[i] : 1); c++){
+                size = 0;
+                do{
+                    uint32_t sector = flash.get_sector_size(address - 1); // Walk back one sector at a time (sectors may have different sizes)
+                    address -= sector;
+                    size += sector;
+                }while(size < SLOT_SIZE[i]);
+                if(i == slot && c == copy){
+                    if(span != nullptr){
+                        *span = size;
+                    }
+                    return address;
+                }
+            }
+        }
+    }
+    return address;                                             // Not reached for a copy below SLOT_COPIES
+}
+
+// FUNCTION TO COMPUTE THE CRC OF THE DATA =================================================================================
+static uint32_t compute_crc(const void *data, uint16_t size){
+    MbedCRC<POLY_32BIT_ANSI, 32> ct;
+    uint32_t crc = 0;
+    ct.compute(data, size, &crc);
+    return crc;
+}
+
+// FUNCTION TO LOAD A RECORD ===============================================================================================
+bool persist_load(persist_slot_t slot, void *data, uint16_t size){
+    return persist_load_copy(slot, 0, data, size);
+}
+
+bool persist_load_copy(persist_slot_t slot, uint8_t copy, void *data, uint16_t size){
+    bool ret = false;
+    persist_header_t header;
+
+    flash_mutex.lock();
+    flash.init();
+    uint32_t address = slot_address(slot, copy);
+
+    if(copy < SLOT_COPIES[slot] && flash.read(&header, address, sizeof(header)) == 0
+       && header.magic == PERSIST_MAGIC && header.version == PERSIST_VERSION
+       && header.slot == slot && header.size == size
+       && flash.read(data, address + sizeof(header), size) == 0){
+        ret = (compute_crc(data, size) == header.crc);
+    }
+
+    flash.deinit();
+    flash_mutex.unlock();
+    return ret;
+}
+
+// FUNCTION TO CHECK A RECORD IN PLACE =====================================================================================
+// For records too large to load next to their RAM copy (the black-box window), read back with persist_read
+bool persist_check(persist_slot_t slot, uint16_t size){
+    bool ret = false;
+    persist_header_t header;
+    char chunk[PERSIST_CHUNK_SIZE];
+
+    flash_mutex.lock();
+    flash.init();
+    uint32_t address = slot_address(slot);
+
+    if(flash.read(&header, address, sizeof(header)) == 0
+       && header.magic == PERSIST_MAGIC && header.version == PERSIST_VERSION
+       && header.slot == slot && header.size == size){
+        MbedCRC<POLY_32BIT_ANSI, 32> ct;
+        uint32_t crc = 0;
+        ret = (ct.compute_partial_start(&crc) == 0);
+        for(uint16_t offset = 0; offset < size && ret; offset += sizeof(chunk)){
+            uint16_t length = (size - offset < (uint16_t)sizeof(chunk)) ? size - offset : sizeof(chunk);
+            ret = (flash.read(chunk, address + sizeof(header) + offset, length) == 0 && ct.compute_partial(chunk, length, &crc) == 0);
+        }
+        ret = ret && (ct.compute_partial_stop(&crc) == 0) && (crc == header.crc);
+    }
+
+    flash.deinit();
+    flash_mutex.unlock();
+    return ret;
+}
+
+// FUNCTION TO READ PART OF A RECORD =======================================================================================
+bool persist_read(persist_slot_t slot, uint16_t offset, void *data, uint16_t length){
+    flash_mutex.lock();
+    flash.init();
+    bool ret = (flash.read(data, slot_address(slot) + sizeof(persist_header_t) + offset, length) == 0);
+    flash.deinit();
+    flash_mutex.unlock();
+    return ret;
+}
+
+// FUNCTION TO SAVE A RECORD ===============================================================================================
+bool persist_save(persist_slot_t slot, const void *data, uint16_t size){
+    return persist_save_copy(slot, 0, data, size);
+}
+
+bool persist_save_copy(persist_slot_t slot, uint8_t copy, const void *data, uint16_t size){
+    bool ret = false;
+    persist_header_t header = {PERSIST_MAGIC, PERSIST_VERSION, (uint8_t)slot, size, compute_crc(data, size)};
+    char chunk[PERSIST_CHUNK_SIZE];                             // Header and data are streamed through this page aligned buffer
+
+    flash_mutex.lock();
+    flash.init();
+    uint32_t span;                                              // Every sector of the copy
+    uint32_t address = slot_address(slot, copy, &span);
+    uint32_t total = sizeof(header) + size;
+
+    uint32_t programmed = ((total + PERSIST_CHUNK_SIZE - 1) / PERSIST_CHUNK_SIZE) * PERSIST_CHUNK_SIZE;
+
+    if(copy < SLOT_COPIES[slot] && programmed <= span && (PERSIST_CHUNK_SIZE % flash.get_page_size()) == 0 && flash.erase(address, span) == 0){
+        ret = true;
+        for(uint32_t offset = 0; offset < total && ret; offset += PERSIST_CHUNK_SIZE){
+            memset(chunk, flash.get_erase_value(), sizeof(chunk));
+            for(uint32_t i = 0; i < PERSIST_CHUNK_SIZE && offset + i < total; i++){
+                uint32_t pos = offset + i;
+                chunk[i] = (pos < sizeof(header)) ? ((const char *)&header)[pos] : ((const char *)data)[pos - sizeof(header)];
+            }
+            ret = (flash.program(chunk, address + offset, PERSIST_CHUNK_SIZE) == 0);
+        }
+    }
+
+    flash.deinit();
+    flash_mutex.unlock();
+    return ret;
+}
+
+// FUNCTION TO ERASE A RECORD ==============================================================================================
+bool persist_erase(persist_slot_t slot){
+    bool ret = true;
+    flash_mutex.lock();
+    flash.init();
+    for(uint8_t copy = 0; copy < SLOT_COPIES[slot]; copy++){
+        uint32_t span;
+        uint32_t address = slot_address(slot, copy, &span);
+        ret = (flash.erase(address, span) == 0) && ret;
+    }
+    flash.deinit();
+    flash_mutex.unlock();
+    return ret;
+}
@@ -0,0 +1,53 @@
+/* File for the flash persistence function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef PERSIST_H
+#define PERSIST_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#define PERSIST_MAGIC        0x50534D45                         // "EMSP", marks a programmed record
+#define PERSIST_VERSION      2                                  // Bump when a record layout changes, old records are then ignored
+#define PERSIST_CHUNK_SIZE   64                                 // Records are programmed in chunks of this size (multiple of the flash page size)
+#define PERSIST_HEADER_SIZE  12                                 // Header programmed in front of every record
+#define PERSIST_STATE_SIZE   256                                // Bytes reserved for each slot, rounded up to whole sectors
+#define PERSIST_GPS_SIZE     128
+#define PERSIST_GPS_COPIES   8                                  // The GPS record rotates through this many copies, each in its own sectors (wear levelling)
+#define PERSIST_CALIBRATION_SIZE 128
+#define PERSIST_BLACKBOX_SIZE 2048                              // Several sectors where they are small
+
+// True if a record of this size, header included and programmed in whole chunks, fits a slot of slot_size bytes
+#define PERSIST_FITS(record_size, slot_size) \
+    ((((record_size) + PERSIST_HEADER_SIZE + PERSIST_CHUNK_SIZE - 1) / PERSIST_CHUNK_SIZE) * PERSIST_CHUNK_SIZE <= (slot_size))
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// Each slot is one flash sector counted from the end of the flash (or as many as its size needs), so records never share an erase unit
+typedef enum {
+    PERSIST_SLOT_STATE,                                          // Runtime state snapshot taken at freefall shutdown
+    PERSIST_SLOT_GPS,                                            // Last good GPS position and time, used to aid the next start
+    PERSIST_SLOT_CALIBRATION,                                    // Analog calibration points entered on the console
+    PERSIST_SLOT_BLACKBOX,                                       // Accelerometer window around the freefall that shut the system down
+    PERSIST_SLOT_COUNT
+} persist_slot_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+bool persist_load(persist_slot_t slot, void *data, uint16_t size);          // False if the slot is empty, corrupted or of another size/version
+bool persist_save(persist_slot_t slot, const void *data, uint16_t size);    // Erase the slot sector and program header + data
+bool persist_erase(persist_slot_t slot);                                    // Every copy of the slot
+bool persist_load_copy(persist_slot_t slot, uint8_t copy, void *data, uint16_t size);        // As persist_load, copy 0 is the one it reads
+bool persist_save_copy(persist_slot_t slot, uint8_t copy, const void *data, uint16_t size);  // As persist_save, only that copy is erased
+bool persist_check(persist_slot_t slot, uint16_t size);                     // As persist_load, the CRC computed chunk by chunk without a copy in RAM
+bool persist_read(persist_slot_t slot, uint16_t offset, void *data, uint16_t length);  // Part of a record already checked by persist_check
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,182 @@
+/* File for the multi-resolution rollup store function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include <ctype.h>
+#include "rollup.h"
+#include "timebase.h"
+
+// LEVEL TABLE (finest first) ----------------------------------------------------------------------------------------------
+#define ROLLUP_TOTAL_BUCKETS (ROLLUP_MINUTE_BUCKETS + ROLLUP_HOUR_BUCKETS + ROLLUP_DAY_BUCKETS)
+
+static const uint32_t LEVEL_SPAN_MINUTES[ROLLUP_LEVEL_COUNT] = {1, 60, 1440};
+static const uint16_t LEVEL_BUCKETS[ROLLUP_LEVEL_COUNT] = {ROLLUP_MINUTE_BUCKETS, ROLLUP_HOUR_BUCKETS, ROLLUP_DAY_BUCKETS};
+static const uint16_t LEVEL_OFFSET[ROLLUP_LEVEL_COUNT] = {0, ROLLUP_MINUTE_BUCKETS, ROLLUP_MINUTE_BUCKETS + ROLLUP_HOUR_BUCKETS};
+static const char LEVEL_NAME[ROLLUP_LEVEL_COUNT][7] = {"minute", "hour", "day"};
+
+// Console letter and validity bit of each channel
+static const char CHANNEL_LETTER[ROLLUP_CH_COUNT] = {'T', 'H', 'M', 'L'};
+static const uint8_t CHANNEL_VALID_BIT[ROLLUP_CH_COUNT] = {MSG_VALID_TEMPERATURE, MSG_VALID_HUMIDITY, MSG_VALID_MOISTURE, MSG_VALID_LIGHT};
+
+// STATIC VARIABLES (only touched by the main thread) ----------------------------------------------------------------------
+// Each level is a ring: the bucket of period p is slot p % LEVEL_BUCKETS, and it holds periods (current - buckets, current]
+static rollup_bucket_t buckets[ROLLUP_CH_COUNT][ROLLUP_TOTAL_BUCKETS];
+static uint32_t current_period[ROLLUP_LEVEL_COUNT];             // Newest period of each level
+
+// FUNCTION TO GET THE BUCKET OF A PERIOD ==================================================================================
+static rollup_bucket_t *slot(uint8_t channel, uint8_t level, uint32_t period){
+    return &buckets[channel][LEVEL_OFFSET[level] + period % LEVEL_BUCKETS[level]];
+}
+
+// FUNCTION TO CHECK IF A PERIOD IS STILL HELD BY A LEVEL ==================================================================
+static bool retained(uint8_t level, uint32_t period){
+    return period > current_period[level] || period + LEVEL_BUCKETS[level] > current_period[level];  // Future periods are simply empty
+}
+
+// FUNCTION TO MOVE A LEVEL TO A NEWER PERIOD ==============================================================================
+static void advance(uint8_t level, uint32_t period){
+    if(period <= current_period[level]){
+        return;
+    }
+
+    // Empty the slots of every period skipped since the last sample (at most one full ring, so bounded)
+    uint32_t skipped = period - current_period[level];
+    if(skipped > LEVEL_BUCKETS[level]){
+        skipped = LEVEL_BUCKETS[level];
+    }
+    for(uint32_t i = 0; i < skipped; i++){
+        for(uint8_t ch = 0; ch < ROLLUP_CH_COUNT; ch++){
+            memset(slot(ch, level, period - i), 0, sizeof(rollup_bucket_t));
+        }
+    }
+    current_period[level] = period;
+}
+
+// FUNCTION TO ADD A SAMPLE ================================================================================================
+void rollup_add(const message_t_sensors *sample){
+    const int16_t values[ROLLUP_CH_COUNT] = {sample->temperature, sample->humidity, (int16_t)sample->moistPercAnalogValue, (int16_t)sample->lightPercAnalogValue};
+    uint32_t minute = (uint32_t)(sample->tick_us / 60000000ULL);
+
+    for(uint8_t level = 0; level < ROLLUP_LEVEL_COUNT; level++){
+        uint32_t period = minute / LEVEL_SPAN_MINUTES[level];
+        advance(level, period);
+        if(!retained(level, period)){
+            continue;                                           // Late sample whose bucket was already recycled
+        }
+
+        for(uint8_t ch = 0; ch < ROLLUP_CH_COUNT; ch++){
+            if(!(sample->valid & CHANNEL_VALID_BIT[ch])){
+                continue;
+            }
+            rollup_bucket_t *b = slot(ch, level, period);
+            int16_t value = values[ch];
+            if(b->count == 0){
+                b->min = value;
+                b->max = value;
+            }else{
+                b->min = (value < b->min) ? value : b->min;
+                b->max = (value > b->max) ? value : b->max;
+            }
+            if(b->count < UINT16_MAX){
+                b->sum += value;                                // Saturated buckets keep the average of their first samples
+                b->count++;
+            }
+        }
+    }
+}
+
+// FUNCTION TO AGGREGATE A RANGE OF MINUTES ================================================================================
+bool rollup_query(rollup_channel_t channel, uint32_t first_minute, uint32_t end_minute, rollup_result_t *result){
+    memset(result, 0, sizeof(*result));
+    result->min = INT16_MAX;
+    result->max = INT16_MIN;
+    result->first_minute = UINT32_MAX;
+
+    uint32_t cursor = first_minute;
+    while(cursor < end_minute){
+        int8_t chosen = -1;
+
+        // Coarsest bucket that fits whole inside what is left of the range
+        for(int8_t level = ROLLUP_LEVEL_COUNT - 1; level >= 0 && chosen < 0; level--){
+            uint32_t span = LEVEL_SPAN_MINUTES[level];
+            if(cursor % span == 0 && end_minute - cursor >= span && retained(level, cursor / span)){
+                chosen = level;
+            }
+        }
+
+        // Otherwise the finer levels have expired: finest bucket still holding the cursor, even if it sticks out of the range
+        for(int8_t level = 0; level < ROLLUP_LEVEL_COUNT && chosen < 0; level++){
+            if(retained(level, cursor / LEVEL_SPAN_MINUTES[level])){
+                chosen = level;
+            }
+        }
+
+        if(chosen < 0){
+            // Older than every level: jump to the oldest day still held
+            cursor = (current_period[ROLLUP_LEVEL_COUNT - 1] - LEVEL_BUCKETS[ROLLUP_LEVEL_COUNT - 1] + 1) * LEVEL_SPAN_MINUTES[ROLLUP_LEVEL_COUNT - 1];
+            continue;
+        }
+
+        uint32_t span = LEVEL_SPAN_MINUTES[chosen];
+        uint32_t period = cursor / span;
+        const rollup_bucket_t *b = slot(channel, chosen, period);
+        if(period <= current_period[chosen] && b->count > 0){
+            result->min = (b->min < result->min) ? b->min : result->min;
+            result->max = (b->max > result->max) ? b->max : result->max;
+            result->sum += b->sum;
+            result->count += b->count;
+            result->buckets_used[chosen]++;
+            if(period * span < result->first_minute){
+                result->first_minute = period * span;
+            }
+            result->end_minute = (period + 1) * span;
+        }
+        cursor = (period + 1) * span;
+    }
+
+    return result->count > 0;
+}
+
+// FUNCTION TO GET THE CURRENT MINUTE ======================================================================================
+uint32_t rollup_now_minute(){
+    return (uint32_t)(timebase_now_us() / 60000000ULL);
+}
+
+// FUNCTION TO ANSWER A CONSOLE QUERY ======================================================================================
+void rollup_query_command(const char *args){
+    char letter;
+    unsigned long from_ago, to_ago;
+    if(sscanf(args, " %c %lu %lu", &letter, &from_ago, &to_ago) != 3 || from_ago < to_ago){
+        printf("Usage: %c <T|H|M|L> <from minutes ago> <to minutes ago>, e.g. %c T 120 0\n\r", ROLLUP_QUERY_COMMAND, ROLLUP_QUERY_COMMAND);
+        return;
+    }
+
+    int8_t channel = -1;
+    for(uint8_t ch = 0; ch < ROLLUP_CH_COUNT; ch++){
+        if(CHANNEL_LETTER[ch] == toupper(letter)){
+            channel = ch;
+        }
+    }
+    if(channel < 0){
+        printf("Unknown channel '%c'\n\r", letter);
+        return;
+    }
+
+    // Both ends included, "0" is the current (partial) minute
+    uint32_t now = rollup_now_minute();
+    uint32_t first = (from_ago < now) ? now - from_ago : 0;
+    uint32_t end = (to_ago <= now) ? now - to_ago + 1 : 0;
+
+    rollup_result_t r;
+    printf("%c %c [-%lu, -%lu] min: ", ROLLUP_QUERY_COMMAND, CHANNEL_LETTER[channel], from_ago, to_ago);
+    if(!rollup_query((rollup_channel_t)channel, first, end, &r)){
+        printf("no samples\n\r");
+        return;
+    }
+
+    printf("min = %.2f, max = %.2f, avg = %.2f (%lu samples", centi_to_float(r.min), centi_to_float(r.max), (float)r.sum / r.count / MSG_CENTI_SCALE, (unsigned long)r.count);
+    for(int8_t level = ROLLUP_LEVEL_COUNT - 1; level >= 0; level--){
+        printf(", %u %s", r.buckets_used[level], LEVEL_NAME[level]);
+    }
+    printf(" buckets covering [-%ld, -%ld] min)\n\r", (long)now - (long)r.first_minute, (long)now + 1 - (long)r.end_minute);
+}
@@ -0,0 +1,70 @@
+/* File for the multi-resolution rollup store function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+#include "sensors_thread.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Levels of the hierarchy, finest first. Periods are counted in minutes of the monotonic tick
+#define ROLLUP_MINUTE_BUCKETS   60                              // Last hour, 1-minute resolution
+#define ROLLUP_HOUR_BUCKETS     24                              // Last day, 1-hour resolution
+#define ROLLUP_DAY_BUCKETS      30                              // Last month, 1-day resolution (days since boot, not calendar days)
+#define ROLLUP_LEVEL_COUNT      3
+
+// Fastest sampling (ADVANCED_MODE, back to back): every acquisition waits at least the white LED settle time
+#define ROLLUP_MIN_SAMPLE_PERIOD_MS ((uint32_t)std::chrono::milliseconds(SENSORS_LED_SETTLE_TIME).count())
+
+#define ROLLUP_QUERY_COMMAND    'Q'                             // Console: "Q <T|H|M|L> <from minutes ago> <to minutes ago>", e.g. "Q T 120 0"
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// Channels kept, values in the fixed-point units of message_t_sensors (all centi)
+typedef enum {
+    ROLLUP_CH_TEMPERATURE,
+    ROLLUP_CH_HUMIDITY,
+    ROLLUP_CH_MOISTURE,
+    ROLLUP_CH_LIGHT,
+    ROLLUP_CH_COUNT
+} rollup_channel_t;
+
+// One bucket, 10 bytes: 4 channels x (60 + 24 + 30) buckets = 4560 bytes of RAM in total
+// Once count saturates the bucket stops accumulating (min and max still follow): the average is that of its first
+// UINT16_MAX samples and the sum, at most UINT16_MAX x INT16_MAX, cannot overflow
+typedef MBED_PACKED(struct) {
+    int16_t min, max;
+    int32_t sum;                                                 // Of the first count samples
+    uint16_t count;                                              // 0 = no sample in the period, saturates at UINT16_MAX
+} rollup_bucket_t;
+
+MBED_STATIC_ASSERT((int64_t)UINT16_MAX * INT16_MAX <= INT32_MAX && (int64_t)UINT16_MAX * INT16_MIN >= INT32_MIN, "A saturated bucket sum must fit int32_t");
+MBED_STATIC_ASSERT(60000 / ROLLUP_MIN_SAMPLE_PERIOD_MS < UINT16_MAX, "Minute buckets must never saturate at the fastest sampling rate");
+
+// Result of a range query
+typedef struct {
+    int16_t min, max;
+    int64_t sum;                                                 // Up to 30 day buckets of INT32_MAX
+    uint32_t count;
+    uint32_t first_minute, end_minute;                           // Range actually covered by the buckets used (may stick out of the request)
+    uint16_t buckets_used[ROLLUP_LEVEL_COUNT];                   // Buckets taken from each level, finest first
+} rollup_result_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void rollup_add(const message_t_sensors *sample);                                 // O(1): one bucket per level and channel (channels with a failed read are skipped)
+bool rollup_query(rollup_channel_t channel, uint32_t first_minute, uint32_t end_minute, rollup_result_t *result);  // Aggregate [first, end) from the coarsest buckets, false if no sample
+uint32_t rollup_now_minute();                                                     // Current period of the minute level
+void rollup_query_command(const char *args);                                      // Parse and answer a console query (arguments after ROLLUP_QUERY_COMMAND)
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,214 @@
+/* File for the I2C probe scan scheduler function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "scan.h"
+#include "mma8451.h"
+#include "si7021.h"
+#include "tcs34725.h"
+#include "message_q.h"
+#include "timebase.h"
+#include "blackbox.h"
+#include "float_only.h"
+
+// STATIC VARIABLES (only touched by the sensors' thread) ------------------------------------------------------------------
+static i2c_probe_t probes[SCAN_MAX_DEVICES];                    // Grouped by mux channel, so a scan selects every channel once
+static uint8_t probe_count = 0;
+static bool reverse = false;                                    // Scan direction, alternated so the last channel of a scan is the first of the next
+static uint32_t last_scan_us = 0, worst_scan_us = 0;
+static uint64_t last_drain_us = 0;                              // Last read of the accelerometer FIFO
+static int16_t fifo[MMA8451_FIFO_SIZE][3];                      // Accelerometer FIFO contents of the last drain
+static int16_t last_xyz[3];                                     // Newest accelerometer sample, the one carried by the messages
+static bool have_xyz = false;
+static uint64_t powered_us[SCAN_MAX_DEVICES];                   // Tick from which a TCS34725 powered on by scan_power_on() can be configured, 0 if it was not
+
+// FUNCTION TO ADD A PROBE TO THE TABLE ====================================================================================
+static void add_probe(i2c_device_t device, int address, uint8_t mux_channel, uint8_t probe_id){
+    i2c_probe_t *p = &probes[probe_count++];
+    memset(p, 0, sizeof(*p));
+    p->device = device;
+    p->address = address;
+    p->mux_channel = mux_channel;
+    p->probe_id = probe_id;
+}
+
+// FUNCTION TO CONFIGURE A PROBE ===========================================================================================
+static bool init_probe(i2c_probe_t *p){
+    switch(p->device){
+        case I2C_DEV_MMA8451:  return init_mma8451_pulse_ff(p);
+        case I2C_DEV_TCS34725: {                                // Powered on by scan_power_on() before the scan, never waited for here
+            uint64_t *powered = &powered_us[p - probes];
+            bool warm = (*powered != 0 && timebase_now_us() >= *powered);
+            *powered = 0;                                       // Powered on again before the next try
+            return warm && tcs34725_init(p);
+        }
+        default:               return true;                     // The Si7021 needs no configuration
+    }
+}
+
+// FUNCTION TO CHECK A CONFIGURATION KEPT FROM THE PREVIOUS BOOT ===========================================================
+static bool is_configured(i2c_probe_t *p){
+    switch(p->device){
+        case I2C_DEV_MMA8451:  return mma8451_is_configured(p) && mma8451_clear_interrupts(p);  // Also release the latched freefall
+        case I2C_DEV_TCS34725: return tcs34725_is_configured(p);
+        default:               return true;
+    }
+}
+
+// FUNCTION TO DRAIN THE ACCELEROMETER FIFO INTO THE BLACK BOX ============================================================
+static bool drain_accelerometer(i2c_probe_t *p){
+    uint8_t count;
+    bool overflow;
+    if(!mma8451_read_fifo(p, fifo, &count, &overflow)){
+        return false;
+    }
+    last_drain_us = timebase_now_us();
+    if(count > 0){
+        blackbox_push(fifo, count, overflow, last_drain_us);    // The newest sample was taken within one ODR period of this tick
+        memcpy(last_xyz, fifo[count - 1], sizeof(last_xyz));
+        have_xyz = true;
+    }
+    return true;
+}
+
+// FUNCTION TO READ A PROBE INTO THE RESULT OF ITS BED =====================================================================
+static bool read_probe(i2c_probe_t *p, scan_result_t *r){
+    switch(p->device){
+        case I2C_DEV_MMA8451:
+            if(!drain_accelerometer(p)){
+                return false;
+            }
+            if(have_xyz){                                       // Nothing yet right after the configuration
+                mma8451_to_g(last_xyz, &r->ax, &r->ay, &r->az);
+                r->valid |= MSG_VALID_ACCEL;
+            }
+            return true;
+
+        case I2C_DEV_SI7021: {
+            bool humidity_ok = read_humidity(p, &r->humidity);
+            bool temperature_ok = read_temperature(p, &r->temperature);
+            r->valid |= (humidity_ok ? MSG_VALID_HUMIDITY : 0) | (temperature_ok ? MSG_VALID_TEMPERATURE : 0);
+            return humidity_ok && temperature_ok;
+        }
+
+        case I2C_DEV_TCS34725:
+            if(!tcs34725_read_rgbc(p, &r->clear, &r->red, &r->green, &r->blue)){
+                return false;
+            }
+            r->valid |= MSG_VALID_COLOUR;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// FUNCTION TO BUILD THE PROBE TABLE =======================================================================================
+void scan_init(bool warm_boot){
+    probe_count = 0;
+    add_probe(I2C_DEV_MMA8451, MMA8451_I2C_ADDRESS, I2C_MUX_NONE, 0);
+#if SCAN_MUX_PROBES > 0
+    for(uint8_t channel = 0; channel < SCAN_MUX_PROBES; channel++){
+        add_probe(I2C_DEV_SI7021, SI7021_ADDR, channel, channel);
+        add_probe(I2C_DEV_TCS34725, TCS34725_ADDRESS, channel, channel);
+    }
+#else
+    add_probe(I2C_DEV_SI7021, SI7021_ADDR, I2C_MUX_NONE, 0);
+    add_probe(I2C_DEV_TCS34725, TCS34725_ADDRESS, I2C_MUX_NONE, 0);
+#endif
+
+    memset(powered_us, 0, sizeof(powered_us));
+    if(warm_boot){
+        for(uint8_t i = 0; i < probe_count; i++){
+            probes[i].ready = is_configured(&probes[i]);
+        }
+    }
+}
+
+// FUNCTION TO POWER ON THE PROBES TO CONFIGURE THAT NEED TIME BEFORE THEIR CONFIGURATION =================================
+// Called by sensors_step() when it turns the white LED on, the wait is returned so the task does not block the queue. The
+// channels are walked against the direction of the next scan, which then starts on the channel left selected
+std::chrono::milliseconds scan_power_on(){
+    std::chrono::milliseconds wait = 0ms;
+    for(uint8_t n = 1; n < probe_count; n++){
+        uint8_t i = reverse ? n : probe_count - n;
+        i2c_probe_t *p = &probes[i];
+        if(p->ready || p->device != I2C_DEV_TCS34725){
+            continue;
+        }
+        if(tcs34725_power_on(p)){
+            powered_us[i] = timebase_now_us() + std::chrono::microseconds(TCS34725_POWER_ON_TIME).count();
+            wait = TCS34725_POWER_ON_TIME;
+        }
+    }
+    return wait;
+}
+
+// FUNCTION TO CONFIGURE A PROBE IF NEEDED AND READ IT ====================================================================
+static void scan_probe(i2c_probe_t *p, scan_result_t *r){
+    if(!p->ready){
+        p->ready = init_probe(p);                               // Not configured yet, or it stopped answering (it may have lost power)
+    }
+    if(p->ready && !read_probe(p, r)){
+        p->ready = false;
+    }
+}
+
+// FUNCTION TO READ EVERY PROBE ============================================================================================
+void scan_run(scan_result_t results[SCAN_PROBE_IDS]){
+    uint64_t start_us = timebase_now_us();
+    const uint64_t drain_us = std::chrono::microseconds(SCAN_DRAIN_PERIOD).count();
+
+    for(uint8_t id = 0; id < SCAN_PROBE_IDS; id++){
+        results[id].valid = 0;
+    }
+
+    // The accelerometer (probe 0, on no mux channel) is read first, then again between beds and at the end: a scan of
+    // several beds lasts about as long as its FIFO, and the task waits up to BLACKBOX_DRAIN_PERIOD around a scan
+    scan_probe(&probes[0], &results[0]);
+    for(uint8_t n = 1; n < probe_count; n++){
+        if(timebase_now_us() - last_drain_us >= drain_us){
+            scan_record();
+        }
+        i2c_probe_t *p = &probes[reverse ? probe_count - n : n];
+        scan_probe(p, &results[p->probe_id]);
+    }
+    scan_record();
+    reverse = !reverse;
+
+    last_scan_us = (uint32_t)(timebase_now_us() - start_us);
+    if(last_scan_us > worst_scan_us){
+        worst_scan_us = last_scan_us;
+    }
+}
+
+// FUNCTION TO READ ONLY THE ACCELEROMETER (between scans, and within one) =================================================
+void scan_record(){
+    i2c_probe_t *p = &probes[0];                                // Always the first probe of the table
+    if(probe_count > 0 && p->ready && !drain_accelerometer(p)){
+        p->ready = false;                                       // Configured again at the next scan
+    }
+}
+
+// FUNCTION TO CHECK THAT EVERY PROBE IS CONFIGURED ========================================================================
+bool scan_all_ready(){
+    for(uint8_t i = 0; i < probe_count; i++){
+        if(!probes[i].ready){
+            return false;
+        }
+    }
+    return true;
+}
+
+// FUNCTION TO PRINT THE HEALTH OF THE BUS =================================================================================
+void scan_print_health(){
+    for(uint8_t i = 0; i < probe_count; i++){
+        i2c_bus_print_health(&probes[i]);
+    }
+#if SCAN_MUX_PROBES > 0
+    i2c_bus_print_health(tca9548a_probe());
+    printf("I2C scan: %d devices, last %lu us, worst %lu us, %lu mux switches\n\r", probe_count, (unsigned long)last_scan_us, (unsigned long)worst_scan_us, (unsigned long)tca9548a_switches());
+#else
+    printf("I2C scan: %d devices, last %lu us, worst %lu us\n\r", probe_count, (unsigned long)last_scan_us, (unsigned long)worst_scan_us);
+#endif
+}
@@ -0,0 +1,52 @@
+/* File for the I2C probe scan scheduler function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "i2c_bus.h"
+#include "tca9548a.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef SCAN_H
+#define SCAN_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Probe layout, from mbed_app.json: N > 0 puts one Si7021 + TCS34725 pair on each of the mux channels 0 .. N - 1
+#ifdef MBED_CONF_APP_MUX_PROBES
+#define SCAN_MUX_PROBES   MBED_CONF_APP_MUX_PROBES
+#else
+#define SCAN_MUX_PROBES   0                                     // One probe of each type wired directly
+#endif
+
+#define SCAN_PROBE_IDS    ((SCAN_MUX_PROBES > 0) ? SCAN_MUX_PROBES : 1)  // Beds, probe_id 0 .. SCAN_PROBE_IDS - 1
+#define SCAN_MAX_DEVICES  (1 + 2 * SCAN_PROBE_IDS)              // MMA8451Q on the board + one Si7021 and one TCS34725 per bed
+#define SCAN_DRAIN_PERIOD 100ms                                 // Accelerometer FIFO read again within a scan once its last read is this old
+
+MBED_STATIC_ASSERT(SCAN_MUX_PROBES <= TCA9548A_CHANNELS, "mux-probes can not exceed the TCA9548A channels");
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// I2C readings of one bed in a scan
+typedef struct {
+    uint8_t valid;                                               // MSG_VALID_ACCEL / TEMPERATURE / HUMIDITY / COLOUR of the reads that succeeded
+    float ax, ay, az;                                            // Only in probe 0, the accelerometer is on the board
+    float temperature, humidity;
+    uint16_t clear, red, green, blue;
+} scan_result_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void scan_init(bool warm_boot);                                  // Build the probe table; on a warm boot probes that kept their configuration are not initialized again
+std::chrono::milliseconds scan_power_on();                       // Power on the TCS34725 still to configure, returns the wait before scan_run() can configure them
+void scan_run(scan_result_t results[SCAN_PROBE_IDS]);            // Read every probe, one mux switch per channel, the accelerometer first, last and every SCAN_DRAIN_PERIOD; probes not answering are initialized again at the next scan
+void scan_record();                                              // Drain the accelerometer FIFO into the black box, without a full scan
+bool scan_all_ready();                                           // Every probe configured and answering
+void scan_print_health();                                        // Health counters of every probe, mux switches and scan time
+// PROTOTYPES END ===============================================================================
+
+#endif
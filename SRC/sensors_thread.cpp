@@ -3,31 +3,48 @@
 // LIBRARIES ------------------------------------------------------------------------------------
 #include "mbed.h"
 #include "sensors_thread.h"
+#include "scan.h"
 #include "mma8451.h"
-#include "si7021.h"
 #include "tcs34725.h"
 #include "soilmoisture.h"
 #include "phototrans.h"
+#include "calib.h"
 #include "message_q.h"
+#include "alarms.h"
+#include "anomaly.h"
+#include "timebase.h"
+#include "blackbox.h"
+#include "adaptive.h"
+#include "float_only.h"
 
 // EXTERN VARIABLES --------------------------------------------------------------------
-extern bool TEST_MODE_SAMPLING_FLAG;
-extern bool NORMAL_MODE_SAMPLING_FLAG;
+extern volatile bool TEST_MODE_SAMPLING_FLAG;
+extern volatile bool NORMAL_MODE_SAMPLING_FLAG;
 
 //STATIC VARIABLES -----------------------------------------------------------------------------
-static float ax, ay, az;                                     // Variables to store the accelerations
-static float moistPercAnalogValue;                           // Variable to store the normalized analog value of the sensor (0 - 1)
-static float lightPercAnalogValue;
-static uint16_t clear, red, green, blue;
-static float temperature;
-static float humidity;
+static float moistPercAnalogValue;                           // Calibrated soil volumetric water content (%)
+static float lightPercAnalogValue;                           // Calibrated light (% of 100 klx)
+static scan_result_t scan_results[SCAN_PROBE_IDS];           // I2C readings of every bed (static, the thread stack is small)
+static message_t_sensors sample;                             // Packed sample sent to the main thread
+static uint64_t acquisition_tick_us;                         // Monotonic tick at the start of the acquisition
+static uint64_t next_sample_us = 0;                          // Tick of the next sample, the accelerometer FIFO is drained until then
+
+// Steps of the task
+typedef enum {
+    SENSORS_STATE_SETUP,                                     // Probe table and interrupts, once
+    SENSORS_STATE_LIGHT,                                     // White LED on, then wait for the colour integration
+    SENSORS_STATE_ACQUIRE                                    // Read every probe and send the samples
+} sensors_state_t;
+static sensors_state_t state = SENSORS_STATE_SETUP;
+
+static bool warm_boot = false;                               // Set by the main thread before starting this one
+static volatile bool sensors_configured = false;             // I2C sensors configured (by this boot or the previous one)
 
 // ISR FLAGS ------------------------------------------------------------------------------------
 volatile bool tap_detected = false;                          // Flag to indicate tap event
 volatile bool freefall_detected = false;                     // Flag to indicate freefall event
 
 // CONSTRUCTORS ---------------------------------------------------------------------------------
-I2C i2c(SDA_PIN, SCL_PIN);                                   // I2C communication
 static DigitalOut whiteLED(LED_PIN);                         // DigitalOut for builtin white LED control
 static AnalogIn moistureIn(MOISTURE_PIN);                    // Analog pin corresponding to Arduino's A0
 static AnalogIn lightIn(PHTRANS_PIN);                        // Analog pin corresponding to Arduino's A2
@@ -40,64 +57,121 @@ static InterruptIn int2_pin(INT_PIN_FF);                     // Interruption for
 // ISR to detect taps/pulses
 static void tap_ISR() {
     tap_detected = true;
+    blackbox_trigger_from_isr(BLACKBOX_EVENT_TAP);
 }
 
 // ISR to detect freefalls
 static void freefall_ISR(){
     freefall_detected = true;
+    blackbox_trigger_from_isr(BLACKBOX_EVENT_FREEFALL);
 }
 // MMA8451Q ISRs END ============================================================================
 
+// Wait until the next sample, cut to BLACKBOX_DRAIN_PERIOD so the accelerometer FIFO never overflows
+static std::chrono::milliseconds drain_wait(uint64_t remaining_us){
+    if(remaining_us >= (uint64_t)std::chrono::microseconds(BLACKBOX_DRAIN_PERIOD).count()){
+        return BLACKBOX_DRAIN_PERIOD;
+    }
+    return std::chrono::milliseconds((remaining_us + 999) / 1000);  // Rounded up, so the task is not woken just before the sample is due
+}
+
 // ==============================================================================================
 // SENSORS MAIN FUNCTION
 // ==============================================================================================
-void sensor_th_routine(){
-    // THREAD SETUP -----------------------------------------------------------------------------
-    // Accelerometer MMA8451 initialization
-    init_mma8451_pulse_ff();
-    // ATTACH BOTH INTERRUPTIONS ---------------------------------------------------------------------------
-    int1_pin.fall(&tap_ISR);
-    int2_pin.fall(&freefall_ISR);
-    // Colour sensor TCS34725 initialization
-    tcs34725_init();                                         // Initialize the TCS34725 sensor
-    // THREAD SETUP END -------------------------------------------------------------------------
-
-    // THREAD LOOP ------------------------------------------------------------------------------
-    while(true){                                             // While true so it does update as expected
-        // Accelometer MMA8451 measurements -----------------------------------------------------
-        read_accelerations(&ax, &ay, &az);                   // Read the acceleration values for each axis
-        
-        // Ambient sensor Si7021 measurements ---------------------------------------------------
-        humidity = read_humidity();
-        temperature = read_temperature();
-
-        // Soil moisture measurements -----------------------------------------------------------
-        moistPercAnalogValue = moistureIn.read() * 100;      // Read the normalized analog value of soil moisture
-        
-        // Ambient light measurements -----------------------------------------------------------
-        lightPercAnalogValue = lightIn.read() * 100;         // Read the normalized analog value of ambient light
-        
-        // Colour sensor TCS34725 measurements --------------------------------------------------
-        whiteLED = 1;                                        // Turn on the white LED before taking a measurement
-        ThisThread::sleep_for(30ms);                         // Wait for the integration time (24ms) + small extra time for stable readings
-
-        // Read Clear, Red, Green, and Blue channels
-        clear = read_channel(TCS34725_CDATAL);
-        red   = read_channel(TCS34725_RDATAL);
-        green = read_channel(TCS34725_GDATAL);
-        blue  = read_channel(TCS34725_BDATAL);
-
-        whiteLED = 0;                                        // Turn off the white LED after the measurement
-
-        //sending message to the main thread
-        send_sensors_message_through_main_thread(ax, ay, az, moistPercAnalogValue, lightPercAnalogValue, clear, red, green, blue, temperature, humidity);
-
-        if(TEST_MODE_SAMPLING_FLAG){
-            ThisThread::sleep_for(TEST_MODE_SENSOR_THREAD_SLEEP);        // Wait 2 seconds until the next measurement if in TEST_MODE
-        }else if(NORMAL_MODE_SAMPLING_FLAG){
-            ThisThread::sleep_for(NORMAL_MODE_SENSOR_THREAD_SLEEP);      // Wait 10 seconds until the next measurement if in NORMAL_MODE
+// Run by its own thread or by the cooperative executor (see executor.h), so it never blocks: each wait is returned instead
+std::chrono::milliseconds sensors_step(uint32_t woken){
+    switch(state){
+        // TASK SETUP -------------------------------------------------------------------------------
+        case SENSORS_STATE_SETUP:
+            // On a warm boot the sensors kept power and configuration, only check it and release the latched freefall
+            scan_init(warm_boot);
+            // ATTACH BOTH INTERRUPTIONS ---------------------------------------------------------------------------
+            int1_pin.fall(&tap_ISR);
+            int2_pin.fall(&freefall_ISR);
+            state = SENSORS_STATE_LIGHT;
+            return 0ms;
+        // TASK SETUP END ---------------------------------------------------------------------------
+
+        case SENSORS_STATE_LIGHT: {
+            uint64_t now_us = timebase_now_us();
+            if(!woken && now_us < next_sample_us){
+                scan_record();                               // Between samples only the accelerometer FIFO is read, into the black box
+                return drain_wait(next_sample_us - now_us);
+            }
+            acquisition_tick_us = now_us;                    // Stamp the sample when the acquisition starts
+            whiteLED = 1;                                    // Turn on the white LED before taking a measurement
+            std::chrono::milliseconds power_on = scan_power_on();  // TCS34725 to configure: powered on now, configured by the scan once warm
+            state = SENSORS_STATE_ACQUIRE;
+            return (power_on > SENSORS_LED_SETTLE_TIME) ? power_on : std::chrono::milliseconds(SENSORS_LED_SETTLE_TIME);  // Wait for the integration time for stable readings
         }
+
+        case SENSORS_STATE_ACQUIRE:
+        default:
+            break;
+    }
+
+    // ACQUISITION ------------------------------------------------------------------------------
+    std::chrono::microseconds lit(timebase_now_us() - acquisition_tick_us);
+    if(lit < SENSORS_LED_SETTLE_TIME){
+        return std::chrono::duration_cast<std::chrono::milliseconds>(SENSORS_LED_SETTLE_TIME - lit) + 1ms;  // Woken up early, the colour is not integrated yet
     }
-    // THREAD LOOP END --------------------------------------------------------------------------
+
+    // I2C probes (accelerometer, Si7021 and TCS34725 of every bed) -------------------------
+    scan_run(scan_results);                              // Probes not configured yet (or that stopped answering) are initialized until they answer
+    whiteLED = 0;                                        // Turn off the white LED after the measurement
+    sensors_configured = scan_all_ready();
+
+    // Soil moisture measurements -----------------------------------------------------------
+    moistPercAnalogValue = centi_to_float(calib_apply(CALIB_CH_MOISTURE, moistureIn.read_u16() >> 4));  // 12-bit counts through the probe curve
+    
+    // Ambient light measurements -----------------------------------------------------------
+    lightPercAnalogValue = centi_to_float(calib_apply(CALIB_CH_LIGHT, lightIn.read_u16() >> 4));
+
+    // One message per bed: probe 0 also carries the board channels and is the one watched by alarms and anomalies
+    for(uint8_t id = 0; id < SCAN_PROBE_IDS; id++){
+        const scan_result_t *r = &scan_results[id];
+        uint8_t valid = r->valid | ((id == 0) ? (MSG_VALID_MOISTURE | MSG_VALID_LIGHT) : 0);  // Analog channels cannot fail
+        pack_sensors_message(&sample, acquisition_tick_us, valid, r->ax, r->ay, r->az, moistPercAnalogValue, lightPercAnalogValue, r->clear, r->red, r->green, r->blue, r->temperature, r->humidity);
+        sample.probe_id = id;
+        if(id != 0){
+            send_sensors_message_through_main_thread(&sample);
+            continue;
+        }
+
+        // Alarm rules are evaluated once per sample, on the packed fixed-point values (failed channels keep their alarm state)
+        sample.alarms = alarms_evaluate(&sample);
+        sample.anomalies = anomaly_evaluate(&sample);
+#if ADAPTIVE_ENABLED
+        adaptive_update(&sample);                        // In every mode, so the rates are known when NORMAL_MODE starts
+#endif
+
+        //sending message to the main thread, which reports priority alarms and new anomalies as soon as it takes the sample
+        send_sensors_message_through_main_thread(&sample);
+    }
+    // ACQUISITION END --------------------------------------------------------------------------
+
+    // Wait for the next measurement, a mode change or an on-demand request wakes the task up right away
+    state = SENSORS_STATE_LIGHT;
+    std::chrono::milliseconds period = 0ms;                  // ADVANCED_MODE: back to back, every scan also drains the FIFO
+    if(core_util_atomic_load_bool(&TEST_MODE_SAMPLING_FLAG)){
+        period = TEST_MODE_SENSOR_THREAD_SLEEP;              // Wait 2 seconds until the next measurement if in TEST_MODE
+    }else if(core_util_atomic_load_bool(&NORMAL_MODE_SAMPLING_FLAG)){
+#if ADAPTIVE_ENABLED
+        period = adaptive_period();                          // Stretched while the channels are stable, back to the minimum when they move
+#else
+        period = NORMAL_MODE_SENSOR_THREAD_SLEEP;            // Wait 10 seconds until the next measurement if in NORMAL_MODE
+#endif
+    }
+    next_sample_us = timebase_now_us() + std::chrono::microseconds(period).count();
+    return drain_wait(std::chrono::microseconds(period).count());
 }
-// SENSORS MAIN FUNCTION END ====================================================================
\ No newline at end of file
+// SENSORS MAIN FUNCTION END ====================================================================
+
+// FUNCTIONS FOR THE WARM RESTART ---------------------------------------------------------------
+void sensors_set_warm_boot(bool warm){
+    warm_boot = warm;
+}
+
+bool sensors_are_configured(){
+    return sensors_configured;
+}
\ No newline at end of file
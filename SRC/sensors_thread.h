@@ -11,18 +11,24 @@
 // MACROS
 // ==============================================================================================
 // Thread macros
+#define SENSORS_THREAD_STACK            512                       // Stack of the sensors' thread (threaded build)
 #define TEST_MODE_SENSOR_THREAD_SLEEP   2000ms                    // Sensor measuring every 2 seconds - TEST_MODE
 #define NORMAL_MODE_SENSOR_THREAD_SLEEP 10000ms                   // Sensor measuring every 10 seconds - NORMAL_MODE
+#define SENSORS_LED_SETTLE_TIME         30ms                      // White LED on before the colour read: integration time (24ms) + small extra time
 
-// I2C macros
-#define SDA_PIN PB_9
-#define SCL_PIN PB_8
+// Thread flags that cut the sampling wait short
+#define SENSORS_FLAG_MODE_CHANGE  0x01                            // Sampling period changed, sample now at the new cadence
+#define SENSORS_FLAG_SAMPLE_NOW   0x02                            // On-demand sample request
+#define SENSORS_WAKEUP_FLAGS      (SENSORS_FLAG_MODE_CHANGE | SENSORS_FLAG_SAMPLE_NOW)
+#define SENSORS_SAMPLE_COMMAND    'S'                             // Console: take a sample now (sets SENSORS_FLAG_SAMPLE_NOW)
 // MACROS END ===================================================================================
 
 // ==============================================================================================
 // PROTOTYPES
 // ==============================================================================================
-extern void sensor_th_routine();
+extern std::chrono::milliseconds sensors_step(uint32_t woken);   // One step of the sensors' task (setup, FIFO drain, LED on, acquisition), returns the wait before the next
+extern void sensors_set_warm_boot(bool warm);                     // Call before starting the thread to skip redundant sensor initialization
+extern bool sensors_are_configured();                             // True once the I2C sensors hold their configuration
 // PROTOTYPES END ===============================================================================
 
 #endif
\ No newline at end of file
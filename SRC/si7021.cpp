@@ -2,38 +2,41 @@
 
 // LIBRARIES ---------------------------------------------------------------------------------------------------------------
 #include "mbed.h"
-#include "sensors_thread.h"
+#include "i2c_bus.h"
 #include "si7021.h"
-
-// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
-static float temperature, humidity;
-
-// CONSTRUCTOR -------------------------------------------------------------------------------------------------------------
-extern I2C i2c;
+#include "float_only.h"
 
 // FUNCTION TO READ 16-BIT DATA FROM SENSOR Si7021 =========================================================================
-static uint16_t read_register_si7021(char command) {
+static bool read_register_si7021(i2c_probe_t *probe, char command, uint16_t *value) {
     char data[2];                                           // Data buffer of 16-bit size
-    i2c.write(SI7021_ADDR, &command, 1);                    // Send command to start measurement
-    i2c.read(SI7021_ADDR, data, 2);                         // Read the data after waiting
+    if(!i2c_bus_transfer(probe, &command, 1, data, 2)){     // Send command to start measurement, the sensor holds SCL until the data is ready
+        return false;
+    }
 
-    return (data[0] << 8) | data[1];                        // Combine the two bytes (0 is the value if the reading is not successful)
+    *value = ((uint8_t)data[0] << 8) | (uint8_t)data[1];    // Combine the two bytes
+    return true;
 }
 
 // FUNCTION TO READ %RH (HUMIDITY) =======================================================================================
-float read_humidity(){
-    uint16_t raw_humidity = read_register_si7021(CMD_MEASURE_HUMIDITY);
-    
-    humidity = ((125.0 * raw_humidity) / 65536.0) - 6.0;    // As noted in the datasheet, convert raw humidity to percentage
+bool read_humidity(i2c_probe_t *probe, float *humidity){
+    uint16_t raw_humidity;
+    if(!read_register_si7021(probe, CMD_MEASURE_HUMIDITY, &raw_humidity)){
+        return false;
+    }
+
+    *humidity = raw_humidity * (125.0f / 65536.0f) - 6.0f;  // As noted in the datasheet, convert raw humidity to percentage (constant folded, one float multiply)
 
-    return humidity;   
+    return true;
 }
 
 // FUNCTION TO READ TEMPERATURE AND CONVERT IT TO CELSIUS ================================================================
-float read_temperature(){
-    uint16_t raw_temperature = read_register_si7021(CMD_MEASURE_TEMP);
+bool read_temperature(i2c_probe_t *probe, float *temperature){
+    uint16_t raw_temperature;
+    if(!read_register_si7021(probe, CMD_MEASURE_TEMP, &raw_temperature)){
+        return false;
+    }
 
-    temperature = ((175.72 * raw_temperature) / 65536.0) - 46.85;  // As noted in the datasheet, convert raw temperature to Celsius  
+    *temperature = raw_temperature * (175.72f / 65536.0f) - 46.85f; // As noted in the datasheet, convert raw temperature to Celsius
 
-    return temperature;                               
+    return true;
 }
\ No newline at end of file
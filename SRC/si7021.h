@@ -2,6 +2,7 @@
 
 // LIBRARIES ------------------------------------------------------------------------------------
 #include "mbed.h"
+#include "i2c_bus.h"
 
 // LIBRARY GUARD --------------------------------------------------------------------------------
 #ifndef SI7021_H
@@ -13,8 +14,8 @@
 #define CMD_MEASURE_TEMP 0xE3                               // Si7021 Command: Measure Temperature, Hold Master Mode
 
 // PROTOTYPES ===================================================================================
-float read_humidity();
-float read_temperature();
+bool read_humidity(i2c_probe_t *probe, float *humidity);    // False if the sensor did not answer within its I2C budget
+bool read_temperature(i2c_probe_t *probe, float *temperature);
 // PROTOTYPES END ===============================================================================
 
 #endif
\ No newline at end of file
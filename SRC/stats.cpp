@@ -0,0 +1,165 @@
+/* File for the NORMAL_MODE stats function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "stats.h"
+#include "alarms.h"
+#include "mma8451.h"
+#include "scan.h"
+#include "message_q.h"
+#include "track.h"
+#include "executor.h"
+#include "uplink.h"
+#include "adaptive.h"
+#include "float_only.h"
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+// FOR ALL VARIABLES, THE INITIALIZATIONS IN stats_reset() HAVE BEEN DONE LIKE THIS TO WORK WITH 'fminf()' and 'fmaxf()' FUNCTIONS
+static stats_t stats = {
+    100.0f, 0.0f, 0.0f,
+    100.0f, -100.0f, 0.0f,
+    100.0f, 0.0f, 0.0f,
+    100.0f, 0.0f, 0.0f,
+    100.0f, -100.0f,
+    100.0f, -100.0f,
+    100.0f, -100.0f,
+    0,
+    0, 0,
+    {0},
+    0, 0
+};
+
+// FUNCTION TO RESET STATS VARIABLES ===============================================================================================
+void stats_reset(){
+    // Reset stats for next period - Si7021
+    stats.humidity_min = 100.0f; stats.humidity_max = 0.0f; stats.humidity_sum = 0.0f;
+    stats.temperature_min = 100.0f; stats.temperature_max = -100.0f; stats.temperature_sum = 0.0f;
+
+    // Reset stats for next period - Analogic sensors
+    stats.moist_min = 100.0f; stats.moist_max = 0.0f; stats.moist_sum = 0.0f;
+    stats.light_min = 100.0f; stats.light_max = 0.0f; stats.light_sum = 0.0f;
+
+    // Reset stats for next period - MMA8451Q
+    stats.ax_min = 100.0f; stats.ax_max = -100.0f;               // Reset acceleration min/max values
+    stats.ay_min = 100.0f; stats.ay_max = -100.0f;
+    stats.az_min = 100.0f; stats.az_max = -100.0f;
+
+    // Reset counters for next period
+    stats.sample_count = 0;
+    stats.humidity_count = 0; stats.temperature_count = 0;       // Reset Si7021 counters
+    memset(stats.colour_class_count, 0, sizeof(stats.colour_class_count));  // Reset colour class counters
+    stats.accel_count = 0; stats.colour_count = 0;
+}
+
+// FUNCTION TO ADD A SAMPLE TO THE STATS ===========================================================================================
+void stats_update(uint8_t valid, float humidity, float temperature, float moistPercAnalogValue, float lightPercAnalogValue, float ax, float ay, float az, colour_class_t colour){
+    // Channels whose read failed (MSG_VALID_* bit cleared) hold stale values and are skipped
+
+    // Update humidity stats if within valid range
+    if((valid & MSG_VALID_HUMIDITY) && alarms_in_range(ALARM_CH_HUMIDITY, float_to_centi(humidity))) {
+        stats.humidity_sum += humidity;
+        stats.humidity_min = fminf(stats.humidity_min, humidity); // Function that returns the smaller of two floating-point numbers
+        stats.humidity_max = fmaxf(stats.humidity_max, humidity); // Function that returns the larger of two floating-point numbers.
+        stats.humidity_count++;
+    }
+
+    // Update temperature stats if within valid range
+    if((valid & MSG_VALID_TEMPERATURE) && alarms_in_range(ALARM_CH_TEMPERATURE, float_to_centi(temperature))) {
+        stats.temperature_sum += temperature;
+        stats.temperature_min = fminf(stats.temperature_min, temperature);
+        stats.temperature_max = fmaxf(stats.temperature_max, temperature);
+        stats.temperature_count++;
+    }
+
+    // Always update soil moisture and ambient light stats
+    stats.moist_sum += moistPercAnalogValue;
+    stats.moist_min = fminf(stats.moist_min, moistPercAnalogValue);
+    stats.moist_max = fmaxf(stats.moist_max, moistPercAnalogValue);
+    stats.light_sum += lightPercAnalogValue;
+    stats.light_min = fminf(stats.light_min, lightPercAnalogValue);
+    stats.light_max = fmaxf(stats.light_max, lightPercAnalogValue);
+
+    // Update min and max acceleration for each axis
+    if(valid & MSG_VALID_ACCEL){
+        stats.ax_min = fminf(stats.ax_min, ax);
+        stats.ax_max = fmaxf(stats.ax_max, ax);
+        stats.ay_min = fminf(stats.ay_min, ay);
+        stats.ay_max = fmaxf(stats.ay_max, ay);
+        stats.az_min = fminf(stats.az_min, az);
+        stats.az_max = fmaxf(stats.az_max, az);
+        stats.accel_count++;
+    }
+
+    stats.sample_count++;
+
+    // Count the leaf colour class (already classified by the caller)
+    if(valid & MSG_VALID_COLOUR){
+        stats.colour_class_count[colour]++;
+        stats.colour_count++;
+    }
+}
+
+// FUNCTION TO CALCULATE STATS FOR Si7021 AND ANALOGIC SENSORS =====================================================================
+FLOAT_ONLY_OUTPUT_BEGIN
+void stats_print(){
+    printf("--------------------------------\n\r");
+    printf("ONE HOUR STATS:\n\r");
+    printf("--------------------------------\n\r");
+    // Only print Si7021 relative humidity stats if we have valid samples
+    if(stats.humidity_count > 0){
+        printf("RHmin = %.1f %%, RHmax = %.1f %%, RHavg = %.1f %%\n\r", stats.humidity_min, stats.humidity_max, stats.humidity_sum / stats.humidity_count);
+    }else{
+        printf("No valid data for relative humidity\n\r");
+    }
+
+    // Only print Si7021 temperature stats if we have valid samples
+    if(stats.temperature_count > 0){
+        printf("Tmin = %.1f celsius, Tmax = %.1f celsius, Tavg = %.1f celsius\n\r", stats.temperature_min, stats.temperature_max, stats.temperature_sum / stats.temperature_count);
+    }else{
+        printf("No valid data for temperature\n\r");
+    }
+
+    printf("SMmin = %.1f %%, SMmax = %.1f %%, SMavg = %.1f %%\n\r", stats.moist_min, stats.moist_max, stats.moist_sum / stats.sample_count);
+    printf("ALmin = %.1f %%, ALmax = %.1f %%, ALavg = %.1f %%\n\r", stats.light_min, stats.light_max, stats.light_sum / stats.sample_count);
+
+    // Print min and max acceleration for each axis
+    if(stats.accel_count > 0){
+        printf("axmin = %.2f m/s2, axmax = %.2f m/s2\n\r", stats.ax_min * G_TO_MS2, stats.ax_max * G_TO_MS2);
+        printf("aymin = %.2f m/s2, aymax = %.2f m/s2\n\r", stats.ay_min * G_TO_MS2, stats.ay_max * G_TO_MS2);
+        printf("azmin = %.2f m/s2, azmax = %.2f m/s2\n\r", stats.az_min * G_TO_MS2, stats.az_max * G_TO_MS2);
+    }else{
+        printf("No valid data for acceleration\n\r");
+    }
+
+    // Print how many samples fell in each leaf colour class
+    if(stats.colour_count == 0){
+        printf("No valid data for color\n\r");
+    }else{
+        printf("Leaf colour:");
+        for(uint8_t c = 0; c < COLOUR_CLASS_COUNT; c++){
+            printf("%s %s %u", (c == 0) ? "" : ",", colour_class_name((colour_class_t)c), stats.colour_class_count[c]);
+        }
+        printf(" (of %u)\n\r", stats.colour_count);
+    }
+
+    scan_print_health();                                         // Cumulative since boot, not reset with the stats
+    printf("Queue drops: %lu sensors, %lu GPS\n\r", (unsigned long)sensors_messages_dropped(), (unsigned long)GPS_messages_dropped());
+    track_print_stats();
+    executor_print_stats();
+    uplink_print_stats();
+#if ADAPTIVE_ENABLED
+    adaptive_print_stats();
+#endif
+
+    stats_reset();
+}
+FLOAT_ONLY_OUTPUT_END
+
+// FUNCTIONS TO SAVE AND RESTORE THE ACCUMULATORS (warm restart) ===================================================================
+void stats_snapshot(stats_t *snapshot){
+    *snapshot = stats;
+}
+
+void stats_restore(const stats_t *snapshot){
+    stats = *snapshot;
+}
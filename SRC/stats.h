@@ -0,0 +1,40 @@
+/* File for the NORMAL_MODE stats function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "colour_class.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef STATS_H
+#define STATS_H
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+// Stats accumulators, kept in a struct so they can be snapshotted to flash at shutdown
+typedef struct {
+    float humidity_min, humidity_max, humidity_sum;              // Stats of Si7021 %RH
+    float temperature_min, temperature_max, temperature_sum;     // Stats of Si7021 T
+    float moist_min, moist_max, moist_sum;                       // Stats of soil moisture sensor
+    float light_min, light_max, light_sum;                       // Stats of phototransistor
+    float ax_min, ax_max;                                        // Stats of x-axis
+    float ay_min, ay_max;                                        // Stats of y-axis
+    float az_min, az_max;                                        // Stats of z-axis
+    uint8_t sample_count;                                        // Counter to computate stats after the performed amount of measurements
+    uint8_t humidity_count, temperature_count;                   // Valid temperature and relative humidity samples count
+    uint8_t colour_class_count[COLOUR_CLASS_COUNT];              // Samples of each leaf colour class
+    uint8_t accel_count, colour_count;                           // Samples with a valid accelerometer and colour read
+} stats_t;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void stats_reset();
+void stats_update(uint8_t valid, float humidity, float temperature, float moistPercAnalogValue, float lightPercAnalogValue, float ax, float ay, float az, colour_class_t colour);
+void stats_print();                                              // REMEMBER THIS FUNCTION IS TO CALCULATE STATS FOR THE REQUIRED SENSORS, NOT ALL OF THEM
+void stats_snapshot(stats_t *snapshot);
+void stats_restore(const stats_t *snapshot);
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,38 @@
+/* File for the I2C multiplexer TCA9548A function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "tca9548a.h"
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+static i2c_probe_t mux = {I2C_DEV_TCA9548A, TCA9548A_ADDRESS, I2C_MUX_NONE, 0, false, {}};
+static uint8_t selected = TCA9548A_UNKNOWN;                     // Cached control register, the mux keeps it until written or reset
+static uint32_t switches = 0;
+
+// FUNCTION TO SELECT A DOWNSTREAM CHANNEL =================================================================================
+bool tca9548a_select(uint8_t channel){
+    if(channel == selected){
+        return true;                                            // Probes are scanned grouped by channel, so this is the common case
+    }
+
+    char control = (char)(1 << channel);                        // One bit per channel, a single channel enabled at a time
+    if(!i2c_bus_transfer(&mux, &control, 1, nullptr, 0)){
+        selected = TCA9548A_UNKNOWN;
+        return false;
+    }
+
+    mux.ready = true;
+    selected = channel;
+    switches++;
+    return true;
+}
+
+// FUNCTION TO GET THE NUMBER OF CHANNEL CHANGES ===========================================================================
+uint32_t tca9548a_switches(){
+    return switches;
+}
+
+// FUNCTION TO GET THE MUX PROBE ===========================================================================================
+i2c_probe_t *tca9548a_probe(){
+    return &mux;
+}
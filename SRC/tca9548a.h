@@ -0,0 +1,22 @@
+/* File for the I2C multiplexer TCA9548A function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "i2c_bus.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef TCA9548A_H
+#define TCA9548A_H
+
+// MACROS ---------------------------------------------------------------------------------------
+#define TCA9548A_ADDRESS (0x70 << 1)                                        // A2..A0 tied low, 7-bit address shifted
+#define TCA9548A_CHANNELS 8
+#define TCA9548A_UNKNOWN 0xFE                                               // Selection not known (boot or failed write), forces the next write
+
+// PROTOTYPES ===================================================================================
+bool tca9548a_select(uint8_t channel);                                      // Connect only this downstream channel, skipped if it is already the selected one
+uint32_t tca9548a_switches();                                               // Channel changes since boot
+i2c_probe_t *tca9548a_probe();                                              // The mux itself, for its health counters
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -2,34 +2,57 @@
 
 // LIBRARIES ---------------------------------------------------------------------------------------------------------------
 #include "mbed.h"
-#include "sensors_thread.h"
+#include "i2c_bus.h"
 #include "tcs34725.h"
-
-// CONSTRUCTORS ---------------------------------------------------------------------------------------------------------
-extern I2C i2c;                                                             // I2C communication
+#include "float_only.h"
 
 // FUNCTION TO WRITE TO A REGISTER ==============================================================
-static void write_register(uint8_t reg, uint8_t value){
+static bool write_register(i2c_probe_t *probe, uint8_t reg, uint8_t value){
     char data[2] = {static_cast<char>(TCS34725_COMMAND_BIT | reg), static_cast<char>(value)};  // Command to write to the specific register, which is achieved by combining bit by bit TCS34725_COMMAND_BIT and 'reg' using the bitwise OR (|) operator
-    i2c.write(TCS34725_ADDRESS, data, 2);
+    return i2c_bus_transfer(probe, data, 2, nullptr, 0);
+}
+
+// FUNCTION TO READ AN 8-BIT REGISTER ===========================================================
+static bool read_register(i2c_probe_t *probe, uint8_t reg, uint8_t *value){
+    char cmd = TCS34725_COMMAND_BIT | reg;
+    return i2c_bus_transfer(probe, &cmd, 1, (char *)value, 1);
 }
 
-// FUNCTION TO INITIALIZE THE TCS34725 ==========================================================
-void tcs34725_init(){
-    write_register(TCS34725_ENABLE, TCS34725_ATIME);                        // Power on the device
-    ThisThread::sleep_for(3ms);                                             // Wait 3ms for power ON
+// FUNCTION TO POWER ON THE TCS34725 ============================================================
+bool tcs34725_power_on(i2c_probe_t *probe){
+    return write_register(probe, TCS34725_ENABLE, TCS34725_ATIME);          // Power on the device, the ADC may only be enabled TCS34725_POWER_ON_TIME later
+}
 
-    write_register(TCS34725_ENABLE, TCS34725_ATIME | TCS34725_ENABLE_AEN);  // Enable the RGBC ADC
+// FUNCTION TO INITIALIZE THE TCS34725 (powered on by tcs34725_power_on()) ======================
+bool tcs34725_init(i2c_probe_t *probe){
+    return write_register(probe, TCS34725_ENABLE, TCS34725_ATIME | TCS34725_ENABLE_AEN) // Enable the RGBC ADC
+        && write_register(probe, TCS34725_ATIME, 0xF6)                      // Integration time: 24ms (for good accuracy) - 2.4 x (256 - ATIME), where 0xF6 is 246
+        && write_register(probe, TCS34725_AGAIN, 0x01);                     // Gain control: 4x - BOTH INTEGRATION TIME AND GAIN ARE SET FOR BRIGHT AMBIENT LIGHT CONDITIONS
+}
 
-    write_register(TCS34725_ATIME, 0xF6);                                   // Integration time: 24ms (for good accuracy) - 2.4 x (256 - ATIME), where 0xF6 is 246
-    write_register(TCS34725_AGAIN, 0x01);                                   // Gain control: 4x - BOTH INTEGRATION TIME AND GAIN ARE SET FOR BRIGHT AMBIENT LIGHT CONDITIONS
+// FUNCTION TO CHECK THAT THE CONFIGURATION OF tcs34725_init() IS STILL IN PLACE (warm boot) ====
+bool tcs34725_is_configured(i2c_probe_t *probe){
+    uint8_t enable, atime, again;
+    return read_register(probe, TCS34725_ENABLE, &enable)
+        && read_register(probe, TCS34725_ATIME, &atime)
+        && read_register(probe, TCS34725_AGAIN, &again)
+        && enable == (TCS34725_ATIME | TCS34725_ENABLE_AEN)
+        && atime == 0xF6
+        && again == 0x01;
 }
 
-// FUNCTION TO READ FROM A 16-BIT REGISTER ======================================================
-uint16_t read_channel(uint8_t reg){
-    char data[2];                                                           // Command to be read, 16-bit size
-    char cmd = TCS34725_COMMAND_BIT | reg;                                  // Command to be written (which will be values of the measurements)
-    i2c.write(TCS34725_ADDRESS, &cmd, 1);                                   // Write the command
-    i2c.read(TCS34725_ADDRESS, data, 2);                                    // Read two bytes
-    return (data[1] << 8) | data[0];                                        // Combine into 16-bit value
+// FUNCTION TO READ THE FOUR 16-BIT CHANNELS ====================================================
+bool tcs34725_read_rgbc(i2c_probe_t *probe, uint16_t *clear, uint16_t *red, uint16_t *green, uint16_t *blue){
+    char data[8];                                                           // CDATAL, CDATAH, RDATAL ... BDATAH
+    char cmd = TCS34725_COMMAND_BIT | TCS34725_COMMAND_AUTO_INC | TCS34725_CDATAL;  // Auto-increment, so the burst walks the eight data registers
+    if(!i2c_bus_transfer(probe, &cmd, 1, data, 8)){
+        return false;                                                       // The outputs are left untouched
+    }
+
+    // Combine each low/high pair into a 16-bit value (reading CDATAL latches the other channels, so all four are coherent)
+    *clear = ((uint8_t)data[1] << 8) | (uint8_t)data[0];
+    *red   = ((uint8_t)data[3] << 8) | (uint8_t)data[2];
+    *green = ((uint8_t)data[5] << 8) | (uint8_t)data[4];
+    *blue  = ((uint8_t)data[7] << 8) | (uint8_t)data[6];
+    return true;
 }
@@ -2,15 +2,17 @@
 
 // LIBRARIES ------------------------------------------------------------------------------------
 #include "mbed.h"
+#include "i2c_bus.h"
 
 // LIBRARY GUARD --------------------------------------------------------------------------------
 #ifndef TCS34725_H
-#define TCS34735_H
+#define TCS34725_H
 
 // MACROS ---------------------------------------------------------------------------------------
 #define LED_PIN PH_1                                                        // White LED connected to PA_5 (adjust if necessary)
 #define TCS34725_ADDRESS (0x29 << 1)                                        // 7-bit I2C address shifted
 #define TCS34725_COMMAND_BIT 0x80                                           // Indicate that the following byte will be a command
+#define TCS34725_COMMAND_AUTO_INC 0x20                                      // Command type: auto-increment the register address on every byte
 #define TCS34725_ENABLE 0x00                                                // Enables states and interrupts
 #define TCS34725_ATIME 0x01                                                 // RGBC time 
 #define TCS34725_ENABLE_AEN 0x02                                            // ADC enable
@@ -19,10 +21,14 @@
 #define TCS34725_RDATAL 0x16                                                // Red data low byte
 #define TCS34725_GDATAL 0x18                                                // Green data low byte
 #define TCS34725_BDATAL 0x1A                                                // Blue data low byte
+#define TCS34725_POWER_ON_TIME 3ms                                          // Oscillator warm-up after power on (2.4 ms), before the ADC is enabled
 
 // PROTOTYPES ===================================================================================
-void tcs34725_init();
-uint16_t read_channel(uint8_t reg);
+// Every function returns false if the sensor did not answer within its I2C budget
+bool tcs34725_power_on(i2c_probe_t *probe);                                 // First step of the configuration, the caller waits TCS34725_POWER_ON_TIME (it does not block)
+bool tcs34725_init(i2c_probe_t *probe);                                     // Rest of the configuration, TCS34725_POWER_ON_TIME after tcs34725_power_on()
+bool tcs34725_read_rgbc(i2c_probe_t *probe, uint16_t *clear, uint16_t *red, uint16_t *green, uint16_t *blue);
+bool tcs34725_is_configured(i2c_probe_t *probe);
 // PROTOTYPES END ===============================================================================
 
 #endif
\ No newline at end of file
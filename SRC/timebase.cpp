@@ -0,0 +1,117 @@
+/* File for the monotonic timebase and sensor/GPS join function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "timebase.h"
+
+// MACROS ------------------------------------------------------------------------------------------------------------------
+#define US_PER_DAY ((int64_t)MS_PER_DAY * 1000)
+
+// STATIC VARIABLES --------------------------------------------------------------------------------------------------------
+// Timebase (only updated from the main thread)
+static int64_t utc_offset_us = 0;                               // UTC microseconds of the day = (tick + offset) mod US_PER_DAY
+static bool utc_offset_valid = false;
+
+// Join stage
+static message_t_gps fix_history[JOIN_FIX_HISTORY];             // Ring of the last fixes
+static uint8_t fix_history_next = 0, fix_history_count = 0;
+
+// FUNCTION TO WRAP A VALUE INTO [0, US_PER_DAY) ===========================================================================
+static int64_t wrap_day(int64_t us){
+    us %= US_PER_DAY;
+    return (us < 0) ? us + US_PER_DAY : us;
+}
+
+// FUNCTION TO GET THE MONOTONIC TICK ======================================================================================
+uint64_t timebase_now_us(){
+    return HighResClock::now().time_since_epoch().count();      // 64-bit microseconds since boot, never wraps in practice
+}
+
+// FUNCTION TO DISCIPLINE THE OFFSET WITH A GPS FIX ========================================================================
+void timebase_update_from_gps(const message_t_gps *fix){
+    if(fix->fix_status == 0 || fix->fix_status > 2){
+        return;                                                 // Time of a fix-less sentence is not trusted
+    }
+
+    int64_t fix_utc_us = ((int64_t)(fix->gps_hour * 60 + fix->gps_minute) * 60000 + fix->gps_millis) * 1000;
+    int64_t measured = wrap_day(fix_utc_us - (int64_t)fix->tick_us);
+
+    // Error between the new measurement and the current offset, folded into [-half day, half day) to survive midnight
+    int64_t error = wrap_day(measured - utc_offset_us + US_PER_DAY / 2) - US_PER_DAY / 2;
+
+    if(!utc_offset_valid || error > TIMEBASE_STEP_THRESHOLD_US || error < -TIMEBASE_STEP_THRESHOLD_US){
+        utc_offset_us = measured;                               // First fix or large jump: step
+        utc_offset_valid = true;
+    }else{
+        utc_offset_us = wrap_day(utc_offset_us + error / (1 << TIMEBASE_SLEW_SHIFT));  // Small error: slew to filter NMEA output jitter
+    }
+}
+
+// FUNCTION TO MAP A TICK TO UTC ===========================================================================================
+bool timebase_tick_to_utc(uint64_t tick_us, uint32_t *utc_ms){
+    if(!utc_offset_valid){
+        return false;
+    }
+
+    *utc_ms = (uint32_t)(wrap_day((int64_t)tick_us + utc_offset_us) / 1000);
+    return true;
+}
+
+// FUNCTION TO SPLIT UTC MILLISECONDS OF THE DAY INTO LOCAL TIME ===========================================================
+void timebase_split_local(uint32_t utc_ms, uint8_t *hour, uint8_t *minute, uint16_t *millis){
+    uint32_t local_ms = (utc_ms + MS_PER_DAY + LOCAL_TIME_OFFSET_MINUTES * 60000L) % MS_PER_DAY;
+
+    *hour = local_ms / 3600000;
+    *minute = (local_ms / 60000) % 60;
+    *millis = local_ms % 60000;
+}
+
+// FUNCTION TO KEEP A FIX FOR THE JOIN STAGE ===============================================================================
+void join_push_fix(const message_t_gps *fix){
+    fix_history[fix_history_next] = *fix;
+    fix_history_next = (fix_history_next + 1) % JOIN_FIX_HISTORY;
+    if(fix_history_count < JOIN_FIX_HISTORY){
+        fix_history_count++;
+    }
+}
+
+// FUNCTION TO KEEP A FIX IF IT IS THE NEAREST TO THE SAMPLE SO FAR =======================================================
+static void consider_fix(const message_t_gps *fix, const message_t_sensors *sample, int64_t *best_skew_us, record_t_joined *record){
+    int64_t skew_us = (int64_t)fix->tick_us - (int64_t)sample->tick_us;
+    if(llabs(skew_us) < llabs(*best_skew_us)){
+        *best_skew_us = skew_us;
+        record->fix = *fix;
+    }
+}
+
+// FUNCTION TO BUILD A TIME-ALIGNED SENSOR + POSITION RECORD ===============================================================
+void join_sensor_sample(const message_t_sensors *sample, record_t_joined *record){
+    record->sensors = *sample;
+    record->flags = 0;
+    record->skew_ms = 0;
+    memset(&record->fix, 0, sizeof(record->fix));
+
+    if(timebase_tick_to_utc(sample->tick_us, &record->utc_ms)){
+        record->flags |= RECORD_UTC_VALID;
+    }
+
+    // Nearest fix in time, whether it came before or after the sample
+    int64_t best_skew_us = INT64_MAX;
+    for(uint8_t i = 0; i < fix_history_count; i++){
+        consider_fix(&fix_history[i], sample, &best_skew_us, record);
+    }
+
+    // The queue only carries the points of the simplified track, the newest fix is usually the nearest one
+    message_t_gps latest;
+    bool latest_valid = read_latest_from_GPS(&latest);
+    if(latest_valid){
+        consider_fix(&latest, sample, &best_skew_us, record);
+    }
+
+    if(fix_history_count > 0 || latest_valid){
+        record->skew_ms = (int32_t)(best_skew_us / 1000);
+        if(record->fix.fix_status > 0 && record->fix.fix_status <= 2 && llabs(best_skew_us) <= JOIN_MAX_SKEW_MS * 1000LL){
+            record->flags |= RECORD_POSITION_VALID;
+        }
+    }
+}
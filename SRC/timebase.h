@@ -0,0 +1,53 @@
+/* File for the monotonic timebase and sensor/GPS join function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#define LOCAL_TIME_OFFSET_MINUTES 60                            // Local time shown on the terminal (Spain, UTC+1). Messages always carry UTC
+#define MS_PER_DAY                86400000UL
+
+// GPS discipline of the tick -> UTC offset
+#define TIMEBASE_STEP_THRESHOLD_US 100000                       // Errors above 100 ms step the offset, smaller ones are slewed
+#define TIMEBASE_SLEW_SHIFT        3                            // Slew 1/8 of the error at every fix
+
+// Join stage
+#define JOIN_FIX_HISTORY           4                            // Last GPS fixes kept to pair with sensor samples
+#define JOIN_MAX_SKEW_MS           1500                         // A fix further than this from the sample is not used as its position
+
+// Flags of a joined record
+#define RECORD_UTC_VALID           0x01                         // utc_ms is valid (GPS disciplined offset available)
+#define RECORD_POSITION_VALID      0x02                         // fix holds a valid position within JOIN_MAX_SKEW_MS of the sample
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// TYPES
+// ==============================================================================================
+typedef struct {
+    message_t_sensors sensors;                                   // Sensor sample
+    message_t_gps fix;                                           // Fix nearest in time to the sample
+    uint32_t utc_ms;                                             // UTC milliseconds of the day of the sample
+    int32_t skew_ms;                                             // Fix tick minus sample tick
+    uint8_t flags;                                               // RECORD_* flags
+} record_t_joined;
+// TYPES END ====================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+uint64_t timebase_now_us();                                                     // Monotonic microsecond tick used to stamp every message
+void timebase_update_from_gps(const message_t_gps *fix);                        // Discipline the tick -> UTC offset with a new fix
+bool timebase_tick_to_utc(uint64_t tick_us, uint32_t *utc_ms);                  // Map a tick to UTC milliseconds of the day
+void timebase_split_local(uint32_t utc_ms, uint8_t *hour, uint8_t *minute, uint16_t *millis);  // Split UTC ms of the day into local hh:mm + ms of the minute
+void join_push_fix(const message_t_gps *fix);                                   // Keep a fix for the join stage
+void join_sensor_sample(const message_t_sensors *sample, record_t_joined *record);  // Pair a sample with the nearest fix and its UTC time
+// PROTOTYPES END ===============================================================================
+
+#endif
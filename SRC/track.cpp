@@ -0,0 +1,127 @@
+/* File for the GPS track simplification function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include <math.h>
+#include "track.h"
+#include "float_only.h"
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    int32_t latitude, longitude;                                 // Micro-degrees
+} track_point_t;
+
+// STATIC VARIABLES (only touched by the GPS thread, except the counters read by the stats) --------------------------------
+// Opening window: the segment from the anchor to the newest fix must stay within TRACK_TOLERANCE_M of every fix in between.
+// When it does not, the fix before the newest one is kept and becomes the next anchor.
+static bool tracking = false;                                   // An anchor with a valid fix exists
+static message_t_gps anchor;                                    // Last kept point
+static message_t_gps last;                                      // Newest fix of the window, kept if the next one breaks the tolerance
+static track_point_t window[TRACK_WINDOW];                      // Fixes after the anchor, last included
+static uint8_t window_count = 0;
+static float metres_per_microdeg_lon;                           // Longitude scale at the anchor latitude
+static float window_deviation2 = 0.0f;                          // Largest squared distance of the window to the anchor -> last segment
+
+static volatile uint32_t fixes_in = 0, points_kept = 0;
+static volatile uint32_t max_deviation_cm = 0;                  // Largest distance of a dropped fix to the kept track
+
+// FUNCTION TO CHECK IF A FIX HOLDS A POSITION =============================================================================
+static bool has_position(const message_t_gps *fix){
+    return fix->fix_status > 0 && fix->fix_status <= 2;
+}
+
+// FUNCTION TO KEEP A POINT AND MAKE IT THE NEW ANCHOR =====================================================================
+static void keep(const message_t_gps *point, message_t_gps out[TRACK_MAX_OUTPUT], uint8_t *n){
+    out[(*n)++] = *point;
+    points_kept = points_kept + 1;
+
+    uint32_t deviation_cm = (uint32_t)(sqrtf(window_deviation2) * 100.0f);
+    if(deviation_cm > max_deviation_cm){
+        max_deviation_cm = deviation_cm;
+    }
+
+    anchor = *point;
+    window_count = 0;
+    window_deviation2 = 0.0f;
+    metres_per_microdeg_lon = TRACK_METRES_PER_MICRODEG * cosf(anchor.latitude * 1e-6f * 0.0174533f);
+}
+
+// FUNCTION TO GET THE LARGEST SQUARED DISTANCE OF THE WINDOW TO THE ANCHOR -> END SEGMENT (metres^2) ======================
+static float window_distance2(const message_t_gps *end){
+    // Local plane in metres with the anchor at the origin, good enough over the few hundred metres of a window
+    float ex = (end->longitude - anchor.longitude) * metres_per_microdeg_lon;
+    float ey = (end->latitude - anchor.latitude) * TRACK_METRES_PER_MICRODEG;
+    float length2 = ex * ex + ey * ey;
+
+    float worst = 0.0f;
+    for(uint8_t i = 0; i < window_count; i++){
+        float px = (window[i].longitude - anchor.longitude) * metres_per_microdeg_lon;
+        float py = (window[i].latitude - anchor.latitude) * TRACK_METRES_PER_MICRODEG;
+
+        // Distance to the segment, not the line, so going back and forth is not hidden
+        float t = (length2 > 0.0f) ? (px * ex + py * ey) / length2 : 0.0f;
+        t = (t < 0.0f) ? 0.0f : ((t > 1.0f) ? 1.0f : t);
+        float dx = px - t * ex, dy = py - t * ey;
+        float d2 = dx * dx + dy * dy;
+        worst = (d2 > worst) ? d2 : worst;
+    }
+    return worst;
+}
+
+// FUNCTION TO FEED A FIX ==================================================================================================
+uint8_t track_push(const message_t_gps *fix, message_t_gps out[TRACK_MAX_OUTPUT]){
+    uint8_t n = 0;
+
+    // Fix lost: close the track with its last point and report the loss once
+    if(!has_position(fix)){
+        if(tracking){
+            if(window_count > 0){
+                keep(&last, out, &n);
+            }
+            out[n++] = *fix;
+            tracking = false;
+        }
+        return n;
+    }
+
+    fixes_in = fixes_in + 1;
+    if(!tracking){
+        keep(fix, out, &n);                                     // First fix of a track
+        tracking = true;
+        return n;
+    }
+
+    // Does the segment to this fix still cover the window? A full window is closed the same way
+    if(window_count > 0){
+        float deviation2 = window_distance2(fix);
+        if(deviation2 > (float)TRACK_TOLERANCE_M * TRACK_TOLERANCE_M || window_count == TRACK_WINDOW){
+            keep(&last, out, &n);
+        }else{
+            window_deviation2 = deviation2;
+        }
+    }
+
+    // Geofence events and the heartbeat are kept as they are, so they reach the queue on their own fix
+    if(fix->geofence_events[0] != GEOFENCE_NO_EVENT || fix->tick_us - anchor.tick_us >= TRACK_MAX_INTERVAL_US){
+        keep(fix, out, &n);
+        return n;
+    }
+
+    window[window_count].latitude = fix->latitude;
+    window[window_count].longitude = fix->longitude;
+    window_count++;
+    last = *fix;
+    return n;
+}
+
+// FUNCTION TO PRINT THE COMPRESSION STATS =================================================================================
+FLOAT_ONLY_OUTPUT_BEGIN
+void track_print_stats(){
+    uint32_t in = fixes_in, kept = points_kept;
+    if(kept == 0){
+        printf("GPS track: no fixes yet\n\r");
+        return;
+    }
+    printf("GPS track: %lu fixes, %lu kept (%.1f:1), max deviation %.2f m (tolerance %d m)\n\r", (unsigned long)in, (unsigned long)kept, (float)in / kept, max_deviation_cm / 100.0f, TRACK_TOLERANCE_M);
+}
+FLOAT_ONLY_OUTPUT_END
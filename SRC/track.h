@@ -0,0 +1,34 @@
+/* File for the GPS track simplification function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef TRACK_H
+#define TRACK_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+#ifdef MBED_CONF_APP_TRACK_TOLERANCE_M
+#define TRACK_TOLERANCE_M      MBED_CONF_APP_TRACK_TOLERANCE_M
+#else
+#define TRACK_TOLERANCE_M      5                                // Largest distance between a dropped fix and the simplified track
+#endif
+
+#define TRACK_WINDOW           16                               // Fixes held since the last kept point (bounds memory and the work per fix)
+#define TRACK_MAX_INTERVAL_US  60000000ULL                      // A point is kept at least once a minute, even when stationary
+#define TRACK_MAX_OUTPUT       2                                // Points track_push can release for one fix
+
+#define TRACK_METRES_PER_MICRODEG 0.11132f                      // Metres per micro-degree of latitude (and of longitude at the equator)
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+uint8_t track_push(const message_t_gps *fix, message_t_gps out[TRACK_MAX_OUTPUT]);  // Feed a fix, returns the points to queue (oldest first)
+void track_print_stats();                                                         // Compression ratio and largest deviation since boot
+// PROTOTYPES END ===============================================================================
+
+#endif
@@ -0,0 +1,282 @@
+/* File for the uplink payload batcher function definitions */
+
+// LIBRARIES ---------------------------------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "uplink.h"
+#include "timebase.h"
+
+// TYPES -------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    uint8_t data[UPLINK_PAYLOAD_SIZE];
+    uint8_t length;
+    uint8_t count;                                              // Samples in the payload
+    uint32_t check;                                             // Hash of the last sample, compared by the loopback decoder
+} uplink_payload_t;
+
+// TIME ON AIR (Semtech AN1200.13: explicit header, CRC on, coding rate 4/5) ------------------------------------------------
+static constexpr uint32_t airtime(uint8_t sf, uint16_t frame_bytes){
+    uint32_t symbol_us = (uint32_t)(((uint64_t)1000000 << sf) / UPLINK_BANDWIDTH_HZ);
+    uint8_t low_rate = (sf >= 11) ? 1 : 0;                      // Low data rate optimization, mandatory at 125 kHz from SF11
+    int32_t bits = 8 * frame_bytes - 4 * sf + 28 + 16;
+    int32_t per_block = 4 * (sf - 2 * low_rate);
+    uint32_t payload_symbols = 8 + ((bits > 0) ? (uint32_t)((bits + per_block - 1) / per_block) * 5 : 0);
+    return (4 * UPLINK_PREAMBLE_SYMBOLS + 17 + 4 * payload_symbols) * symbol_us / 4;  // Preamble + 4.25 sync symbols
+}
+
+MBED_STATIC_ASSERT(airtime(7, 51 + UPLINK_FRAME_OVERHEAD) == 118016, "SF7 51-byte frame is 118.0 ms");
+MBED_STATIC_ASSERT(airtime(12, 51 + UPLINK_FRAME_OVERHEAD) == 2793472, "SF12 51-byte frame is 2793.5 ms");
+
+// RESOLUTION SENT FOR EACH FIELD (units of message_t_sensors) --------------------------------------------------------------
+// Below the accuracy of the sensors, so the noise of the last digits does not cost a delta in every sample
+static constexpr uint8_t FIELD_STEP[UPLINK_FIELD_COUNT] = {
+    1, 1, 1, 1,                                                 // Tick, valid, alarms and anomalies as they are
+    10,                                                         // 0.1 celsius (Si7021 accuracy ±0.4)
+    50,                                                         // 0.5 %RH (±3)
+    10, 10,                                                     // 0.1 % of moisture and of light (100 lux)
+    4, 4, 4, 4,                                                 // Colour counts / 4
+    16, 16, 16                                                  // 4 mg
+};
+
+// STATIC VARIABLES (main thread only) -------------------------------------------------------------------------------------
+static uplink_payload_t filling;                               // Payload being filled
+static int64_t previous[UPLINK_FIELD_COUNT];                    // Fields of the last sample appended
+static int64_t previous_period = 0;                             // Tick difference of the last two samples appended
+static uint64_t filling_tick_us = 0;                            // Tick of the keyframe of the payload being filled
+
+static uplink_payload_t queue[UPLINK_QUEUE_SIZE];               // Closed payloads, oldest at queue_head
+static uint8_t queue_head = 0, queue_count = 0;
+static uint64_t next_tx_us = 0;                                 // Duty cycle: no transmission before this tick
+
+static uint32_t payloads_sent = 0, samples_sent = 0, bytes_sent = 0, samples_dropped = 0;
+static uint64_t airtime_sent_us = 0;
+static uint32_t loopback_ok = 0, loopback_bad = 0;
+
+// FUNCTIONS FOR THE VARINTS ===============================================================================================
+static uint64_t zigzag(int64_t value){
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);    // 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+}
+
+static int64_t unzigzag(uint64_t value){
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// 7 bits per byte, least significant first, bit 7 set on every byte but the last. Returns 0 if there is no room
+static uint8_t put_varint(uint8_t *out, uint8_t room, uint64_t value){
+    uint8_t n = 0;
+    do{
+        if(n == room){
+            return 0;
+        }
+        out[n++] = (uint8_t)(value & 0x7F) | ((value > 0x7F) ? 0x80 : 0);
+        value >>= 7;
+    }while(value != 0);
+    return n;
+}
+
+static bool get_varint(const uint8_t *in, uint8_t length, uint8_t *pos, uint64_t *value){
+    *value = 0;
+    for(uint8_t shift = 0; shift < 64 && *pos < length; shift += 7){
+        uint8_t byte = in[(*pos)++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)){
+            return true;
+        }
+    }
+    return false;                                               // Truncated
+}
+
+// FUNCTION TO LIST THE FIELDS OF A SAMPLE =================================================================================
+// Values in FIELD_STEP units, rounded to nearest: the receiver multiplies them back (error at most half a step)
+static void sample_fields(const message_t_sensors *s, int64_t f[UPLINK_FIELD_COUNT]){
+    f[UPLINK_FIELD_TICK] = (int64_t)(s->tick_us / UPLINK_TICK_UNIT_US);
+    f[UPLINK_FIELD_VALID] = s->valid;
+    f[UPLINK_FIELD_ALARMS] = s->alarms;
+    f[UPLINK_FIELD_ANOMALIES] = s->anomalies;
+    f[UPLINK_FIELD_TEMPERATURE] = s->temperature;
+    f[UPLINK_FIELD_HUMIDITY] = s->humidity;
+    f[UPLINK_FIELD_MOISTURE] = s->moistPercAnalogValue;
+    f[UPLINK_FIELD_LIGHT] = s->lightPercAnalogValue;
+    f[UPLINK_FIELD_CLEAR] = s->clear;
+    f[UPLINK_FIELD_RED] = s->red;
+    f[UPLINK_FIELD_GREEN] = s->green;
+    f[UPLINK_FIELD_BLUE] = s->blue;
+    f[UPLINK_FIELD_AX] = s->ax;
+    f[UPLINK_FIELD_AY] = s->ay;
+    f[UPLINK_FIELD_AZ] = s->az;
+    for(uint8_t i = 0; i < UPLINK_FIELD_COUNT; i++){
+        int64_t half = FIELD_STEP[i] / 2;
+        f[i] = (f[i] >= 0) ? (f[i] + half) / FIELD_STEP[i] : -((half - f[i]) / FIELD_STEP[i]);
+    }
+}
+
+// FNV-1a of the fields, enough to tell a decoding mistake
+static uint32_t fields_hash(const int64_t f[UPLINK_FIELD_COUNT]){
+    uint32_t hash = 2166136261u;
+    for(uint8_t i = 0; i < UPLINK_FIELD_COUNT; i++){
+        for(uint8_t b = 0; b < 8; b++){
+            hash = (hash ^ (uint8_t)((uint64_t)f[i] >> (8 * b))) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// FUNCTION TO ENCODE ONE SAMPLE RECORD (0 if it does not fit in room) =====================================================
+static uint8_t encode_record(uint8_t *out, uint8_t room, const int64_t f[UPLINK_FIELD_COUNT], bool keyframe){
+    int64_t d[UPLINK_FIELD_COUNT];
+    uint32_t mask = 0;
+    for(uint8_t i = 0; i < UPLINK_FIELD_COUNT; i++){
+        d[i] = keyframe ? f[i] : f[i] - previous[i];
+    }
+    if(!keyframe){
+        d[UPLINK_FIELD_TICK] -= previous_period;                // Steady sampling: nothing to send for the tick
+    }
+    for(uint8_t i = 0; i < UPLINK_FIELD_COUNT; i++){
+        mask |= (d[i] != 0) ? (1UL << i) : 0;
+    }
+
+    uint8_t n = put_varint(out, room, mask);
+    for(uint8_t i = 0; i < UPLINK_FIELD_COUNT && n > 0; i++){
+        if(mask & (1UL << i)){
+            uint8_t written = put_varint(out + n, room - n, zigzag(d[i]));
+            n = (written > 0) ? n + written : 0;
+        }
+    }
+    return n;
+}
+
+// FUNCTION TO DECODE A PAYLOAD (loopback check, the network server does the same) =========================================
+static bool decode_payload(const uint8_t *data, uint8_t length, uint8_t *count, int64_t f[UPLINK_FIELD_COUNT]){
+    uint8_t pos = 1;
+    int64_t period = 0;
+    *count = data[0];
+    for(uint8_t s = 0; s < *count; s++){
+        uint64_t mask, value;
+        if(!get_varint(data, length, &pos, &mask)){
+            return false;
+        }
+        int64_t tick = f[UPLINK_FIELD_TICK];
+        for(uint8_t i = 0; i < UPLINK_FIELD_COUNT; i++){
+            int64_t d = 0;
+            if(mask & (1ULL << i)){
+                if(!get_varint(data, length, &pos, &value)){
+                    return false;
+                }
+                d = unzigzag(value);
+            }
+            f[i] = (s == 0) ? d : f[i] + d;
+        }
+        if(s > 0){
+            f[UPLINK_FIELD_TICK] += period;
+            period = f[UPLINK_FIELD_TICK] - tick;
+        }
+    }
+    return pos == length;
+}
+
+// ==============================================================================================
+// LOOPBACK RADIO (stand-in for the LoRa modem: prints the payload and decodes it back)
+// ==============================================================================================
+static void radio_send(const uplink_payload_t *p){
+    printf("UPL,%u,", p->count);
+    for(uint8_t i = 0; i < p->length; i++){
+        printf("%02X", p->data[i]);
+    }
+    printf("\n\r");
+
+    uint8_t count;
+    int64_t f[UPLINK_FIELD_COUNT] = {0};
+    if(decode_payload(p->data, p->length, &count, f) && count == p->count && fields_hash(f) == p->check){
+        loopback_ok++;
+    }else{
+        loopback_bad++;
+        printf("Uplink loopback: payload does not decode to its samples\n\r");
+    }
+}
+// LOOPBACK RADIO END ===========================================================================
+
+// FUNCTION TO QUEUE THE OPEN PAYLOAD ======================================================================================
+static void close_payload(){
+    if(filling.count == 0){
+        return;
+    }
+    filling.data[0] = filling.count;
+    filling.check = fields_hash(previous);
+
+    if(queue_count == UPLINK_QUEUE_SIZE){
+        samples_dropped += queue[queue_head].count;             // No airtime left for it: the oldest goes
+        queue_head = (queue_head + 1) % UPLINK_QUEUE_SIZE;
+        queue_count--;
+    }
+    queue[(queue_head + queue_count) % UPLINK_QUEUE_SIZE] = filling;
+    queue_count++;
+    filling.count = 0;
+}
+
+// ==============================================================================================
+// PUBLIC FUNCTIONS
+// ==============================================================================================
+uint32_t uplink_airtime_us(uint8_t payload_size){
+    return airtime(UPLINK_SPREADING_FACTOR, payload_size + UPLINK_FRAME_OVERHEAD);
+}
+
+void uplink_add(const message_t_sensors *sample){
+    int64_t f[UPLINK_FIELD_COUNT];
+    sample_fields(sample, f);
+
+    bool keyframe = (filling.count == 0);
+    uint8_t length = keyframe ? 0 : encode_record(filling.data + filling.length, UPLINK_PAYLOAD_SIZE - filling.length, f, false);
+    if(length == 0){
+        close_payload();                                        // Full: this sample is the keyframe of the next one
+        keyframe = true;
+        length = encode_record(filling.data + 1, UPLINK_PAYLOAD_SIZE - 1, f, true);
+        if(length == 0){
+            samples_dropped++;                                  // Values too large for a payload this small
+            return;
+        }
+        filling.length = 1;
+        filling_tick_us = sample->tick_us;
+    }
+
+    previous_period = keyframe ? 0 : f[UPLINK_FIELD_TICK] - previous[UPLINK_FIELD_TICK];
+    memcpy(previous, f, sizeof(previous));
+    filling.length += length;
+    filling.count++;
+    if(filling.count == UINT8_MAX){
+        close_payload();
+    }
+}
+
+void uplink_service(){
+    uint64_t now_us = timebase_now_us();
+    if(filling.count > 0 && now_us - filling_tick_us >= UPLINK_MAX_BATCH_AGE_US){
+        close_payload();                                        // Slow sampling: bound the delivery delay
+    }
+    if(queue_count == 0 || now_us < next_tx_us){
+        return;
+    }
+
+    const uplink_payload_t *p = &queue[queue_head];
+    uint32_t airtime_us = uplink_airtime_us(p->length);
+    radio_send(p);
+    next_tx_us = now_us + (uint64_t)airtime_us * (1000 - UPLINK_DUTY_CYCLE_PERMILLE) / UPLINK_DUTY_CYCLE_PERMILLE;  // Off time of the sub-band
+
+    payloads_sent++;
+    samples_sent += p->count;
+    bytes_sent += p->length;
+    airtime_sent_us += airtime_us;
+    queue_head = (queue_head + 1) % UPLINK_QUEUE_SIZE;
+    queue_count--;
+}
+
+void uplink_print_stats(){
+    if(samples_sent == 0){
+        printf("Uplink: nothing sent yet, %u payloads queued, %u samples open\n\r", queue_count, filling.count);
+        return;
+    }
+    printf("Uplink (SF%d, %d B, %.1f %% duty cycle): %lu payloads, %.1f samples/payload, %.1f B/sample, %.1f ms airtime/sample\n\r",
+           UPLINK_SPREADING_FACTOR, UPLINK_PAYLOAD_SIZE, UPLINK_DUTY_CYCLE_PERMILLE / 10.0f, (unsigned long)payloads_sent,
+           (float)samples_sent / payloads_sent, (float)bytes_sent / samples_sent, airtime_sent_us / 1000.0f / samples_sent);
+    printf("Uplink backlog: %u payloads queued, %lu samples dropped, loopback %lu ok / %lu bad\n\r", queue_count,
+           (unsigned long)samples_dropped, (unsigned long)loopback_ok, (unsigned long)loopback_bad);
+}
+// PUBLIC FUNCTIONS END =========================================================================
@@ -0,0 +1,83 @@
+/* File for the uplink payload batcher function declarations and macros */
+
+// LIBRARIES ------------------------------------------------------------------------------------
+#include "mbed.h"
+#include "message_q.h"
+
+// LIBRARY GUARD --------------------------------------------------------------------------------
+#ifndef UPLINK_H
+#define UPLINK_H
+
+// ==============================================================================================
+// MACROS
+// ==============================================================================================
+// Radio link, from mbed_app.json
+#ifdef MBED_CONF_APP_UPLINK_PAYLOAD_SIZE
+#define UPLINK_PAYLOAD_SIZE       MBED_CONF_APP_UPLINK_PAYLOAD_SIZE
+#else
+#define UPLINK_PAYLOAD_SIZE       51                            // Application payload of LoRaWAN EU868 DR0 - DR2
+#endif
+
+#ifdef MBED_CONF_APP_UPLINK_SPREADING_FACTOR
+#define UPLINK_SPREADING_FACTOR   MBED_CONF_APP_UPLINK_SPREADING_FACTOR
+#else
+#define UPLINK_SPREADING_FACTOR   10
+#endif
+
+#ifdef MBED_CONF_APP_UPLINK_DUTY_CYCLE_PERMILLE
+#define UPLINK_DUTY_CYCLE_PERMILLE MBED_CONF_APP_UPLINK_DUTY_CYCLE_PERMILLE
+#else
+#define UPLINK_DUTY_CYCLE_PERMILLE 10                           // 1 %, the EU868 g1 sub-band limit
+#endif
+
+#define UPLINK_BANDWIDTH_HZ       125000
+#define UPLINK_PREAMBLE_SYMBOLS   8
+#define UPLINK_FRAME_OVERHEAD     13                            // LoRaWAN MHDR + FHDR + FPort + MIC around the application payload
+#define UPLINK_TICK_UNIT_US       10000                         // Sample ticks sent in 10 ms units
+#define UPLINK_QUEUE_SIZE         4                             // Closed payloads waiting for airtime, the oldest is dropped when full
+#define UPLINK_MAX_BATCH_AGE_US   (15 * 60 * 1000000ULL)        // An open payload is closed after 15 min even if not full
+
+MBED_STATIC_ASSERT(UPLINK_PAYLOAD_SIZE >= 32 && UPLINK_PAYLOAD_SIZE <= 242, "uplink-payload-size must hold a keyframe and fit a LoRaWAN frame");
+MBED_STATIC_ASSERT(UPLINK_SPREADING_FACTOR >= 7 && UPLINK_SPREADING_FACTOR <= 12, "uplink-spreading-factor is 7 to 12");
+MBED_STATIC_ASSERT(UPLINK_DUTY_CYCLE_PERMILLE >= 1 && UPLINK_DUTY_CYCLE_PERMILLE <= 1000, "uplink-duty-cycle-permille is 1 to 1000");
+// MACROS END ===================================================================================
+
+// ==============================================================================================
+// PAYLOAD FORMAT
+// ==============================================================================================
+// byte 0: number of samples. Then one record per sample, fields of message_t_sensors in the order of uplink_field_t:
+//   varint mask of the fields present (bit f = uplink_field_t f), then one zigzag varint per present field.
+// Fields are sent in the steps of FIELD_STEP (uplink.cpp), a little finer than the sensor accuracy.
+// The first sample (keyframe) holds the values themselves, the others the difference with the previous sample, so a field
+// that did not change costs nothing. The tick is sent as the difference of sampling periods, 0 while the period holds.
+// Every payload starts with a keyframe: payloads decode on their own and a lost one loses only its samples.
+typedef enum {
+    UPLINK_FIELD_TICK,                                           // tick_us / UPLINK_TICK_UNIT_US
+    UPLINK_FIELD_VALID,
+    UPLINK_FIELD_ALARMS,
+    UPLINK_FIELD_ANOMALIES,
+    UPLINK_FIELD_TEMPERATURE,
+    UPLINK_FIELD_HUMIDITY,
+    UPLINK_FIELD_MOISTURE,
+    UPLINK_FIELD_LIGHT,
+    UPLINK_FIELD_CLEAR,
+    UPLINK_FIELD_RED,
+    UPLINK_FIELD_GREEN,
+    UPLINK_FIELD_BLUE,
+    UPLINK_FIELD_AX,
+    UPLINK_FIELD_AY,
+    UPLINK_FIELD_AZ,
+    UPLINK_FIELD_COUNT
+} uplink_field_t;
+// PAYLOAD FORMAT END ===========================================================================
+
+// ==============================================================================================
+// PROTOTYPES
+// ==============================================================================================
+void uplink_add(const message_t_sensors *sample);                // Main thread, probe 0 samples: appended to the open payload, closed when the next would not fit
+void uplink_service();                                           // Main thread: close an old payload, send the next one when the duty cycle allows
+uint32_t uplink_airtime_us(uint8_t payload_size);                // Time on air of a frame carrying payload_size application bytes
+void uplink_print_stats();                                       // Samples per payload, airtime per sample, backlog and loopback check
+// PROTOTYPES END ===============================================================================
+
+#endif
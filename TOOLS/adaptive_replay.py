@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Replay a fixed-rate REC trace through the adaptive sampling controller (SRC/adaptive.cpp).
+
+Usage: adaptive_replay.py [serial_log] [--min-ms 2000] [--max-ms 600000]   (reads stdin without a file)
+
+The log is the REC lines printed in NORMAL_MODE with adaptive-sampling off (one sample every 10 s). The controller picks
+the trace samples it would have taken. Every channel is then rebuilt by linear interpolation between the picked samples
+and compared with the full trace. Anomalies are not in the REC lines, so the fall back to the minimum period on an
+anomaly is not replayed.
+"""
+
+import argparse
+import math
+import sys
+
+# Mirrors of adaptive.h / adaptive.cpp
+GROWTH_NUM, GROWTH_DEN = 5, 4
+RELEASE_SHIFT = 2
+CHANNELS = [('T', 'celsius', 10), ('H', '%RH', 50), ('M', '% moisture', 20), ('L', '% light', 100)]   # name, unit, deadband
+REC_COLUMNS = (4, 5, 6, 7)                  # REC,tick_us,utc_ms,skew_ms,T,RH,SM,AL,...
+
+
+class Channel:
+    def __init__(self, deadband, min_ms, max_ms):
+        self.deadband, self.min_ms, self.max_ms = deadband, min_ms, max_ms
+        self.previous, self.previous_tick, self.rate, self.interval = 0, 0, 0, 0
+
+    def update(self, x, tick_us):
+        if self.previous_tick == 0 or tick_us <= self.previous_tick:
+            self.previous, self.previous_tick, self.interval = x, tick_us, self.min_ms
+            return
+        last_rate = min(abs(x - self.previous) * 1000000000 // (tick_us - self.previous_tick), 0xFFFFFFFF)
+        self.rate = last_rate if last_rate >= self.rate else self.rate - ((self.rate - last_rate) >> RELEASE_SHIFT)
+        self.previous, self.previous_tick = x, tick_us
+        target = self.deadband * 1000000 // self.rate if self.rate > 0 else self.max_ms
+        grown = self.interval * GROWTH_NUM // GROWTH_DEN
+        self.interval = max(self.min_ms, min(self.max_ms, min(target, grown)))
+
+
+def read_trace(lines):
+    trace = []
+    for line in lines:
+        fields = line.strip().split(',')
+        if fields[0] != 'REC' or len(fields) <= REC_COLUMNS[-1]:
+            continue
+        values = [int(fields[c]) if fields[c] else None for c in REC_COLUMNS]
+        trace.append((int(fields[1]), values))
+    return trace
+
+
+def interpolate(picked, tick):
+    """Value at tick from the (tick, value) samples picked, linear in between, held after the last one."""
+    for (t0, v0), (t1, v1) in zip(picked, picked[1:]):
+        if t0 <= tick <= t1:
+            return v0 + (v1 - v0) * (tick - t0) / (t1 - t0)
+    return picked[-1][1] if tick >= picked[-1][0] else picked[0][1]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('log', nargs='?')
+    parser.add_argument('--min-ms', type=int, default=2000)
+    parser.add_argument('--max-ms', type=int, default=600000)
+    args = parser.parse_args()
+
+    trace = read_trace(open(args.log, errors='replace') if args.log else sys.stdin)
+    if len(trace) < 2:
+        sys.exit('Need at least two REC lines')
+
+    channels = [Channel(deadband, args.min_ms, args.max_ms) for _, _, deadband in CHANNELS]
+    picked = [[] for _ in CHANNELS]
+    taken, due = 0, 0
+    for tick, values in trace:
+        if tick < due:
+            continue
+        taken += 1
+        shortest = args.max_ms
+        for ch, value in enumerate(values):
+            if value is not None:
+                channels[ch].update(value, tick)
+                picked[ch].append((tick, value))
+            if channels[ch].interval > 0:
+                shortest = min(shortest, channels[ch].interval)
+        due = tick + shortest * 1000
+
+    hours = (trace[-1][0] - trace[0][0]) / 3.6e9
+    print('%d trace samples over %.2f h: fixed %.0f samples/h, adaptive %.0f samples/h (%.1f%%)'
+          % (len(trace), hours, len(trace) / hours, taken / hours, 100.0 * taken / len(trace)))
+    for ch, (name, unit, _) in enumerate(CHANNELS):
+        errors = [interpolate(picked[ch], tick) - values[ch] for tick, values in trace if values[ch] is not None and picked[ch]]
+        if not errors:
+            print('%s: no valid samples' % name)
+            continue
+        rms = math.sqrt(sum(e * e for e in errors) / len(errors)) / 100
+        print('%s: reconstruction error RMS %.3f %s, max %.3f %s' % (name, rms, unit, max(abs(e) for e in errors) / 100, unit))
+
+
+if __name__ == '__main__':
+    main()
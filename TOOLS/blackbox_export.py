@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Export the accelerometer black-box window dumped by the 'B' console command to CSV.
+
+Usage: blackbox_export.py [serial_log] > window.csv   (reads stdin without a file)
+
+Columns: time relative to the trigger (s), ax, ay, az and |a| in g. Every other line of the log is ignored.
+"""
+
+import math
+import sys
+
+COUNTS_PER_G = 4096                     # MMA8451_COUNTS_PER_G
+
+
+def to_int16(word):
+    value = int(word, 16)
+    return value - 0x10000 if value & 0x8000 else value
+
+
+def parse(lines):
+    header, samples = None, []
+    for line in lines:
+        line = line.strip()
+        if line.startswith('BBH,'):
+            event, rate, pre, count, tick, overflows = line.split(',')[1:7]
+            header = {'event': event, 'rate': int(rate), 'pre': int(pre), 'count': int(count), 'tick_us': int(tick), 'overflows': int(overflows)}
+            samples = []
+        elif line.startswith('BBD,') and header is not None:
+            data = line.split(',')[2]
+            for i in range(0, len(data) - 11, 12):
+                samples.append(tuple(to_int16(data[i + 4 * axis:i + 4 * axis + 4]) for axis in range(3)))
+        elif line.startswith('BBE') and header is not None:
+            return header, samples      # First complete dump of the log
+    sys.exit('No complete black-box dump (BBH ... BBE) found')
+
+
+def main():
+    source = open(sys.argv[1], errors='replace') if len(sys.argv) > 1 else sys.stdin
+    header, samples = parse(source)
+    if len(samples) != header['count']:
+        print('Warning: %d samples, the header announces %d' % (len(samples), header['count']), file=sys.stderr)
+    if header['overflows']:
+        print('Warning: %d FIFO overflows while recording, the window has gaps' % header['overflows'], file=sys.stderr)
+
+    print('# %s at tick %d us, %d Hz, trigger at sample %d' % (header['event'], header['tick_us'], header['rate'], header['pre']))
+    print('t_s,ax_g,ay_g,az_g,norm_g')
+    for i, xyz in enumerate(samples):
+        ax, ay, az = (c / COUNTS_PER_G for c in xyz)
+        print('%.3f,%.4f,%.4f,%.4f,%.4f' % ((i - header['pre']) / header['rate'], ax, ay, az, math.sqrt(ax * ax + ay * ay + az * az)))
+
+
+if __name__ == '__main__':
+    main()
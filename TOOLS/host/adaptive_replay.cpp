@@ -0,0 +1,236 @@
+/* Host replay of the adaptive sampling period (adaptive.cpp) over a fixed-rate trace. The sensors' task is followed: each
+ * sample taken is scored by the anomaly detector (anomaly.cpp) and then updates the period, and the next sample is the
+ * first trace row at or after the period. Every channel is rebuilt by linear interpolation between the samples taken
+ * and compared with the full trace, and with the same number of samples taken at a fixed period.
+ *
+ * The committed trace (traces/adaptive_day.csv) is synthetic, printed by traces/adaptive_trace.py. It has one row every
+ * NORMAL_MODE period (10 s), so periods below that are rounded up to it; a trace rebuilt from a recording in the same
+ * format replays the same way.
+ *
+ *   ./adaptive_replay          [trace, default traces/adaptive_day.csv]
+ */
+
+#include <math.h>
+#include <vector>
+#include "mbed.h"
+#include "adaptive.h"
+#include "anomaly.h"
+#include "sensors_thread.h"
+#include "timebase.h"
+
+#define BOOT_MS             60000                                // Trace tick 0 is a minute after boot (tick 0 means "no value yet" to adaptive.cpp)
+
+static const char *const CHANNEL[ADAPTIVE_CHANNELS] = {"T", "RH", "SM", "AL"};
+static const char *const UNIT[ADAPTIVE_CHANNELS] = {"celsius", "%RH", "%", "%"};
+static const uint8_t VALID[ADAPTIVE_CHANNELS] = {MSG_VALID_TEMPERATURE, MSG_VALID_HUMIDITY, MSG_VALID_MOISTURE, MSG_VALID_LIGHT};
+
+static uint64_t now_us = 0;
+uint64_t timebase_now_us(){ return now_us; }
+
+// ==============================================================================================
+// TRACE
+// ==============================================================================================
+typedef struct {
+    uint8_t channels;                                            // Mask of alarm_channel_t
+    uint64_t start_ms, end_ms;                                   // [start_ms, end_ms)
+    char name[64];
+} event_t;
+
+typedef struct {
+    uint64_t tick_ms;
+    int32_t value[ADAPTIVE_CHANNELS];
+    uint8_t valid;
+} row_t;
+
+static bool load(const char *path, std::vector<event_t> *events, std::vector<row_t> *rows){
+    FILE *f = fopen(path, "r");
+    if(f == nullptr){
+        printf("Cannot open %s\n", path);
+        return false;
+    }
+    char line[256];
+    while(fgets(line, sizeof(line), f) != nullptr){
+        event_t e;
+        unsigned channels, valid;
+        unsigned long long start, end, tick;
+        int t, rh, sm, al;
+        if(line[0] == '#'){
+            continue;
+        }else if(sscanf(line, "EVENT,%u,%llu,%llu,%63[^\n]", &channels, &start, &end, e.name) == 4){
+            e.channels = (uint8_t)channels;
+            e.start_ms = start;
+            e.end_ms = end;
+            events->push_back(e);
+        }else if(sscanf(line, "%llu,%d,%d,%d,%d,%u", &tick, &t, &rh, &sm, &al, &valid) == 6){
+            rows->push_back({tick, {t, rh, sm, al}, (uint8_t)valid});
+        }
+    }
+    fclose(f);
+    return rows->size() > 1;
+}
+
+// Sample of the sensors' task for a row: the channels of the trace, the others steady
+static message_t_sensors sample_of(const row_t &r){
+    message_t_sensors s = {};
+    s.tick_us = (r.tick_ms + BOOT_MS) * 1000;
+    s.temperature = (int16_t)r.value[ALARM_CH_TEMPERATURE];
+    s.humidity = (int16_t)r.value[ALARM_CH_HUMIDITY];
+    s.moistPercAnalogValue = (uint16_t)r.value[ALARM_CH_MOISTURE];
+    s.lightPercAnalogValue = (uint16_t)r.value[ALARM_CH_LIGHT];
+    s.clear = (uint16_t)(40 + r.value[ALARM_CH_LIGHT] * 5 / 2);
+    s.az = MSG_ACCEL_COUNTS_PER_G;
+    s.valid = r.valid;
+    return s;
+}
+// TRACE END ====================================================================================
+
+// ==============================================================================================
+// RECONSTRUCTION ERROR
+// ==============================================================================================
+typedef struct {
+    double rms, max;                                             // Over every valid row
+    double event_rms, event_max;                                 // Over the rows of the events labelled on the channel
+} rebuild_error_t;
+
+static bool in_event(const std::vector<event_t> &events, uint8_t ch, uint64_t tick_ms){
+    for(const event_t &e : events){
+        if(((e.channels >> ch) & 1) && tick_ms >= e.start_ms && tick_ms < e.end_ms){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Channel rebuilt from the rows taken where it was valid, linear in between, held before the first and after the last
+static rebuild_error_t reconstruction_error(const std::vector<row_t> &rows, const std::vector<size_t> &taken, const std::vector<event_t> &events, uint8_t ch){
+    std::vector<size_t> kept;
+    for(size_t i : taken){
+        if(rows[i].valid & VALID[ch]){
+            kept.push_back(i);
+        }
+    }
+    rebuild_error_t e = {};
+    double sum = 0, event_sum = 0;
+    size_t n = 0, event_n = 0, k = 0;
+    for(size_t i = 0; i < rows.size() && !kept.empty(); i++){
+        if(!(rows[i].valid & VALID[ch])){
+            continue;
+        }
+        while(k + 1 < kept.size() && kept[k + 1] <= i){
+            k++;
+        }
+        double rebuilt;
+        if(i <= kept[0]){
+            rebuilt = rows[kept[0]].value[ch];
+        }else if(k + 1 >= kept.size()){
+            rebuilt = rows[kept[k]].value[ch];
+        }else{
+            const row_t &a = rows[kept[k]], &b = rows[kept[k + 1]];
+            rebuilt = a.value[ch] + (double)(b.value[ch] - a.value[ch]) * (rows[i].tick_ms - a.tick_ms) / (b.tick_ms - a.tick_ms);
+        }
+        double error = fabs(rebuilt - rows[i].value[ch]) / MSG_CENTI_SCALE;
+        sum += error * error;
+        n++;
+        e.max = (error > e.max) ? error : e.max;
+        if(in_event(events, ch, rows[i].tick_ms)){
+            event_sum += error * error;
+            event_n++;
+            e.event_max = (error > e.event_max) ? error : e.event_max;
+        }
+    }
+    e.rms = n ? sqrt(sum / n) : 0;
+    e.event_rms = event_n ? sqrt(event_sum / event_n) : 0;
+    return e;
+}
+// RECONSTRUCTION ERROR END =====================================================================
+
+int main(int argc, char **argv){
+    const char *path = (argc > 1) ? argv[1] : "traces/adaptive_day.csv";
+    std::vector<event_t> events;
+    std::vector<row_t> rows;
+    if(!load(path, &events, &rows)){
+        return 2;
+    }
+    uint64_t trace_period_ms = rows[1].tick_ms - rows[0].tick_ms;
+    double hours = (rows.back().tick_ms - rows[0].tick_ms + trace_period_ms) / 3.6e6;
+
+    // The sensors' task: score the sample, update the period, wait for it
+    std::vector<size_t> adaptive;
+    std::vector<uint32_t> period_ms(rows.size(), 0);             // Period chosen at each row taken
+    uint64_t due_ms = 0;
+    uint32_t flagged = 0;
+    for(size_t i = 0; i < rows.size(); i++){
+        if(rows[i].tick_ms < due_ms){
+            continue;
+        }
+        message_t_sensors s = sample_of(rows[i]);
+        now_us = s.tick_us;
+        s.anomalies = anomaly_evaluate(&s);
+        flagged += (s.anomalies & ((1 << ADAPTIVE_CHANNELS) - 1)) ? 1 : 0;
+        adaptive_update(&s);
+        period_ms[i] = (uint32_t)adaptive_period().count();
+        due_ms = rows[i].tick_ms + period_ms[i];
+        adaptive.push_back(i);
+    }
+    now_us = (rows.back().tick_ms + BOOT_MS + trace_period_ms) * 1000;
+
+    // The same number of samples at a fixed period
+    std::vector<size_t> fixed;
+    double stride = (double)rows.size() / adaptive.size();
+    for(size_t n = 0; n < adaptive.size(); n++){
+        fixed.push_back((size_t)(n * stride));
+    }
+
+    bool pass = true;
+    printf("%zu trace rows over %.1f h, one every %llu ms; adaptive period %d to %d ms\n", rows.size(), hours,
+           (unsigned long long)trace_period_ms, ADAPTIVE_MIN_PERIOD_MS, ADAPTIVE_MAX_PERIOD_MS);
+    printf("Samples/h: fixed NORMAL_MODE %.0f, adaptive %.0f (%.1f %%), %u samples with an anomaly\n", rows.size() / hours,
+           adaptive.size() / hours, 100.0 * adaptive.size() / rows.size(), flagged);
+    printf("Firmware stats line: ");
+    fflush(stdout);
+    adaptive_print_stats();
+
+    // Periods within the limits (rounded up to the trace rows)
+    uint64_t shortest = UINT64_MAX, longest = 0;
+    for(size_t n = 1; n < adaptive.size(); n++){
+        uint64_t gap = rows[adaptive[n]].tick_ms - rows[adaptive[n - 1]].tick_ms;
+        shortest = (gap < shortest) ? gap : shortest;
+        longest = (gap > longest) ? gap : longest;
+    }
+    bool limits_ok = shortest >= ADAPTIVE_MIN_PERIOD_MS && longest < ADAPTIVE_MAX_PERIOD_MS + trace_period_ms;
+    printf("Gaps between samples: %llu to %llu ms%s\n\n", (unsigned long long)shortest, (unsigned long long)longest, limits_ok ? "" : "  <- FAIL");
+    pass = pass && limits_ok && adaptive.size() < rows.size();
+
+    printf("Reconstruction error against the full trace (same %zu samples, adaptive vs fixed period):\n", adaptive.size());
+    printf("%-4s %-8s %9s %9s %9s %9s   %9s %9s %9s %9s\n", "", "", "adaptive", "", "in events", "", "fixed", "", "in events", "");
+    printf("%-4s %-8s %9s %9s %9s %9s   %9s %9s %9s %9s\n", "", "unit", "rms", "max", "rms", "max", "rms", "max", "rms", "max");
+    for(uint8_t ch = 0; ch < ADAPTIVE_CHANNELS; ch++){
+        rebuild_error_t a = reconstruction_error(rows, adaptive, events, ch);
+        rebuild_error_t f = reconstruction_error(rows, fixed, events, ch);
+        printf("%-4s %-8s %9.3f %9.3f %9.3f %9.3f   %9.3f %9.3f %9.3f %9.3f\n", CHANNEL[ch], UNIT[ch], a.rms, a.max, a.event_rms, a.event_max,
+               f.rms, f.max, f.event_rms, f.event_max);
+    }
+
+    // Each labelled change: how long the period was when it started, and how fast it came down
+    printf("\n%-46s %-7s %9s %9s %9s %9s\n", "labelled change", "", "period", "seen", "period", "samples");
+    printf("%-46s %-7s %9s %9s %9s %9s\n", "", "", "before s", "after s", "then s", "in event");
+    for(const event_t &e : events){
+        size_t first = 0, inside = 0;
+        for(size_t n = 0; n < adaptive.size(); n++){
+            uint64_t tick_ms = rows[adaptive[n]].tick_ms;
+            if(tick_ms >= e.start_ms && tick_ms < e.end_ms){
+                first = inside++ ? first : n;
+            }
+        }
+        bool ok = inside > 0 && first > 0;
+        uint32_t before = ok ? period_ms[adaptive[first - 1]] : 0;
+        uint64_t late = ok ? rows[adaptive[first]].tick_ms - e.start_ms : 0;
+        uint32_t then = ok ? period_ms[adaptive[first]] : 0;
+        ok = ok && then < before;                                // The change shortens the period at the first sample that sees it
+        printf("%-46s %-7s %9.0f %9.0f %9.0f %9zu%s\n", e.name, "", before / 1000.0, late / 1000.0, then / 1000.0, inside, ok ? "" : "  <- FAIL");
+        pass = pass && ok;
+    }
+
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/* Host replay of the streaming anomaly detector (anomaly.cpp) over a labelled trace: every labelled fault must be flagged
+ * on its first sample unless the label says the detector cannot see it, no failed read may be flagged, and the flags
+ * outside the labels give the false-positive rate.
+ *
+ * The committed trace (traces/anomaly_labelled.csv) is synthetic, printed by traces/anomaly_trace.py; a trace rebuilt
+ * from a recording in the same format replays the same way.
+ *
+ *   ./anomaly_replay           [trace, default traces/anomaly_labelled.csv]
+ */
+
+#include <vector>
+#include "mbed.h"
+#include "anomaly.h"
+
+#define SETTLE_SAMPLES      ANOMALY_WARMUP_SAMPLES               // Flags this close after a fault are reported apart
+#define MAX_FALSE_POSITIVE  0.005                                // Of the valid channel samples outside the labels
+
+static const char *const CHANNEL[ALARM_CH_COUNT] = {"T", "RH", "SM", "AL", "CLR", "ax", "ay", "az"};
+
+// ==============================================================================================
+// TRACE
+// ==============================================================================================
+typedef struct {
+    uint8_t channels;                                            // Mask of alarm_channel_t
+    uint64_t start_ms, end_ms;                                   // [start_ms, end_ms)
+    bool must_detect;
+    char name[64];
+} event_t;
+
+typedef struct {
+    message_t_sensors sample;
+    uint8_t labelled;                                            // Channels inside an event window
+    uint8_t settling;                                            // Channels within SETTLE_SAMPLES after one
+    uint8_t flags;                                               // What anomaly_evaluate() returned
+} row_t;
+
+static bool load(const char *path, std::vector<event_t> *events, std::vector<row_t> *rows){
+    FILE *f = fopen(path, "r");
+    if(f == nullptr){
+        printf("Cannot open %s\n", path);
+        return false;
+    }
+    char line[256];
+    while(fgets(line, sizeof(line), f) != nullptr){
+        event_t e;
+        unsigned channels, must;
+        unsigned long long start, end, tick;
+        int t, rh, sm, al, clr, ax, ay, az, valid;
+        if(line[0] == '#'){
+            continue;
+        }else if(sscanf(line, "EVENT,%u,%llu,%llu,%u,%63[^\n]", &channels, &start, &end, &must, e.name) == 5){
+            e.channels = (uint8_t)channels;
+            e.start_ms = start;
+            e.end_ms = end;
+            e.must_detect = must != 0;
+            events->push_back(e);
+        }else if(sscanf(line, "%llu,%d,%d,%d,%d,%d,%d,%d,%d,%d", &tick, &t, &rh, &sm, &al, &clr, &ax, &ay, &az, &valid) == 10){
+            row_t r = {};
+            r.sample.tick_us = tick * 1000;
+            r.sample.temperature = (int16_t)t;
+            r.sample.humidity = (int16_t)rh;
+            r.sample.moistPercAnalogValue = (uint16_t)sm;
+            r.sample.lightPercAnalogValue = (uint16_t)al;
+            r.sample.clear = (uint16_t)clr;
+            r.sample.ax = (int16_t)ax;
+            r.sample.ay = (int16_t)ay;
+            r.sample.az = (int16_t)az;
+            r.sample.valid = (uint8_t)valid;
+            rows->push_back(r);
+        }
+    }
+    fclose(f);
+
+    // Labels of every row, then the rows just after each window
+    for(const event_t &e : *events){
+        int after = -1;
+        for(size_t i = 0; i < rows->size(); i++){
+            uint64_t tick_ms = (*rows)[i].sample.tick_us / 1000;
+            if(tick_ms >= e.start_ms && tick_ms < e.end_ms){
+                (*rows)[i].labelled |= e.channels;
+                after = 0;
+            }else if(after >= 0 && after < SETTLE_SAMPLES){
+                (*rows)[i].settling |= e.channels;
+                after++;
+            }
+        }
+    }
+    for(row_t &r : *rows){
+        r.settling &= ~r.labelled;
+    }
+    return !rows->empty();
+}
+// TRACE END ====================================================================================
+
+// ==============================================================================================
+// REPORT
+// ==============================================================================================
+static void print_clock(uint64_t tick_ms){
+    printf("%02u:%02u", (unsigned)(tick_ms / 3600000), (unsigned)(tick_ms / 60000 % 60));
+}
+
+static bool report_events(const std::vector<event_t> &events, const std::vector<row_t> &rows){
+    bool pass = true;
+    printf("%-44s %-7s %5s %8s %11s %s\n", "labelled fault", "channel", "at", "detected", "latency", "flagged");
+    printf("%-44s %-7s %5s %8s %11s\n", "", "", "", "", "samples (s)");
+    for(const event_t &e : events){
+        for(uint8_t ch = 0; ch < ALARM_CH_COUNT; ch++){
+            if(!((e.channels >> ch) & 1)){
+                continue;
+            }
+            int first = -1, samples = 0, flagged = 0;
+            uint64_t first_ms = 0;
+            for(size_t i = 0; i < rows.size(); i++){
+                uint64_t tick_ms = rows[i].sample.tick_us / 1000;
+                if(tick_ms < e.start_ms || tick_ms >= e.end_ms){
+                    continue;
+                }
+                if((rows[i].flags >> ch) & 1){
+                    first_ms = (first < 0) ? tick_ms : first_ms;
+                    first = (first < 0) ? samples : first;
+                    flagged++;
+                }
+                samples++;
+            }
+            bool ok = !e.must_detect || first == 0;               // Within one sample: the first one of the fault
+            printf("%-44s %-7s ", e.name, CHANNEL[ch]);
+            print_clock(e.start_ms);
+            if(first >= 0){
+                printf(" %8s %2d (%4.0f s) %d/%d%s\n", "yes", first, (first_ms - e.start_ms) / 1000.0, flagged, samples, ok ? "" : "  <- FAIL");
+            }else{
+                printf(" %8s %11s %d/%d%s\n", e.must_detect ? "NO" : "no (blind)", "-", flagged, samples, ok ? "" : "  <- FAIL");
+            }
+            pass = pass && ok;
+        }
+    }
+    return pass;
+}
+
+// Flags outside the labels, per channel, and their runs with the time they started
+static bool report_false_positives(const std::vector<row_t> &rows){
+    uint32_t valid[ALARM_CH_COUNT] = {}, flagged[ALARM_CH_COUNT] = {}, settling[ALARM_CH_COUNT] = {}, invalid_flagged = 0;
+    uint32_t total_valid = 0, total_flagged = 0;
+    printf("\nFlags outside the labels (first sample of each run):\n");
+    for(size_t i = 0; i < rows.size(); i++){
+        int32_t values[ALARM_CH_COUNT];
+        alarms_channel_values(&rows[i].sample, values);
+        for(uint8_t ch = 0; ch < ALARM_CH_COUNT; ch++){
+            bool flag = (rows[i].flags >> ch) & 1;
+            if(!alarms_channel_valid(&rows[i].sample, (alarm_channel_t)ch)){
+                invalid_flagged += flag;
+                continue;
+            }
+            if((rows[i].labelled >> ch) & 1){
+                continue;
+            }
+            valid[ch]++;
+            flagged[ch] += flag;
+            settling[ch] += flag && ((rows[i].settling >> ch) & 1);
+            if(flag && (i == 0 || !((rows[i - 1].flags & ~rows[i - 1].labelled) >> ch & 1))){
+                printf("  ");
+                print_clock(rows[i].sample.tick_us / 1000);
+                printf(" %-3s %6ld%s\n", CHANNEL[ch], (long)values[ch], ((rows[i].settling >> ch) & 1) ? "  (settling after a fault)" : "");
+            }
+        }
+    }
+
+    printf("\n%-7s %13s %8s %14s %8s\n", "channel", "valid samples", "flagged", "after a fault", "rate");
+    for(uint8_t ch = 0; ch < ALARM_CH_COUNT; ch++){
+        printf("%-7s %13lu %8lu %14lu %7.2f%%\n", CHANNEL[ch], (unsigned long)valid[ch], (unsigned long)flagged[ch], (unsigned long)settling[ch],
+               valid[ch] ? 100.0 * flagged[ch] / valid[ch] : 0.0);
+        total_valid += valid[ch];
+        total_flagged += flagged[ch];
+    }
+    double rate = (double)total_flagged / total_valid;
+    printf("False positives: %lu of %lu valid channel samples (%.2f%%, limit %.2f%%); %lu flags on failed reads\n",
+           (unsigned long)total_flagged, (unsigned long)total_valid, 100.0 * rate, 100.0 * MAX_FALSE_POSITIVE, (unsigned long)invalid_flagged);
+    return rate <= MAX_FALSE_POSITIVE && invalid_flagged == 0;
+}
+// REPORT END ===================================================================================
+
+int main(int argc, char **argv){
+    const char *path = (argc > 1) ? argv[1] : "traces/anomaly_labelled.csv";
+    std::vector<event_t> events;
+    std::vector<row_t> rows;
+    if(!load(path, &events, &rows)){
+        printf("FAIL\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(row_t &r : rows){
+        r.flags = anomaly_evaluate(&r.sample);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rows.size();
+
+    uint64_t span_ms = rows.back().sample.tick_us / 1000 - rows.front().sample.tick_us / 1000;
+    printf("%s: %zu samples over %.1f h, %zu labelled faults, %.0f ns per sample on this host\n\n", path, rows.size(), span_ms / 3.6e6, events.size(), ns);
+    bool pass = report_events(events, rows);
+    pass = report_false_positives(rows) && pass;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
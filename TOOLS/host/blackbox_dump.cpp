@@ -0,0 +1,202 @@
+/* Host harness of the black-box dump (blackbox.cpp, persist.cpp): the console command prints the frozen window or the one
+ * in flash while the sensors' task keeps pushing FIFO batches and an MMA8451Q interrupt fires, as on the board where the
+ * dump takes longer than the FIFO holds. Checks that the recorder comes back in the state it was in, that the interrupt
+ * raised during the dump is acted on, and that a flash record, valid or with a bad CRC, never reaches the live ring.
+ *
+ * The console output is captured through a stdio cookie; the first BBD line runs the sensors' task in the middle of it.
+ *
+ *   ./blackbox_dump            prints one line per check and PASS/FAIL
+ */
+
+#include <string>
+#include <vector>
+#include "mbed.h"
+#include "blackbox.h"
+#include "persist.h"
+#include "timebase.h"
+
+#define BATCH               10                                   // FIFO samples per drain, one every 100 ms at MMA8451_ODR_HZ
+#define BATCH_US            (BATCH * 1000000ULL / MMA8451_ODR_HZ)
+#define DUMP_FEED_MS        500                                  // Sensors' task time while the dump prints (FIFO overflows after 320 ms)
+
+// Blackbox slot as persist.cpp lays it out on the host flash: after the state, GPS and calibration slots from the end
+#define SLOT_ADDRESS        (HOST_FLASH_START + HOST_FLASH_SIZE - PERSIST_STATE_SIZE - PERSIST_GPS_SIZE - PERSIST_CALIBRATION_SIZE - PERSIST_BLACKBOX_SIZE)
+
+uint64_t timebase_now_us(){ return host_now_us(); }
+
+// ==============================================================================================
+// SENSORS' TASK AND CONSOLE
+// ==============================================================================================
+static uint32_t sample_n = 0;                                    // Every sample carries its number in x, -x in y
+
+static void feed(uint32_t ms){
+    for(uint32_t t = 0; t < ms; t += BATCH_US / 1000){
+        int16_t xyz[BATCH][3];
+        for(uint8_t i = 0; i < BATCH; i++, sample_n++){
+            xyz[i][0] = (int16_t)(sample_n & 0x7FFF);
+            xyz[i][1] = (int16_t)-(sample_n & 0x7FFF);
+            xyz[i][2] = 1000;
+        }
+        host_advance_us(BATCH_US);
+        blackbox_push(xyz, BATCH, false, host_now_us());
+    }
+}
+
+static uint32_t interrupt_sample = 0;                            // Newest sample when the last interrupt fired
+
+static void interrupt(blackbox_event_t event){
+    interrupt_sample = sample_n - 1;
+    blackbox_trigger_from_isr(event);
+}
+
+static void freefall_while_printing(){
+    interrupt(BLACKBOX_EVENT_FREEFALL);
+    feed(DUMP_FEED_MS);
+}
+
+typedef struct {
+    std::string text;
+    void (*hook)();
+    bool fired;
+} capture_t;
+
+static ssize_t capture_write(void *cookie, const char *buffer, size_t size){
+    capture_t *c = (capture_t *)cookie;
+    c->text.append(buffer, size);
+    if(c->hook != nullptr && !c->fired && c->text.find("BBD,") != std::string::npos){
+        c->fired = true;
+        c->hook();
+    }
+    return size;
+}
+
+// Console output of fn(), with hook() run once the first sample line is out
+static std::string console(void (*fn)(), void (*hook)() = nullptr){
+    capture_t c = {"", hook, false};
+    cookie_io_functions_t io = {nullptr, capture_write, nullptr, nullptr};
+    FILE *f = fopencookie(&c, "w", io);
+    setvbuf(f, nullptr, _IONBF, 0);
+    fflush(stdout);
+    FILE *saved = stdout;
+    stdout = f;
+    fn();
+    stdout = saved;
+    fclose(f);
+    return c.text;
+}
+
+static void command(){ blackbox_command(""); }
+
+// Flip one sample byte of the flash record, its CRC no longer matches
+static void corrupt_flash_record(){
+    FlashIAP flash;
+    uint8_t sector[HOST_FLASH_SECTOR];
+    uint32_t address = SLOT_ADDRESS + HOST_FLASH_SECTOR;
+    flash.read(sector, address, sizeof(sector));
+    sector[5] ^= 0x01;
+    flash.erase(address, sizeof(sector));
+    flash.program(sector, address, sizeof(sector));
+}
+// SENSORS' TASK AND CONSOLE END ================================================================
+
+// ==============================================================================================
+// CHECKS
+// ==============================================================================================
+typedef struct {
+    unsigned pre_samples, count;
+    std::vector<int16_t> x;
+} window_t;
+
+// Parse a dump and check its samples are consecutive and as many as the header says
+static bool parse(const std::string &text, window_t *w){
+    char event[16];
+    unsigned rate;
+    size_t at = text.find("BBH,");
+    if(at == std::string::npos || sscanf(text.c_str() + at, "BBH,%15[^,],%u,%u,%u", event, &rate, &w->pre_samples, &w->count) != 4){
+        return false;
+    }
+    w->x.clear();
+    for(at = text.find("BBD,", at); at != std::string::npos; at = text.find("BBD,", at + 1)){
+        const char *p = strchr(text.c_str() + at + 4, ',') + 1;
+        unsigned x, y, z;
+        while(sscanf(p, "%4X%4X%4X", &x, &y, &z) == 3){
+            if((int16_t)y != (int16_t)-(int16_t)x || z != 1000){
+                return false;
+            }
+            w->x.push_back((int16_t)x);
+            p += 12;
+        }
+    }
+    bool ok = (w->x.size() == w->count) && (text.find("BBE") != std::string::npos);
+    for(size_t i = 1; i < w->x.size() && ok; i++){
+        ok = (w->x[i] == w->x[i - 1] + 1);
+    }
+    return ok;
+}
+
+static bool report(const char *name, bool ok){
+    printf("  %-74s %s\n", name, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Feed until the window of the last interrupt is frozen, and check it is the live one with a full history
+static bool frozen_live_window(blackbox_event_t event){
+    feed(1500);
+    window_t w;
+    std::string text = console(command);
+    return blackbox_frozen_event() == event && parse(text, &w) && w.pre_samples == BLACKBOX_PRE_SAMPLES
+           && (uint16_t)w.x[w.pre_samples] == (uint16_t)(interrupt_sample & 0x7FFF);
+}
+// CHECKS END ===================================================================================
+
+int main(){
+    bool pass = true;
+    window_t w;
+    persist_erase(PERSIST_SLOT_BLACKBOX);
+    console(blackbox_init);
+
+    printf("Recording, nothing in flash:\n");
+    feed(3000);
+    std::string text = console(command);
+    pass = report("reports no window", text.find("no frozen window") != std::string::npos) && pass;
+    interrupt(BLACKBOX_EVENT_TAP);
+    pass = report("ring kept recording through the command (tap window with 2 s of history)", frozen_live_window(BLACKBOX_EVENT_TAP)) && pass;
+
+    printf("Frozen tap window, freefall interrupt while it prints:\n");
+    text = console(command, freefall_while_printing);
+    pass = report("dump complete and consecutive", parse(text, &w) && w.count == BLACKBOX_SAMPLES) && pass;
+    pass = report("tap window still frozen after the dump", blackbox_frozen_event() == BLACKBOX_EVENT_TAP) && pass;
+    feed(1500);
+    pass = report("freefall raised during the dump takes over the tap window", blackbox_frozen_event() == BLACKBOX_EVENT_FREEFALL) && pass;
+    pass = report("freefall window saved to flash", blackbox_save()) && pass;
+    std::string saved = console(command);
+    pass = report("frozen freefall window dumped", parse(saved, &w)) && pass;
+
+    printf("Next boot, recording, valid window in flash, freefall interrupt while it prints:\n");
+    console(blackbox_init);
+    feed(3000);
+    text = console(command, freefall_while_printing);
+    pass = report("flash dump identical to the frozen dump before the reboot", text == saved) && pass;
+    pass = report("interrupt during the flash dump cuts a live window with 2 s of history", frozen_live_window(BLACKBOX_EVENT_FREEFALL)) && pass;
+
+    printf("Next boot, recording, flash record with a bad CRC:\n");
+    console(blackbox_init);
+    corrupt_flash_record();
+    feed(3000);
+    text = console(command);
+    pass = report("reports no window", text.find("no frozen window") != std::string::npos && text.find("BBH") == std::string::npos) && pass;
+    interrupt(BLACKBOX_EVENT_TAP);
+    pass = report("live ring untouched (tap window with 2 s of history)", frozen_live_window(BLACKBOX_EVENT_TAP)) && pass;
+
+    printf("Window still recording its post-trigger samples:\n");
+    console(blackbox_init);
+    feed(3000);
+    interrupt(BLACKBOX_EVENT_TAP);
+    feed(300);
+    text = console(command);
+    pass = report("reports it is still recording", text.find("still recording") != std::string::npos && text.find("BBH") == std::string::npos) && pass;
+    pass = report("window completes with 2 s of history", frozen_live_window(BLACKBOX_EVENT_TAP)) && pass;
+
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
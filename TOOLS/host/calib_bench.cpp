@@ -0,0 +1,168 @@
+/* Host harness of the analog calibration (calib.cpp, persist.cpp): every raw count of both channels against the exact
+ * piecewise-linear curve in double, next to a float evaluation of the same points and to the uncalibrated raw * 100 %;
+ * then the cost of a lookup against the float one, and a curve entered on the console surviving a reboot through flash.
+ *
+ * The cost is measured on this host, which has an FPU. The STM32L072 has none: there every float operation of the float
+ * evaluation is a library call, so the host ratio understates the gap.
+ *
+ * Each boot is a fork() of this process, so the statics of calib.cpp start over while the flash (host_mbed.cpp) stays.
+ *
+ *   ./calib_bench              prints the accuracy and cost tables and PASS/FAIL
+ */
+
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "mbed.h"
+#include "calib.h"
+#include "persist.h"
+
+#define LOOKUPS             20000000
+
+// Same as MOISTURE_PROBES[0] and LIGHT_PROBES[0] in calib.cpp (checked at the points below)
+static const calib_points_t DEFAULT_POINTS[CALIB_CH_COUNT] = {
+    {5, {{1300, 5000}, {1750, 3500}, {2300, 2000}, {2900, 800}, {3300, 0}}},
+    {6, {{300, 0}, {700, 5}, {1300, 50}, {2400, 500}, {3300, 3000}, {4000, 10000}}},
+};
+
+// Entered on the console in the reboot check
+static const char *const CONSOLE_CURVE = "M 1200:5200 1800:3300 2600:1500 3400:0";
+static const calib_points_t CONSOLE_POINTS = {4, {{1200, 5200}, {1800, 3300}, {2600, 1500}, {3400, 0}}};
+
+static const char *const CHANNEL[CALIB_CH_COUNT] = {"Soil moisture", "Ambient light"};
+
+// ==============================================================================================
+// REFERENCE AND FLOAT EVALUATIONS
+// ==============================================================================================
+// Exact curve: constant outside the points, linear in between
+static double reference(const calib_points_t *p, uint16_t raw){
+    if(raw <= p->points[0].raw){
+        return p->points[0].value;
+    }
+    for(uint8_t i = 1; i < p->count; i++){
+        if(raw <= p->points[i].raw){
+            const calib_point_t &a = p->points[i - 1], &b = p->points[i];
+            return a.value + (double)(raw - a.raw) * ((double)b.value - a.value) / (b.raw - a.raw);
+        }
+    }
+    return p->points[p->count - 1].value;
+}
+
+// What calib_apply() replaces: a search over the points and a float interpolation, rounded to centi-units
+static int16_t float_apply(const calib_points_t *p, uint16_t raw){
+    if(raw <= p->points[0].raw){
+        return (int16_t)p->points[0].value;
+    }
+    for(uint8_t i = 1; i < p->count; i++){
+        if(raw <= p->points[i].raw){
+            const calib_point_t &a = p->points[i - 1], &b = p->points[i];
+            float value = a.value + (float)(raw - a.raw) * ((float)b.value - (float)a.value) / (float)(b.raw - a.raw);
+            return (int16_t)lroundf(value);
+        }
+    }
+    return (int16_t)p->points[p->count - 1].value;
+}
+
+typedef struct {
+    double worst, sum2;
+} error_stats_t;
+
+static void account(error_stats_t *e, double error){
+    e->worst = (fabs(error) > e->worst) ? fabs(error) : e->worst;
+    e->sum2 += error * error;
+}
+// REFERENCE AND FLOAT EVALUATIONS END ==========================================================
+
+// ==============================================================================================
+// CHECKS
+// ==============================================================================================
+// Every count of a channel against the reference; exact at the calibration points
+static bool check_accuracy(calib_channel_t ch, const calib_points_t *p, bool print){
+    error_stats_t fixed = {}, floating = {}, raw_percent = {};
+    bool exact = true;
+    for(uint16_t raw = 0; raw <= CALIB_RAW_MAX; raw++){
+        double ref = reference(p, raw);
+        account(&fixed, calib_apply(ch, raw) - ref);
+        account(&floating, float_apply(p, raw) - ref);
+        account(&raw_percent, raw * 10000.0 / CALIB_RAW_MAX - ref);          // AnalogIn::read() * 100, in centi-%
+    }
+    for(uint8_t i = 0; i < p->count; i++){
+        exact = exact && calib_apply(ch, p->points[i].raw) == p->points[i].value;
+    }
+    bool ok = exact && fixed.worst <= 1.0;                        // Rounding to the centi-unit plus the Q12 slope
+    if(print){
+        const double n = CALIB_RAW_MAX + 1;
+        printf("%-14s %-26s %10.2f %10.2f%s\n", CHANNEL[ch], "calib_apply (integer)", fixed.worst, sqrt(fixed.sum2 / n), ok ? "" : "  <- FAIL");
+        printf("%-14s %-26s %10.2f %10.2f\n", "", "float evaluation", floating.worst, sqrt(floating.sum2 / n));
+        printf("%-14s %-26s %10.2f %10.2f\n", "", "uncalibrated raw * 100 %", raw_percent.worst, sqrt(raw_percent.sum2 / n));
+    }
+    return ok;
+}
+
+// ns per lookup over every count of the channel, the sum keeps the calls
+template <typename F>
+static double cost(F lookup){
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < LOOKUPS; i++){
+        sum += (uint16_t)lookup((uint16_t)(i & CALIB_RAW_MAX));
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / LOOKUPS;
+    return ns + (sum == 1 ? 1e-9 : 0);
+}
+
+static void measure_cost(){
+    Mutex mutex;
+    double fixed = cost([](uint16_t raw){ return calib_apply(CALIB_CH_LIGHT, raw); });
+    double floating = cost([](uint16_t raw){ return float_apply(&DEFAULT_POINTS[CALIB_CH_LIGHT], raw); });
+    double locking = cost([&mutex](uint16_t raw){ mutex.lock(); mutex.unlock(); return raw; });
+    printf("\nCost per lookup on this host (light curve, 6 points, every count in turn):\n");
+    printf("  calib_apply %.1f ns, of which %.1f ns is the host Mutex; float evaluation %.1f ns\n", fixed, locking, floating);
+}
+
+// A boot: the compile-time curves, or the flash record once the console saved one
+static int boot(bool expect_saved){
+    calib_init();
+    bool ok = check_accuracy(CALIB_CH_MOISTURE, expect_saved ? &CONSOLE_POINTS : &DEFAULT_POINTS[CALIB_CH_MOISTURE], false)
+           && check_accuracy(CALIB_CH_LIGHT, &DEFAULT_POINTS[CALIB_CH_LIGHT], false);
+    if(!expect_saved){
+        calib_command("M 1200:5200 1210:3300");                  // Rejected: two points in one bin
+        ok = ok && check_accuracy(CALIB_CH_MOISTURE, &DEFAULT_POINTS[CALIB_CH_MOISTURE], false);
+        calib_command(CONSOLE_CURVE);
+        ok = ok && check_accuracy(CALIB_CH_MOISTURE, &CONSOLE_POINTS, false);
+    }
+    return ok ? 0 : 1;
+}
+
+static bool run_boot(bool expect_saved){
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0){
+        _exit(boot(expect_saved));
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+// CHECKS END ===================================================================================
+
+int main(){
+    bool pass = true;
+    printf("Error against the exact curve over the %d counts, in centi-units (0.01 %%):\n", CALIB_RAW_MAX + 1);
+    printf("%-14s %-26s %10s %10s\n", "channel", "evaluation", "worst", "RMS");
+    for(uint8_t ch = 0; ch < CALIB_CH_COUNT; ch++){
+        pass = check_accuracy((calib_channel_t)ch, &DEFAULT_POINTS[ch], true) && pass;
+    }
+    measure_cost();
+
+    printf("\nConsole curve, saved and loaded again at the next boot:\n");
+    persist_erase(PERSIST_SLOT_CALIBRATION);
+    bool first = run_boot(false);
+    bool second = run_boot(true);
+    printf("  first boot (compile-time curves, console rejects a bad curve and saves a good one): %s\n", first ? "ok" : "FAIL");
+    printf("  second boot (curve from the flash record): %s\n", second ? "ok" : "FAIL");
+    pass = pass && first && second;
+
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+/* Host fake of the I2C bus: devices, timing and fault injection (see fake_i2c.h) */
+
+#include <vector>
+#include "fake_i2c.h"
+
+#define SDA PB_9                                                 // SDA_PIN / SCL_PIN of i2c_bus.h
+#define SCL PB_8
+#define RELEASE_CLOCKS 5                                         // Clocks a stuck slave needs to finish its byte (at most 9)
+
+fake_i2c_stats_t fake_i2c_stats;
+
+static std::vector<FakeI2CDevice *> devices;
+static FakeTCA9548A *mux = nullptr;
+static bool sda_stuck = false;
+static int release_clocks = 0;
+static int scl_level = 1, sda_level = 1;                         // Levels driven through DigitalInOut
+static bool sda_output = false;
+
+// BUS ==========================================================================================
+void fake_i2c_attach(FakeI2CDevice *device){
+    devices.push_back(device);
+    if(dynamic_cast<FakeTCA9548A *>(device) != nullptr){
+        mux = (FakeTCA9548A *)device;
+    }
+}
+
+void fake_i2c_detach_all(){
+    devices.clear();
+    mux = nullptr;
+    sda_stuck = false;
+}
+
+bool fake_i2c_sda_stuck(){
+    return sda_stuck;
+}
+
+// Device answering an address: wired directly, or behind a channel the mux connects
+static FakeI2CDevice *find(int address){
+    FakeI2CDevice *found = nullptr;
+    int answering = 0;
+    for(FakeI2CDevice *d : devices){
+        bool connected = (d->mux_channel == FAKE_I2C_DIRECT) || (mux != nullptr && (mux->control >> d->mux_channel) & 1);
+        if(d->address == (address & 0xFE) && connected){
+            found = d;
+            answering++;
+        }
+    }
+    if(answering > 1){
+        fake_i2c_stats.collisions++;
+    }
+    return found;
+}
+
+// START and address byte, nullptr if the transfer ends there
+static FakeI2CDevice *start(int address){
+    fake_i2c_stats.transfers++;
+    host_advance_us(FAKE_I2C_BYTE_US);
+    if(sda_stuck){
+        fake_i2c_stats.bus_busy++;                               // No START possible while a slave holds SDA
+        return nullptr;
+    }
+
+    FakeI2CDevice *d = find(address);
+    if(d == nullptr || d->absent || d->nack > 0){
+        if(d != nullptr && d->nack > 0){
+            d->nack--;
+        }
+        fake_i2c_stats.nacks++;
+        host_advance_us(FAKE_I2C_STOP_US);
+        return nullptr;
+    }
+    if(d->stick > 0){
+        d->stick--;
+        sda_stuck = true;                                        // Master lost arbitration mid-byte, the slave keeps driving a 0
+        release_clocks = RELEASE_CLOCKS;
+        host_advance_us(FAKE_I2C_BYTE_US / 2);
+        return nullptr;
+    }
+    return d;
+}
+
+I2C::I2C(PinName sda, PinName scl){
+    fake_i2c_stats.inits++;
+}
+
+I2C::~I2C(){}
+
+int I2C::write(int address, const char *data, int length, bool repeated){
+    FakeI2CDevice *d = start(address);
+    if(d == nullptr){
+        return -1;
+    }
+    host_advance_us((uint64_t)length * FAKE_I2C_BYTE_US + (repeated ? 0 : FAKE_I2C_STOP_US));
+    d->on_write((const uint8_t *)data, length);
+    d->transfers++;
+    return 0;
+}
+
+int I2C::read(int address, char *data, int length, bool repeated){
+    FakeI2CDevice *d = start(address | 1);
+    if(d == nullptr){
+        return -1;
+    }
+    uint64_t transfer_us = d->conversion_us() + d->stretch_us + (uint64_t)length * FAKE_I2C_BYTE_US;
+    d->stretch_us = 0;
+    uint64_t timeout_us = (uint64_t)(length + 1) * FAKE_I2C_BYTE_TIMEOUT_US;
+    if(transfer_us > timeout_us){
+        fake_i2c_stats.timeouts++;
+        host_advance_us(timeout_us + FAKE_I2C_STOP_US);
+        return -1;
+    }
+    host_advance_us(transfer_us + FAKE_I2C_STOP_US);
+    d->on_read((uint8_t *)data, length);
+    d->transfers++;
+    return 0;
+}
+
+// PINS (bus recovery) ==========================================================================
+void DigitalInOut::input(){
+    if(pin == SDA){
+        sda_output = false;
+    }
+}
+
+void DigitalInOut::output(){
+    if(pin == SDA){
+        sda_output = true;
+        sda_level = 1;
+    }
+}
+
+int DigitalInOut::read(){
+    if(pin == SCL){
+        return scl_level;
+    }
+    return (!sda_stuck && (!sda_output || sda_level)) ? 1 : 0;
+}
+
+void DigitalInOut::write(int value){
+    if(pin == SCL){
+        if(scl_level == 0 && value && sda_stuck && --release_clocks == 0){
+            sda_stuck = false;                                   // The slave finished its byte and saw no ACK
+            fake_i2c_stats.recoveries++;
+        }
+        scl_level = value ? 1 : 0;
+    }else if(pin == SDA && sda_output){
+        if(sda_level == 0 && value && scl_level){
+            fake_i2c_stats.stops++;
+        }
+        sda_level = value ? 1 : 0;
+    }
+}
+
+int gpio_read(gpio_t *obj){
+    return (obj->pin == SDA && sda_stuck) ? 0 : 1;               // Pulled up when idle
+}
+
+// DEVICES ======================================================================================
+FakeSi7021::FakeSi7021(uint8_t mux_channel, float humidity, float temperature) : FakeI2CDevice(0x40 << 1, mux_channel){
+    raw_humidity = (uint16_t)((humidity + 6.0) * 65536.0 / 125.0) & ~3;
+    raw_temperature = (uint16_t)((temperature + 46.85) * 65536.0 / 175.72) & ~3;
+}
+
+void FakeSi7021::on_write(const uint8_t *data, int length){
+    command = data[0];
+}
+
+void FakeSi7021::on_read(uint8_t *data, int length){
+    uint16_t value = (command == 0xE5) ? raw_humidity : raw_temperature;
+    data[0] = value >> 8;
+    if(length > 1){
+        data[1] = value & 0xFF;
+    }
+}
+
+uint32_t FakeSi7021::conversion_us(){
+    return (command == 0xE5) ? 12000 + 10800 : (command == 0xE3) ? 10800 : 0;  // Datasheet maxima, 12-bit RH and 14-bit T
+}
+
+FakeTCS34725::FakeTCS34725(uint8_t mux_channel, uint16_t clear, uint16_t red, uint16_t green, uint16_t blue) : FakeI2CDevice(0x29 << 1, mux_channel){
+    uint16_t values[4] = {clear, red, green, blue};
+    for(int i = 0; i < 4; i++){
+        regs[0x14 + 2 * i] = values[i] & 0xFF;
+        regs[0x15 + 2 * i] = values[i] >> 8;
+    }
+}
+
+void FakeTCS34725::on_write(const uint8_t *data, int length){
+    if(data[0] & 0x80){
+        pointer = data[0] & 0x1F;
+        auto_increment = (data[0] & 0x60) == 0x20;
+    }
+    for(int i = 1; i < length; i++){
+        if(pointer == 0x00){                                     // ENABLE: PON 0x01, AEN 0x02
+            if((data[i] & 0x01) && !(regs[0x00] & 0x01)){
+                power_on_us = host_now_us();
+            }
+            if((data[i] & 0x02) && host_now_us() - power_on_us < 2400){
+                early_enables++;
+            }
+        }
+        regs[pointer] = data[i];
+        pointer = (pointer + 1) & 0x1F;
+    }
+}
+
+void FakeTCS34725::on_read(uint8_t *data, int length){
+    for(int i = 0; i < length; i++){
+        data[i] = regs[pointer];
+        if(auto_increment){
+            pointer = (pointer + 1) & 0x1F;
+        }
+    }
+}
+
+FakeTCA9548A::FakeTCA9548A() : FakeI2CDevice(0x70 << 1, FAKE_I2C_DIRECT){}
+
+void FakeTCA9548A::on_write(const uint8_t *data, int length){
+    control = data[length - 1];
+    fake_i2c_stats.mux_writes++;
+}
+
+void FakeTCA9548A::on_read(uint8_t *data, int length){
+    memset(data, control, length);
+}
+
+FakeMMA8451::FakeMMA8451() : FakeI2CDevice(0x1D << 1, FAKE_I2C_DIRECT){}
+
+void FakeMMA8451::push_sample(int16_t x, int16_t y, int16_t z){
+    if(fifo_count == 32){
+        memmove(fifo[0], fifo[1], sizeof(fifo[0]) * 31);        // Circular mode: the oldest sample is dropped
+        fifo_count--;
+        overflow = true;
+    }
+    fifo[fifo_count][0] = x;
+    fifo[fifo_count][1] = y;
+    fifo[fifo_count][2] = z;
+    fifo_count++;
+}
+
+void FakeMMA8451::on_write(const uint8_t *data, int length){
+    pointer = data[0];
+    fifo_byte = 0;
+    for(int i = 1; i < length && pointer < sizeof(regs); i++){
+        regs[pointer++] = data[i];
+    }
+}
+
+void FakeMMA8451::on_read(uint8_t *data, int length){
+    bool fifo_on = (regs[0x09] & 0xC0) != 0;                     // F_SETUP F_MODE
+    for(int i = 0; i < length; i++){
+        if(pointer == 0x00){
+            data[i] = fifo_count | (overflow ? 0x80 : 0);        // F_STATUS
+            overflow = false;
+            pointer++;
+        }else if(pointer <= 0x06 && fifo_on){
+            // X, Y, Z MSB/LSB of the oldest sample, then the address wraps back to OUT_X_MSB for the next one
+            uint16_t left = (fifo_count > 0) ? (uint16_t)(fifo[0][fifo_byte / 2] << 2) : 0;
+            data[i] = (fifo_byte % 2 == 0) ? left >> 8 : left & 0xFC;
+            if(++fifo_byte == 6){
+                fifo_byte = 0;
+                if(fifo_count > 0){
+                    memmove(fifo[0], fifo[1], sizeof(fifo[0]) * (fifo_count - 1));
+                    fifo_count--;
+                }
+            }
+            pointer = 0x01 + fifo_byte;
+        }else{
+            data[i] = (pointer < sizeof(regs)) ? regs[pointer] : 0;
+            pointer++;
+        }
+    }
+}
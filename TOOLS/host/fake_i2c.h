@@ -0,0 +1,111 @@
+/* Host fake of the I2C bus behind mbed.h's I2C, DigitalInOut and gpio_read: simulated devices, bus timing at 100 kHz on
+ * the simulated clock, and faults a harness can inject (NACK, absent device, slave holding SDA low, long clock stretch) */
+
+#ifndef FAKE_I2C_H
+#define FAKE_I2C_H
+
+#include "mbed.h"
+
+// ==============================================================================================
+// BUS MODEL
+// ==============================================================================================
+#define FAKE_I2C_BYTE_US       90                                // 8 bits + ACK at 100 kHz
+#define FAKE_I2C_STOP_US       10
+// mbed's STM32 i2c_api gives up on a transfer after (length + 1) * BYTE_TIMEOUT_US, about 9.6 ms per byte at
+// 32 MHz and 100 kHz (SystemCoreClock / hz * 3 * 10): that is what ends a slave stretching SCL for too long
+#define FAKE_I2C_BYTE_TIMEOUT_US 9600
+#define FAKE_I2C_DIRECT        0xFF                              // Device wired to the bus, not behind the mux
+
+class FakeI2CDevice {
+public:
+    FakeI2CDevice(int address, uint8_t mux_channel) : address(address), mux_channel(mux_channel){}
+    virtual ~FakeI2CDevice(){}
+
+    int address;                                                 // 8-bit mbed address
+    uint8_t mux_channel;                                         // FAKE_I2C_DIRECT or the TCA9548A channel
+
+    // Faults, each counter is consumed by the next transfers addressed to the device
+    bool absent = false;                                         // Never ACKs its address
+    int nack = 0;                                                // NACK the address of the next n transfers
+    int stick = 0;                                               // Stop mid-byte holding SDA low on the next n transfers
+    uint32_t stretch_us = 0;                                     // Extra clock stretch of the next read
+
+    uint32_t transfers = 0;                                      // Transfers the device answered
+
+    virtual void on_write(const uint8_t *data, int length) = 0;  // Bytes after the address
+    virtual void on_read(uint8_t *data, int length) = 0;
+    virtual uint32_t conversion_us(){ return 0; }                // SCL held before the first byte of a read (hold master mode)
+};
+
+typedef struct {
+    uint32_t transfers;                                          // I2C::write and I2C::read calls
+    uint32_t nacks, bus_busy, timeouts, collisions;              // collisions: two selected devices answered one address
+    uint32_t recoveries;                                         // SDA released by clocking SCL
+    uint32_t stops;                                              // STOP conditions driven through DigitalInOut
+    uint32_t inits;                                              // I2C objects created
+    uint32_t mux_writes;
+} fake_i2c_stats_t;
+
+void fake_i2c_attach(FakeI2CDevice *device);                     // A FakeTCA9548A becomes the mux of the bus
+void fake_i2c_detach_all();
+bool fake_i2c_sda_stuck();
+extern fake_i2c_stats_t fake_i2c_stats;
+// BUS MODEL END ================================================================================
+
+// ==============================================================================================
+// DEVICES
+// ==============================================================================================
+// Si7021: hold master measurements, E5 (RH, converts the temperature too) and E3
+class FakeSi7021 : public FakeI2CDevice {
+public:
+    FakeSi7021(uint8_t mux_channel, float humidity, float temperature);
+    void on_write(const uint8_t *data, int length) override;
+    void on_read(uint8_t *data, int length) override;
+    uint32_t conversion_us() override;
+    uint16_t raw_humidity, raw_temperature;                      // What a read returns, status bits clear
+private:
+    uint8_t command = 0;
+};
+
+// TCS34725: register file, command byte 0x80 | reg, 0x20 for auto-increment; counts the ADC enables written before the
+// oscillator warmed up (2.4 ms after power on)
+class FakeTCS34725 : public FakeI2CDevice {
+public:
+    FakeTCS34725(uint8_t mux_channel, uint16_t clear, uint16_t red, uint16_t green, uint16_t blue);
+    void on_write(const uint8_t *data, int length) override;
+    void on_read(uint8_t *data, int length) override;
+    uint8_t regs[32] = {};
+    uint32_t early_enables = 0;
+private:
+    uint8_t pointer = 0;
+    bool auto_increment = false;
+    uint64_t power_on_us = 0;
+};
+
+// TCA9548A: one control register, bit i connects channel i
+class FakeTCA9548A : public FakeI2CDevice {
+public:
+    FakeTCA9548A();
+    void on_write(const uint8_t *data, int length) override;
+    void on_read(uint8_t *data, int length) override;
+    uint8_t control = 0;
+};
+
+// MMA8451Q: register file and the FIFO, read in bursts from OUT_X_MSB
+class FakeMMA8451 : public FakeI2CDevice {
+public:
+    FakeMMA8451();
+    void on_write(const uint8_t *data, int length) override;
+    void on_read(uint8_t *data, int length) override;
+    void push_sample(int16_t x, int16_t y, int16_t z);          // 14-bit counts, what the next FIFO read returns
+    uint8_t regs[0x32] = {};
+private:
+    uint8_t pointer = 0;
+    int16_t fifo[32][3];
+    uint8_t fifo_count = 0;
+    bool overflow = false;
+    int fifo_byte = 0;                                           // Byte of the oldest sample the burst is at
+};
+// DEVICES END ==================================================================================
+
+#endif
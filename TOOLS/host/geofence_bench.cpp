@@ -0,0 +1,187 @@
+/* Host benchmark of the geofence grid index (SRC/geofence_index.h) against a brute-force point-in-polygon check
+ *
+ * Usage: geofence_bench [polygons 4096] [grid 64] [fixes 200000] [seed 1]
+ *
+ * 1. The firmware fences: the index the compiler put in flash must match a run-time build of the same tables, and every
+ *    classification must match the brute-force test.
+ * 2. Random star-shaped fences (5 to 8 vertices, 200 m to 3 km) over a 1 x 1 degree area: fixes per second of the grid
+ *    lookup and of the brute-force test, and the mismatches between them over the brute-force sample.
+ */
+
+#include "geofence.cpp"                                         // Firmware tables and index, static in the module
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define BENCH_MAX_INSIDE 16                                     // Deeper than any overlap of the random fences
+
+typedef std::chrono::steady_clock bench_clock;
+
+// BRUTE FORCE: every edge of every polygon ----------------------------------------------------------------------------
+static uint8_t brute_force(const geofence_vertex_t *vertices, const geofence_polygon_t *polygons, uint16_t polygon_count,
+                           int32_t lat, int32_t lon, uint16_t *inside, uint8_t max){
+    uint8_t count = 0;
+    for(uint16_t i = 0; i < polygon_count && count < max; i++){
+        if(geofence_inside_polygon(vertices, &polygons[i], lat, lon)){
+            inside[count++] = i;
+        }
+    }
+    return count;
+}
+
+// Points exactly on an edge are inside for one test and outside for the other, both are right
+static bool on_boundary(const geofence_vertex_t *vertices, const geofence_polygon_t *polygons, uint16_t polygon_count, int32_t lat, int32_t lon){
+    for(uint16_t i = 0; i < polygon_count; i++){
+        const geofence_polygon_t *p = &polygons[i];
+        for(uint16_t v = p->first_vertex; v < p->first_vertex + p->vertex_count; v++){
+            const geofence_vertex_t *a = &vertices[v], *b = &vertices[geofence_next_vertex(p, v)];
+            if(geofence_orientation(a, b, lat, lon) == 0
+               && lat >= std::min(a->latitude, b->latitude) && lat <= std::max(a->latitude, b->latitude)
+               && lon >= std::min(a->longitude, b->longitude) && lon <= std::max(a->longitude, b->longitude)){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// INDEX BUILT AT RUN TIME -----------------------------------------------------------------------------------------------
+typedef struct {
+    std::vector<uint32_t> cell_start;
+    std::vector<geofence_entry_t> entries;
+    std::vector<uint16_t> cell_edges;
+    geofence_index_t index;
+} bench_index_t;
+
+static void build(bench_index_t *b, const std::vector<geofence_vertex_t> &vertices, const std::vector<geofence_polygon_t> &polygons,
+                  uint16_t rows, uint16_t cols){
+    geofence_grid_t grid = geofence_index_build(vertices.data(), vertices.size(), polygons.data(), polygons.size(), rows, cols,
+                                                nullptr, nullptr, 0, nullptr, 0);
+    b->cell_start.assign((size_t)rows * cols + 1, 0);
+    b->entries.assign(grid.entry_count, geofence_entry_t());
+    b->cell_edges.assign(grid.edge_count, 0);
+    grid = geofence_index_build(vertices.data(), vertices.size(), polygons.data(), polygons.size(), rows, cols,
+                                b->cell_start.data(), b->entries.data(), grid.entry_count, b->cell_edges.data(), grid.edge_count);
+    b->index = {vertices.data(), polygons.data(), grid, b->cell_start.data(), b->entries.data(), b->cell_edges.data()};
+}
+
+// CHECK 1: FIRMWARE FENCES ----------------------------------------------------------------------------------------------
+static int check_firmware(std::mt19937 &rng){
+    std::vector<geofence_vertex_t> vertices(GEOFENCE_VERTICES, GEOFENCE_VERTICES + GEOFENCE_VERTEX_COUNT);
+    std::vector<geofence_polygon_t> polygons(GEOFENCE_POLYGONS, GEOFENCE_POLYGONS + GEOFENCE_POLYGON_COUNT);
+    bench_index_t runtime;
+    build(&runtime, vertices, polygons, GEOFENCE_GRID_ROWS, GEOFENCE_GRID_COLS);
+
+    int errors = 0;
+    errors += memcmp(GEOFENCE_TABLES.cell_start, runtime.cell_start.data(), sizeof(GEOFENCE_TABLES.cell_start)) != 0;
+    errors += memcmp(GEOFENCE_TABLES.entries, runtime.entries.data(), sizeof(GEOFENCE_TABLES.entries)) != 0;
+    errors += memcmp(GEOFENCE_TABLES.cell_edges, runtime.cell_edges.data(), sizeof(GEOFENCE_TABLES.cell_edges)) != 0;
+
+    // Points over the grid and a margin around it
+    std::uniform_int_distribution<int32_t> lat(GEOFENCE_GRID.lat0 - 1000, GEOFENCE_GRID.lat0 + GEOFENCE_GRID.rows * GEOFENCE_GRID.cell_height + 1000);
+    std::uniform_int_distribution<int32_t> lon(GEOFENCE_GRID.lon0 - 1000, GEOFENCE_GRID.lon0 + GEOFENCE_GRID.cols * GEOFENCE_GRID.cell_width + 1000);
+    uint32_t mismatches = 0, on_edge = 0;
+    for(uint32_t n = 0; n < 1000000; n++){
+        int32_t la = lat(rng), lo = lon(rng);
+        uint16_t a[GEOFENCE_MAX_INSIDE], b[GEOFENCE_MAX_INSIDE];
+        uint8_t na = geofence_classify(la, lo, a, GEOFENCE_MAX_INSIDE);
+        uint8_t nb = brute_force(GEOFENCE_VERTICES, GEOFENCE_POLYGONS, GEOFENCE_POLYGON_COUNT, la, lo, b, GEOFENCE_MAX_INSIDE);
+        if((na != nb) || memcmp(a, b, na * sizeof(a[0])) != 0){
+            bool edge = on_boundary(GEOFENCE_VERTICES, GEOFENCE_POLYGONS, GEOFENCE_POLYGON_COUNT, la, lo);
+            on_edge += edge;
+            mismatches += !edge;
+        }
+    }
+
+    printf("Firmware fences: %u polygons, %ux%u grid, %lu entries, %lu edges, %lu B of flash\n", GEOFENCE_POLYGON_COUNT, GEOFENCE_GRID_ROWS,
+           GEOFENCE_GRID_COLS, (unsigned long)GEOFENCE_GRID.entry_count, (unsigned long)GEOFENCE_GRID.edge_count, (unsigned long)sizeof(GEOFENCE_TABLES));
+    printf("  compile-time index %s the run-time build, %lu of 1000000 points differ from brute force (%lu more lie on an edge)\n",
+           errors ? "DIFFERS FROM" : "matches", (unsigned long)mismatches, (unsigned long)on_edge);
+    return errors + (mismatches != 0);
+}
+
+// CHECK 2: THOUSANDS OF RANDOM FENCES -----------------------------------------------------------------------------------
+static int benchmark(std::mt19937 &rng, uint16_t polygon_count, uint16_t grid_size, uint32_t fix_count){
+    const int32_t area = 1000000;                               // 1 degree
+    const int32_t lat0 = 40000000, lon0 = -4000000;
+    std::uniform_int_distribution<int32_t> coordinate(0, area);
+    std::uniform_int_distribution<int32_t> radius(1800, 27000);  // ~200 m to ~3 km
+    std::uniform_int_distribution<int> sides(5, 8);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<geofence_vertex_t> vertices;
+    std::vector<geofence_polygon_t> polygons;
+    for(uint16_t i = 0; i < polygon_count; i++){
+        int32_t c_lat = lat0 + coordinate(rng), c_lon = lon0 + coordinate(rng), r = radius(rng);
+        int n = sides(rng);
+        polygons.push_back({(uint16_t)vertices.size(), (uint8_t)n, "bench"});
+        for(int k = 0; k < n; k++){                            // Increasing angles, so the polygon is simple
+            double angle = 2 * M_PI * (k + 0.8 * unit(rng)) / n;
+            double rk = r * (0.5 + 0.5 * unit(rng));
+            vertices.push_back({c_lat + (int32_t)(rk * sin(angle)), c_lon + (int32_t)(rk * cos(angle))});
+        }
+    }
+
+    bench_index_t b;
+    auto t0 = bench_clock::now();
+    build(&b, vertices, polygons, grid_size, grid_size);
+    double build_s = std::chrono::duration<double>(bench_clock::now() - t0).count();
+
+    std::vector<geofence_vertex_t> fixes(fix_count);
+    for(auto &f : fixes){
+        f = {lat0 + coordinate(rng), lon0 + coordinate(rng)};
+    }
+
+    // Grid lookup over every fix
+    std::vector<uint8_t> grid_counts(fix_count);
+    std::vector<uint16_t> grid_inside((size_t)fix_count * BENCH_MAX_INSIDE);
+    t0 = bench_clock::now();
+    for(uint32_t n = 0; n < fix_count; n++){
+        grid_counts[n] = geofence_index_classify(&b.index, fixes[n].latitude, fixes[n].longitude, &grid_inside[(size_t)n * BENCH_MAX_INSIDE], BENCH_MAX_INSIDE);
+    }
+    double grid_s = std::chrono::duration<double>(bench_clock::now() - t0).count();
+
+    // Brute force over a sample (every polygon per fix is too slow for all of them)
+    uint32_t brute_count = (fix_count < 2000) ? fix_count : 2000;
+    uint32_t mismatches = 0, on_edge = 0, hits = 0;
+    t0 = bench_clock::now();
+    for(uint32_t n = 0; n < brute_count; n++){
+        uint16_t inside[BENCH_MAX_INSIDE];
+        uint8_t count = brute_force(vertices.data(), polygons.data(), polygon_count, fixes[n].latitude, fixes[n].longitude, inside, BENCH_MAX_INSIDE);
+        mismatches += (count != grid_counts[n]) || memcmp(inside, &grid_inside[(size_t)n * BENCH_MAX_INSIDE], count * sizeof(inside[0])) != 0;
+        hits += (count > 0);
+    }
+    double brute_s = std::chrono::duration<double>(bench_clock::now() - t0).count();
+    for(uint32_t n = 0; n < brute_count && mismatches > 0; n++){  // Outside the timing, only if something differs
+        uint16_t inside[BENCH_MAX_INSIDE];
+        uint8_t count = brute_force(vertices.data(), polygons.data(), polygon_count, fixes[n].latitude, fixes[n].longitude, inside, BENCH_MAX_INSIDE);
+        if(((count != grid_counts[n]) || memcmp(inside, &grid_inside[(size_t)n * BENCH_MAX_INSIDE], count * sizeof(inside[0])) != 0)
+           && on_boundary(vertices.data(), polygons.data(), polygon_count, fixes[n].latitude, fixes[n].longitude)){
+            on_edge++;
+        }
+    }
+    mismatches -= on_edge;
+
+    size_t index_bytes = b.cell_start.size() * sizeof(uint32_t) + b.entries.size() * sizeof(geofence_entry_t) + b.cell_edges.size() * sizeof(uint16_t);
+    printf("Random fences: %u polygons, %u vertices, %ux%u grid, index %lu entries / %lu edges / %lu B, built in %.3f s\n", polygon_count,
+           (unsigned)vertices.size(), grid_size, grid_size, (unsigned long)b.index.grid.entry_count, (unsigned long)b.index.grid.edge_count,
+           (unsigned long)index_bytes, build_s);
+    printf("  grid lookup: %.0f fixes/s (%lu fixes)\n", fix_count / grid_s, (unsigned long)fix_count);
+    printf("  brute force: %.0f fixes/s (%lu fixes, %lu inside a fence), %.0fx slower\n", brute_count / brute_s, (unsigned long)brute_count,
+           (unsigned long)hits, (brute_s / brute_count) / (grid_s / fix_count));
+    printf("  %lu of %lu fixes differ from brute force (%lu more lie on an edge)\n", (unsigned long)mismatches, (unsigned long)brute_count,
+           (unsigned long)on_edge);
+    return mismatches != 0;
+}
+
+int main(int argc, char **argv){
+    uint16_t polygons = (argc > 1) ? atoi(argv[1]) : 4096;
+    uint16_t grid = (argc > 2) ? atoi(argv[2]) : 64;
+    uint32_t fixes = (argc > 3) ? atoi(argv[3]) : 200000;
+    std::mt19937 rng((argc > 4) ? atoi(argv[4]) : 1);
+
+    int failures = check_firmware(rng) + benchmark(rng, polygons, grid, fixes);
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
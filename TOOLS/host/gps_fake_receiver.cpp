@@ -0,0 +1,577 @@
+/* Host harness of the GPS start (gps_thread.cpp, gps_config.cpp, persist.cpp): a scripted fake receiver answers on the
+ * other end of the UART and follows a TTFF model, so cold, hot and aided boots can be compared without a board.
+ *
+ * Each boot is a fork() of this process: the statics of gps_thread.cpp start over while the simulated clock, the RTC,
+ * the flash (host_mbed.cpp) and the receiver backup domain (shared here) carry over, as they do on the board. The flash
+ * sectors each boot erases are counted: the GPS record must only be written when the position moved.
+ *
+ *   ./gps_fake_receiver        prints one line per boot and PASS/FAIL
+ */
+
+#include <deque>
+#include <string>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "mbed.h"
+#include "gps_thread.h"
+#include "message_q.h"
+#include "timebase.h"
+#include "persist.h"
+
+// ==============================================================================================
+// TTFF MODEL (assumptions, not measurements)
+// Figures of the MT3339 class receiver datasheet at -130 dBm: hot 1 s, warm 33 s, cold 35 s.
+// Hot needs an ephemeris younger than MODEL_EPHEMERIS_MAX_AGE_US plus the time. The datasheet warm
+// start also assumes the almanac is known; PMTK740/741 only give time and position, so a receiver
+// aided after losing its backup is counted as warm only if MODEL_WARM_NEEDS_ALMANAC is 0.
+// ==============================================================================================
+#define MODEL_TTFF_HOT_US          1000000ULL
+#define MODEL_TTFF_WARM_US         33000000ULL
+#define MODEL_TTFF_COLD_US         35000000ULL
+#define MODEL_EPHEMERIS_MAX_AGE_US (4ULL * 3600 * 1000000)
+#define MODEL_WARM_NEEDS_ALMANAC   0
+#define MODEL_REBOOT_US            300000ULL                     // Silent after PMTK101, commands sent meanwhile are lost
+#define MODEL_AID_TIME_TOLERANCE_S 3                             // PMTK740 further off is rejected
+#define MODEL_AID_POSITION_TOLERANCE_M 30000.0                   // PMTK741 further off is rejected
+#define MODEL_FACTORY_BAUD         9600
+
+// Where the receiver starts, how far it is carried in the boot that moves it, and the UTC of world tick 0
+#define TRUE_LATITUDE   40416775                                 // Micro-degrees
+#define TRUE_LONGITUDE  -3703790
+#define MOVE_LATITUDE   45000                                    // 5 km north
+#define TRUE_ALTITUDE   "657.0"
+#define WORLD_UTC0      1780300800                               // 2026-06-01 08:00:00 UTC
+
+#define UART_RX_BUFFER  256                                      // MBED_CONF_DRIVERS_UART_SERIAL_RXBUF_SIZE
+#define BOOT_LIMIT_US   60000000ULL                              // A boot without a fix by then fails
+#define BOOT_AFTER_FIX_US 3000000ULL                             // Run on after the first fix, unless the boot runs for longer
+
+// ==============================================================================================
+// SHARED STATE (survives the forked boots)
+// ==============================================================================================
+typedef struct {
+    bool ephemeris, almanac, rtc, position;                      // Receiver backup domain
+    uint64_t ephemeris_world_us;
+    int baud;                                                    // PMTK251 setting, kept with the backup domain
+    bool standby;                                                // Left in standby by gps_standby()
+} receiver_backup_t;
+
+typedef struct {
+    bool finished;
+    uint32_t ttff_ms;                                            // gps_get_ttff_ms()
+    uint32_t expected_ms;                                        // First fix epoch of the model minus the boot (the GPS task starts with it)
+    bool aided;                                                  // gps_is_aided_start()
+    const char *start;                                           // Start the model applied: hot, warm or cold
+    int hot_starts, aiding_accepted, aiding_rejected;
+    int commands_lost;                                           // Eaten by the standby wake, sent while the receiver reboots, or
+                                                                 // other than PMTK251 sent at the factory baud to a switched receiver
+    int checksum_errors;
+    int receiver_baud, mcu_baud;
+    uint32_t rx_overflow;
+    bool record_ok;                                              // Newest flash record is where the receiver is
+    uint32_t erases;                                             // Flash sectors erased by this boot
+} boot_result_t;
+
+typedef struct {
+    receiver_backup_t backup;
+    int32_t latitude, longitude;                                 // Where the receiver is
+    boot_result_t result;
+} shared_t;
+static shared_t *shared;
+
+// Same layout as gps_fix_record_t in gps_thread.cpp (persist_load checks the size)
+typedef struct {
+    int32_t latitude, longitude;
+    int16_t altitude;
+    uint32_t utc_time;
+} gps_fix_record_t;
+
+// Newest copy of the record, as gps_thread.cpp picks it
+static bool load_newest_record(gps_fix_record_t *newest, int *copies = nullptr){
+    bool found = false;
+    int valid = 0;
+    for(uint8_t copy = 0; copy < PERSIST_GPS_COPIES; copy++){
+        gps_fix_record_t record;
+        if(persist_load_copy(PERSIST_SLOT_GPS, copy, &record, sizeof(record))){
+            valid++;
+            if(!found || record.utc_time > newest->utc_time){
+                *newest = record;
+                found = true;
+            }
+        }
+    }
+    if(copies != nullptr){
+        *copies = valid;
+    }
+    return found;
+}
+
+// ==============================================================================================
+// FAKE RECEIVER
+// ==============================================================================================
+static struct {
+    int baud;
+    bool standby;
+    bool time_known, position_known;
+    uint64_t nav_start_us, fix_at_us, silent_until_us;           // World ticks
+    bool fixed;
+    uint64_t first_fix_epoch_us;
+    const char *start;                                           // Start of the model that gave the fix
+    uint64_t next_epoch_us, period_us;
+    bool filtered;                                               // PMTK314 received: GGA and RMC only
+    std::deque<std::pair<uint64_t, char>> tx;                    // Bytes on the line, with their arrival tick
+    std::string command;
+} rx;
+
+// MCU side of the UART (BufferedSerial below)
+static struct {
+    int baud;
+    bool blocking = true, input = true, output = true;
+} uart;
+static std::deque<char> &uart_fifo(){
+    static std::deque<char> fifo;
+    return fifo;
+}
+
+static uint64_t world_utc(uint64_t world_us){
+    return WORLD_UTC0 + world_us / 1000000;
+}
+
+static uint64_t model_ttff(){
+    bool ephemeris = shared->backup.ephemeris && rx.nav_start_us - shared->backup.ephemeris_world_us < MODEL_EPHEMERIS_MAX_AGE_US;
+    if(ephemeris && rx.time_known){
+        return MODEL_TTFF_HOT_US;
+    }
+    if(rx.time_known && rx.position_known && (shared->backup.almanac || !MODEL_WARM_NEEDS_ALMANAC)){
+        return MODEL_TTFF_WARM_US;
+    }
+    return MODEL_TTFF_COLD_US;
+}
+
+static const char *model_start_name(uint64_t ttff){
+    return (ttff == MODEL_TTFF_HOT_US) ? "hot" : (ttff == MODEL_TTFF_WARM_US) ? "warm" : "cold";
+}
+
+// Start navigating with what the backup domain holds (power up, standby wake or PMTK101)
+static void receiver_start(uint64_t now){
+    rx.nav_start_us = now;
+    rx.time_known = shared->backup.rtc;
+    rx.position_known = shared->backup.position;
+    rx.fix_at_us = now + model_ttff();
+    rx.fixed = false;
+}
+
+static void receiver_power_up(uint64_t now){
+    rx.baud = shared->backup.baud;
+    rx.standby = shared->backup.standby;
+    rx.next_epoch_us = (now / 1000000 + 1) * 1000000;
+    rx.period_us = 1000000;
+    rx.filtered = false;
+    rx.silent_until_us = 0;
+    receiver_start(now);
+}
+
+// A better knowledge only brings the fix forward
+static void receiver_learned(uint64_t now){
+    uint64_t fix_at = rx.nav_start_us + model_ttff();
+    fix_at = (fix_at < now) ? now : fix_at;
+    rx.fix_at_us = (fix_at < rx.fix_at_us) ? fix_at : rx.fix_at_us;
+}
+
+static void send_sentence(const char *body, uint64_t now){
+    char sentence[128];
+    uint8_t checksum = 0;
+    for(const char *p = body; *p != '\0'; p++){
+        checksum ^= *p;
+    }
+    snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+
+    uint64_t at = rx.tx.empty() ? now : rx.tx.back().first;
+    uint64_t byte_us = 10000000ULL / rx.baud;                    // 8N1
+    for(const char *p = sentence; *p != '\0'; p++){
+        at += byte_us;
+        rx.tx.push_back({at, *p});
+    }
+}
+
+static void format_coordinate(char *out, size_t size, int32_t microdeg, int degree_digits, char positive, char negative){
+    uint32_t magnitude = (microdeg < 0) ? -microdeg : microdeg;
+    uint32_t minutes_e4 = (magnitude % 1000000) * 60 / 100;      // Minutes with 4 decimals
+    snprintf(out, size, "%0*u%02u.%04u,%c", degree_digits, (unsigned)(magnitude / 1000000), (unsigned)(minutes_e4 / 10000),
+             (unsigned)(minutes_e4 % 10000), (microdeg < 0) ? negative : positive);
+}
+
+static void receiver_epoch(uint64_t now){
+    if(!rx.fixed && now >= rx.fix_at_us){
+        rx.start = model_start_name(model_ttff());
+        rx.fixed = true;
+        rx.time_known = rx.position_known = true;
+        rx.first_fix_epoch_us = now;
+        shared->backup.ephemeris = shared->backup.almanac = shared->backup.rtc = shared->backup.position = true;
+    }
+    if(rx.fixed){
+        shared->backup.ephemeris_world_us = now;                 // Kept fresh while it tracks
+    }
+
+    time_t utc = (time_t)world_utc(now);
+    struct tm t;
+    gmtime_r(&utc, &t);
+    char hms[24] = "", date[24] = "", lat[24], lon[24], body[100];
+    if(rx.time_known){
+        snprintf(hms, sizeof(hms), "%02d%02d%02d.000", t.tm_hour, t.tm_min, t.tm_sec);
+        snprintf(date, sizeof(date), "%02d%02d%02d", t.tm_mday, t.tm_mon + 1, t.tm_year % 100);
+    }
+    format_coordinate(lat, sizeof(lat), shared->latitude, 2, 'N', 'S');
+    format_coordinate(lon, sizeof(lon), shared->longitude, 3, 'E', 'W');
+
+    if(rx.fixed){
+        snprintf(body, sizeof(body), "GPGGA,%s,%s,%s,1,08,0.95,%s,M,50.0,M,,", hms, lat, lon, TRUE_ALTITUDE);
+    }else{
+        snprintf(body, sizeof(body), "GPGGA,%s,,,,,0,00,,,M,,M,,", hms);
+    }
+    send_sentence(body, now);
+    if(!rx.filtered){
+        send_sentence(rx.fixed ? "GPGSA,A,3,01,03,08,11,14,17,22,28,,,,,1.72,0.95,1.43" : "GPGSA,A,1,,,,,,,,,,,,,,,", now);
+    }
+    if(rx.fixed){
+        snprintf(body, sizeof(body), "GPRMC,%s,A,%s,%s,0.00,0.00,%s,,,A", hms, lat, lon, date);
+    }else{
+        snprintf(body, sizeof(body), "GPRMC,%s,V,,,,,0.00,0.00,%s,,,N", hms, date);
+    }
+    send_sentence(body, now);
+    if(!rx.filtered){
+        send_sentence("GPVTG,0.00,T,,M,0.00,N,0.00,K,A", now);
+    }
+}
+
+static bool parse_aiding_time(const char *args, uint64_t now){
+    struct tm t = {};
+    if(sscanf(args, "%d,%d,%d,%d,%d,%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) != 6){
+        return false;
+    }
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    long long error = (long long)timegm(&t) - (long long)world_utc(now);
+    return llabs(error) <= MODEL_AID_TIME_TOLERANCE_S;
+}
+
+static bool parse_aiding_position(const char *args){
+    double lat, lon, alt;
+    if(sscanf(args, "%lf,%lf,%lf", &lat, &lon, &alt) != 3){
+        return false;
+    }
+    double north_m = (lat - shared->latitude / 1e6) * 111320.0;
+    double east_m = (lon - shared->longitude / 1e6) * 111320.0 * cos(lat * M_PI / 180.0);
+    return sqrt(north_m * north_m + east_m * east_m) <= MODEL_AID_POSITION_TOLERANCE_M;
+}
+
+static void receiver_command(const std::string &line, uint64_t now){
+    // $body*hh
+    if(line.empty() || line[0] != '$'){
+        shared->result.commands_lost++;                          // Its '$' was eaten, the receiver drops the line
+        return;
+    }
+    size_t star = line.find('*');
+    if(star == std::string::npos || star + 3 > line.size()){
+        shared->result.checksum_errors++;
+        return;
+    }
+    std::string body = line.substr(1, star - 1);
+    uint8_t checksum = 0;
+    for(char c : body){
+        checksum ^= c;
+    }
+    if(strtoul(line.substr(star + 1, 2).c_str(), nullptr, 16) != checksum){
+        shared->result.checksum_errors++;
+        return;
+    }
+
+    const char *args = strchr(body.c_str(), ',');
+    args = (args != nullptr) ? args + 1 : "";
+    if(body.compare(0, 7, "PMTK251") == 0){
+        rx.baud = atoi(args);
+        shared->backup.baud = rx.baud;
+    }else if(body == "PMTK101"){
+        shared->result.hot_starts++;
+        rx.silent_until_us = now + MODEL_REBOOT_US;
+        rx.tx.clear();
+        receiver_start(now);
+    }else if(body.compare(0, 7, "PMTK740") == 0 || body.compare(0, 7, "PMTK741") == 0){
+        bool is_time = (body[6] == '0');
+        if(is_time ? parse_aiding_time(args, now) : parse_aiding_position(args)){
+            (is_time ? rx.time_known : rx.position_known) = true;
+            shared->result.aiding_accepted++;
+            receiver_learned(now);
+        }else{
+            shared->result.aiding_rejected++;
+            fprintf(stderr, "  rejected aiding: %s\n", body.c_str());
+        }
+    }else if(body.compare(0, 7, "PMTK314") == 0){
+        rx.filtered = true;
+    }else if(body.compare(0, 7, "PMTK220") == 0){
+        rx.period_us = (uint64_t)atoi(args) * 1000;
+    }else if(body.compare(0, 7, "PMTK161") == 0){
+        rx.standby = true;
+        shared->backup.standby = true;
+    }
+}
+
+// A byte written by the MCU at the UART baud
+static void receiver_receive(char c, uint64_t now){
+    if(rx.standby){
+        rx.standby = false;                                      // Any byte wakes it up, this one is lost
+        shared->backup.standby = false;
+        rx.next_epoch_us = (now / 1000000 + 1) * 1000000;
+        receiver_start(now);
+        return;
+    }
+    if(uart.baud != rx.baud){
+        return;                                                  // Garbage at its baud, PMTK251 only (checked by the caller)
+    }
+    if(now < rx.silent_until_us){
+        if(c == '\n'){
+            shared->result.commands_lost++;                      // Sent while it reboots
+        }
+        return;
+    }
+    rx.command += c;
+    if(c == '\n'){
+        receiver_command(rx.command.substr(0, rx.command.find('\r')), now);
+        rx.command.clear();
+    }
+}
+
+// Everything due up to now, returns the world tick of the next receiver event
+static uint64_t receiver_run(uint64_t now){
+    while(!rx.standby && now >= rx.next_epoch_us){
+        if(now >= rx.silent_until_us){
+            receiver_epoch(rx.next_epoch_us);
+        }
+        rx.next_epoch_us += rx.period_us;
+    }
+    while(!rx.tx.empty() && rx.tx.front().first <= now){
+        char c = rx.tx.front().second;
+        rx.tx.pop_front();
+        if(uart.input){
+            if(uart_fifo().size() >= UART_RX_BUFFER){
+                shared->result.rx_overflow++;
+            }else{
+                uart_fifo().push_back(uart.baud == rx.baud ? c : (char)(c | 0x80));  // Wrong baud: framing garbage, never a '$'
+            }
+        }
+    }
+    uint64_t next = rx.standby ? UINT64_MAX : rx.next_epoch_us;
+    return (!rx.tx.empty() && rx.tx.front().first < next) ? rx.tx.front().first : next;
+}
+// FAKE RECEIVER END ============================================================================
+
+// ==============================================================================================
+// MCU SIDE: BufferedSerial, and what gps_thread.cpp needs from the other modules
+// ==============================================================================================
+BufferedSerial::BufferedSerial(PinName tx, PinName rx, int baud){ uart.baud = baud; }
+void BufferedSerial::set_baud(int baud){ uart.baud = baud; }
+void BufferedSerial::set_format(int bits, Parity parity, int stop_bits){}
+bool BufferedSerial::readable() const { return !uart_fifo().empty(); }
+int BufferedSerial::set_blocking(bool blocking){ uart.blocking = blocking; return 0; }
+int BufferedSerial::sync(){ return 0; }                          // Bytes reach the receiver as they are written
+int BufferedSerial::enable_input(bool enabled){ uart.input = enabled; return 0; }
+int BufferedSerial::enable_output(bool enabled){ uart.output = enabled; return 0; }
+
+ssize_t BufferedSerial::read(void *buffer, size_t length){
+    if(uart_fifo().empty()){
+        if(uart.blocking){
+            fprintf(stderr, "FAIL: blocking read on an empty UART, the step would hang\n");
+            exit(1);
+        }
+        return -EAGAIN;
+    }
+    size_t n = 0;
+    for(; n < length && !uart_fifo().empty(); n++){
+        ((char *)buffer)[n] = uart_fifo().front();
+        uart_fifo().pop_front();
+    }
+    return n;
+}
+
+ssize_t BufferedSerial::write(const void *buffer, size_t length){
+    if(!uart.output){
+        return length;
+    }
+    bool baud_mismatch = (uart.baud != rx.baud) && !rx.standby;
+    for(size_t i = 0; i < length; i++){
+        receiver_receive(((const char *)buffer)[i], host_world_us());
+    }
+    if(baud_mismatch && strncmp((const char *)buffer, "$PMTK251", 8) != 0){
+        shared->result.commands_lost++;                          // Only the baud switch is expected to go out at a stale baud
+    }
+    return length;
+}
+
+uint64_t timebase_now_us(){ return host_now_us(); }
+
+void pack_GPS_message(message_t_gps *message, uint64_t tick_us, uint8_t fix_status, uint8_t gps_hour, uint8_t gps_minute, uint16_t gps_millis,
+                      int32_t latitude, int32_t longitude, float altitude, const uint16_t *geofence_events){
+    message->tick_us = tick_us;
+    message->fix_status = fix_status;
+    message->gps_hour = gps_hour;
+    message->gps_minute = gps_minute;
+    message->gps_millis = gps_millis;
+    message->latitude = latitude;
+    message->longitude = longitude;
+    message->altitude = metres_to_decimetres(altitude);
+    memcpy(message->geofence_events, geofence_events, sizeof(message->geofence_events));
+}
+void update_latest_GPS(const message_t_gps *message){}
+void send_GPS_message_through_main_thread(const message_t_gps *message){}
+// MCU SIDE END =================================================================================
+
+// ==============================================================================================
+// BOOTS
+// ==============================================================================================
+typedef struct {
+    const char *name;
+    uint64_t off_us;                                             // Time since the previous boot
+    bool receiver_backup_lost;                                   // GPS supply cut: backup domain and baud lost
+    bool rtc_lost;                                               // MCU supply cut as well
+    bool erase_record;                                           // No persisted fix (first boot, or to compare)
+    uint64_t run_us;                                             // How long the boot runs, 0 until shortly after the first fix
+    uint64_t move_at_us;                                         // When the receiver is carried MOVE_LATITUDE north, 0 never
+    const char *expected_start;
+    bool expected_aided;
+    int expected_hot_starts;                                     // PMTK101 received (none: it would restart the search)
+    int expected_aiding;                                         // PMTK740/741 accepted
+    int expected_lost;                                           // Commands the receiver never saw
+    uint32_t expected_erases;                                    // One sector per record written
+} boot_t;
+
+// A standby wake eats the first byte sent, now the PMTK251 that follows the silent probe at the target baud
+// Boots that start where the record was saved write nothing, the hourly checks of a long run neither; moving does
+static const boot_t BOOTS[] = {
+    {"first boot, factory receiver",           0,                  true,  true,  true,  0, 0, "cold", false, 0, 0, 0, 1},
+    {"standby wake, 20 min off",               20 * 60000000ULL,   false, false, false, 0, 0, "hot",  true,  0, 2, 0, 0},
+    {"standby wake, 6 h off (stale ephemeris)", 6 * 3600000000ULL, false, false, false, 0, 0, "warm", true,  0, 2, 0, 0},
+    {"GPS supply cut, RTC kept, 20 min off",   20 * 60000000ULL,   true,  false, false, 0, 0, "warm", true,  0, 2, 0, 0},
+    {"same, without the persisted fix",        20 * 60000000ULL,   true,  false, true,  0, 0, "cold", false, 0, 0, 0, 1},
+    {"GPS and MCU supply cut, 20 min off",     20 * 60000000ULL,   true,  true,  false, 0, 0, "cold", false, 0, 0, 0, 0},  // RTC behind the record: no aiding
+    {"standby wake, 26 h on in the same place", 20 * 60000000ULL,  false, false, false, 26 * 3600000000ULL, 0, "hot", true, 0, 2, 0, 0},
+    {"standby wake, 3 h on, moved 5 km at 1.5 h", 20 * 60000000ULL, false, false, false, 3 * 3600000000ULL, 5400000000ULL, "hot", true, 0, 2, 0, 1},
+};
+#define BOOT_COUNT (sizeof(BOOTS) / sizeof(BOOTS[0]))
+
+// Child: one boot of the GPS task until shortly after the first fix or for the run of the boot, then standby as before a shutdown
+static void run_boot(const boot_t *b){
+    host_reboot();
+    uint64_t boot_us = host_world_us();
+    receiver_power_up(boot_us);
+    uart_fifo().clear();
+    uint32_t erases = host_flash_erase_count();
+
+    uint64_t next_step_us = 0;
+    gps_fix_record_t record;
+    while(b->run_us ? host_now_us() < b->run_us : host_now_us() < BOOT_LIMIT_US){
+        if(host_now_us() >= next_step_us){
+            next_step_us = host_now_us() + (uint64_t)gps_step(0).count() * 1000;
+        }
+        if(b->run_us == 0 && gps_get_ttff_ms() != 0 && host_now_us() >= gps_get_ttff_ms() * 1000ULL + BOOT_AFTER_FIX_US){
+            break;
+        }
+        if(b->move_at_us != 0 && host_now_us() >= b->move_at_us && shared->latitude == TRUE_LATITUDE){
+            shared->latitude += MOVE_LATITUDE;
+        }
+        uint64_t next_rx_us = receiver_run(host_world_us()) - (host_world_us() - host_now_us());
+        uint64_t next_us = (next_rx_us < next_step_us) ? next_rx_us : next_step_us;
+        host_advance_us((next_us > host_now_us()) ? next_us - host_now_us() : 0);
+    }
+
+    boot_result_t *r = &shared->result;
+    r->ttff_ms = gps_get_ttff_ms();
+    r->aided = gps_is_aided_start();
+    r->start = rx.start;
+    r->expected_ms = (uint32_t)((rx.first_fix_epoch_us - boot_us) / 1000);
+    r->receiver_baud = rx.baud;
+    r->mcu_baud = uart.baud;
+    r->record_ok = load_newest_record(&record) && record.latitude == shared->latitude && record.longitude == shared->longitude;
+    r->erases = host_flash_erase_count() - erases;
+    r->finished = rx.fixed;
+
+    gps_standby();
+    while(!rx.tx.empty()){
+        receiver_run(rx.tx.back().first);
+    }
+}
+
+int main(){
+    setenv("TZ", "UTC", 1);                                      // newlib mktime() has no time zone either
+    tzset();
+
+    shared = (shared_t *)mmap(nullptr, sizeof(shared_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(shared == MAP_FAILED){
+        perror("mmap");
+        return 2;
+    }
+
+    printf("TTFF model: hot %llu s, warm %llu s, cold %llu s, warm %s the almanac\n", MODEL_TTFF_HOT_US / 1000000, MODEL_TTFF_WARM_US / 1000000,
+           MODEL_TTFF_COLD_US / 1000000, MODEL_WARM_NEEDS_ALMANAC ? "needs" : "does not need");
+    printf("%-42s %5s %9s %9s %5s %4s %6s %4s %6s %6s\n", "boot", "start", "ttff ms", "model ms", "aided", "hot", "aiding", "lost", "baud", "erases");
+
+    shared->latitude = TRUE_LATITUDE;
+    shared->longitude = TRUE_LONGITUDE;
+    bool pass = true;
+    uint32_t ttff[BOOT_COUNT] = {};
+    uint32_t erases = 0;
+    for(size_t i = 0; i < BOOT_COUNT; i++){
+        const boot_t *b = &BOOTS[i];
+        host_advance_us(b->off_us);
+        if(b->receiver_backup_lost){
+            shared->backup = {false, false, false, false, 0, MODEL_FACTORY_BAUD, false};
+        }
+        if(b->rtc_lost){
+            host_rtc_lose();
+        }
+        if(b->erase_record){
+            persist_erase(PERSIST_SLOT_GPS);
+        }
+        memset(&shared->result, 0, sizeof(shared->result));
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if(pid == 0){
+            run_boot(b);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+
+        const boot_result_t *r = &shared->result;
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && r->finished && r->record_ok
+                  && strcmp(r->start, b->expected_start) == 0 && r->aided == b->expected_aided && r->aiding_accepted == b->expected_aiding
+                  && r->aiding_rejected == 0 && r->hot_starts == b->expected_hot_starts && r->commands_lost == b->expected_lost
+                  && r->checksum_errors == 0 && r->rx_overflow == 0 && r->receiver_baud == 115200 && r->mcu_baud == 115200 && r->erases == b->expected_erases
+                  && r->ttff_ms >= r->expected_ms && r->ttff_ms <= r->expected_ms + 520;  // Stamped when the 500 ms drain reads the '$'
+        ttff[i] = r->ttff_ms;
+        printf("%-42s %5s %9lu %9lu %5s %4d %6d %4d %6d %6lu%s\n", b->name, r->start ? r->start : "-", (unsigned long)r->ttff_ms, (unsigned long)r->expected_ms,
+               r->aided ? "yes" : "no", r->hot_starts, r->aiding_accepted, r->commands_lost, r->receiver_baud, (unsigned long)r->erases, ok ? "" : "  <- FAIL");
+        if(!ok){
+            printf("  finished %d, record %d, rejected %d, checksum errors %d, overflow %lu, mcu baud %d\n", r->finished, r->record_ok, r->aiding_rejected,
+                   r->checksum_errors, (unsigned long)r->rx_overflow, r->mcu_baud);
+        }
+        pass = pass && ok;
+        erases += r->erases;
+    }
+
+    // Hot after a standby comes from the receiver backup domain; only the supply cut pair isolates the persisted fix. Without
+    // the RTC the persisted fix can not be used, and that boot must not be slower than one without it.
+    pass = pass && ttff[1] < ttff[0] && ttff[3] < ttff[4] && ttff[5] <= ttff[4];
+    printf("Hot vs cold: %.1f s. Persisted fix after a GPS supply cut: %.1f s saved (per the model)\n",
+           (ttff[0] - (double)ttff[1]) / 1000.0, (ttff[4] - (double)ttff[3]) / 1000.0);
+
+    // The move is written to the copy after the one saved at the erased boot, not over it
+    gps_fix_record_t newest;
+    int copies = 0;
+    pass = pass && load_newest_record(&newest, &copies) && copies == 2 && newest.latitude == TRUE_LATITUDE + MOVE_LATITUDE;
+    printf("GPS record: %lu sectors erased over %zu boots, %d copies in flash\n", (unsigned long)erases, BOOT_COUNT, copies);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
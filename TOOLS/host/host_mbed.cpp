@@ -0,0 +1,87 @@
+/* Host stand-in for the mbed OS state the harnesses share: simulated clock, RTC and flash */
+
+#include "mbed.h"
+#include <sys/mman.h>
+
+typedef struct {
+    uint64_t world_us;                                           // Since the harness started
+    uint64_t boot_us;                                            // world_us of the current boot
+    bool rtc_running;
+    int64_t rtc_offset_s;                                        // RTC = offset + world seconds
+    uint32_t erase_count;
+    uint8_t flash[HOST_FLASH_SIZE];
+} host_state_t;
+
+// Shared mapping, so the boots a harness forks see the same clock, RTC and flash
+static host_state_t *state(){
+    static host_state_t *s = nullptr;
+    if(s == nullptr){
+        void *p = mmap(nullptr, sizeof(host_state_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED){
+            perror("mmap");
+            exit(2);
+        }
+        s = (host_state_t *)p;                                   // Zero filled: erased flash, RTC stopped
+    }
+    return s;
+}
+
+// CLOCK AND RTC ================================================================================
+uint64_t host_now_us(){ return state()->world_us - state()->boot_us; }
+uint64_t host_world_us(){ return state()->world_us; }
+void host_advance_us(uint64_t us){ state()->world_us += us; }
+void host_reboot(){ state()->boot_us = state()->world_us; }
+void host_rtc_lose(){ state()->rtc_running = false; }
+
+#undef time
+time_t host_time(time_t *t){
+    time_t now = state()->rtc_running ? (time_t)(state()->rtc_offset_s + (int64_t)(state()->world_us / 1000000)) : 0;
+    if(t != nullptr){
+        *t = now;
+    }
+    return now;
+}
+
+void set_time(time_t t){
+    state()->rtc_offset_s = (int64_t)t - (int64_t)(state()->world_us / 1000000);
+    state()->rtc_running = true;
+}
+
+// FLASH ========================================================================================
+// Same checks as the STM32 flash_api: in range, program in whole pages, erase in whole sectors
+static bool in_flash(uint32_t addr, uint32_t size){
+    return addr >= HOST_FLASH_START && size <= HOST_FLASH_SIZE && addr - HOST_FLASH_START <= HOST_FLASH_SIZE - size;
+}
+
+int FlashIAP::read(void *buffer, uint32_t addr, uint32_t size){
+    if(!in_flash(addr, size)){
+        return -1;
+    }
+    memcpy(buffer, &state()->flash[addr - HOST_FLASH_START], size);
+    return 0;
+}
+
+int FlashIAP::program(const void *buffer, uint32_t addr, uint32_t size){
+    if(!in_flash(addr, size) || addr % HOST_FLASH_PAGE != 0 || size % HOST_FLASH_PAGE != 0){
+        return -1;
+    }
+    uint8_t *flash = &state()->flash[addr - HOST_FLASH_START];
+    for(uint32_t i = 0; i < size; i++){
+        if(flash[i] != get_erase_value()){
+            return -1;                                           // Programming over data: the slot was not erased first
+        }
+    }
+    memcpy(flash, buffer, size);
+    return 0;
+}
+
+int FlashIAP::erase(uint32_t addr, uint32_t size){
+    if(!in_flash(addr, size) || addr % HOST_FLASH_SECTOR != 0 || size % HOST_FLASH_SECTOR != 0){
+        return -1;
+    }
+    memset(&state()->flash[addr - HOST_FLASH_START], get_erase_value(), size);
+    state()->erase_count += size / HOST_FLASH_SECTOR;
+    return 0;
+}
+
+uint32_t host_flash_erase_count(){ return state()->erase_count; }
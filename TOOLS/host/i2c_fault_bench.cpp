@@ -0,0 +1,209 @@
+/* Host harness of the I2C error handling (i2c_bus.cpp through the si7021.cpp and tcs34725.cpp drivers) on the fault
+ * injecting fake bus (fake_i2c.cpp): retry only while the device budget lasts, recover the bus only when SDA is held,
+ * and never hand back data from a failed read. The budget limits the retries, it can not cut an attempt short: only a
+ * slave stretching the clock may take a transaction past it, up to the i2c_api byte timeout (the bound).
+ *
+ *   ./i2c_fault_bench          one line per scripted fault, then a random soak, PASS/FAIL
+ */
+
+#include <random>
+#include <math.h>
+#include "mbed.h"
+#include "fake_i2c.h"
+#include "i2c_bus.h"
+#include "si7021.h"
+#include "tcs34725.h"
+
+// Same as DEVICES[] in i2c_bus.cpp, retry budgets
+#define BUDGET_SI7021_US    30000
+#define BUDGET_TCS34725_US  2000
+
+#define SOAK_OPERATIONS     30000
+#define SOAK_SEED           7
+
+uint64_t timebase_now_us(){ return host_now_us(); }
+
+// ==============================================================================================
+// DEVICES AND OPERATIONS
+// ==============================================================================================
+static FakeSi7021 si7021(FAKE_I2C_DIRECT, 55.0f, 21.5f);
+static FakeTCS34725 tcs34725(FAKE_I2C_DIRECT, 1200, 400, 500, 300);
+static i2c_probe_t si7021_probe = {I2C_DEV_SI7021, SI7021_ADDR, I2C_MUX_NONE, 0, true, {}};
+static i2c_probe_t tcs34725_probe = {I2C_DEV_TCS34725, TCS34725_ADDRESS, I2C_MUX_NONE, 0, true, {}};
+
+typedef enum { OP_HUMIDITY, OP_TEMPERATURE, OP_COLOUR, OP_COUNT } op_t;
+
+typedef struct {
+    bool ok;                                                     // What the driver returned
+    bool data_ok;                                                // Right values when ok, outputs untouched when not
+    uint32_t latency_us;
+} op_result_t;
+
+static op_result_t run(op_t op){
+    op_result_t r;
+    uint64_t start_us = host_now_us();
+    if(op == OP_COLOUR){
+        const uint16_t untouched = 0xDEAD;
+        uint16_t c = untouched, red = untouched, g = untouched, b = untouched;
+        r.ok = tcs34725_read_rgbc(&tcs34725_probe, &c, &red, &g, &b);
+        r.data_ok = r.ok ? (c == 1200 && red == 400 && g == 500 && b == 300)
+                         : (c == untouched && red == untouched && g == untouched && b == untouched);
+    }else{
+        float value = NAN;
+        r.ok = (op == OP_HUMIDITY) ? read_humidity(&si7021_probe, &value) : read_temperature(&si7021_probe, &value);
+        float expected = (op == OP_HUMIDITY) ? si7021.raw_humidity * (125.0f / 65536.0f) - 6.0f
+                                             : si7021.raw_temperature * (175.72f / 65536.0f) - 46.85f;
+        r.data_ok = r.ok ? (value == expected) : isnan(value);
+    }
+    r.latency_us = (uint32_t)(host_now_us() - start_us);
+    return r;
+}
+
+static i2c_probe_t *probe_of(op_t op){
+    return (op == OP_COLOUR) ? &tcs34725_probe : &si7021_probe;
+}
+
+static uint32_t budget_of(op_t op){
+    return (op == OP_COLOUR) ? BUDGET_TCS34725_US : BUDGET_SI7021_US;
+}
+
+// Worst a transaction may take: the budget is checked between attempts, so the last one may end past it (bounded by
+// the i2c_api timeout of its read), plus the bus recovery
+static uint32_t bound_of(op_t op){
+    int rx_len = (op == OP_COLOUR) ? 8 : 2;
+    return budget_of(op) + (rx_len + 1) * FAKE_I2C_BYTE_TIMEOUT_US + 4 * FAKE_I2C_BYTE_US + 2 * I2C_RECOVERY_CLOCKS * I2C_RECOVERY_HALF_PERIOD_US + 50;
+}
+
+static void reset_counters(){
+    memset(&si7021_probe.health, 0, sizeof(i2c_health_t));
+    memset(&tcs34725_probe.health, 0, sizeof(i2c_health_t));
+    memset(&fake_i2c_stats, 0, sizeof(fake_i2c_stats));
+}
+// DEVICES AND OPERATIONS END ===================================================================
+
+// ==============================================================================================
+// SCRIPTED FAULTS
+// ==============================================================================================
+typedef struct {
+    const char *name;
+    op_t op;
+    void (*inject)();
+    bool ok;                                                     // Expected outcome
+    uint32_t retries, recoveries, over_budget;
+} scenario_t;
+
+static const scenario_t SCENARIOS[] = {
+    {"Si7021 RH, healthy",                   OP_HUMIDITY,    []{},                                   true,  0, 0, 0},
+    {"TCS34725 RGBC, healthy",               OP_COLOUR,      []{},                                   true,  0, 0, 0},
+    {"Si7021 NACKs once (busy)",             OP_TEMPERATURE, []{ si7021.nack = 1; },                 true,  1, 0, 0},
+    {"TCS34725 NACKs twice",                 OP_COLOUR,      []{ tcs34725.nack = 2; },               false, 1, 0, 0},  // Budget holds 2 attempts
+    {"Si7021 absent",                        OP_HUMIDITY,    []{ si7021.absent = true; },            false, 2, 0, 0},
+    {"TCS34725 absent",                      OP_COLOUR,      []{ tcs34725.absent = true; },          false, 1, 0, 0},
+    {"TCS34725 holds SDA low",               OP_COLOUR,      []{ tcs34725.stick = 1; },              false, 1, 1, 0},
+    {"Si7021 stretches past the i2c timeout", OP_HUMIDITY,   []{ si7021.stretch_us = 40000; },       false, 0, 0, 0},
+    {"TCS34725 answers after its budget",    OP_COLOUR,      []{ tcs34725.stretch_us = 1500; },      false, 0, 1, 1},
+};
+
+static bool run_scenarios(){
+    bool pass = true;
+    printf("%-40s %6s %7s %10s %11s %10s %9s\n", "fault", "result", "retries", "recoveries", "over budget", "latency us", "budget us");
+    for(const scenario_t &s : SCENARIOS){
+        reset_counters();
+        si7021.absent = tcs34725.absent = false;
+        s.inject();
+
+        op_result_t r = run(s.op);
+        const i2c_health_t *h = &probe_of(s.op)->health;
+        bool after_ok = (si7021.absent = tcs34725.absent = false, run(OP_HUMIDITY).ok && run(OP_COLOUR).ok);  // Bus usable again
+        bool ok = r.ok == s.ok && r.data_ok && h->retries == s.retries && h->recoveries == s.recoveries && h->over_budget == s.over_budget
+                  && fake_i2c_stats.stops == s.recoveries && !fake_i2c_sda_stuck()              // A recovery frees SDA and ends with a STOP
+                  && h->transactions == 2 && h->failures == (s.ok ? 0u : 1u)
+                  && (r.latency_us <= budget_of(s.op) || s.over_budget) && r.latency_us <= bound_of(s.op) && after_ok;
+        printf("%-40s %6s %7lu %10lu %11lu %10lu %9lu%s\n", s.name, r.ok ? "ok" : "failed", (unsigned long)h->retries, (unsigned long)h->recoveries,
+               (unsigned long)h->over_budget, (unsigned long)r.latency_us, (unsigned long)budget_of(s.op), ok ? "" : "  <- FAIL");
+        pass = pass && ok;
+    }
+    return pass;
+}
+// SCRIPTED FAULTS END ==========================================================================
+
+// ==============================================================================================
+// RANDOM SOAK: faults drawn per operation, every result checked against the invariants
+// ==============================================================================================
+static bool run_soak(){
+    std::mt19937 rng(SOAK_SEED);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    reset_counters();
+
+    uint32_t ops[OP_COUNT] = {}, failed[OP_COUNT] = {}, worst[OP_COUNT] = {}, violations = 0;
+    uint32_t late = 0, late_stretched = 0;                       // Past the budget, and among them with a clock stretch injected
+    int unplugged[OP_COUNT] = {};                                // Operations left before the device is plugged back
+    for(int i = 0; i < SOAK_OPERATIONS; i++){
+        op_t op = (op_t)(rng() % OP_COUNT);
+        FakeI2CDevice *d = (op == OP_COLOUR) ? (FakeI2CDevice *)&tcs34725 : (FakeI2CDevice *)&si7021;
+        double p = chance(rng);
+        if(p < 0.03){
+            d->nack = 1 + rng() % 3;
+        }else if(p < 0.04){
+            d->stick = 1;
+        }else if(p < 0.05){
+            d->stretch_us = rng() % 40000;
+        }else if(p < 0.051 && unplugged[op] == 0){
+            unplugged[op] = 1 + rng() % 50;
+        }
+        d->absent = unplugged[op] > 0;
+        bool stretched = (d->stretch_us != 0);                   // Drawn now or left by an operation that failed before its read
+        unplugged[op] -= (unplugged[op] > 0);
+
+        op_result_t r = run(op);
+        ops[op]++;
+        failed[op] += !r.ok;
+        worst[op] = (r.latency_us > worst[op]) ? r.latency_us : worst[op];
+        if(!r.data_ok || r.latency_us > bound_of(op)){
+            violations++;
+        }
+        if(r.latency_us > budget_of(op)){
+            late++;
+            late_stretched += stretched;
+        }
+    }
+
+    // Faults cleared: every device must answer again, nothing left stuck
+    si7021.absent = tcs34725.absent = false;
+    si7021.nack = tcs34725.nack = 0;
+    si7021.stick = tcs34725.stick = 0;
+    si7021.stretch_us = tcs34725.stretch_us = 0;
+    bool clean = true;
+    for(int i = 0; i < 10; i++){
+        clean = clean && run(OP_HUMIDITY).ok && run(OP_COLOUR).ok;
+    }
+    clean = clean && !fake_i2c_sda_stuck() && si7021_probe.health.consecutive_failures == 0 && tcs34725_probe.health.consecutive_failures == 0;
+
+    printf("\nSoak, %d operations (seed %d), a fault drawn for ~5%% of them:\n", SOAK_OPERATIONS, SOAK_SEED);
+    for(i2c_probe_t *p : {&si7021_probe, &tcs34725_probe}){
+        i2c_bus_print_health(p);
+    }
+    uint32_t si_ops = ops[OP_HUMIDITY] + ops[OP_TEMPERATURE] + 10, si_failed = failed[OP_HUMIDITY] + failed[OP_TEMPERATURE];
+    bool consistent = si7021_probe.health.transactions == si_ops && si7021_probe.health.failures == si_failed
+                 && tcs34725_probe.health.transactions == ops[OP_COLOUR] + 10 && tcs34725_probe.health.failures == failed[OP_COLOUR];
+    printf("Worst latency: Si7021 RH %lu us, T %lu us (budget %d, bound %lu), TCS34725 %lu us (budget %d, bound %lu)\n",
+           (unsigned long)worst[OP_HUMIDITY], (unsigned long)worst[OP_TEMPERATURE], BUDGET_SI7021_US, (unsigned long)bound_of(OP_HUMIDITY),
+           (unsigned long)worst[OP_COLOUR], BUDGET_TCS34725_US, (unsigned long)bound_of(OP_COLOUR));
+    printf("Past their budget: %lu operations, %lu of them with a clock stretch injected\n", (unsigned long)late, (unsigned long)late_stretched);
+    printf("Bus: %lu transfers, %lu NACKs, %lu busy, %lu timeouts, %lu recoveries; %lu invariant violations, counters %s, bus %s after the faults\n",
+           (unsigned long)fake_i2c_stats.transfers, (unsigned long)fake_i2c_stats.nacks, (unsigned long)fake_i2c_stats.bus_busy,
+           (unsigned long)fake_i2c_stats.timeouts, (unsigned long)fake_i2c_stats.recoveries, (unsigned long)violations,
+           consistent ? "consistent" : "INCONSISTENT", clean ? "clean" : "NOT CLEAN");
+    return violations == 0 && late == late_stretched && consistent && clean;
+}
+// RANDOM SOAK END ==============================================================================
+
+int main(){
+    fake_i2c_attach(&si7021);
+    fake_i2c_attach(&tcs34725);
+
+    bool pass = run_scenarios();
+    pass = run_soak() && pass;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/* Host stress test of the latest-value cell (latest_value.h): one writer thread and several reader threads hammer a cell
+ * and every value read is checked for tearing and for going back in time; then the uncontended and contended read/write
+ * throughput, next to a mutex protected cell.
+ *
+ * A naive cell (one slot, no sequence) runs through the same checker first, to show the checker does catch torn reads.
+ * The board is single core, so the host threads (preemption, and real parallelism when there are several cores) are a
+ * harsher test than the firmware ever sees.
+ *
+ *   ./latest_value_stress      [seconds per run, default 1]
+ */
+
+#include <thread>
+#include <vector>
+#include "mbed.h"
+#include "latest_value.h"
+#include "message_q.h"
+
+#define READERS 3
+
+// ==============================================================================================
+// VALUES: every field derived from one sequence number, so a mix of two writes shows
+// ==============================================================================================
+static void fill(message_t_sensors *m, uint32_t n){
+    m->tick_us = n;
+    m->ax = m->ay = m->az = (int16_t)n;
+    m->moistPercAnalogValue = m->lightPercAnalogValue = (uint16_t)n;
+    m->clear = m->red = m->green = m->blue = (uint16_t)n;
+    m->temperature = m->humidity = (int16_t)n;
+    m->alarms = (uint16_t)n;
+    m->valid = m->anomalies = m->probe_id = (uint8_t)n;
+}
+
+static bool check(const message_t_sensors *m, uint32_t *n){
+    *n = (uint32_t)m->tick_us;
+    return m->tick_us == *n && m->ax == (int16_t)*n && m->ay == (int16_t)*n && m->az == (int16_t)*n
+        && m->moistPercAnalogValue == (uint16_t)*n && m->lightPercAnalogValue == (uint16_t)*n
+        && m->clear == (uint16_t)*n && m->red == (uint16_t)*n && m->green == (uint16_t)*n && m->blue == (uint16_t)*n
+        && m->temperature == (int16_t)*n && m->humidity == (int16_t)*n && m->alarms == (uint16_t)*n
+        && m->valid == (uint8_t)*n && m->anomalies == (uint8_t)*n && m->probe_id == (uint8_t)*n;
+}
+
+static void fill(message_t_gps *m, uint32_t n){
+    m->tick_us = n;
+    m->latitude = m->longitude = (int32_t)n;
+    m->altitude = (int16_t)n;
+    m->gps_millis = (uint16_t)n;
+    m->fix_status = m->gps_hour = m->gps_minute = (uint8_t)n;
+    m->geofence_events[0] = m->geofence_events[1] = (uint16_t)n;
+}
+
+static bool check(const message_t_gps *m, uint32_t *n){
+    *n = (uint32_t)m->tick_us;
+    return m->latitude == (int32_t)*n && m->longitude == (int32_t)*n && m->altitude == (int16_t)*n && m->gps_millis == (uint16_t)*n
+        && m->fix_status == (uint8_t)*n && m->gps_hour == (uint8_t)*n && m->gps_minute == (uint8_t)*n
+        && m->geofence_events[0] == (uint16_t)*n && m->geofence_events[1] == (uint16_t)*n;
+}
+
+// Large enough that a preemption often lands inside a copy, even on one core
+typedef struct {
+    uint32_t words[4096];
+} big_t;
+
+static void fill(big_t *b, uint32_t n){
+    for(uint32_t &w : b->words){
+        w = n;
+    }
+}
+
+static bool check(const big_t *b, uint32_t *n){
+    *n = b->words[0];
+    for(uint32_t w : b->words){
+        if(w != *n){
+            return false;
+        }
+    }
+    return true;
+}
+// VALUES END ===================================================================================
+
+// ==============================================================================================
+// CELLS UNDER TEST (same interface as LatestValue)
+// ==============================================================================================
+template <typename T>
+class NaiveCell {                                                // Control: one slot, no sequence
+public:
+    void write(const T &value){ memcpy(&_slot, &value, sizeof(T)); _written = true; }
+    bool read(T *value) const { memcpy(value, &_slot, sizeof(T)); return _written; }
+private:
+    volatile bool _written = false;
+    T _slot;
+};
+
+template <typename T>
+class MutexCell {                                                // Reference for the throughput
+public:
+    void write(const T &value){ std::lock_guard<std::mutex> lock(_mutex); _slot = value; _written = true; }
+    bool read(T *value) const { std::lock_guard<std::mutex> lock(_mutex); *value = _slot; return _written; }
+private:
+    mutable std::mutex _mutex;
+    bool _written = false;
+    T _slot;
+};
+// CELLS UNDER TEST END =========================================================================
+
+// ==============================================================================================
+// RUNS
+// ==============================================================================================
+typedef struct {
+    uint64_t writes, reads, torn, backwards;
+    double seconds;
+} run_result_t;
+
+// One writer flat out, READERS readers flat out, for the given time
+template <typename Cell, typename T>
+static run_result_t stress(Cell *cell, double seconds){
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0), torn(0), backwards(0);
+    uint64_t writes = 0;
+
+    std::vector<std::thread> readers;
+    for(int r = 0; r < READERS; r++){
+        readers.emplace_back([&]{
+            T value;
+            uint32_t n, newest = 0;
+            uint64_t my_reads = 0, my_torn = 0, my_backwards = 0;
+            while(!stop.load(std::memory_order_relaxed)){
+                if(!cell->read(&value)){
+                    continue;
+                }
+                my_reads++;
+                if(!check(&value, &n)){
+                    my_torn++;
+                }else if(n < newest){
+                    my_backwards++;                              // Newer value seen before by this same reader
+                }else{
+                    newest = n;
+                }
+            }
+            reads += my_reads;
+            torn += my_torn;
+            backwards += my_backwards;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    T *value = new T;
+    while(std::chrono::steady_clock::now() < end){
+        for(int i = 0; i < 64; i++){
+            fill(value, (uint32_t)++writes);
+            cell->write(*value);
+        }
+    }
+    delete value;
+    stop = true;
+    for(std::thread &t : readers){
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {writes, reads.load(), torn.load(), backwards.load(), elapsed};
+}
+
+// Single thread, no contention: nanoseconds per write and per read
+template <typename Cell, typename T>
+static void uncontended(Cell *cell, double *write_ns, double *read_ns){
+    const int n = 2000000;
+    T value;
+    fill(&value, 1);
+    auto t0 = std::chrono::steady_clock::now();
+    for(int i = 0; i < n; i++){
+        value.tick_us = i;
+        cell->write(value);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for(int i = 0; i < n; i++){
+        cell->read(&value);
+        sum += value.tick_us;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    *write_ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    *read_ns = std::chrono::duration<double, std::nano>(t2 - t1).count() / n + (sum == 42 ? 1e-9 : 0);  // Keeps the reads
+}
+
+static void print(const char *name, const run_result_t &r, bool ok){
+    printf("%-34s %12.0f %12.0f %10llu %10llu%s\n", name, r.writes / r.seconds, r.reads / r.seconds, (unsigned long long)r.torn,
+           (unsigned long long)r.backwards, ok ? "" : "  <- FAIL");
+}
+// RUNS END =====================================================================================
+
+int main(int argc, char **argv){
+    double seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+    bool pass = true;
+    printf("%u hardware threads, %d readers, %.1f s per run\n", std::thread::hardware_concurrency(), READERS, seconds);
+    printf("%-34s %12s %12s %10s %10s\n", "cell", "writes/s", "reads/s", "torn", "backwards");
+
+    // Control: the checker must see the tears of a cell without protection
+    NaiveCell<big_t> *naive = new NaiveCell<big_t>;
+    run_result_t control = stress<NaiveCell<big_t>, big_t>(naive, seconds);
+    print("naive cell, 16 KB (control)", control, true);
+    if(control.torn == 0){
+        printf("  control saw no torn read: the checker is not proven on this machine, runs below are weaker\n");
+    }
+
+    LatestValue<big_t> *big = new LatestValue<big_t>;
+    run_result_t r = stress<LatestValue<big_t>, big_t>(big, seconds);
+    bool ok = r.torn == 0 && r.backwards == 0 && r.reads > 0;
+    print("LatestValue, 16 KB", r, ok);
+    pass = pass && ok;
+
+    LatestValue<message_t_sensors> sensors;
+    r = stress<LatestValue<message_t_sensors>, message_t_sensors>(&sensors, seconds);
+    ok = r.torn == 0 && r.backwards == 0 && r.reads > 0;
+    print("LatestValue<message_t_sensors>", r, ok);
+    pass = pass && ok;
+
+    LatestValue<message_t_gps> gps;
+    r = stress<LatestValue<message_t_gps>, message_t_gps>(&gps, seconds);
+    ok = r.torn == 0 && r.backwards == 0 && r.reads > 0;
+    print("LatestValue<message_t_gps>", r, ok);
+    pass = pass && ok;
+
+    MutexCell<message_t_sensors> locked;
+    r = stress<MutexCell<message_t_sensors>, message_t_sensors>(&locked, seconds);
+    print("mutex cell, message_t_sensors", r, r.torn == 0);
+
+    double write_ns, read_ns, locked_write_ns, locked_read_ns;
+    LatestValue<message_t_sensors> quiet;
+    MutexCell<message_t_sensors> quiet_locked;
+    uncontended<LatestValue<message_t_sensors>, message_t_sensors>(&quiet, &write_ns, &read_ns);
+    uncontended<MutexCell<message_t_sensors>, message_t_sensors>(&quiet_locked, &locked_write_ns, &locked_read_ns);
+    printf("Uncontended message_t_sensors: LatestValue write %.1f ns, read %.1f ns; mutex cell write %.1f ns, read %.1f ns\n",
+           write_ns, read_ns, locked_write_ns, locked_read_ns);
+
+    delete naive;
+    delete big;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
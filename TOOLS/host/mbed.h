@@ -0,0 +1,174 @@
+/* Host stand-in for the few mbed OS definitions the SRC modules checked by the host harnesses use, not a port of mbed OS */
+
+#ifndef HOST_MBED_H
+#define HOST_MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+
+using namespace std::chrono_literals;
+
+// Toolchain macros (mbed_toolchain.h, mbed_assert.h)
+#define MBED_STATIC_ASSERT(expr, msg) static_assert(expr, msg)
+#define MBED_PACKED(declaration)      declaration __attribute__((packed))
+#define MBED_BARRIER()                std::atomic_signal_fence(std::memory_order_seq_cst)
+
+// Atomics (mbed_atomic.h), real ones so the harnesses may use threads
+static inline uint32_t core_util_atomic_load_u32(const volatile uint32_t *p){ return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static inline void core_util_atomic_store_u32(volatile uint32_t *p, uint32_t v){ __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static inline uint32_t core_util_atomic_exchange_u32(volatile uint32_t *p, uint32_t v){ return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+static inline uint32_t core_util_atomic_incr_u32(volatile uint32_t *p, uint32_t d){ return __atomic_add_fetch(p, d, __ATOMIC_SEQ_CST); }
+static inline uint64_t core_util_atomic_load_u64(const volatile uint64_t *p){ return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static inline void core_util_atomic_store_u64(volatile uint64_t *p, uint64_t v){ __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+
+// Critical section (mbed_critical.h): the harnesses that use it run one thread, the ISRs are called from it
+static inline void core_util_critical_section_enter(){}
+static inline void core_util_critical_section_exit(){}
+
+// ==============================================================================================
+// SIMULATED TIME AND STATE (host_mbed.cpp)
+// Nothing runs in the background: a harness moves the clock itself. The clock, the RTC and the
+// flash live in shared memory, so a harness can fork() one process per boot and keep them.
+// ==============================================================================================
+uint64_t host_now_us();                                          // Tick since the current boot
+uint64_t host_world_us();                                        // Tick since the harness started, across boots
+void host_advance_us(uint64_t us);
+void host_reboot();                                              // Tick back to 0, RTC and flash kept
+void host_rtc_lose();                                            // RTC stopped, time() returns 0 until set_time()
+time_t host_time(time_t *t);
+void set_time(time_t t);
+#define time(t) host_time(t)                                      // The RTC follows the simulated clock
+
+static inline void wait_us(int us){ host_advance_us(us); }
+
+// Kernel::Clock (rtos/Kernel.h) on the simulated clock
+namespace Kernel {
+struct Clock {
+    using duration = std::chrono::milliseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<Clock>;
+    static constexpr bool is_steady = true;
+    static time_point now(){ return time_point(duration(host_now_us() / 1000)); }
+};
+}
+
+namespace ThisThread {
+static inline void sleep_for(Kernel::Clock::duration d){ host_advance_us((uint64_t)d.count() * 1000); }
+}
+
+// ==============================================================================================
+// DRIVERS
+// ==============================================================================================
+typedef int PinName;
+enum { PA_9 = 9, PA_10 = 10, PA_11 = 11, PA_12 = 12, PB_8 = 24, PB_9 = 25, PH_1 = 113 };
+typedef enum { PullNone, PullUp, PullDown, OpenDrain } PinMode;
+
+class Mutex {                                                    // Recursive, like rtos::Mutex
+public:
+    void lock(){ m.lock(); }
+    void unlock(){ m.unlock(); }
+    bool trylock(){ return m.try_lock(); }
+private:
+    std::recursive_mutex m;
+};
+
+// MbedCRC: only the CRC-32 persist.cpp uses (reflected, 0xFFFFFFFF in and out, as mbed's table for POLY_32BIT_ANSI)
+enum { POLY_32BIT_ANSI = 0x04C11DB7 };
+template <uint32_t polynomial, int width>
+class MbedCRC {
+public:
+    int32_t compute(const void *buffer, unsigned long size, uint32_t *crc){
+        compute_partial_start(crc);
+        compute_partial(buffer, size, crc);
+        return compute_partial_stop(crc);
+    }
+    int32_t compute_partial_start(uint32_t *crc){ *crc = 0xFFFFFFFF; return 0; }
+    int32_t compute_partial(const void *buffer, unsigned long size, uint32_t *crc){
+        uint32_t c = *crc;
+        for(unsigned long i = 0; i < size; i++){
+            c ^= ((const uint8_t *)buffer)[i];
+            for(int bit = 0; bit < 8; bit++){
+                c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+            }
+        }
+        *crc = c;
+        return 0;
+    }
+    int32_t compute_partial_stop(uint32_t *crc){ *crc ^= 0xFFFFFFFF; return 0; }
+};
+
+// FlashIAP in RAM with the STM32L072 geometry: 128 B sectors, erased bytes read 0x00
+#define HOST_FLASH_START   0x08000000
+#define HOST_FLASH_SIZE    (192 * 1024)
+#define HOST_FLASH_SECTOR  128
+#define HOST_FLASH_PAGE    4
+
+class FlashIAP {
+public:
+    int init(){ return 0; }
+    int deinit(){ return 0; }
+    int read(void *buffer, uint32_t addr, uint32_t size);
+    int program(const void *buffer, uint32_t addr, uint32_t size);
+    int erase(uint32_t addr, uint32_t size);
+    uint32_t get_flash_start() const { return HOST_FLASH_START; }
+    uint32_t get_flash_size() const { return HOST_FLASH_SIZE; }
+    uint32_t get_sector_size(uint32_t addr) const { return HOST_FLASH_SECTOR; }
+    uint32_t get_page_size() const { return HOST_FLASH_PAGE; }
+    uint8_t get_erase_value() const { return 0x00; }
+};
+uint32_t host_flash_erase_count();                               // Sectors erased since the harness started
+
+// BufferedSerial: declared here, defined by the harness that fakes the device on the other end
+class BufferedSerial {
+public:
+    enum Parity { None = 0, Odd, Even, Forced1, Forced0 };
+    BufferedSerial(PinName tx, PinName rx, int baud);
+    void set_baud(int baud);
+    void set_format(int bits = 8, Parity parity = None, int stop_bits = 1);
+    ssize_t read(void *buffer, size_t length);
+    ssize_t write(const void *buffer, size_t length);
+    bool readable() const;
+    int set_blocking(bool blocking);
+    int sync();
+    int enable_input(bool enabled);
+    int enable_output(bool enabled);
+};
+
+// I2C, DigitalInOut and gpio_t: declared here, defined by fake_i2c.cpp (a simulated bus with fault injection)
+class I2C {
+public:
+    I2C(PinName sda, PinName scl);
+    ~I2C();
+    void frequency(int hz){}
+    int write(int address, const char *data, int length, bool repeated = false);
+    int read(int address, char *data, int length, bool repeated = false);
+};
+
+class DigitalInOut {
+public:
+    DigitalInOut(PinName pin) : pin(pin){}
+    void input();
+    void output();
+    void mode(PinMode pull){}
+    int read();
+    void write(int value);
+    DigitalInOut &operator=(int value){ write(value); return *this; }
+    operator int(){ return read(); }
+private:
+    PinName pin;
+};
+
+typedef struct { PinName pin; } gpio_t;
+static inline void gpio_init(gpio_t *obj, PinName pin){ obj->pin = pin; }
+int gpio_read(gpio_t *obj);
+// DRIVERS END ==================================================================================
+
+#endif
@@ -0,0 +1,177 @@
+/* Host harness of the probe scan scheduler (scan.cpp through i2c_bus.cpp, tca9548a.cpp and the drivers) on the fake bus
+ * (fake_i2c.cpp) with N Si7021 + TCS34725 beds behind a TCA9548A: every bed must come back under its own probe_id with
+ * its own values, the mux must switch once per channel per scan, a bed unplugged for one scan must not take the others
+ * with it, and the accelerometer FIFO (32 samples at 100 Hz, 320 ms) must never overflow however long the scan takes.
+ * The scans are paced as sensors_step() does in TEST_MODE. Reports the scan time and the mux switches for this N.
+ *
+ * N is MBED_CONF_APP_MUX_PROBES, fixed at build time as in the firmware: the Makefile builds one binary per N.
+ *
+ *   ./scan_bench_<N>
+ */
+
+#include <math.h>
+#include "mbed.h"
+#include "fake_i2c.h"
+#include "scan.h"
+#include "message_q.h"
+#include "blackbox.h"
+#include "sensors_thread.h"
+
+#define SCANS               20
+#define SWITCH_US           (2 * FAKE_I2C_BYTE_US + FAKE_I2C_STOP_US)  // Address and control byte
+#define FIFO_LASTS_US       (MMA8451_FIFO_SIZE * 1000000 / MMA8451_ODR_HZ)
+
+uint64_t timebase_now_us(){ return host_now_us(); }
+
+// Black box: what the FIFO drains hand over
+static uint32_t pushed = 0, overflows = 0;
+static uint64_t last_drain_us = 0, worst_drain_gap_us = 0;
+
+void blackbox_push(const int16_t xyz[][3], uint8_t count, bool overflow, uint64_t read_tick_us){
+    pushed += count;
+    overflows += overflow;
+    if(last_drain_us != 0 && read_tick_us - last_drain_us > worst_drain_gap_us){
+        worst_drain_gap_us = read_tick_us - last_drain_us;
+    }
+    last_drain_us = read_tick_us;
+}
+
+// MMA8451Q sampling at MMA8451_ODR_HZ on the simulated clock once active: the FIFO is brought up to date when F_STATUS
+// is addressed
+class TimedMMA8451 : public FakeMMA8451 {
+public:
+    void on_write(const uint8_t *data, int length) override {
+        if(!(regs[CTRL_REG1] & 0x01)){
+            next_sample_us = host_now_us();                      // Standby, nothing sampled yet
+        }else if(length == 1 && data[0] == F_STATUS){
+            for(; next_sample_us <= host_now_us(); next_sample_us += 1000000 / MMA8451_ODR_HZ){
+                push_sample((int16_t)(taken++ & 0x3F), 0, MMA8451_COUNTS_PER_G);
+            }
+        }
+        FakeMMA8451::on_write(data, length);
+    }
+    uint32_t taken = 0;
+private:
+    uint64_t next_sample_us = 0;
+};
+
+// ==============================================================================================
+// BEDS: bed i reads T = 20 + i celsius, RH = 40 + 2i %RH, clear = 1000 + i
+// ==============================================================================================
+#if SCAN_MUX_PROBES > 0
+#define BED_CHANNEL(id)     (id)
+#else
+#define BED_CHANNEL(id)     FAKE_I2C_DIRECT
+#endif
+
+static FakeTCA9548A mux;
+static TimedMMA8451 accelerometer;
+static FakeSi7021 *si7021[SCAN_PROBE_IDS];
+static FakeTCS34725 *tcs34725[SCAN_PROBE_IDS];
+
+static void attach_beds(){
+#if SCAN_MUX_PROBES > 0
+    fake_i2c_attach(&mux);
+#endif
+    fake_i2c_attach(&accelerometer);
+    for(int id = 0; id < SCAN_PROBE_IDS; id++){
+        si7021[id] = new FakeSi7021(BED_CHANNEL(id), 40.0f + 2 * id, 20.0f + id);
+        tcs34725[id] = new FakeTCS34725(BED_CHANNEL(id), 1000 + id, 400 + id, 500 + id, 300 + id);
+        fake_i2c_attach(si7021[id]);
+        fake_i2c_attach(tcs34725[id]);
+    }
+}
+
+// Valid bits and values each bed must report, except the beds in skip (unplugged)
+static bool check_results(const scan_result_t results[SCAN_PROBE_IDS], uint32_t skip){
+    bool ok = true;
+    for(int id = 0; id < SCAN_PROBE_IDS; id++){
+        const scan_result_t *r = &results[id];
+        uint8_t expected = ((skip >> id) & 1) ? 0 : (MSG_VALID_TEMPERATURE | MSG_VALID_HUMIDITY | MSG_VALID_COLOUR);
+        expected |= (id == 0) ? MSG_VALID_ACCEL : 0;             // Only the board probe has the accelerometer
+        ok = ok && r->valid == expected;
+        if(expected & MSG_VALID_TEMPERATURE){
+            ok = ok && fabsf(r->temperature - (20.0f + id)) < 0.01f && fabsf(r->humidity - (40.0f + 2 * id)) < 0.01f;
+            ok = ok && r->clear == 1000 + id && r->red == 400 + id && r->green == 500 + id && r->blue == 300 + id;
+        }
+        if(!ok){
+            printf("  bed %d: valid 0x%02X (expected 0x%02X), T %.2f, RH %.2f, clear %u\n", id, r->valid, expected, r->temperature, r->humidity, r->clear);
+            return false;
+        }
+    }
+    return true;
+}
+
+// One sample period of sensors_step(): FIFO drains every BLACKBOX_DRAIN_PERIOD until the sample is due, the white LED
+// settles, then the scan
+static uint32_t scan(scan_result_t results[SCAN_PROBE_IDS]){
+    const uint64_t drain_us = std::chrono::microseconds(BLACKBOX_DRAIN_PERIOD).count();
+    uint64_t next_sample_us = host_now_us() + std::chrono::microseconds(TEST_MODE_SENSOR_THREAD_SLEEP).count();
+    while(host_now_us() < next_sample_us){
+        scan_record();
+        uint64_t remaining_us = next_sample_us - host_now_us();
+        host_advance_us((remaining_us < drain_us) ? remaining_us : drain_us);
+    }
+    std::chrono::milliseconds power_on = scan_power_on();        // With the white LED, the longer wait of the two
+    host_advance_us(std::chrono::microseconds((power_on > SENSORS_LED_SETTLE_TIME) ? power_on : std::chrono::milliseconds(SENSORS_LED_SETTLE_TIME)).count());
+    uint64_t start_us = host_now_us();
+    scan_run(results);
+    return (uint32_t)(host_now_us() - start_us);
+}
+// BEDS END =====================================================================================
+
+int main(){
+    attach_beds();
+    scan_init(false);
+    scan_result_t results[SCAN_PROBE_IDS];
+    bool pass = true;
+
+    // First scan configures every probe and selects the channels from an unknown mux state, after the TCS34725 power-on pass
+    // walked them the other way
+    uint32_t first_us = scan(results);
+    pass = check_results(results, 0) && scan_all_ready() && pass;
+    uint32_t first_switches = tca9548a_switches();
+
+    // Steady scans
+    uint32_t switches = tca9548a_switches(), transfers = fake_i2c_stats.transfers, total_us = 0, worst_us = 0;
+    for(int s = 0; s < SCANS; s++){
+        uint32_t us = scan(results);
+        total_us += us;
+        worst_us = (us > worst_us) ? us : worst_us;
+        pass = check_results(results, 0) && pass;
+    }
+    double switches_per_scan = (double)(tca9548a_switches() - switches) / SCANS;
+    double transfers_per_scan = (double)(fake_i2c_stats.transfers - transfers) / SCANS;
+    uint32_t steady_switches = (SCAN_MUX_PROBES > 0) ? SCAN_MUX_PROBES - 1 : 0;  // Direction alternates: the last channel of a scan opens the next
+    uint32_t power_on_switches = (SCAN_MUX_PROBES > 0) ? SCAN_MUX_PROBES - 1 : 0;
+    pass = pass && switches_per_scan == steady_switches && first_switches == SCAN_MUX_PROBES + power_on_switches && fake_i2c_stats.collisions == 0;
+    pass = pass && overflows == 0 && pushed + 32 >= accelerometer.taken;   // Nothing dropped, at most a FIFO still to read
+
+    // One bed unplugged for a scan, then plugged back: the others keep reading, it comes back configured
+    int gone = SCAN_PROBE_IDS / 2;
+    si7021[gone]->absent = tcs34725[gone]->absent = true;
+    scan(results);
+    bool isolated = check_results(results, 1u << gone) && !scan_all_ready();
+    si7021[gone]->absent = tcs34725[gone]->absent = false;
+    scan(results);
+    bool back = check_results(results, 0) && scan_all_ready();
+    uint32_t early_enables = 0;                                  // TCS34725 ADC enabled before the power-on wait
+    for(int id = 0; id < SCAN_PROBE_IDS; id++){
+        early_enables += tcs34725[id]->early_enables;
+    }
+    pass = pass && early_enables == 0;
+    pass = pass && isolated && back;
+
+    double mean_ms = total_us / 1000.0 / SCANS;
+    printf("N = %d (%d devices): first scan %.1f ms (%lu mux switches), then %.1f ms mean, %.1f ms worst, %.1f ms per bed; "
+           "%.1f mux switches (%.2f ms) and %.0f transfers per scan, %d switches in the order of the types; unplugged bed %s, back %s; "
+           "%lu TCS34725 enabled before their power-on wait\n"
+           "Accelerometer FIFO: worst %.0f ms between reads (it lasts %d ms), %lu overflows, %lu of %lu samples in the black box\n",
+           SCAN_MUX_PROBES, SCAN_MAX_DEVICES, first_us / 1000.0, (unsigned long)first_switches, mean_ms, worst_us / 1000.0,
+           mean_ms / SCAN_PROBE_IDS, switches_per_scan, switches_per_scan * SWITCH_US / 1000.0, transfers_per_scan, 2 * SCAN_MUX_PROBES,
+           isolated ? "isolated" : "NOT ISOLATED", back ? "ok" : "NOT BACK", (unsigned long)early_enables,
+           worst_drain_gap_us / 1000.0, FIFO_LASTS_US / 1000, (unsigned long)overflows, (unsigned long)pushed, (unsigned long)accelerometer.taken);
+    scan_print_health();
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
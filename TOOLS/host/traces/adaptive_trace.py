@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Generate the trace replayed by adaptive_replay.cpp (adaptive_day.csv).
+
+Usage: adaptive_trace.py > adaptive_day.csv
+
+One day of samples every 10 s (the fixed NORMAL_MODE rate the adaptive period is compared with), in the fixed-point units
+of message_t_sensors, for the channels the adaptive period follows: temperature, humidity, soil moisture and light. Quiet
+stretches (night, a dry soil drying slowly) alternate with the changes the period must follow: two waterings that raise
+the soil moisture by 12 % in a minute and drain back part of it, the sun reaching the probe and heating it by 4 celsius,
+passing clouds and dawn and dusk. Noise is that of the Si7021 and of the ADC. The seed is fixed, so the committed file is
+what this script prints. Synthetic, not recorded.
+
+Lines: '#' comments; 'EVENT,channels,start_ms,end_ms,name' labels (channels is a mask of alarm_channel_t, the window is
+[start_ms, end_ms)); then 'tick_ms,T,RH,SM,AL,valid' samples.
+"""
+
+import math
+import random
+
+PERIOD_MS = 10000
+DAY_MS = 24 * 3600 * 1000
+T, RH, SM, AL = range(4)
+VALID_T, VALID_RH, VALID_SM, VALID_AL = 0x02, 0x04, 0x10, 0x20
+VALID_OTHERS = 0x01 | 0x08                                      # Accelerometer and colour, constant in the replay
+
+rng = random.Random(46)
+
+
+def hours(h):
+    return int(h * 3600 * 1000)
+
+
+# Labelled changes: channel mask, start, end, name
+EVENTS = [
+    (1 << SM,                   hours(6.0),   hours(6.5),   'morning watering, +12 % in 1 min then drains'),
+    (1 << AL,                   hours(10.3) - hours(0.1), hours(10.3) + hours(0.1), 'cloud, light -30 %'),
+    ((1 << T) | (1 << AL),      hours(13.0),  hours(13.25), 'sun reaches the probe, +4 celsius in 5 min'),
+    ((1 << T) | (1 << AL),      hours(16.0),  hours(16.25), 'probe back in the shade'),
+    (1 << SM,                   hours(18.0),  hours(18.5),  'evening watering'),
+]
+
+
+def step(tick, start, duration_ms):
+    """0 before start, 1 after start + duration, linear in between."""
+    return min(max((tick - start) / duration_ms, 0.0), 1.0)
+
+
+def sample(tick, state):
+    h = tick / 3600000.0
+    day = math.sin(2 * math.pi * (h - 9) / 24)                  # Warmest at 15:00
+
+    # Sun on the probe from 13:00 to 16:00: +4 celsius in 5 min, off again in 10 min
+    sun = step(tick, hours(13.0), 300000) - step(tick, hours(16.0), 600000)
+    t = 2150 + 650 * day + 400 * sun + rng.gauss(0, 2)
+    rh = 6500 - 1200 * day - 800 * sun + rng.gauss(0, 10)
+
+    # Soil dries by 0.3 % an hour; a watering raises it by 12 % in a minute, then 4 % of it drains in 20 min
+    state['sm'] -= 30 * PERIOD_MS / 3600000.0
+    for watering in (6.0, 18.0):
+        start = hours(watering)
+        if start <= tick < start + 60000:
+            state['sm'] += 1200 * PERIOD_MS / 60000.0
+        elif start + 60000 <= tick < start + 60000 + 1200000:
+            state['sm'] -= 400 * PERIOD_MS / 1200000.0
+    sm = state['sm'] + rng.gauss(0, 8)
+
+    # Daylight from 06:00 to 20:00, a cloud at 10:18 dims it by a third for a few minutes, the sun patch adds 10 %
+    light = max(0.0, math.sin(math.pi * (h - 6) / 14)) * 7000 if 6 <= h <= 20 else 0.0
+    light *= 1 - 0.30 * math.exp(-((h - 10.3) * 60 / 3) ** 2)
+    light += 1000 * sun
+    al = light + rng.gauss(0, 10) if light > 0 else 0.0
+
+    valid = VALID_T | VALID_RH | VALID_SM | VALID_AL | VALID_OTHERS
+    if hours(8.0) <= tick < hours(8.05):
+        valid &= ~(VALID_T | VALID_RH)                           # Si7021 reads failing for three minutes
+    return [round(t), round(rh), round(min(max(sm, 0), 10000)), round(min(max(al, 0), 10000)), valid]
+
+
+def main():
+    print('# Trace of the adaptive sampling replay, printed by adaptive_trace.py (seed 46, synthetic, not recorded)')
+    print('# EVENT,channels,start_ms,end_ms,name')
+    for mask, start, end, name in EVENTS:
+        print('EVENT,%d,%d,%d,%s' % (mask, start, end, name))
+    print('# tick_ms,T,RH,SM,AL,valid')
+    state = {'sm': 2800.0}
+    for n in range(DAY_MS // PERIOD_MS):
+        tick = n * PERIOD_MS
+        print(','.join(str(v) for v in [tick] + sample(tick, state)))
+
+
+if __name__ == '__main__':
+    main()
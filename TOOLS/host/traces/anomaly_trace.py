@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Generate the labelled trace replayed by anomaly_replay.cpp (anomaly_labelled.csv).
+
+Usage: anomaly_trace.py > anomaly_labelled.csv
+
+One day of samples every 30 s, in the fixed-point units of message_t_sensors, with the slow changes the detector must
+let through (day and night, two waterings a day, clouds, failed reads) and labelled faults. The faults
+are synthetic, shaped after what the station sees: a probe pulled out of the soil, a covered light sensor, a knock, a
+tilted station, a glitching or noisy probe, a probe stuck on one value and a missed watering. The seed is fixed, so the
+committed file is what this script prints.
+
+Lines: '#' comments; 'EVENT,channels,start_ms,end_ms,must_detect,name' labels (channels is a mask of alarm_channel_t,
+the window is [start_ms, end_ms)); then 'tick_ms,T,RH,SM,AL,CLR,ax,ay,az,valid' samples.
+"""
+
+import math
+import random
+
+PERIOD_MS = 30000
+DAY_MS = 24 * 3600 * 1000
+T, RH, SM, AL, CLR, AX, AY, AZ = range(8)
+VALID_ACCEL, VALID_T, VALID_RH, VALID_COLOUR, VALID_SM, VALID_AL = 0x01, 0x02, 0x04, 0x08, 0x10, 0x20
+
+rng = random.Random(36)
+
+
+def hours(h):
+    return int(h * 3600 * 1000)
+
+
+# Labelled faults: channel mask, start, end, must be detected, name
+EVENTS = [
+    (1 << T,                    hours(3.0),   hours(3.0) + PERIOD_MS,   True,  'temperature glitch, one sample +9 celsius'),
+    (1 << RH,                   hours(4.5),   hours(4.8),               True,  'humidity probe noisy, +-6 %RH'),
+    (1 << SM,                   hours(9.0),   hours(9.5) + PERIOD_MS,   True,  'soil probe pulled out and pushed back'),
+    ((1 << AL) | (1 << CLR),    hours(12.0),  hours(12.2) + PERIOD_MS,  True,  'light sensor covered by a leaf'),
+    (1 << AZ,                   hours(14.0),  hours(14.0) + PERIOD_MS,  True,  'knock on the station'),
+    ((1 << AX) | (1 << AZ),     hours(16.0),  hours(16.0) + PERIOD_MS,  True,  'station tilted by 30 degrees'),
+    (1 << T,                    hours(20.0),  hours(21.0),              False, 'temperature probe stuck on one value'),
+    (1 << SM,                   hours(18.0),  hours(19.0),              False, 'evening watering missed'),
+]
+
+
+def inside(channel, tick):
+    return any((mask >> channel) & 1 and start <= tick < end for mask, start, end, _, _ in EVENTS)
+
+
+def sample(tick, state):
+    h = tick / 3600000.0
+    day = math.sin(2 * math.pi * (h - 9) / 24)                  # Warmest at 15:00
+    t = 2150 + 650 * day + rng.gauss(0, 5)
+    rh = 6500 - 1200 * day + rng.gauss(0, 30)
+
+    # Soil dries by 0.5 % an hour, watered at 06:00 and 18:00 (+12 % over two samples)
+    state['sm'] -= 50 * PERIOD_MS / 3600000.0
+    for watering in (6.0, 18.0):
+        if hours(watering) <= tick < hours(watering) + 2 * PERIOD_MS and not inside(SM, hours(watering)):
+            state['sm'] += 600
+    sm = state['sm'] + rng.gauss(0, 15)
+
+    # Daylight from 06:00 to 20:00, clouds dim it by up to a third over a few minutes
+    light = max(0.0, math.sin(math.pi * (h - 6) / 14)) * 7000 if 6 <= h <= 20 else 0.0
+    for centre, depth in ((10.3, 0.30), (11.1, 0.20), (13.4, 0.35), (15.2, 0.25)):
+        light *= 1 - depth * math.exp(-((h - centre) * 60 / 4) ** 2)
+    al = light + rng.gauss(0, 20)
+    clear = 40 + light * 2.5 + rng.gauss(0, 30)
+
+    ax, ay, az = rng.gauss(0, 8), rng.gauss(0, 8), 4096 + rng.gauss(0, 8)
+
+    # Faults
+    if hours(3.0) <= tick < hours(3.0) + PERIOD_MS:
+        t += 900
+    if hours(4.5) <= tick < hours(4.8):
+        rh += rng.uniform(-600, 600)
+    if hours(9.0) <= tick < hours(9.5):
+        sm = 200 + rng.gauss(0, 15)
+    if hours(12.0) <= tick < hours(12.2):
+        al, clear = 300 + rng.gauss(0, 20), 60 + rng.gauss(0, 30)
+    if hours(14.0) <= tick < hours(14.0) + PERIOD_MS:
+        az += 3000
+    if tick >= hours(16.0):
+        ax, az = ax + 2048, az - 548                             # sin 30 and cos 30 of 4096 counts
+    if hours(20.0) <= tick < hours(21.0):
+        t = state.setdefault('stuck', t)
+
+    valid = 0x3F
+    if hours(7.0) <= tick < hours(7.1):
+        valid &= ~(VALID_T | VALID_RH)                           # Si7021 unplugged for six minutes
+    if rng.random() < 0.005:
+        valid &= ~VALID_COLOUR                                   # Scattered failed colour reads
+    return [round(t), round(rh), round(min(max(sm, 0), 10000)), round(min(max(al, 0), 10000)), round(min(max(clear, 0), 65535)),
+            round(ax), round(ay), round(az), valid]
+
+
+def main():
+    print('# Labelled trace of the anomaly detector replay, printed by anomaly_trace.py (seed 36, synthetic, not recorded)')
+    print('# EVENT,channels,start_ms,end_ms,must_detect,name')
+    for mask, start, end, must, name in EVENTS:
+        print('EVENT,%d,%d,%d,%d,%s' % (mask, start, end, must, name))
+    print('# tick_ms,T,RH,SM,AL,CLR,ax,ay,az,valid')
+    state = {'sm': 3500.0}
+    for n in range(DAY_MS // PERIOD_MS):
+        tick = n * PERIOD_MS
+        print(','.join(str(v) for v in [tick] + sample(tick, state)))
+
+
+if __name__ == '__main__':
+    main()
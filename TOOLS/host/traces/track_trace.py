@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Generate the GPS track replayed by track_replay.cpp (track_walk_drive.csv).
+
+Usage: track_trace.py > track_walk_drive.csv
+
+One hour of 1 Hz fixes: a walk, a stop, a drive through a few turns and a roundabout, 30 s without a fix, a slower
+drive and a walk back. The receiver noise is 1.5 m per axis, correlated over about 10 s as a consumer receiver's is, so a
+standing receiver wanders instead of jumping. Two geofence events are set on the fixes that would carry them. The seed is
+fixed, so the committed file is what this script prints. Synthetic, not recorded.
+
+Lines: '#' comments, then 'tick_ms,fix_status,latitude,longitude,event,phase' (micro-degrees, event 65535 = none).
+"""
+
+import math
+import random
+
+START_LAT, START_LON = 40.416800, -3.703800
+METRES_PER_DEG = 111320.0
+NOISE_M, NOISE_TAU_S = 1.5, 10.0
+NO_EVENT = 0xFFFF
+
+rng = random.Random(39)
+
+# Phases: seconds, name, speed (m/s)
+PHASES = [
+    (900, 'walk', 1.4),
+    (600, 'stop', 0.0),
+    (1200, 'drive', 13.0),
+    (30, 'lost', 13.0),
+    (270, 'drive', 8.0),
+    (600, 'walk', 1.4),
+]
+EVENTS = {600: 0x8000, 2000: 0x0000}                            # Enter fence 0 while walking, leave it while driving
+
+
+def main():
+    print('# GPS track of the track simplifier replay, printed by track_trace.py (seed 39, synthetic, not recorded)')
+    print('# tick_ms,fix_status,latitude,longitude,event,phase')
+    x = y = 0.0                                                 # Metres east and north of the start
+    heading = 30.0
+    turn_rate, turn_left = 0.0, 0
+    nx = ny = 0.0
+    a = math.exp(-1.0 / NOISE_TAU_S)
+    t = 0
+    for length, phase, speed in PHASES:
+        for _ in range(length):
+            # Walks wander, drives go straight with a 90 degree corner now and then and one roundabout
+            if turn_left > 0:
+                heading += turn_rate
+                turn_left -= 1
+            elif phase == 'walk':
+                heading += rng.gauss(0, 4)
+                if rng.random() < 1 / 120:
+                    turn_rate, turn_left = rng.choice((-1, 1)) * 9.0, 10
+            elif phase in ('drive', 'lost'):
+                if t == 2100:
+                    turn_rate, turn_left = 18.0, 15                  # Three quarters of a roundabout
+                elif rng.random() < 1 / 150:
+                    turn_rate, turn_left = rng.choice((-1, 1)) * 15.0, 6
+            x += speed * math.sin(math.radians(heading))
+            y += speed * math.cos(math.radians(heading))
+
+            nx = a * nx + math.sqrt(1 - a * a) * rng.gauss(0, NOISE_M)
+            ny = a * ny + math.sqrt(1 - a * a) * rng.gauss(0, NOISE_M)
+            lat = START_LAT + (y + ny) / METRES_PER_DEG
+            lon = START_LON + (x + nx) / (METRES_PER_DEG * math.cos(math.radians(START_LAT)))
+            if phase == 'lost':
+                status, lat, lon = 0, 0.0, 0.0                  # GGA without a fix has empty position fields
+            else:
+                status = 1
+            print('%d,%d,%d,%d,%d,%s' % (t * 1000, status, round(lat * 1e6), round(lon * 1e6), EVENTS.get(t, NO_EVENT), phase))
+            t += 1
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,186 @@
+/* Host replay of the GPS track simplifier (track.cpp) over a recorded or generated track: reports the compression ratio
+ * and the largest deviation, checked independently of track.cpp (every fix against the kept polyline, in double), and
+ * checks the heartbeat, the geofence events and the loss of fix.
+ *
+ * The committed track (traces/track_walk_drive.csv) is synthetic, printed by traces/track_trace.py; a GGA log converted
+ * to the same columns replays the same way.
+ *
+ *   ./track_replay             [track, default traces/track_walk_drive.csv]
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "mbed.h"
+#include "track.h"
+
+#define SLACK_M             0.05                                 // float in track.cpp against double here
+
+// ==============================================================================================
+// TRACK
+// ==============================================================================================
+typedef struct {
+    message_t_gps fix;
+    std::string phase;
+    double deviation_m;                                          // To the kept polyline, -1 while not covered yet
+} input_t;
+
+static bool load(const char *path, std::vector<input_t> *fixes){
+    FILE *f = fopen(path, "r");
+    if(f == nullptr){
+        printf("Cannot open %s\n", path);
+        return false;
+    }
+    char line[128], phase[16];
+    unsigned long long tick_ms;
+    unsigned status, event;
+    long latitude, longitude;
+    while(fgets(line, sizeof(line), f) != nullptr){
+        if(line[0] == '#' || sscanf(line, "%llu,%u,%ld,%ld,%u,%15s", &tick_ms, &status, &latitude, &longitude, &event, phase) != 6){
+            continue;
+        }
+        input_t in = {};
+        in.fix.tick_us = tick_ms * 1000;
+        in.fix.fix_status = (uint8_t)status;
+        in.fix.latitude = (int32_t)latitude;
+        in.fix.longitude = (int32_t)longitude;
+        in.fix.geofence_events[0] = (uint16_t)event;
+        in.fix.geofence_events[1] = GEOFENCE_NO_EVENT;
+        in.phase = phase;
+        in.deviation_m = -1.0;
+        fixes->push_back(in);
+    }
+    fclose(f);
+    return !fixes->empty();
+}
+
+static bool has_position(const message_t_gps *m){
+    return m->fix_status > 0 && m->fix_status <= 2;
+}
+
+// Distance of p to the segment a-b in metres, on the plane tangent at a
+static double segment_distance(const message_t_gps &p, const message_t_gps &a, const message_t_gps &b){
+    const double metres_per_microdeg = 6371008.8 * M_PI / 180.0 * 1e-6;
+    double scale_x = metres_per_microdeg * cos(a.latitude * 1e-6 * M_PI / 180.0);
+    double px = (p.longitude - a.longitude) * scale_x, py = (p.latitude - a.latitude) * metres_per_microdeg;
+    double ex = (b.longitude - a.longitude) * scale_x, ey = (b.latitude - a.latitude) * metres_per_microdeg;
+    double length2 = ex * ex + ey * ey;
+    double t = (length2 > 0.0) ? (px * ex + py * ey) / length2 : 0.0;
+    t = (t < 0.0) ? 0.0 : ((t > 1.0) ? 1.0 : t);
+    return hypot(px - t * ex, py - t * ey);
+}
+// TRACK END ====================================================================================
+
+int main(int argc, char **argv){
+    const char *path = (argc > 1) ? argv[1] : "traces/track_walk_drive.csv";
+    std::vector<input_t> fixes;
+    if(!load(path, &fixes)){
+        printf("FAIL\n");
+        return 1;
+    }
+
+    // Replay, timing every call
+    std::vector<message_t_gps> kept;
+    double worst_ns = 0.0, total_ns = 0.0;
+    for(const input_t &in : fixes){
+        message_t_gps out[TRACK_MAX_OUTPUT];
+        auto start = std::chrono::steady_clock::now();
+        uint8_t n = track_push(&in.fix, out);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        total_ns += ns;
+        worst_ns = (ns > worst_ns) ? ns : worst_ns;
+        kept.insert(kept.end(), out, out + n);
+    }
+
+    // Every fix against the segment of kept points around it; the loss of fix splits the polyline
+    size_t k = 0, pending = 0;
+    for(input_t &in : fixes){
+        if(!has_position(&in.fix)){
+            continue;
+        }
+        while(k + 1 < kept.size() && kept[k + 1].tick_us <= in.fix.tick_us){
+            k++;
+        }
+        if(kept[k].tick_us == in.fix.tick_us && has_position(&kept[k])){
+            in.deviation_m = 0.0;
+        }else if(k + 1 < kept.size() && has_position(&kept[k]) && has_position(&kept[k + 1])){
+            in.deviation_m = segment_distance(in.fix, kept[k], kept[k + 1]);
+        }else{
+            pending++;                                           // After the last kept point: still in the window
+        }
+    }
+
+    // Heartbeat, events and losses
+    uint32_t points = 0, positions = 0, losses_in = 0, losses_out = 0, events_in = 0, events_kept = 0;
+    uint64_t longest_gap_us = 0;
+    for(size_t i = 0; i < kept.size(); i++){
+        if(!has_position(&kept[i])){
+            losses_out++;
+            continue;
+        }
+        points++;
+        events_kept += kept[i].geofence_events[0] != GEOFENCE_NO_EVENT;
+        if(i > 0 && has_position(&kept[i - 1]) && kept[i].tick_us - kept[i - 1].tick_us > longest_gap_us){
+            longest_gap_us = kept[i].tick_us - kept[i - 1].tick_us;
+        }
+    }
+    for(size_t i = 0; i < fixes.size(); i++){
+        positions += has_position(&fixes[i].fix);
+        events_in += fixes[i].fix.geofence_events[0] != GEOFENCE_NO_EVENT;
+        losses_in += !has_position(&fixes[i].fix) && (i == 0 || has_position(&fixes[i - 1].fix));
+    }
+
+    // Report, per phase of the track and overall
+    printf("%s: %zu fixes over %.1f min, tolerance %d m, window %d fixes\n\n", path, fixes.size(),
+           (fixes.back().fix.tick_us - fixes.front().fix.tick_us) / 6e7, TRACK_TOLERANCE_M, TRACK_WINDOW);
+    printf("%-8s %6s %6s %7s %10s %10s\n", "phase", "fixes", "kept", "ratio", "max dev m", "mean dev m");
+    std::vector<std::string> phases;
+    for(const input_t &in : fixes){
+        if(std::find(phases.begin(), phases.end(), in.phase) == phases.end()){
+            phases.push_back(in.phase);
+        }
+    }
+    double worst_m = 0.0;
+    bool pass = true;
+    for(const std::string &phase : phases){
+        uint32_t n = 0, kept_n = 0, covered = 0;
+        double worst = 0.0, sum = 0.0;
+        for(const input_t &in : fixes){
+            if(in.phase != phase || !has_position(&in.fix)){
+                continue;
+            }
+            n++;
+            kept_n += in.deviation_m == 0.0;
+            if(in.deviation_m >= 0.0){
+                covered++;
+                sum += in.deviation_m;
+                worst = (in.deviation_m > worst) ? in.deviation_m : worst;
+            }
+        }
+        if(n == 0){
+            printf("%-8s %6s\n", phase.c_str(), "no fix");
+            continue;
+        }
+        printf("%-8s %6lu %6lu %6.1f:1 %10.2f %10.2f\n", phase.c_str(), (unsigned long)n, (unsigned long)kept_n, kept_n ? (double)n / kept_n : 0.0,
+               worst, covered ? sum / covered : 0.0);
+        worst_m = (worst > worst_m) ? worst : worst_m;
+    }
+
+    bool within = worst_m <= TRACK_TOLERANCE_M + SLACK_M;
+    bool heartbeat = longest_gap_us <= TRACK_MAX_INTERVAL_US;
+    bool events = events_kept == events_in;
+    bool losses = losses_out == losses_in;
+    printf("\n%lu of %lu fixes kept (%.1f:1), %zu messages queued with the losses of fix; %zu fixes still in the window at the end\n",
+           (unsigned long)points, (unsigned long)positions, (double)positions / points, kept.size(), pending);
+    printf("Largest deviation %.2f m against the kept polyline (tolerance %d m)%s\n", worst_m, TRACK_TOLERANCE_M, within ? "" : "  <- FAIL");
+    printf("Longest time between kept points %.0f s (heartbeat %llu s)%s\n", longest_gap_us / 1e6, TRACK_MAX_INTERVAL_US / 1000000, heartbeat ? "" : "  <- FAIL");
+    printf("Geofence events kept %lu of %lu%s, losses of fix reported %lu of %lu%s\n", (unsigned long)events_kept, (unsigned long)events_in,
+           events ? "" : "  <- FAIL", (unsigned long)losses_out, (unsigned long)losses_in, losses ? "" : "  <- FAIL");
+    printf("track_push: %.0f ns mean, %.0f ns worst per fix on this host\n", total_ns / fixes.size(), worst_ns);
+    track_print_stats();
+
+    pass = within && heartbeat && events && losses;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
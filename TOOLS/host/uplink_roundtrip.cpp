@@ -0,0 +1,323 @@
+/* Host round trip of the uplink batcher (uplink.cpp): samples go through uplink_add()/uplink_service() as the main thread
+ * sends them, the UPL lines of the loopback radio are decoded again here from the format in uplink.h, and every decoded
+ * sample is checked against the one that went in: tick exact in UPLINK_TICK_UNIT_US, other fields within half their step.
+ * Samples that never come out must be the ones the batcher counts as dropped, and payloads must keep the duty cycle.
+ *
+ * Inputs: the day of traces/anomaly_labelled.csv at its 30 s period, the same rows at the NORMAL_MODE 10 s and the
+ * TEST_MODE 2 s periods, and random samples at the edges of every field (jumps, full scale, irregular periods).
+ *
+ *   ./uplink_roundtrip         [trace, default traces/anomaly_labelled.csv]
+ */
+
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+#include "mbed.h"
+#include "uplink.h"
+#include "timebase.h"
+
+#define SERVICE_US          100000ULL                            // uplink_service() every MAIN_THREAD_FREQ
+#define DRAIN_US            (2 * 3600 * 1000000ULL)              // After the last sample: the open payload ages out and the queue empties
+#define RANDOM_SAMPLES      5000
+
+// Same steps as FIELD_STEP in uplink.cpp (the network server decoder keeps its own copy too)
+static const uint8_t FIELD_STEP[UPLINK_FIELD_COUNT] = {1, 1, 1, 1, 10, 50, 10, 10, 4, 4, 4, 4, 16, 16, 16};
+static const char *const FIELD_NAME[UPLINK_FIELD_COUNT] = {"tick", "valid", "alarms", "anomalies", "T", "RH", "SM", "AL",
+                                                           "clear", "red", "green", "blue", "ax", "ay", "az"};
+
+typedef std::array<int64_t, UPLINK_FIELD_COUNT> fields_t;
+
+uint64_t timebase_now_us(){ return host_now_us(); }
+
+// ==============================================================================================
+// CONSOLE: UPL lines of the loopback radio with the tick they went out, and the batcher stats
+// ==============================================================================================
+typedef struct {
+    uint64_t sent_us;
+    unsigned count;                                              // As printed on the UPL line
+    std::vector<uint8_t> data;
+} payload_t;
+
+static std::vector<payload_t> payloads;
+static unsigned long stats_dropped = 0;                          // Last "samples dropped" of uplink_print_stats()
+static unsigned loopback_complaints = 0;
+static std::string line;
+
+static ssize_t capture_write(void *cookie, const char *buffer, size_t size){
+    for(size_t i = 0; i < size; i++){
+        if(buffer[i] == '\r'){
+            continue;                                            // Lines end in "\n\r" on the board console
+        }
+        if(buffer[i] != '\n'){
+            line += buffer[i];
+            continue;
+        }
+        unsigned count;
+        int at = 0;
+        size_t dropped = line.find("samples dropped");
+        if(sscanf(line.c_str(), "UPL,%u,%n", &count, &at) == 1 && at > 0){
+            payload_t p = {host_now_us(), count, {}};
+            for(size_t c = at; c + 1 < line.size() && isxdigit((unsigned char)line[c]); c += 2){
+                p.data.push_back((uint8_t)strtoul(line.substr(c, 2).c_str(), nullptr, 16));
+            }
+            payloads.push_back(p);
+        }else if(dropped != std::string::npos){
+            size_t comma = line.rfind(',', dropped);
+            stats_dropped = strtoul(line.c_str() + comma + 1, nullptr, 10);
+        }else if(line.find("does not decode") != std::string::npos){
+            loopback_complaints++;
+        }
+        line.clear();
+    }
+    return size;
+}
+
+static FILE *report;                                             // The real stdout, the module prints into the capture
+
+static unsigned long dropped_so_far(){
+    uplink_print_stats();
+    return stats_dropped;
+}
+// CONSOLE END ==================================================================================
+
+// ==============================================================================================
+// INDEPENDENT DECODER (from the PAYLOAD FORMAT comment of uplink.h)
+// ==============================================================================================
+static bool get_varint(const std::vector<uint8_t> &in, size_t *pos, uint64_t *value){
+    *value = 0;
+    for(unsigned shift = 0; shift < 64 && *pos < in.size(); shift += 7){
+        uint8_t byte = in[(*pos)++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+// cost[i] counts the bytes of field i, cost[UPLINK_FIELD_COUNT] those of the masks and sample counts
+static bool decode(const std::vector<uint8_t> &in, std::vector<fields_t> *out, size_t cost[UPLINK_FIELD_COUNT + 1]){
+    if(in.empty() || in.size() > UPLINK_PAYLOAD_SIZE){
+        return false;
+    }
+    fields_t f = {};
+    int64_t period = 0;
+    size_t pos = 1;
+    cost[UPLINK_FIELD_COUNT]++;
+    for(unsigned s = 0; s < in[0]; s++){
+        uint64_t mask, value;
+        size_t at = pos;
+        if(!get_varint(in, &pos, &mask) || (mask >> UPLINK_FIELD_COUNT) != 0){
+            return false;
+        }
+        cost[UPLINK_FIELD_COUNT] += pos - at;
+        int64_t tick = f[UPLINK_FIELD_TICK];
+        for(unsigned i = 0; i < UPLINK_FIELD_COUNT; i++){
+            int64_t delta = 0;
+            if((mask >> i) & 1){
+                at = pos;
+                if(!get_varint(in, &pos, &value)){
+                    return false;
+                }
+                cost[i] += pos - at;
+                delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+            }
+            f[i] = (s == 0) ? delta : f[i] + delta;
+        }
+        if(s > 0){
+            f[UPLINK_FIELD_TICK] += period;                      // The tick carries the change of period
+            period = f[UPLINK_FIELD_TICK] - tick;
+        }
+        out->push_back(f);
+    }
+    return pos == in.size();
+}
+
+static fields_t fields_of(const message_t_sensors &s){
+    return {{(int64_t)(s.tick_us / UPLINK_TICK_UNIT_US), s.valid, s.alarms, s.anomalies, s.temperature, s.humidity,
+             s.moistPercAnalogValue, s.lightPercAnalogValue, s.clear, s.red, s.green, s.blue, s.ax, s.ay, s.az}};
+}
+
+// Decoded fields back in the units of message_t_sensors: the tick exact, the others within half a step
+static bool matches(const fields_t &decoded, const fields_t &sent){
+    for(unsigned i = 0; i < UPLINK_FIELD_COUNT; i++){
+        int64_t error = decoded[i] * FIELD_STEP[i] - sent[i];
+        if(llabs(error) > FIELD_STEP[i] / 2){
+            return false;
+        }
+    }
+    return true;
+}
+// INDEPENDENT DECODER END ======================================================================
+
+// ==============================================================================================
+// INPUTS
+// ==============================================================================================
+// Rows of the anomaly trace, ticks relative to the first one, re-timed at period_ms (0 keeps the trace ticks)
+static bool load_trace(const char *path, uint32_t period_ms, size_t max_rows, std::vector<message_t_sensors> *out){
+    FILE *f = fopen(path, "r");
+    if(f == nullptr){
+        fprintf(report, "Cannot open %s\n", path);
+        return false;
+    }
+    char text[256];
+    while(fgets(text, sizeof(text), f) != nullptr && out->size() < max_rows){
+        unsigned long long tick;
+        int t, rh, sm, al, clr, ax, ay, az, valid;
+        if(text[0] == '#' || sscanf(text, "%llu,%d,%d,%d,%d,%d,%d,%d,%d,%d", &tick, &t, &rh, &sm, &al, &clr, &ax, &ay, &az, &valid) != 10){
+            continue;
+        }
+        message_t_sensors s = {};
+        s.tick_us = (period_ms ? (uint64_t)out->size() * period_ms : tick) * 1000;
+        s.temperature = (int16_t)t;
+        s.humidity = (int16_t)rh;
+        s.moistPercAnalogValue = (uint16_t)sm;
+        s.lightPercAnalogValue = (uint16_t)al;
+        s.clear = (uint16_t)clr;
+        s.red = (uint16_t)(clr * 35 / 100);                      // The trace has only the clear channel: a daylight split of it
+        s.green = (uint16_t)(clr * 40 / 100);
+        s.blue = (uint16_t)(clr * 25 / 100);
+        s.ax = (int16_t)ax;
+        s.ay = (int16_t)ay;
+        s.az = (int16_t)az;
+        s.valid = (uint8_t)valid;
+        out->push_back(s);
+    }
+    fclose(f);
+    return !out->empty();
+}
+
+// Random walks with jumps to full scale, random flags and periods from one tick unit to an hour
+static void random_samples(std::vector<message_t_sensors> *out){
+    std::mt19937 rng(45);
+    std::uniform_int_distribution<int> percent(0, 99);
+    int64_t walk[UPLINK_FIELD_COUNT] = {};
+    uint64_t tick_us = 0;
+    for(int n = 0; n < RANDOM_SAMPLES; n++){
+        int p = percent(rng);
+        tick_us += (p < 80) ? 10000000 : (p < 90) ? UPLINK_TICK_UNIT_US * (1 + rng() % 100) : (uint64_t)(rng() % 3600) * 1000000 + UPLINK_TICK_UNIT_US;
+        for(unsigned i = UPLINK_FIELD_TEMPERATURE; i < UPLINK_FIELD_COUNT; i++){
+            int q = percent(rng);
+            bool is_signed = (i == UPLINK_FIELD_TEMPERATURE || i == UPLINK_FIELD_HUMIDITY || i >= UPLINK_FIELD_AX);
+            int64_t low = is_signed ? INT16_MIN : 0, high = is_signed ? INT16_MAX : UINT16_MAX;
+            walk[i] = (q < 3) ? low : (q < 6) ? high : (q < 10) ? low + (int64_t)(rng() % (high - low + 1)) : walk[i] + (int64_t)(rng() % 41) - 20;
+            walk[i] = (walk[i] < low) ? low : (walk[i] > high) ? high : walk[i];
+        }
+        message_t_sensors s = {};
+        s.tick_us = tick_us;
+        s.valid = (percent(rng) < 90) ? MSG_VALID_ALL : (uint8_t)(rng() & MSG_VALID_ALL);
+        s.alarms = (percent(rng) < 80) ? 0 : (uint16_t)rng();
+        s.anomalies = (percent(rng) < 90) ? 0 : (uint8_t)rng();
+        s.temperature = (int16_t)walk[UPLINK_FIELD_TEMPERATURE];
+        s.humidity = (int16_t)walk[UPLINK_FIELD_HUMIDITY];
+        s.moistPercAnalogValue = (uint16_t)walk[UPLINK_FIELD_MOISTURE];
+        s.lightPercAnalogValue = (uint16_t)walk[UPLINK_FIELD_LIGHT];
+        s.clear = (uint16_t)walk[UPLINK_FIELD_CLEAR];
+        s.red = (uint16_t)walk[UPLINK_FIELD_RED];
+        s.green = (uint16_t)walk[UPLINK_FIELD_GREEN];
+        s.blue = (uint16_t)walk[UPLINK_FIELD_BLUE];
+        s.ax = (int16_t)walk[UPLINK_FIELD_AX];
+        s.ay = (int16_t)walk[UPLINK_FIELD_AY];
+        s.az = (int16_t)walk[UPLINK_FIELD_AZ];
+        out->push_back(s);
+    }
+}
+// INPUTS END ===================================================================================
+
+// ==============================================================================================
+// ROUND TRIP
+// ==============================================================================================
+static void run_until(uint64_t tick_us){
+    while(host_now_us() + SERVICE_US <= tick_us){
+        host_advance_us(SERVICE_US);
+        uplink_service();
+    }
+    host_advance_us(tick_us - host_now_us());
+}
+
+// Feed the samples as the main thread does, then decode what went out and compare it with what went in
+static bool round_trip(const char *name, std::vector<message_t_sensors> in){
+    size_t first = payloads.size();
+    unsigned long dropped = dropped_so_far();
+    uint64_t start_us = (host_now_us() / 1000000 + 1) * 1000000;
+    for(message_t_sensors &s : in){
+        s.tick_us += start_us;
+        run_until(s.tick_us);
+        uplink_add(&s);
+        uplink_service();
+    }
+    run_until(host_now_us() + DRAIN_US);
+    dropped = dropped_so_far() - dropped;
+
+    // Each payload must be the next samples that went in, after the ones the batcher dropped
+    bool decoded_ok = true, duty_ok = true;
+    size_t next = 0, lost = 0, delivered = 0, bytes = 0;
+    size_t cost[UPLINK_FIELD_COUNT + 1] = {};
+    uint64_t airtime_us = 0, worst_delay_us = 0;
+    for(size_t p = first; p < payloads.size(); p++){
+        std::vector<fields_t> out;
+        decoded_ok = decoded_ok && decode(payloads[p].data, &out, cost) && out.size() == payloads[p].count && !out.empty();
+        for(; decoded_ok && next < in.size() && fields_of(in[next])[UPLINK_FIELD_TICK] != out[0][UPLINK_FIELD_TICK]; next++){
+            lost++;
+        }
+        for(size_t k = 0; decoded_ok && k < out.size(); k++, next++){
+            decoded_ok = next < in.size() && matches(out[k], fields_of(in[next]));
+            uint64_t delay_us = decoded_ok ? payloads[p].sent_us - in[next].tick_us : 0;
+            worst_delay_us = (delay_us > worst_delay_us) ? delay_us : worst_delay_us;
+        }
+        if(p > 0){
+            uint64_t off_us = (uint64_t)uplink_airtime_us(payloads[p - 1].data.size()) * (1000 - UPLINK_DUTY_CYCLE_PERMILLE) / UPLINK_DUTY_CYCLE_PERMILLE;
+            duty_ok = duty_ok && payloads[p].sent_us - payloads[p - 1].sent_us >= off_us;
+        }
+        delivered += out.size();
+        bytes += payloads[p].data.size();
+        airtime_us += uplink_airtime_us(payloads[p].data.size());
+    }
+    lost += in.size() - next;
+    size_t sent = payloads.size() - first;
+
+    bool ok = decoded_ok && duty_ok && delivered + lost == in.size() && lost == dropped && loopback_complaints == 0 && sent > 0;
+    fprintf(report, "%-30s %7zu %8zu %7.1f %7.1f %8.1f %7zu %7.1f%s\n", name, in.size(), sent, (double)delivered / sent,
+            (double)bytes / delivered, airtime_us / 1000.0 / delivered, lost, worst_delay_us / 60e6, ok ? "" : "  <- FAIL");
+    fprintf(report, "  B/smp by field: masks %.1f", (double)cost[UPLINK_FIELD_COUNT] / delivered);
+    for(unsigned i = 0; i < UPLINK_FIELD_COUNT; i++){
+        fprintf(report, " %s %.1f", FIELD_NAME[i], (double)cost[i] / delivered);
+    }
+    fprintf(report, "\n");
+    if(!ok){
+        fprintf(report, "  decoded %d, duty cycle %d, delivered %zu + lost %zu of %zu, batcher dropped %lu, loopback complaints %u\n",
+                decoded_ok, duty_ok, delivered, lost, in.size(), dropped, loopback_complaints);
+    }
+    return ok;
+}
+// ROUND TRIP END ===============================================================================
+
+int main(int argc, char **argv){
+    const char *path = (argc > 1) ? argv[1] : "traces/anomaly_labelled.csv";
+    report = stdout;
+    cookie_io_functions_t io = {nullptr, capture_write, nullptr, nullptr};
+    stdout = fopencookie(nullptr, "w", io);
+    setvbuf(stdout, nullptr, _IONBF, 0);
+
+    std::vector<message_t_sensors> day, normal, test, edges;
+    if(!load_trace(path, 0, SIZE_MAX, &day) || !load_trace(path, 10000, SIZE_MAX, &normal) || !load_trace(path, 2000, 1800, &test)){
+        return 2;
+    }
+    random_samples(&edges);
+
+    fprintf(report, "SF%d, %d B payloads, %.1f %% duty cycle, %.1f ms for a full payload\n", UPLINK_SPREADING_FACTOR, UPLINK_PAYLOAD_SIZE,
+            UPLINK_DUTY_CYCLE_PERMILLE / 10.0, uplink_airtime_us(UPLINK_PAYLOAD_SIZE) / 1000.0);
+    fprintf(report, "%-30s %7s %8s %7s %7s %8s %7s %7s\n", "input", "samples", "payloads", "smp/pl", "B/smp", "ms/smp", "dropped", "max min");
+    bool pass = round_trip("trace day, 30 s", day);
+    pass = round_trip("trace rows at 10 s (NORMAL)", normal) && pass;
+    pass = round_trip("trace rows at 2 s (TEST), 1 h", test) && pass;
+    pass = round_trip("random, fields at full scale", edges) && pass;
+
+    fprintf(report, "Every decoded sample checked against its input: tick exact, fields within half of");
+    for(unsigned i = UPLINK_FIELD_TEMPERATURE; i < UPLINK_FIELD_COUNT; i++){
+        fprintf(report, " %s %u", FIELD_NAME[i], FIELD_STEP[i]);
+    }
+    fprintf(report, "\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}